@@ -0,0 +1,118 @@
+/*
+ * PARALAX - adaptive sample-rate conversion between clock domains
+ * ThisOldCPU Project - https://github.com/thisoldcpu
+ *
+ * Decoded PCM runs on the Pico's crystal (DacPcmSource's 48 kHz grid over
+ * capture timestamps); a sink such as the USB endpoint consumes at its own
+ * clock. The two differ by tens to hundreds of ppm and drift with
+ * temperature, so a plain FIFO either runs dry or builds latency over a
+ * long recording.
+ *
+ * Asrc sits between them. The producer pushes into a single-producer
+ * single-consumer FIFO; the sink pulls exactly the frames it needs, read
+ * from the FIFO at a fractional step with 4-point cubic (Catmull-Rom)
+ * interpolation. Every CONTROL_FRAMES output frames a PI loop compares the
+ * smoothed FIFO fill with TARGET_FRAMES and steers the step, so latency
+ * settles at the target and the integrator holds the clock ratio.
+ *
+ * Underruns still happen if the producer stalls: the rest of the pull is
+ * padded with the last frame, counted, and the FIFO is primed back to the
+ * target. The burst that follows a stall is skipped back down to the
+ * target rather than drained through the loop. Either way the integrator
+ * is kept, so the loop does not have to relock.
+ *
+ * A sink that stops (USB alt 0) calls set_streaming(false): the producer
+ * keeps running, but its frames are dropped without counting them as
+ * overruns, so overruns only counts frames lost while streaming.
+ *
+ * Fixed point throughout (Q32 step and phase), no allocation.
+ *
+ * License : MIT
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#include <atomic>
+
+#include "dac_pcm.h"
+
+class Asrc : public PcmSink
+{
+public:
+  static constexpr uint32_t CHANNELS = 2;
+  static constexpr uint32_t FIFO_FRAMES = 1024; // power of two, ~21 ms at 48 kHz
+  static constexpr uint32_t TARGET_FRAMES = 192; // 4 ms at 48 kHz
+  static constexpr uint32_t CONTROL_FRAMES = 48; // loop update interval
+  static constexpr uint32_t RESYNC_FRAMES = 192; // fill beyond TARGET + this is skipped
+  static constexpr int32_t MAX_PPM = 2000;       // correction clamp
+
+  static_assert((FIFO_FRAMES & (FIFO_FRAMES - 1)) == 0, "FIFO_FRAMES must be power-of-two");
+
+  Asrc();
+
+  // Only while neither side is running
+  void reset();
+
+  // ---- Producer ----
+  void on_sample(int16_t left, int16_t right) override;
+
+  // ---- Consumer ----
+  // Always fills `frames` interleaved stereo frames
+  void pull(int16_t *out, uint32_t frames);
+
+  // Drop everything queued and prime again (sink stopped or restarted)
+  void flush();
+
+  // Sink started or stopped: flushes, and while stopped the producer's
+  // frames are dropped uncounted (on after reset())
+  void set_streaming(bool on);
+  bool streaming() const { return streaming_.load(std::memory_order_relaxed); }
+
+  bool priming() const { return priming_; }
+  uint32_t fill() const;
+
+  // Smoothed fill in frames, as the loop sees it
+  uint32_t latency_frames() const { return (uint32_t)(fill_q8_ >> 8); }
+
+  // Current correction, input frames consumed per output frame - 1
+  int32_t ratio_ppm() const;
+
+  // The integrator alone: the loop's estimate of the clock offset
+  int32_t clock_ppm() const;
+
+  uint32_t frames_in() const { return frames_in_; }
+  uint32_t frames_out() const { return frames_out_; }
+  uint32_t underruns() const { return underruns_; }
+  uint32_t padded_frames() const { return padded_; }
+  uint32_t overruns() const { return overruns_; }
+  uint32_t skipped_frames() const { return skipped_; }
+
+private:
+  static int16_t interpolate(int32_t p0, int32_t p1, int32_t p2, int32_t p3, int32_t t);
+  void control();
+
+  uint32_t fifo_[FIFO_FRAMES]; // left in the low half, right in the high half
+  std::atomic<uint32_t> head_; // written by the producer
+  std::atomic<uint32_t> tail_; // written by the consumer
+  std::atomic<bool> streaming_; // written by the consumer
+
+  // Producer only
+  uint32_t frames_in_;
+  uint32_t overruns_;
+
+  // Consumer only
+  bool     priming_;
+  uint32_t hist_;      // frame before tail, the first interpolation tap
+  uint32_t last_out_;  // last frame produced, held through underruns
+  uint32_t phase_;     // Q32 position between tail and tail + 1
+  int64_t  step_;      // Q32 input frames per output frame
+  int64_t  integ_;     // PI integrator, Q32 << 8
+  int32_t  fill_q8_;   // smoothed fill, Q8 frames
+  uint32_t until_control_;
+  uint32_t frames_out_;
+  uint32_t underruns_;
+  uint32_t padded_;
+  uint32_t skipped_;
+};
@@ -0,0 +1,99 @@
+/*
+ * PARALAX LPT Sniffer - capture frame shared by firmware and host tools
+ * ThisOldCPU Project - https://github.com/thisoldcpu
+ *
+ * One frame is one snapshot of the DB25 bus: D0..D7 plus the 9 packed
+ * control/status lines, at the electrical level seen on the wire
+ * (active-low lines read 0 when asserted).
+ *
+ * This header must stay free of Arduino / Pico SDK includes so the
+ * decoders built on it also compile on the host.
+ *
+ * License : MIT
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+struct CaptureFrame
+{
+  uint32_t t_us;  // timestamp since start
+  uint8_t  data;  // D0..D7
+  uint8_t  t_sub; // sub-microsecond part, 1/256 us (0 for IRQ-edge capture)
+  uint16_t bits;  // packed 9-bit control/status snapshot
+  // bits layout:
+  // 0 STROBE
+  // 1 ACK
+  // 2 BUSY
+  // 3 AUTOFEED
+  // 4 INIT
+  // 5 SELECTIN
+  // 6 PAPER_OUT
+  // 7 SELECT
+  // 8 ERROR
+};
+
+// Bit indices into CaptureFrame::bits (same order as the CSV columns)
+enum FrameBit : uint8_t
+{
+  FB_STROBE    = 0,
+  FB_ACK       = 1,
+  FB_BUSY      = 2,
+  FB_AUTOFEED  = 3,
+  FB_INIT      = 4,
+  FB_SELECTIN  = 5,
+  FB_PAPER_OUT = 6,
+  FB_SELECT    = 7,
+  FB_ERROR     = 8,
+};
+
+static constexpr uint16_t FRAME_BITS_MASK = 0x01FFu;
+
+// All lines pulled up: what an idle or disconnected port reads as
+static constexpr uint16_t FRAME_BITS_IDLE = FRAME_BITS_MASK;
+
+static inline uint8_t bit_at(uint16_t bits, uint8_t idx)
+{
+  return (uint8_t)((bits >> idx) & 1u);
+}
+
+// Frame time in 1/256 us ticks, for handshake timing below 1 us.
+// Only differences are meaningful: the value wraps with t_us.
+static inline uint32_t frame_ticks(const CaptureFrame &f)
+{
+  return (f.t_us << 8) | f.t_sub;
+}
+
+// Tick difference to nanoseconds
+static inline uint32_t ticks_to_ns(uint32_t ticks)
+{
+  return (uint32_t)(((uint64_t)ticks * 1000u) >> 8);
+}
+
+// Edge helpers between two consecutive snapshots
+static inline bool bit_fell(uint16_t prev, uint16_t cur, uint8_t idx)
+{
+  return bit_at(prev, idx) && !bit_at(cur, idx);
+}
+
+static inline bool bit_rose(uint16_t prev, uint16_t cur, uint8_t idx)
+{
+  return !bit_at(prev, idx) && bit_at(cur, idx);
+}
+
+// t_us is 32-bit and wraps every ~71.6 minutes. Feed timestamps in capture
+// order to get a monotonic 64-bit time for long sessions.
+struct TimeUnwrapper
+{
+  uint32_t last = 0;
+  uint64_t high = 0;
+
+  uint64_t extend(uint32_t t_us)
+  {
+    if (t_us < last && (last - t_us) > 0x80000000u)
+      high += 0x100000000ull;
+    last = t_us;
+    return high | t_us;
+  }
+};
@@ -0,0 +1,74 @@
+/*
+ * PARALAX - streaming change-point detection over classifier windows
+ * ThisOldCPU Project - https://github.com/thisoldcpu
+ *
+ * Splits a capture into segments that each look like one device. Every
+ * DeviceClassifier window becomes a feature vector (per-device scores,
+ * which already fold in strobe timing, control-line usage and data
+ * statistics, plus the log2 event rate). A one-sided CUSUM tracks how far
+ * windows drift from the open segment's mean; once the excess passes
+ * THRESHOLD the segment is closed where the drift began and the deviating
+ * windows seed the next one. A silence longer than GAP_US always splits.
+ *
+ * One linear pass, O(1) per window, no allocation.
+ *
+ * License : MIT
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#include "device_classifier.h"
+
+struct CaptureSegment
+{
+  uint32_t  start_us;    // first bus event
+  uint32_t  end_us;      // last bus event
+  uint32_t  first_frame; // classifier frame index of the first event
+  uint32_t  windows;
+  LptDevice device;
+  uint8_t   confidence;  // 0..100
+};
+
+class ChangePointDetector
+{
+public:
+  static constexpr uint32_t FEATURES = DEV_COUNT + 1;
+  static constexpr uint32_t DRIFT = 40;      // L1 distance per window taken as noise
+  static constexpr uint32_t THRESHOLD = 240; // accumulated excess that is a change
+  static constexpr uint32_t GAP_US = 1000000;
+
+  ChangePointDetector();
+
+  void reset();
+
+  // Returns true and fills `out` when a change point closes a segment
+  bool add(const DeviceWindow &w, CaptureSegment &out);
+
+  // Close the open segment (end of capture)
+  bool finish(CaptureSegment &out);
+
+  uint32_t segments() const { return segments_; }
+
+private:
+  struct Accum
+  {
+    uint32_t sum[FEATURES];
+    uint32_t n;
+    uint32_t start_us;
+    uint32_t end_us;
+    uint32_t first_frame;
+  };
+
+  static void features(const DeviceWindow &w, uint32_t *out);
+  static void clear(Accum &a);
+  static void add_window(Accum &a, const DeviceWindow &w, const uint32_t *feat);
+  static void merge(Accum &into, const Accum &from);
+  bool close(CaptureSegment &out);
+
+  Accum    seg_;
+  Accum    pend_; // windows since the drift began
+  uint32_t cusum_;
+  uint32_t segments_;
+};
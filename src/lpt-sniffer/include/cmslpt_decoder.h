@@ -0,0 +1,73 @@
+/*
+ * PARALAX - CMSLPT decoder (Creative Music System / twin SAA1099 over LPT)
+ * ThisOldCPU Project - https://github.com/thisoldcpu
+ *
+ * The adapter puts the byte on D0..D7, selects address (A0=1) or data
+ * (A0=0) with one control line and pulses a per-chip write line. The
+ * decoder latches the register address per chip and emits one CmsWrite
+ * for every data write, stamped with the time of the write edge.
+ *
+ * O(1) per frame, no allocation: safe for the firmware and fast on the host.
+ *
+ * License : MIT
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#include "capture_frame.h"
+
+// SAA1099 register file is 0x00..0x1F; anything above is a bus error
+static constexpr uint8_t SAA1099_REG_COUNT = 0x20;
+
+struct CmsWrite
+{
+  uint32_t t_us;  // time of the write strobe edge
+  uint8_t  chip;  // 0 = left SAA1099, 1 = right SAA1099
+  uint8_t  reg;   // latched register address
+  uint8_t  value; // data byte
+};
+
+// Which control lines carry the chip write strobes and A0.
+// Write strobes are active low; A0 is sampled at the write edge.
+struct CmsLptWiring
+{
+  uint8_t wr_bit[2]; // FrameBit index of /WR for chip 0 and chip 1
+  uint8_t a0_bit;    // FrameBit index of A0 (high = address, low = data)
+};
+
+// Default wiring: STROBE -> chip 0 /WR, AUTOFEED -> chip 1 /WR, INIT -> A0.
+// Clones that route the lines differently only need a different table.
+static constexpr CmsLptWiring CMSLPT_DEFAULT_WIRING = {{FB_STROBE, FB_AUTOFEED}, FB_INIT};
+
+class CmsLptDecoder
+{
+public:
+  explicit CmsLptDecoder(const CmsLptWiring &wiring = CMSLPT_DEFAULT_WIRING);
+
+  void reset();
+
+  // Feed one capture frame. Returns true and fills `out` when the frame
+  // completes a data write to one of the chips.
+  bool feed(const CaptureFrame &f, CmsWrite &out);
+
+  uint32_t address_writes(uint8_t chip) const { return addr_writes_[chip & 1u]; }
+  uint32_t data_writes(uint8_t chip) const { return data_writes_[chip & 1u]; }
+
+  // Protocol violations: data before any address, address out of range,
+  // or both write strobes falling in the same frame.
+  uint32_t violations() const { return violations_; }
+
+private:
+  CmsLptWiring wiring_;
+
+  bool     primed_;
+  uint16_t prev_bits_;
+  uint8_t  addr_[2];
+  bool     addr_valid_[2];
+
+  uint32_t addr_writes_[2];
+  uint32_t data_writes_[2];
+  uint32_t violations_;
+};
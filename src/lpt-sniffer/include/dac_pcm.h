@@ -0,0 +1,108 @@
+/*
+ * PARALAX - Covox / DSS events to a 48 kHz PCM stream
+ * ThisOldCPU Project - https://github.com/thisoldcpu
+ *
+ * Rebuilds what the DAC put on its output from decoded DeviceEvents. A
+ * Covox holds each written byte until the next write, so the held value is
+ * sampled on a 48 kHz grid laid over the event timestamps. A Disney Sound
+ * Source queues bytes in its 16-byte FIFO and plays them at its own
+ * ~7 kHz; writes fill the FIFO, the grid drains it.
+ *
+ * Time only moves with events and advance(); the firmware calls advance()
+ * with the current capture time minus a little holdback, so silence keeps
+ * the stream flowing. Events older than the grid (a replayed speculative
+ * prefix) only update the held value.
+ *
+ * Covox writes also go through a PitClock. Once it has found the timer
+ * divisor the program plays at, each write takes effect at its slot on
+ * the recovered grid instead of at its jittered timestamp, so the held
+ * signal steps at the exact rate the program meant.
+ *
+ * Unsigned 8-bit DAC values become signed 16-bit, the same on both
+ * channels. O(1) per output sample, no allocation.
+ *
+ * License : MIT
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#include "device_decoders.h"
+#include "pit_clock.h"
+
+class PcmSink
+{
+public:
+  virtual ~PcmSink() = default;
+  virtual void on_sample(int16_t left, int16_t right) = 0;
+};
+
+// Hands every sample to two sinks, e.g. USB and the headphone monitor
+class PcmTee : public PcmSink
+{
+public:
+  PcmTee(PcmSink &a, PcmSink &b) : a_(a), b_(b) {}
+
+  void on_sample(int16_t left, int16_t right) override
+  {
+    a_.on_sample(left, right);
+    b_.on_sample(left, right);
+  }
+
+private:
+  PcmSink &a_;
+  PcmSink &b_;
+};
+
+class DacPcmSource
+{
+public:
+  static constexpr uint32_t RATE_HZ = 48000;
+  static constexpr uint32_t DSS_RATE_HZ = 7000;
+  static constexpr uint32_t DSS_FIFO = 16;
+  static constexpr uint32_t MAX_GAP_US = 100000; // longer jumps restart the grid
+  static constexpr uint32_t HOLDBACK_US = 1000;  // advance() this far behind live
+
+  explicit DacPcmSource(PcmSink &sink);
+
+  void reset();
+
+  // Covox and DSS events; anything else is ignored
+  void on_event(const DeviceEvent &e);
+
+  // Emit every sample due up to t_us
+  void advance(uint32_t t_us);
+
+  uint32_t samples() const { return samples_; }
+  uint32_t late_events() const { return late_; }
+  uint32_t dss_overflows() const { return dss_overflows_; }
+  uint32_t resyncs() const { return resyncs_; }
+  const PitClock &pit() const { return pit_; }
+
+private:
+  void start(uint32_t t_us);
+  void advance_to(uint32_t t_us, int32_t offset_q16);
+  void run_until(uint64_t end);
+
+  PcmSink &sink_;
+
+  bool     started_;
+  uint8_t  device_;
+  uint8_t  held_;
+  uint32_t last_t_;
+  uint64_t now_us_;    // unwrapped event time
+  uint64_t grid_;      // next output sample, in us * RATE_HZ
+  uint32_t dss_phase_; // DSS clock against the output clock
+
+  PitClock pit_;
+
+  uint8_t dss_fifo_[DSS_FIFO];
+  uint8_t dss_head_;
+  uint8_t dss_count_;
+
+  uint32_t samples_;
+  uint32_t late_;
+  uint32_t dss_overflows_;
+  uint32_t resyncs_;
+};
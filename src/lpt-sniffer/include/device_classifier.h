@@ -0,0 +1,132 @@
+/*
+ * PARALAX - streaming LPT device classifier
+ * ThisOldCPU Project - https://github.com/thisoldcpu
+ *
+ * Online replacement for the batch statistics in analyze_capture.py. Every
+ * frame updates a handful of counters; a window closes after WINDOW_EVENTS
+ * bus events (or WINDOW_MAX_US), is scored against each device signature
+ * and cleared. A device is announced once it wins COMMIT_WINDOWS windows in
+ * a row, so a 22 kHz Covox is named within ~6 ms and an OPL2LPT within a
+ * few dozen register writes.
+ *
+ * Signatures (wire levels; a "write" is a control line falling):
+ *   Covox    data changes only, steady 4..48 kHz, wide value spread
+ *   DSS      SELECTIN pulse per byte, ACK/BUSY FIFO handshake, ~7 kHz
+ *   OPL2LPT  INIT pulse per write, STROBE (A0) alternating address/data,
+ *            addresses <= 0xF5
+ *   TNDLPT   INIT pulse per write, STROBE static, SN76489 latch bytes
+ *            (bit 7 set) mixed with data bytes
+ *   CMSLPT   STROBE/AUTOFEED pulse per write, INIT (A0) alternating,
+ *            addresses < 0x20 (CMSLPT_DEFAULT_WIRING)
+ *
+ * O(1) per frame, no allocation, ~100 bytes of state.
+ *
+ * License : MIT
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#include "capture_frame.h"
+
+enum LptDevice : uint8_t
+{
+  DEV_UNKNOWN = 0,
+  DEV_COVOX,
+  DEV_DSS,
+  DEV_OPL2LPT,
+  DEV_TNDLPT,
+  DEV_CMSLPT,
+  DEV_COUNT
+};
+
+const char *lpt_device_name(LptDevice device);
+
+struct DeviceGuess
+{
+  uint32_t  t_us;       // frame that closed the deciding window
+  LptDevice device;
+  uint8_t   confidence; // 0..100
+  uint32_t  event_hz;   // bus event rate of the deciding window
+};
+
+// One scored window, for consumers that look at more than the verdict
+struct DeviceWindow
+{
+  uint32_t start_us;    // first bus event
+  uint32_t end_us;      // last bus event
+  uint32_t first_frame; // index of the first event's frame since reset()
+  uint16_t events;
+  uint32_t event_hz;
+  uint8_t  scores[DEV_COUNT]; // 0..100; [DEV_UNKNOWN] = 100 - best
+};
+
+class DeviceClassifier
+{
+public:
+  static constexpr uint32_t WINDOW_EVENTS = 64;
+  static constexpr uint32_t WINDOW_MAX_US = 50000;
+  static constexpr uint32_t MIN_EVENTS = 12;     // fewer in WINDOW_MAX_US: no verdict
+  static constexpr uint8_t  COMMIT_SCORE = 60;   // a window needs this to count as a win
+  static constexpr uint8_t  COMMIT_WINDOWS = 2;
+
+  DeviceClassifier();
+
+  void reset();
+
+  // Returns true and fills `out` when the announced device changes
+  bool feed(const CaptureFrame &f, DeviceGuess &out);
+
+  LptDevice device() const { return device_; }
+  uint8_t confidence() const { return confidence_; }
+
+  // Last evaluated window; windows() counts them
+  const DeviceWindow &last_window() const { return window_; }
+  uint32_t windows() const { return windows_; }
+
+  uint8_t score(LptDevice device) const { return window_.scores[device < DEV_COUNT ? device : 0]; }
+  uint32_t event_hz() const { return window_.event_hz; }
+
+private:
+  void clear_window();
+  void score_window();
+  bool evaluate(uint32_t t_us, DeviceGuess &out);
+
+  // Window counters
+  uint32_t first_event_us_;
+  uint32_t first_event_frame_;
+  uint32_t last_event_us_;
+  uint16_t events_;
+  uint16_t data_changes_;
+  uint16_t falls_[4];        // STROBE, AUTOFEED, INIT, SELECTIN
+  uint16_t status_edges_;    // ACK, BUSY
+  uint16_t gap_hist_[16];    // log2 buckets of data-change gaps in us
+  uint32_t seen_[8];         // distinct data values (bitmap)
+  uint16_t distinct_;
+  uint16_t init_a0_flips_;   // STROBE level changed since the last INIT fall
+  uint16_t init_addr_ok_;    // INIT fall with STROBE low and data <= 0xF5
+  uint16_t init_addr_;       // INIT fall with STROBE low
+  uint16_t init_latch_;      // INIT fall with data bit 7 set
+  uint16_t cms_a0_flips_;    // INIT level changed since the last STROBE/AUTOFEED fall
+  uint16_t cms_addr_ok_;     // STROBE/AUTOFEED fall with INIT high and data < 0x20
+  uint16_t cms_addr_;        // STROBE/AUTOFEED fall with INIT high
+
+  // Carried across windows
+  bool     primed_;
+  uint16_t prev_bits_;
+  uint8_t  prev_data_;
+  uint32_t last_change_us_;
+  bool     have_change_;
+  uint8_t  last_init_a0_;
+  uint8_t  last_cms_a0_;
+
+  uint32_t     frames_;
+  DeviceWindow window_;
+  LptDevice leader_;
+  uint8_t   leader_conf_;
+  uint8_t   streak_;
+  LptDevice device_;
+  uint8_t   confidence_;
+  uint32_t  windows_;
+};
@@ -0,0 +1,136 @@
+/*
+ * PARALAX - per-device decoders behind one interface
+ * ThisOldCPU Project - https://github.com/thisoldcpu
+ *
+ * One decoder per DeviceClassifier class, each turning capture frames into
+ * DeviceEvents (DAC samples, chip register writes) and counting frames
+ * that its device could not have produced. The counts are what lets a
+ * speculative run switch a wrong candidate off early.
+ *
+ * Wiring follows the classifier's signatures: OPL2LPT and TNDLPT write on
+ * INIT with STROBE as A0, DSS latches on SELECTIN, CMSLPT uses
+ * CMSLPT_DEFAULT_WIRING.
+ *
+ * O(1) per frame, no allocation.
+ *
+ * License : MIT
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#include "capture_frame.h"
+#include "cmslpt_decoder.h"
+#include "device_classifier.h"
+
+struct DeviceEvent
+{
+  uint32_t t_us;
+  uint8_t  device; // LptDevice
+  uint8_t  chip;   // CMSLPT chip, otherwise 0
+  uint8_t  reg;    // OPL2LPT / CMSLPT register, otherwise 0
+  uint8_t  value;  // DAC sample, register value or SN76489 byte
+};
+
+class DeviceDecoder
+{
+public:
+  virtual ~DeviceDecoder() = default;
+
+  virtual LptDevice device() const = 0;
+  virtual void reset() = 0;
+
+  // Returns true and fills `out` when the frame produces an event
+  virtual bool feed(const CaptureFrame &f, DeviceEvent &out) = 0;
+
+  // Frames this device could not have produced
+  virtual uint32_t violations() const = 0;
+};
+
+// Covox: every data change is a sample. STROBE is allowed (latched clones).
+class CovoxDecoder : public DeviceDecoder
+{
+public:
+  CovoxDecoder() { reset(); }
+
+  LptDevice device() const override { return DEV_COVOX; }
+  void reset() override;
+  bool feed(const CaptureFrame &f, DeviceEvent &out) override;
+  uint32_t violations() const override { return violations_; }
+
+private:
+  bool     primed_;
+  uint8_t  prev_data_;
+  uint16_t prev_bits_;
+  uint32_t violations_;
+};
+
+// Disney Sound Source: SELECTIN falling latches the byte into the FIFO
+class DssDecoder : public DeviceDecoder
+{
+public:
+  DssDecoder() { reset(); }
+
+  LptDevice device() const override { return DEV_DSS; }
+  void reset() override;
+  bool feed(const CaptureFrame &f, DeviceEvent &out) override;
+  uint32_t violations() const override { return violations_; }
+
+private:
+  bool     primed_;
+  uint16_t prev_bits_;
+  uint32_t violations_;
+};
+
+// OPL2LPT: INIT falling writes; STROBE low = address, high = data
+class Opl2LptDecoder : public DeviceDecoder
+{
+public:
+  Opl2LptDecoder() { reset(); }
+
+  LptDevice device() const override { return DEV_OPL2LPT; }
+  void reset() override;
+  bool feed(const CaptureFrame &f, DeviceEvent &out) override;
+  uint32_t violations() const override { return violations_; }
+
+private:
+  bool     primed_;
+  uint16_t prev_bits_;
+  uint8_t  addr_;
+  bool     addr_valid_;
+  uint32_t violations_;
+};
+
+// TNDLPT: INIT falling writes one SN76489 byte; no A0, so STROBE stays put
+class TndLptDecoder : public DeviceDecoder
+{
+public:
+  TndLptDecoder() { reset(); }
+
+  LptDevice device() const override { return DEV_TNDLPT; }
+  void reset() override;
+  bool feed(const CaptureFrame &f, DeviceEvent &out) override;
+  uint32_t violations() const override { return violations_; }
+
+private:
+  bool     primed_;
+  uint16_t prev_bits_;
+  bool     latched_;
+  uint32_t violations_;
+};
+
+// CMSLPT through the existing CmsLptDecoder
+class CmsLptDeviceDecoder : public DeviceDecoder
+{
+public:
+  CmsLptDeviceDecoder() = default;
+
+  LptDevice device() const override { return DEV_CMSLPT; }
+  void reset() override { dec_.reset(); }
+  bool feed(const CaptureFrame &f, DeviceEvent &out) override;
+  uint32_t violations() const override { return dec_.violations(); }
+
+private:
+  CmsLptDecoder dec_;
+};
@@ -0,0 +1,100 @@
+/*
+ * PARALAX - IEEE 1284 ECP decoder with run-length expansion
+ * ThisOldCPU Project - https://github.com/thisoldcpu
+ *
+ * ECP signal names on the sniffer lines (wire levels):
+ *   HostClk         = STROBE     forward clock (falls = byte valid)
+ *   HostAck         = AUTOFEED   forward: high = data, low = command
+ *                                reverse: host handshake
+ *   PeriphAck       = BUSY       forward: peripheral handshake
+ *                                reverse: high = data, low = command
+ *   PeriphClk       = ACK        reverse clock (falls = byte valid)
+ *   nReverseRequest = INIT       low = host asks for the reverse channel
+ *   nAckReverse     = PAPER_OUT  low = peripheral granted reverse
+ *
+ * Command bytes: bit 7 clear = run-length count, the next data byte is
+ * repeated count + 1 times; bit 7 set = channel address (bits 6..0).
+ * The decoder emits one EcpEvent per data byte (with its expanded run
+ * length) or channel address, at the end of its handshake.
+ *
+ * License : MIT
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#include "capture_frame.h"
+
+enum EcpPhase : uint8_t
+{
+  ECP_FORWARD = 0,
+  ECP_REVERSE = 1,
+  ECP_TURNAROUND = 2, // between request and grant, either way
+};
+
+enum EcpItem : uint8_t
+{
+  ECP_ITEM_DATA = 0,
+  ECP_ITEM_CHANNEL = 1,
+};
+
+struct EcpEvent
+{
+  uint32_t t_us;     // clock edge time
+  uint8_t  t_sub;    // 1/256 us
+  uint8_t  dir;      // ECP_FORWARD or ECP_REVERSE
+  uint8_t  item;     // EcpItem
+  uint8_t  value;    // data byte or channel address
+  uint8_t  run;      // data: logical repeat count 1..128 (1 = no RLE)
+  uint32_t cycle_ns; // clock fall -> clock rise
+};
+
+class EcpDecoder
+{
+public:
+  EcpDecoder();
+
+  void reset();
+
+  // Start decoding mid-stream: `bits` is the frame before the first one
+  // fed. Drops any cycle or pending run, keeps the counters.
+  void resync(uint16_t bits);
+
+  // Returns true and fills `out` when a data or channel cycle completes.
+  // Run-length commands update state only; their count shows up in the
+  // `run` of the following data event.
+  bool feed(const CaptureFrame &f, EcpEvent &out);
+
+  EcpPhase phase() const { return phase_; }
+
+  // Per direction (ECP_FORWARD / ECP_REVERSE)
+  uint32_t wire_cycles(uint8_t dir) const { return wire_cycles_[dir & 1u]; }
+  uint32_t rle_commands(uint8_t dir) const { return rle_commands_[dir & 1u]; }
+  uint64_t logical_bytes(uint8_t dir) const { return logical_bytes_[dir & 1u]; }
+  uint32_t phase_changes() const { return phase_changes_; }
+
+  // Clock edges outside their phase, or a run-length command not followed by data
+  uint32_t violations() const { return violations_; }
+
+private:
+  void update_phase(uint16_t cur);
+
+  uint16_t prev_bits_;
+  EcpPhase phase_;
+
+  bool     in_cycle_;
+  bool     cycle_is_cmd_;
+  uint8_t  cycle_value_;
+  uint32_t cycle_us_;
+  uint8_t  cycle_sub_;
+  uint32_t cycle_ticks_;
+
+  uint8_t  pending_run_[2]; // 0 = none
+
+  uint32_t wire_cycles_[2];
+  uint32_t rle_commands_[2];
+  uint64_t logical_bytes_[2];
+  uint32_t phase_changes_;
+  uint32_t violations_;
+};
@@ -0,0 +1,84 @@
+/*
+ * PARALAX - IEEE 1284 EPP cycle decoder
+ * ThisOldCPU Project - https://github.com/thisoldcpu
+ *
+ * EPP signal names on the sniffer lines (wire levels, all active low):
+ *   nWrite      = STROBE    (low = host writes, high = host reads)
+ *   nDataStrobe = AUTOFEED
+ *   nAddrStrobe = SELECTIN
+ *   nWait       = BUSY      (peripheral raises it to acknowledge)
+ *
+ * A cycle runs strobe low -> nWait high -> strobe high. The decoder emits
+ * one EppCycle at strobe release with the byte, the ack latency and the
+ * full handshake time. Needs the PIO capture profile for real EPP rates;
+ * with IRQ-edge capture the timing is only good to ~1 us.
+ *
+ * License : MIT
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#include "capture_frame.h"
+
+enum EppCycleType : uint8_t
+{
+  EPP_DATA = 0,
+  EPP_ADDR = 1,
+};
+
+enum EppDirection : uint8_t
+{
+  EPP_WRITE = 0, // host -> peripheral
+  EPP_READ  = 1, // peripheral -> host
+};
+
+struct EppCycle
+{
+  uint32_t t_us;     // strobe assert time
+  uint8_t  t_sub;    // 1/256 us
+  uint8_t  type;     // EppCycleType
+  uint8_t  dir;      // EppDirection
+  uint8_t  value;    // byte transferred
+  bool     acked;    // false = host gave up (EPP timeout)
+  uint32_t ack_ns;   // strobe assert -> nWait high
+  uint32_t cycle_ns; // strobe assert -> strobe release
+};
+
+class EppDecoder
+{
+public:
+  EppDecoder();
+
+  void reset();
+
+  // Start decoding mid-stream: `bits` is the frame before the first one
+  // fed. Drops any cycle in progress, keeps the counters.
+  void resync(uint16_t bits);
+
+  // Returns true and fills `out` when the frame ends an EPP cycle.
+  bool feed(const CaptureFrame &f, EppCycle &out);
+
+  uint32_t cycles(uint8_t type, uint8_t dir) const { return cycles_[type & 1u][dir & 1u]; }
+  uint32_t timeouts() const { return timeouts_; }
+
+  // Both strobes asserted together, or nWrite changing mid-cycle
+  uint32_t violations() const { return violations_; }
+
+private:
+  uint16_t prev_bits_;
+  bool     in_cycle_;
+  bool     acked_;
+  uint8_t  type_;
+  uint8_t  dir_;
+  uint8_t  value_;
+  uint32_t start_us_;
+  uint8_t  start_sub_;
+  uint32_t start_ticks_;
+  uint32_t ack_ticks_;
+
+  uint32_t cycles_[2][2];
+  uint32_t timeouts_;
+  uint32_t violations_;
+};
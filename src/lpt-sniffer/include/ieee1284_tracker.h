@@ -0,0 +1,169 @@
+/*
+ * PARALAX - IEEE 1284 negotiation tracker and mode-switching session
+ * ThisOldCPU Project - https://github.com/thisoldcpu
+ *
+ * Ieee1284Tracker follows the negotiation handshake in the frame stream:
+ *   event 0  host: extensibility byte on D0..D7, SELECTIN high, AUTOFEED low
+ *   event 2  peripheral: ACK low, PAPER_OUT high, SELECT high, ERROR high
+ *   event 3  host: STROBE low (latches the byte), event 4: STROBE + AUTOFEED high
+ *   event 6  peripheral: ACK high, SELECT = XFlag (mode accepted)
+ * and termination (SELECTIN low; INIT low for EPP) back to compatibility.
+ *
+ * Ieee1284Session runs the tracker in front of the per-mode decoders and
+ * hands each frame to exactly one of them. Negotiation frames are held
+ * back; if the negotiation fails they are replayed to the compatibility
+ * sink, so no frame is lost or decoded twice around a switch.
+ *
+ * License : MIT
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#include "capture_frame.h"
+#include "ecp_decoder.h"
+#include "epp_decoder.h"
+#include "reverse_decoder.h"
+
+enum Ieee1284Mode : uint8_t
+{
+  M1284_COMPAT = 0,
+  M1284_NIBBLE = 1,
+  M1284_BYTE   = 2,
+  M1284_ECP    = 3,
+  M1284_EPP    = 4,
+};
+
+// Extensibility byte bits
+static constexpr uint8_t EXT_BYTE_MODE = 0x01;
+static constexpr uint8_t EXT_DEVICE_ID = 0x04;
+static constexpr uint8_t EXT_ECP_MODE  = 0x10;
+static constexpr uint8_t EXT_ECP_RLE   = 0x20;
+static constexpr uint8_t EXT_EPP_MODE  = 0x40;
+
+// IEEE 1284 hosts give up on a silent peripheral after 35 ms, but DOS
+// drivers often time it with the 55 ms BIOS tick; 50 ms keeps a slow
+// host's negotiation from being dropped before it gives up itself
+static constexpr uint32_t NEGOTIATION_TIMEOUT_US = 50000;
+
+const char *ieee1284_mode_name(Ieee1284Mode mode);
+Ieee1284Mode ieee1284_mode_from_ext(uint8_t ext);
+
+struct Ieee1284Transition
+{
+  uint32_t     t_us;      // frame where the new mode takes effect
+  Ieee1284Mode from;
+  Ieee1284Mode to;
+  uint8_t      ext;       // extensibility byte (0 for termination)
+  bool         accepted;  // false = peripheral refused, mode stays COMPAT
+  bool         device_id; // request was for the IEEE 1284 device ID
+};
+
+enum Ieee1284Step : uint8_t
+{
+  STEP_NONE = 0,        // frame belongs to the current mode
+  STEP_NEGOTIATING,     // frame is part of a negotiation in progress
+  STEP_ABORTED,         // negotiation abandoned; held frames belong to COMPAT
+  STEP_SWITCHED,        // mode changed at this frame (see transition())
+};
+
+class Ieee1284Tracker
+{
+public:
+  Ieee1284Tracker();
+
+  void reset();
+
+  Ieee1284Step feed(const CaptureFrame &f);
+
+  // Drop a negotiation in progress (counted as an abort)
+  void cancel();
+
+  Ieee1284Mode mode() const { return mode_; }
+  const Ieee1284Transition &transition() const { return last_; }
+
+  uint32_t negotiations() const { return negotiations_; }
+  uint32_t refusals() const { return refusals_; }
+  uint32_t aborts() const { return aborts_; }
+
+private:
+  enum NegState : uint8_t
+  {
+    NEG_IDLE,
+    NEG_REQUESTED, // event 0 seen, waiting for event 2
+    NEG_ACKED,     // waiting for the STROBE latch
+    NEG_LATCHED,   // waiting for STROBE + AUTOFEED release
+    NEG_RELEASED,  // waiting for ACK high + XFlag
+  };
+
+  Ieee1284Step switch_to(const CaptureFrame &f, Ieee1284Mode to, uint8_t ext, bool accepted);
+
+  uint16_t     prev_bits_;
+  Ieee1284Mode mode_;
+  NegState     neg_;
+  uint8_t      ext_;
+  uint32_t     neg_start_us_;
+
+  Ieee1284Transition last_;
+  uint32_t negotiations_;
+  uint32_t refusals_;
+  uint32_t aborts_;
+};
+
+// Receives the routed output of an Ieee1284Session
+class Ieee1284Sink
+{
+public:
+  virtual ~Ieee1284Sink() = default;
+
+  virtual void on_transition(const Ieee1284Transition &t) { (void)t; }
+
+  // Compatibility-mode frames (Centronics printers, Covox, OPLxLPT, ...)
+  virtual void on_compat_frame(const CaptureFrame &f) { (void)f; }
+
+  // Nibble / byte mode reverse-channel bytes (mode = M1284_NIBBLE or M1284_BYTE)
+  virtual void on_reverse(Ieee1284Mode mode, const ReverseByte &b)
+  {
+    (void)mode;
+    (void)b;
+  }
+
+  virtual void on_epp(const EppCycle &c) { (void)c; }
+  virtual void on_ecp(const EcpEvent &e) { (void)e; }
+};
+
+class Ieee1284Session
+{
+public:
+  explicit Ieee1284Session(Ieee1284Sink &sink);
+
+  void reset();
+  void feed(const CaptureFrame &f);
+
+  Ieee1284Mode mode() const { return tracker_.mode(); }
+  const Ieee1284Tracker &tracker() const { return tracker_; }
+  const EppDecoder &epp() const { return epp_; }
+  const EcpDecoder &ecp() const { return ecp_; }
+  const ReverseChannelDecoder &reverse() const { return rev_; }
+
+  // Negotiations too long for the hold buffer, replayed as compat traffic
+  uint32_t hold_overflows() const { return hold_overflows_; }
+
+private:
+  static constexpr uint32_t HOLD_FRAMES = 64;
+
+  void route(const CaptureFrame &f);
+  void release_held();
+
+  Ieee1284Sink   &sink_;
+  Ieee1284Tracker tracker_;
+  EppDecoder      epp_;
+  EcpDecoder      ecp_;
+  ReverseChannelDecoder rev_;
+  uint16_t        prev_bits_;
+
+  CaptureFrame held_[HOLD_FRAMES];
+  uint32_t     held_count_;
+  uint32_t     hold_overflows_;
+};
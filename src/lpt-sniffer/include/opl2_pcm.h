@@ -0,0 +1,86 @@
+/*
+ * PARALAX - OPL2LPT register stream to a 48 kHz PCM stream
+ * ThisOldCPU Project - https://github.com/thisoldcpu
+ *
+ * Feeds decoded OPL2LPT writes to an Opl2Synth at their capture time and
+ * puts its output on the same 48 kHz grid DacPcmSource uses, so either can
+ * drive the Asrc and the USB endpoint.
+ *
+ * The synth runs at the chip's rate (~49716 Hz); an exact integer ratio
+ * (3579545 : 72 * 48000) steps it against the grid and consecutive native
+ * samples are linearly interpolated by an 8-bit fraction, which is what
+ * the SIO interpolator's blend mode takes (pcm_blend, see pcm_interp.h).
+ * A write lands between the native samples either side of its timestamp
+ * (~20 us).
+ *
+ * Time moves with events and advance(), exactly as in DacPcmSource; late
+ * events (a replayed speculative prefix) are still written to the synth so
+ * its register state is right, just without moving time back.
+ *
+ * License : MIT
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#include "dac_pcm.h"
+#include "opl2_synth.h"
+
+class Opl2PcmSource
+{
+public:
+  static constexpr uint32_t RATE_HZ = DacPcmSource::RATE_HZ;
+  static constexpr uint32_t MAX_GAP_US = DacPcmSource::MAX_GAP_US;
+  static constexpr uint32_t HOLDBACK_US = DacPcmSource::HOLDBACK_US;
+
+  explicit Opl2PcmSource(PcmSink &sink);
+
+  void reset();
+
+  // OPL2LPT events; anything else is ignored
+  void on_event(const DeviceEvent &e);
+
+  // Emit every sample due up to t_us
+  void advance(uint32_t t_us);
+
+  const Opl2Synth &synth() const { return synth_; }
+
+  uint32_t samples() const { return samples_; }
+  uint32_t native_samples() const { return native_; }
+  uint32_t writes() const { return writes_; }
+  uint32_t late_events() const { return late_; }
+  uint32_t resyncs() const { return resyncs_; }
+
+private:
+  // Native samples per output sample, as an exact fraction
+  static constexpr uint32_t STEP_NUM = Opl2Synth::CLOCK_HZ;
+  static constexpr uint32_t STEP_DEN = Opl2Synth::CLOCKS_PER_SAMPLE * RATE_HZ;
+
+  // Blend fraction without a divide: ((frac_ >> ALPHA_SHIFT) * ALPHA_MUL) >> 24
+  static constexpr uint32_t ALPHA_SHIFT = 6;
+  static constexpr uint32_t ALPHA_MUL = (uint32_t)((1ull << 32) / (STEP_DEN >> ALPHA_SHIFT));
+
+  static_assert((uint64_t)((STEP_DEN - 1) >> ALPHA_SHIFT) * ALPHA_MUL < (1ull << 32),
+                "blend fraction must stay in 32 bits");
+
+  void start(uint32_t t_us);
+  void run_until(uint64_t t_us);
+
+  PcmSink  &sink_;
+  Opl2Synth synth_;
+
+  bool     started_;
+  uint32_t last_t_;
+  uint64_t now_us_;  // unwrapped event time
+  uint64_t grid_;    // next output sample, in us * RATE_HZ
+  uint32_t frac_;    // position between prev_ and cur_, in 1 / STEP_DEN
+  int16_t  prev_;
+  int16_t  cur_;
+
+  uint32_t samples_;
+  uint32_t native_;
+  uint32_t writes_;
+  uint32_t late_;
+  uint32_t resyncs_;
+};
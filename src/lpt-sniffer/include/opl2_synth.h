@@ -0,0 +1,165 @@
+/*
+ * PARALAX - fixed-point YM3812 (OPL2) synthesis
+ * ThisOldCPU Project - https://github.com/thisoldcpu
+ *
+ * Plays the register stream an OPL2LPT was sent, so the sniffer can be
+ * heard without the card. Renders one mono sample per call at the chip's
+ * own rate (3.579545 MHz / 72, ~49716 Hz); Opl2PcmSource puts that on the
+ * 48 kHz output grid.
+ *
+ * Follows the chip rather than approximating it: 18 operators with the
+ * log-sine and exponent ROMs (256 entries each, in RAM), the shared
+ * envelope counter with its per-rate increment patterns, key scaling of
+ * rate and level, tremolo / vibrato LFOs, modulator feedback, the four
+ * OPL2 waveforms behind the WSE bit, and rhythm mode with the noise LFSR
+ * and the hi-hat / cymbal phase taps. Timers, status and CSM are not
+ * modelled; nothing reads them back over the parallel port.
+ *
+ * Integer only, no allocation, no floats; the output is bit-identical on
+ * every target, which is what tools/opl2_render.cpp checks on the host.
+ *
+ * Derived from Nuked-OPL3 by Nuke.YKT (https://github.com/nukeykt/Nuked-OPL3),
+ * Copyright (C) 2013-2020 Nuke.YKT. The envelope generator (its increment
+ * table and rate gating), the phase generator and the rhythm phase taps
+ * follow its OPL3_EnvelopeCalc and OPL3_PhaseGenerate, cut down to OPL2
+ * and renamed; the ROM tables are the chip's own.
+ *
+ * This file is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 2.1 of the License, or
+ * (at your option) any later version. It is distributed in the hope that
+ * it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See
+ * LICENSE-LGPL-2.1 for details.
+ *
+ * License : LGPL-2.1-or-later (unlike the rest of PARALAX, which is MIT)
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+class Opl2Synth
+{
+public:
+  static constexpr uint32_t CLOCK_HZ = 3579545;
+  static constexpr uint32_t CLOCKS_PER_SAMPLE = 72;
+  static constexpr uint32_t CHANNELS = 9;
+  static constexpr uint32_t SLOTS = 18;
+
+  Opl2Synth();
+
+  // Power-on state: all registers 0, envelopes silent
+  void reset();
+
+  // One register write (address 0x00-0xF5)
+  void write(uint8_t reg, uint8_t value);
+
+  // Next sample at the native rate
+  int16_t sample();
+  void render(int16_t *out, uint32_t count);
+
+  // Channels with a key held (melodic key-on bits, rhythm counts as 5)
+  uint32_t keyed() const;
+
+private:
+  enum EgState : uint8_t
+  {
+    EG_ATTACK,
+    EG_DECAY,
+    EG_SUSTAIN,
+    EG_RELEASE
+  };
+
+  struct Channel;
+
+  struct Slot
+  {
+    // Registers
+    uint8_t am, vib, egt, ksr, mult;
+    uint8_t ksl, tl;
+    uint8_t ar, dr, sl, rr;
+    uint8_t wf_reg, wf;
+
+    // Phase generator
+    uint32_t phase;
+    uint16_t phase_out;
+    bool     phase_reset;
+
+    // Envelope generator, 9-bit attenuation (0.1875 dB steps)
+    uint16_t eg_rout;
+    uint16_t eg_out;
+    uint16_t eg_level;   // TL + KSL, cached on writes
+    uint8_t  eg_ksl;
+    uint8_t  eg_rate[4]; // per EgState: key-scaled rate, bit 7 = register rate non-zero
+    uint8_t  eg_state;
+    uint8_t  key; // KEY_NORMAL | KEY_DRUM
+
+    // Operator output, 13-bit signed
+    int16_t        out;
+    int16_t        prev_out;
+    int16_t        fbmod;
+    const int16_t *mod;
+
+    Channel *ch;
+    uint8_t  index;
+  };
+
+  struct Channel
+  {
+    uint16_t fnum;
+    uint8_t  block;
+    uint8_t  ksv;
+    uint8_t  fb;
+    uint8_t  cnt;
+    uint8_t  key_reg;
+    Slot    *mod_slot;
+    Slot    *car_slot;
+    const int16_t *out[4];
+  };
+
+  static constexpr uint8_t KEY_NORMAL = 0x01;
+  static constexpr uint8_t KEY_DRUM = 0x02;
+
+  static int16_t exp_level(uint32_t level);
+  static int16_t operator_out(uint8_t wf, uint16_t phase, uint16_t eg_out);
+
+  void envelope(Slot &s);
+  void phase(Slot &s);
+  void update_level(Slot &s);
+  void update_rates(Slot &s);
+  void update_ksl(Channel &c);
+  void update_ksv(Channel &c);
+  void setup_channel(uint8_t c);
+  void update_rhythm(uint8_t value);
+  void key(Slot &s, uint8_t type, bool on);
+  void tick_timers();
+
+  Slot    slots_[SLOTS];
+  Channel channels_[CHANNELS];
+  int16_t zero_;
+
+  // Global registers
+  bool    wse_;
+  uint8_t nts_;
+  uint8_t rhythm_;
+
+  // LFOs
+  uint16_t timer_;
+  uint8_t  tremolo_pos_;
+  uint8_t  tremolo_;
+  uint8_t  tremolo_shift_;
+  uint8_t  vib_pos_;
+  uint8_t  vib_shift_;
+
+  // Envelope counter, advanced every other sample
+  uint64_t eg_timer_;
+  uint8_t  eg_state_;
+  uint8_t  eg_add_;
+  uint8_t  eg_timer_lo_;
+
+  // Rhythm phase taps and noise
+  uint32_t noise_;
+  uint8_t  hh_bit2_, hh_bit3_, hh_bit7_, hh_bit8_;
+  uint8_t  tc_bit3_, tc_bit5_;
+};
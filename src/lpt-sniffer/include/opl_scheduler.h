@@ -0,0 +1,115 @@
+/*
+ * PARALAX - OPL register writes paced to chip timing
+ * ThisOldCPU Project - https://github.com/thisoldcpu
+ *
+ * A YM3812 needs 12 master clocks (3.35 us) after an address write and
+ * 84 (23.5 us) after a data write before it takes the next; a YMF262 needs
+ * 32 of its faster clock (2.2 us) after each. DOS games on fast machines
+ * write closer than that, or count on a slow ISA bus to spread them out.
+ * Replayed as captured, such a burst would be half lost on a real chip.
+ *
+ * OplScheduler sits between the decoded OPL2LPT writes and whatever plays
+ * them (the soft OPL2, a VGM file, a real chip). Writes are queued with
+ * their capture time and handed to an OplWriteSink in order, each at its
+ * own time or as soon as the previous one has cleared the chip, whichever
+ * is later. Where the program kept to the timing nothing moves; a burst is
+ * spread out and the writes after it catch up in the next gap.
+ *
+ * The queue bounds the error: at most QUEUE_WRITES writes wait, so a write
+ * is never more than QUEUE_WRITES write times late. A write pushed into a
+ * full queue sends the oldest out at once, ahead of the chip timing, and
+ * counts it as forced: timing gives way before a register write is lost.
+ *
+ * Times are unwrapped to nanoseconds inside. O(1) per write, no allocation.
+ *
+ * License : MIT
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+struct OplTiming
+{
+  uint32_t addr_ns; // after an address write
+  uint32_t data_ns; // after a data write
+};
+
+static constexpr OplTiming OPL2_TIMING = {3353, 23467}; // 12 and 84 clocks at 3.579545 MHz
+static constexpr OplTiming OPL3_TIMING = {2235, 2235};  // 32 clocks at 14.31818 MHz
+
+class OplWriteSink
+{
+public:
+  virtual ~OplWriteSink() = default;
+  // The address goes out at t_ns, the data addr_ns later. reg bit 8 is the
+  // OPL3's second register set.
+  virtual void on_opl_write(uint64_t t_ns, uint16_t reg, uint8_t value) = 0;
+};
+
+class OplScheduler
+{
+public:
+  static constexpr uint32_t QUEUE_WRITES = 128; // power of two; ~3.4 ms of OPL2 writes
+  static constexpr uint32_t LATE_BOUND_US = 1000; // writes later than this are counted
+
+  static_assert((QUEUE_WRITES & (QUEUE_WRITES - 1)) == 0, "QUEUE_WRITES must be power-of-two");
+
+  explicit OplScheduler(OplWriteSink &sink, const OplTiming &timing = OPL2_TIMING);
+
+  // Drops anything queued
+  void reset();
+  void set_timing(const OplTiming &timing);
+
+  // Queue one write at its capture time
+  void push(uint32_t t_us, uint16_t reg, uint8_t value);
+
+  // Hand over every write whose slot has come by t_us
+  void advance(uint32_t t_us);
+
+  // Hand over everything queued (end of capture)
+  void flush();
+
+  uint32_t depth() const { return count_; }
+  uint32_t max_depth() const { return max_depth_; }
+  uint32_t writes() const { return writes_; }
+  uint32_t tight() const { return tight_; }     // captured closer than the chip allows
+  uint32_t delayed() const { return delayed_; } // sent after their capture time, forced included
+  uint32_t forced() const { return forced_; }   // sent early because the queue was full
+  uint32_t over_bound() const { return over_bound_; }
+  uint32_t max_late_us() const { return (uint32_t)(max_late_ns_ / 1000); }
+  uint32_t mean_late_us() const; // over the delayed writes
+
+private:
+  struct Entry
+  {
+    uint64_t t_ns;
+    uint16_t reg;
+    uint8_t  value;
+  };
+
+  void emit(uint64_t t_ns);
+  void release(uint64_t now_ns);
+
+  OplWriteSink &sink_;
+  OplTiming timing_;
+
+  Entry    queue_[QUEUE_WRITES];
+  uint32_t head_;
+  uint32_t count_;
+
+  bool     started_;
+  uint32_t last_t_;
+  uint64_t now_ns_;   // unwrapped capture time of the last push
+  uint64_t free_ns_;  // when the chip takes the next address write
+  uint64_t prev_in_;  // capture time of the previous write
+
+  uint32_t max_depth_;
+  uint32_t writes_;
+  uint32_t tight_;
+  uint32_t delayed_;
+  uint32_t forced_;
+  uint32_t over_bound_;
+  uint64_t max_late_ns_;
+  uint64_t sum_late_ns_;
+};
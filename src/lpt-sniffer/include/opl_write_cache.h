@@ -0,0 +1,68 @@
+/*
+ * PARALAX - shadow registers that drop OPL writes which change nothing
+ * ThisOldCPU Project - https://github.com/thisoldcpu
+ *
+ * Music drivers rewrite whole channels on every tick: the same total
+ * level, the same frequency, the same envelope, again and again. Each of
+ * those costs a real chip 27 us of bus time and a VGM file three bytes,
+ * and changes nothing. OplWriteCache keeps the last value written to each
+ * register and drops a write that repeats it.
+ *
+ * Registers whose writes act rather than store always pass, even when the
+ * value repeats:
+ *
+ *   0x01        test / waveform enable
+ *   0x02-0x04   timer presets, timer start and IRQ reset
+ *   0x08        CSM / note select (CSM keys every voice on timer overflow)
+ *   0xb0-0xb8   key-on and block
+ *   0xbd        rhythm key-on, depth
+ *
+ * The same set on the OPL3's second register set (reg | 0x100), where
+ * 0x104 and 0x105 are 4-op connect and OPL3 enable. The cache starts, and
+ * reset() returns it, knowing nothing: the first write to each register
+ * passes. Reset it whenever the chip behind it is reset.
+ *
+ * The shadow also answers which keys are down (keys(): bits 0-8 the
+ * melodic channels of the first register set, 9-13 the rhythm HH, CY,
+ * TOM, SD and BD while rhythm mode is on) and which were struck since
+ * clear_key_ons(), so a note too short to be seen held is still counted.
+ *
+ * License : MIT
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+class OplWriteCache
+{
+public:
+  static constexpr uint32_t REGS = 512; // both OPL3 register sets
+  static constexpr uint32_t BUS_BYTES = 2; // address + data per write on the chip's bus
+
+  OplWriteCache() { reset(); }
+
+  void reset();
+
+  // true if the write must reach the chip
+  bool pass(uint16_t reg, uint8_t value);
+
+  static bool acts(uint16_t reg);
+
+  uint16_t keys() const;
+  uint16_t key_ons() const { return key_ons_; }
+  void clear_key_ons() { key_ons_ = 0; }
+
+  uint32_t writes() const { return writes_; }
+  uint32_t passed() const { return writes_ - dropped_; }
+  uint32_t dropped() const { return dropped_; }
+  uint32_t bytes_saved() const { return dropped_ * BUS_BYTES; }
+
+private:
+  uint8_t  shadow_[REGS];
+  uint32_t known_[REGS / 32];
+
+  uint32_t writes_;
+  uint32_t dropped_;
+  uint16_t key_ons_;
+};
@@ -0,0 +1,174 @@
+/*
+ * PARALAX - SIO interpolator operations for the PCM path
+ * ThisOldCPU Project - https://github.com/thisoldcpu
+ *
+ * Each RP2040 core has two interpolators in its SIO block: two lanes of
+ * shift, mask, sign-extend and add on a pair of accumulators, read back
+ * in one cycle. The PCM path uses two fixed setups:
+ *
+ *   interp0, blend mode  lane 1 is BASE0 + (BASE1 - BASE0) * frac / 256
+ *                        (signed): the lerp between native OPL2 samples
+ *   interp1, pass-through  both lanes hand their accumulator through, so
+ *                        FULL is BASE2 + ACCUM0 + ACCUM1: a channel mix
+ *                        with a bias (PwmMonitor's offset-binary mono)
+ *
+ * Both belong to core 1: interp0 is used from loop1, interp1 only in the
+ * PWM DMA IRQ, so neither is shared and nothing needs saving.
+ *
+ * Built with PARALAX_SIO_INTERP (platformio.ini) the operations run on the
+ * hardware. Everywhere else they run on SoftInterp, a model of the same
+ * lanes from the datasheet's description, so the host tools produce the
+ * firmware's output bit for bit. pcm_interp_check() compares the active
+ * implementation with the model and with plain C; the firmware runs it
+ * once on core 1 at boot and reports the result.
+ *
+ * Only what the PCM path uses is modelled: shift, mask, signed, cross
+ * input, blend. Not CROSS_RESULT, ADD_RAW, FORCE_MSB, clamp or POP.
+ *
+ * License : MIT
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#if defined(PARALAX_SIO_INTERP)
+#include "hardware/interp.h"
+#endif
+
+struct InterpLaneConfig
+{
+  uint8_t shift;    // logical right shift of the input
+  uint8_t mask_lsb; // mask bits lsb..msb
+  uint8_t mask_msb;
+  bool    is_signed;   // sign-extend from mask_msb; signed blend on lane 1
+  bool    cross_input; // take the other lane's accumulator
+  bool    blend;       // interp0 lane 0 only
+};
+
+// Lane setups, shared by the hardware and the model
+static constexpr InterpLaneConfig INTERP0_LANE0 = {0, 0, 31, true, false, true};
+static constexpr InterpLaneConfig INTERP0_LANE1 = {0, 0, 7, true, false, false};
+static constexpr InterpLaneConfig INTERP1_LANE0 = {0, 0, 31, true, false, false};
+static constexpr InterpLaneConfig INTERP1_LANE1 = {0, 0, 31, true, false, false};
+
+// Offset binary mono is (l + r + MIX_BIAS) >> 1
+static constexpr int32_t MIX_BIAS = 65536;
+
+class SoftInterp
+{
+public:
+  uint32_t accum[2] = {0, 0};
+  uint32_t base[3] = {0, 0, 0};
+  InterpLaneConfig lane[2] = {};
+
+  // Shift and mask, before BASE
+  uint32_t raw(uint32_t i) const
+  {
+    const InterpLaneConfig &c = lane[i];
+    uint32_t src = c.cross_input ? accum[i ^ 1] : accum[i];
+    uint32_t upto = c.mask_msb >= 31 ? 0xffffffffu : (2u << c.mask_msb) - 1u;
+    uint32_t v = (src >> c.shift) & (upto & ~((1u << c.mask_lsb) - 1u));
+    if (c.is_signed && c.mask_msb < 31 && (v >> c.mask_msb) & 1u)
+      v |= ~upto;
+    return v;
+  }
+
+  uint32_t peek(uint32_t i) const
+  {
+    if (i == 1 && lane[0].blend)
+    {
+      uint32_t alpha = raw(1) & 0xffu;
+      if (lane[1].is_signed)
+      {
+        int64_t d = (int64_t)(int32_t)base[1] - (int32_t)base[0];
+        return (uint32_t)((int32_t)base[0] + (int32_t)((d * alpha) >> 8));
+      }
+      int64_t d = (int64_t)base[1] - base[0];
+      return (uint32_t)(base[0] + (uint32_t)((d * alpha) >> 8));
+    }
+    return raw(i) + base[i];
+  }
+
+  uint32_t peek_full() const { return base[2] + raw(0) + raw(1); }
+};
+
+#if defined(PARALAX_SIO_INTERP)
+
+// ---- Hardware ----
+
+static inline void pcm_interp_lane(interp_hw_t *hw, uint lane, const InterpLaneConfig &c)
+{
+  interp_config cfg = interp_default_config();
+  interp_config_set_shift(&cfg, c.shift);
+  interp_config_set_mask(&cfg, c.mask_lsb, c.mask_msb);
+  interp_config_set_signed(&cfg, c.is_signed);
+  interp_config_set_cross_input(&cfg, c.cross_input);
+  interp_config_set_blend(&cfg, c.blend);
+  interp_set_config(hw, lane, &cfg);
+}
+
+// On the core that runs the PCM path
+static inline void pcm_interp_init()
+{
+  pcm_interp_lane(interp0, 0, INTERP0_LANE0);
+  pcm_interp_lane(interp0, 1, INTERP0_LANE1);
+  pcm_interp_lane(interp1, 0, INTERP1_LANE0);
+  pcm_interp_lane(interp1, 1, INTERP1_LANE1);
+  interp1->base[0] = 0;
+  interp1->base[1] = 0;
+  interp1->base[2] = (uint32_t)MIX_BIAS;
+}
+
+// a and b are 16-bit: both bases go in one write, sign-extended by lane
+static inline int32_t pcm_blend(int32_t a, int32_t b, uint32_t frac8)
+{
+  interp0->base01 = (uint16_t)a | ((uint32_t)b << 16);
+  interp0->accum[1] = frac8;
+  return (int32_t)interp0->peek[1];
+}
+
+static inline int32_t pcm_mix(int32_t a, int32_t b)
+{
+  interp1->accum[0] = (uint32_t)a;
+  interp1->accum[1] = (uint32_t)b;
+  return (int32_t)interp1->peek[2];
+}
+
+static constexpr bool PCM_INTERP_HW = true;
+
+#else
+
+// ---- Software ----
+
+extern SoftInterp soft_interp0;
+extern SoftInterp soft_interp1;
+
+void pcm_interp_init();
+
+static inline int32_t pcm_blend(int32_t a, int32_t b, uint32_t frac8)
+{
+  soft_interp0.base[0] = (uint32_t)a;
+  soft_interp0.base[1] = (uint32_t)b;
+  soft_interp0.accum[1] = frac8;
+  return (int32_t)soft_interp0.peek(1);
+}
+
+static inline int32_t pcm_mix(int32_t a, int32_t b)
+{
+  soft_interp1.accum[0] = (uint32_t)a;
+  soft_interp1.accum[1] = (uint32_t)b;
+  return (int32_t)soft_interp1.peek_full();
+}
+
+static constexpr bool PCM_INTERP_HW = false;
+
+#endif
+
+// pcm_blend: a + (b - a) * frac8 / 256 rounded down, a and b 16-bit
+// pcm_mix:   a + b + MIX_BIAS
+
+// Runs `vectors` pseudo-random inputs (plus the edge cases) through
+// pcm_blend / pcm_mix and compares them with SoftInterp and with plain C.
+// Call pcm_interp_init() first. Returns the mismatches.
+uint32_t pcm_interp_check(uint32_t vectors);
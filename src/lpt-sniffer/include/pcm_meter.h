@@ -0,0 +1,111 @@
+/*
+ * PARALAX - level meters and spectrum of the decoded PCM, as telemetry
+ * ThisOldCPU Project - https://github.com/thisoldcpu
+ *
+ * Scopes and meters on the host should not need every sample shipped over
+ * USB. PcmMeter sits on the 48 kHz stream next to the USB endpoint and the
+ * headphone monitor and boils each RECORD_SAMPLES (a quarter second) down
+ * to one MeterRecord: peak and RMS per channel, and the spectrum of the
+ * first FFT_N samples (mono, Hann window) in BANDS log-spaced bands from
+ * 94 Hz to 24 kHz. The caller adds the device and the OPL key state.
+ *
+ * on_sample() only accumulates: a compare, a multiply-add per channel and
+ * a store while the FFT block fills. take() does the rest once a record is
+ * due, on the same core (a 512-point radix-2 FFT in Q15, scaled by 1/2 per
+ * stage so nothing overflows, about 2300 butterflies). Integer only, no
+ * allocation.
+ *
+ * Levels are bytes in half-dB steps below full scale: 255 is 0 dBFS, 0 is
+ * -127.5 dB or less. RMS is against a full-scale sine (AES17), so a
+ * full-scale square wave also reads 255. A band is its strongest bin, a
+ * full-scale sine reading 255.
+ *
+ * pack() lays a record out in RECORD_BYTES little-endian bytes:
+ *
+ *   0  seq        u16  records since reset (gaps mean lost lines)
+ *   2  device     u8   LptDevice feeding the stream
+ *   3  peak       u8 x2  left, right
+ *   5  rms        u8 x2
+ *   7  bands      u8 x16 lowest first
+ *   23 keys       u16  OPL keys held: bits 0-8 channels, 9-13 HH CY TOM SD BD
+ *   25 key_ons    u16  keys struck since the last record, same bits
+ *
+ * The firmware prints it as "# meter: " and 54 hex digits, four lines a
+ * second: about 260 bytes/s against 192 kB/s for the samples themselves.
+ *
+ * License : MIT
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#include "dac_pcm.h"
+
+struct MeterRecord
+{
+  static constexpr uint32_t BANDS = 16;
+
+  uint16_t seq;
+  uint8_t  device;
+  uint8_t  peak[2];
+  uint8_t  rms[2];
+  uint8_t  bands[BANDS];
+  uint16_t keys;
+  uint16_t key_ons;
+};
+
+class PcmMeter : public PcmSink
+{
+public:
+  static constexpr uint32_t RATE_HZ = DacPcmSource::RATE_HZ;
+  static constexpr uint32_t RECORD_SAMPLES = RATE_HZ / 4;
+  static constexpr uint32_t FFT_BITS = 9;
+  static constexpr uint32_t FFT_N = 1u << FFT_BITS; // 93.75 Hz bins
+  static constexpr uint32_t BANDS = MeterRecord::BANDS;
+  static constexpr uint32_t RECORD_BYTES = 27;
+
+  static_assert(FFT_N <= RECORD_SAMPLES, "the FFT block must fit in a record");
+
+  PcmMeter();
+
+  void reset();
+
+  // ---- Producer ----
+  void on_sample(int16_t left, int16_t right) override;
+
+  // A record once RECORD_SAMPLES have gone by; device and keys are left 0
+  bool take(MeterRecord &out);
+
+  uint32_t records() const { return seq_; }
+
+  static void pack(const MeterRecord &r, uint8_t *out);
+  static void unpack(const uint8_t *in, MeterRecord &r);
+
+  // In place over FFT_N points, Q15, scaled by 1 / FFT_N
+  static void fft(int16_t *re, int16_t *im);
+
+  // Half-dB steps of power against a reference power 2^ref_log2
+  static uint8_t level(uint64_t power, uint32_t ref_log2);
+
+  // First bin of each band, and one past the last
+  static const uint16_t BAND_EDGES[BANDS + 1];
+
+private:
+  static int32_t sin_q15(uint32_t index); // sin(2 pi index / FFT_N)
+
+  // Accumulating
+  int16_t  block_[FFT_N];
+  uint32_t fill_;
+  uint32_t count_;
+  uint32_t peak_[2];
+  uint64_t sum_sq_[2];
+
+  // The record due, until take(); re_ / im_ are also the FFT's work space
+  bool     due_;
+  int16_t  re_[FFT_N];
+  int16_t  im_[FFT_N];
+  uint32_t due_peak_[2];
+  uint64_t due_sum_sq_[2];
+  uint16_t seq_;
+};
@@ -0,0 +1,113 @@
+/*
+ * PARALAX - PIT divisor inference for DAC writes
+ * ThisOldCPU Project - https://github.com/thisoldcpu
+ *
+ * DOS players pace Covox writes from the 8253 timer: IRQ 0 at 1.193182 MHz
+ * divided by an integer, one write per interrupt. Interrupt latency on the
+ * PC smears the write times by a few microseconds, so the timestamps alone
+ * give a noisy rate. The divisor behind them is exact, and finding it
+ * gives back the clock the program meant.
+ *
+ * Acquisition collects ACQ_INTERVALS write intervals. The lower quartile
+ * is the coarse period (a Covox repeats no event for a repeated byte, so
+ * some intervals span several periods); each interval is then counted in
+ * whole periods and the total time over the total count is the period,
+ * where the jitter of the writes in between cancels. The nearest divisor
+ * must come out of CONFIRM windows in a row, and their combined rate must
+ * be within 1/CONFIRM_TOLERANCE of it, before the clock locks: a player
+ * timed some other way gets no grid.
+ *
+ * Locked, every write is assigned to its slot on the grid and the snapped
+ * time is returned in its place. A PI loop on the residuals keeps the grid
+ * on the writes across the crystal difference between the PC and the
+ * Pico (clamped to MAX_PPM). Writes more than a quarter period off the
+ * grid are counted, leaking back one for every two on it; UNLOCK_MISSES
+ * net misses mean the program changed rate, and the clock unlocks and
+ * acquires again. After a pause longer than MAX_GAP_US the grid is re-anchored on
+ * the next write with the same divisor.
+ *
+ * Time is in microseconds, Q16 inside. O(1) per write apart from one
+ * ACQ_INTERVALS sort per acquisition window, no allocation.
+ *
+ * License : MIT
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+class PitClock
+{
+public:
+  static constexpr uint32_t PIT_HZ = 1193182;
+  static constexpr uint32_t MIN_DIVISOR = 12;       // ~100 kHz
+  static constexpr uint32_t ACQ_INTERVALS = 64;
+  static constexpr uint32_t CONFIRM = 2;            // windows agreeing on the divisor
+  static constexpr uint32_t CONFIRM_TOLERANCE = 400; // their rate within 1/400 of it
+  static constexpr uint32_t UNLOCK_MISSES = 8;
+  static constexpr uint32_t MAX_GAP_US = 100000;    // longer pauses re-anchor
+  static constexpr int32_t MAX_PPM = 1000;          // period correction clamp
+
+  PitClock();
+
+  void reset();
+
+  // Feed one write. Returns true when locked; `offset_q16` is then the
+  // snapped time minus t_us, in 1/65536 us (0 when not locked).
+  bool on_write(uint32_t t_us, int32_t &offset_q16);
+
+  bool     locked() const { return locked_; }
+  uint32_t divisor() const { return divisor_; }                   // 0 until first lock
+  uint32_t rate_mhz() const;                                      // PIT_HZ / divisor, in mHz
+  uint64_t slots() const { return slots_; }                       // grid slots since lock
+  int32_t  clock_ppm() const;                                     // tracked period vs nominal
+  uint32_t jitter_q16() const { return jitter_q16_; }             // mean |residual|
+  uint32_t max_jitter_q16() const { return max_jitter_q16_; }
+
+  uint32_t writes() const { return writes_; }
+  uint32_t locks() const { return locks_; }
+  uint32_t unlocks() const { return unlocks_; }
+  uint32_t relocks() const { return relocks_; }     // re-anchored after a pause
+  uint32_t skipped() const { return skipped_; }     // slots without a write
+  uint32_t collisions() const { return collisions_; } // writes sharing a slot
+
+private:
+  void acquire(uint32_t dt_us);
+  bool estimate(uint32_t &divisor, uint64_t &sum_dt, uint64_t &sum_k);
+  void clamp_period();
+  static uint32_t nearest_divisor(uint64_t sum_dt, uint64_t sum_k, uint32_t tolerance);
+
+  // Nominal period of a divisor, Q16 us
+  static int64_t nominal_q16(uint32_t divisor);
+
+  bool     started_;
+  bool     locked_;
+  uint32_t last_t_;
+  uint64_t now_q16_; // unwrapped write time
+
+  // Acquisition
+  uint32_t dt_[ACQ_INTERVALS];
+  uint32_t count_;
+  uint32_t candidate_;
+  uint32_t agree_;
+  uint64_t acc_dt_; // confirming windows, total us
+  uint64_t acc_k_;  // and total periods
+
+  // Tracking
+  uint32_t divisor_;
+  int64_t  nominal_;
+  int64_t  period_;  // Q16 us
+  int64_t  grid_;    // time of the last slot, Q16 us
+  uint32_t misses_;
+
+  uint64_t slots_;
+  uint32_t jitter_q16_;
+  uint32_t max_jitter_q16_;
+
+  uint32_t writes_;
+  uint32_t locks_;
+  uint32_t unlocks_;
+  uint32_t relocks_;
+  uint32_t skipped_;
+  uint32_t collisions_;
+};
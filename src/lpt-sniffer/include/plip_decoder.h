@@ -0,0 +1,113 @@
+/*
+ * PARALAX - PLIP (4-bit "LapLink" cable) frame decoder
+ * ThisOldCPU Project - https://github.com/thisoldcpu
+ *
+ * The LapLink cable crosses D0..D4 of each end onto ERROR, SELECT,
+ * PAPER_OUT, ACK and BUSY of the other. Seen from the sniffed port:
+ *   TX (this host -> peer): nibble on D0..D3, D4 toggles as its strobe
+ *   RX (peer -> this host): nibble on ERROR/SELECT/PAPER_OUT/ACK, BUSY
+ *                           toggles as its strobe
+ * The receiver copies the strobe level back on its own D4/BUSY, so the line
+ * that toggles while both are equal belongs to the sender. Strobe rise
+ * carries the low nibble, strobe fall the high nibble.
+ *
+ * Frame: length (16-bit LE), that many bytes (a 14-byte Ethernet header
+ * and the packet), then an 8-bit sum of those bytes. The trigger and done
+ * handshakes carry no data and are not decoded. Use the PIO capture
+ * profile; the IRQ deadband merges nibbles at full PLIP speed.
+ *
+ * License : MIT
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#include "capture_frame.h"
+
+enum PlipDirection : uint8_t
+{
+  PLIP_TX = 0, // sniffed host -> peer
+  PLIP_RX = 1, // peer -> sniffed host
+};
+
+struct PlipFrame
+{
+  uint32_t       t_us;        // first nibble of the length
+  uint8_t        t_sub;       // 1/256 us
+  uint8_t        dir;         // PlipDirection
+  bool           checksum_ok;
+  uint16_t       length;      // bytes in payload
+  const uint8_t *payload;     // valid until the next feed()
+  uint32_t       transfer_ns; // first length nibble -> checksum complete
+};
+
+class PlipDecoder
+{
+public:
+  // Ethernet MTU plus header; longer lengths mean the decoder lost sync
+  static constexpr uint16_t MAX_FRAME = 1536;
+
+  // A nibble gap this long abandons the frame in progress
+  static constexpr uint32_t NIBBLE_TIMEOUT_US = 5000;
+
+  PlipDecoder();
+
+  void reset();
+
+  // Returns true and fills `out` when the frame completes a PLIP frame
+  bool feed(const CaptureFrame &f, PlipFrame &out);
+
+  uint32_t frames(uint8_t dir) const { return lane_[dir & 1u].frames; }
+  uint32_t bad_checksums(uint8_t dir) const { return lane_[dir & 1u].bad_sums; }
+  uint32_t timeouts() const { return timeouts_; }
+
+  // D4 and BUSY toggling in the same frame, or an impossible length
+  uint32_t violations() const { return violations_; }
+
+  // Nibble the peer drives onto our status lines
+  static uint8_t status_nibble(uint16_t bits)
+  {
+    return (uint8_t)(bit_at(bits, FB_ERROR) | (bit_at(bits, FB_SELECT) << 1) |
+                     (bit_at(bits, FB_PAPER_OUT) << 2) | (bit_at(bits, FB_ACK) << 3));
+  }
+
+private:
+  enum LaneState : uint8_t
+  {
+    LANE_LEN_LO,
+    LANE_LEN_HI,
+    LANE_DATA,
+    LANE_SUM,
+  };
+
+  struct Lane
+  {
+    LaneState state;
+    bool      have_low;
+    uint8_t   low;
+    uint16_t  length;
+    uint16_t  count;
+    uint8_t   sum;
+    uint32_t  start_us;
+    uint8_t   start_sub;
+    uint32_t  start_ticks;
+    uint32_t  last_us;
+    uint32_t  frames;
+    uint32_t  bad_sums;
+    uint8_t   buf[MAX_FRAME];
+  };
+
+  void restart(Lane &lane);
+  bool nibble(uint8_t dir, const CaptureFrame &f, uint8_t nib, bool rising, PlipFrame &out);
+  bool byte(uint8_t dir, const CaptureFrame &f, uint8_t value, PlipFrame &out);
+
+  bool    primed_;
+  uint8_t prev_d4_;
+  uint8_t prev_busy_;
+
+  Lane lane_[2];
+
+  uint32_t timeouts_;
+  uint32_t violations_;
+};
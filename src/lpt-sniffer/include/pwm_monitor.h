@@ -0,0 +1,81 @@
+/*
+ * PARALAX - PCM to PWM levels for the local headphone monitor
+ * ThisOldCPU Project - https://github.com/thisoldcpu
+ *
+ * Lets a capture be checked by ear on the bench, without a PC. The decoded
+ * 48 kHz stream (the same one the USB endpoint gets) is turned into duty
+ * cycles for a PWM slice whose compare register is written by DMA, one
+ * level per PWM period.
+ *
+ * Each frame covers OVERSAMPLE PWM periods. The ideal level rarely falls on
+ * an integer, so the remainder is carried from one period to the next
+ * (first-order noise shaping): the average over a frame is exact to a
+ * quarter step and the error moves up to the carrier, where the RC filter
+ * removes it. At 133 MHz with OVERSAMPLE 4 the counter wraps at 693, a
+ * 192 kHz carrier with ~11 bits in the audio band.
+ *
+ * The PWM rate is the system clock divided down, close to but not exactly
+ * 48 kHz (-420 ppm at 133 MHz), so the frames go through an Asrc like the
+ * USB endpoint's: the producer pushes into it, the DMA refill pulls from
+ * it at the PWM's own rate and its loop takes up the difference, with no
+ * frame dropped or repeated. A dry FIFO holds the last frame and primes
+ * again.
+ *
+ * Stereo is mixed to mono. Integer only, no allocation.
+ *
+ * License : MIT
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#include "asrc.h"
+#include "dac_pcm.h"
+
+class PwmMonitor : public PcmSink
+{
+public:
+  static constexpr uint32_t RATE_HZ = DacPcmSource::RATE_HZ;
+  static constexpr uint32_t OVERSAMPLE = 4;    // PWM periods per frame
+  static constexpr uint32_t PULL_FRAMES = 32;  // frames taken from the Asrc at a time
+
+  // Counter wrap for a system clock, so that OVERSAMPLE periods last a frame
+  static uint16_t top_for_clock(uint32_t sys_hz);
+
+  explicit PwmMonitor(uint16_t top = 0);
+
+  // Only while neither side is running
+  void set_top(uint16_t top);
+  void reset();
+
+  // ---- Producer ----
+  void on_sample(int16_t left, int16_t right) override;
+
+  // ---- Consumer ----
+  // Always fills frames * OVERSAMPLE compare levels, 0..top + 1
+  void fill(uint16_t *levels, uint32_t frames);
+
+  // One frame to OVERSAMPLE levels, carrying the remainder
+  void convert(int16_t left, int16_t right, uint16_t *levels);
+
+  uint16_t top() const { return (uint16_t)(steps_ - 1); }
+  uint32_t fill_frames() const { return asrc_.fill(); }
+
+  const Asrc &asrc() const { return asrc_; }
+  uint32_t frames_in() const { return asrc_.frames_in(); }
+  uint32_t frames_out() const { return asrc_.frames_out(); }
+  uint32_t overruns() const { return asrc_.overruns(); }
+  uint32_t underruns() const { return asrc_.underruns(); }
+  uint32_t padded_frames() const { return asrc_.padded_frames(); }
+  int32_t clock_ppm() const { return asrc_.clock_ppm(); } // PWM against the 48 kHz grid
+
+private:
+  Asrc asrc_;
+
+  uint32_t steps_; // top + 1
+
+  // Consumer only
+  uint32_t error_; // carried remainder, Q16 of one step
+  int16_t  pcm_[PULL_FRAMES * Asrc::CHANNELS];
+};
@@ -0,0 +1,73 @@
+/*
+ * PARALAX - IEEE 1284 nibble / byte mode reverse-channel decoder
+ * ThisOldCPU Project - https://github.com/thisoldcpu
+ *
+ * Reverse handshake (wire levels):
+ *   HostBusy = AUTOFEED  host pulls it low when ready for data
+ *   PtrClk   = ACK       peripheral pulls it low once data is valid
+ *
+ * Nibble mode: two PtrClk pulses per byte, low nibble first, on the
+ * status lines ERROR (bit 0), SELECT (bit 1), PAPER_OUT (bit 2),
+ * BUSY (bit 3). Byte mode: one PtrClk pulse, byte on D0..D7.
+ *
+ * License : MIT
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#include "capture_frame.h"
+
+enum ReverseMode : uint8_t
+{
+  REVERSE_NIBBLE = 0,
+  REVERSE_BYTE   = 1,
+};
+
+struct ReverseByte
+{
+  uint32_t t_us;    // first PtrClk of the byte
+  uint8_t  t_sub;   // 1/256 us
+  uint8_t  value;
+  uint32_t byte_ns; // nibble: first -> second PtrClk low; 0 in byte mode
+};
+
+class ReverseChannelDecoder
+{
+public:
+  ReverseChannelDecoder();
+
+  void reset();
+
+  // Start decoding in `mode`: `bits` is the frame before the first one fed.
+  // Keeps the counters.
+  void resync(ReverseMode mode, uint16_t bits);
+
+  // Returns true and fills `out` when a byte is complete
+  bool feed(const CaptureFrame &f, ReverseByte &out);
+
+  uint32_t bytes() const { return bytes_; }
+
+  // PtrClk while the host was not ready (HostBusy high)
+  uint32_t violations() const { return violations_; }
+
+  // Nibble from the status lines of one frame
+  static uint8_t status_nibble(uint16_t bits)
+  {
+    return (uint8_t)(bit_at(bits, FB_ERROR) | (bit_at(bits, FB_SELECT) << 1) |
+                     (bit_at(bits, FB_PAPER_OUT) << 2) | (bit_at(bits, FB_BUSY) << 3));
+  }
+
+private:
+  ReverseMode mode_;
+  uint16_t    prev_bits_;
+  bool        have_low_;
+  uint8_t     low_;
+  uint32_t    start_us_;
+  uint8_t     start_sub_;
+  uint32_t    start_ticks_;
+
+  uint32_t bytes_;
+  uint32_t violations_;
+};
@@ -0,0 +1,138 @@
+/*
+ * PARALAX - speculative decoding while the device is being classified
+ * ThisOldCPU Project - https://github.com/thisoldcpu
+ *
+ * Until DeviceClassifier commits, every candidate decoder sees every frame
+ * and keeps its output in its own ring. commit() replays the winner's ring
+ * to the sink, so its stream starts at the first frame rather than at the
+ * verdict, and drops the rest. A candidate is switched off as soon as it
+ * reaches VIOLATION_LIMIT, which keeps the speculative cost close to one
+ * decoder once the traffic has shown what it is not.
+ *
+ * After a commit only the winner runs. If it starts collecting violations
+ * (the program switched devices) speculation reopens for the next verdict.
+ * There the limit is a rate, not a total: ViolationRate lets one violation
+ * leak away every VIOLATION_LEAK_FRAMES frames, so a glitch now and then
+ * over a long session does not throw away a correct verdict.
+ *
+ * Single-threaded and allocation-free: the firmware runs it on core 1.
+ *
+ * License : MIT
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#include "capture_frame.h"
+#include "device_classifier.h"
+#include "device_decoders.h"
+
+class DeviceEventSink
+{
+public:
+  virtual ~DeviceEventSink() = default;
+
+  virtual void on_event(const DeviceEvent &e) = 0;
+
+  // `replayed` events came from the speculative ring, `lost` fell out of it
+  virtual void on_commit(LptDevice device, uint32_t replayed, uint32_t lost)
+  {
+    (void)device;
+    (void)replayed;
+    (void)lost;
+  }
+
+  // The committed decoder stopped making sense; speculating again
+  virtual void on_reopen() {}
+};
+
+class SpeculativeDecoder
+{
+public:
+  static constexpr uint32_t CANDIDATES = DEV_COUNT - 1;
+  static constexpr uint32_t LANE_EVENTS = 512; // per candidate, power of two
+  static constexpr uint32_t VIOLATION_LIMIT = 4;
+  static constexpr uint32_t VIOLATION_LEAK_FRAMES = 4096;
+
+  static_assert((LANE_EVENTS & (LANE_EVENTS - 1)) == 0, "LANE_EVENTS must be power-of-two");
+
+  // Leaky count of the committed decoder's violations; over() is true once
+  // VIOLATION_LIMIT of them land faster than they leak
+  struct ViolationRate
+  {
+    uint32_t seen;
+    uint32_t level;
+    uint32_t frames;
+
+    void reset(uint32_t violations)
+    {
+      seen = violations;
+      level = 0;
+      frames = 0;
+    }
+
+    // Once per frame, with the decoder's running violations() total
+    bool over(uint32_t violations)
+    {
+      level += violations - seen;
+      seen = violations;
+      if (++frames == VIOLATION_LEAK_FRAMES)
+      {
+        frames = 0;
+        if (level > 0)
+          level--;
+      }
+      return level >= VIOLATION_LIMIT;
+    }
+  };
+
+  explicit SpeculativeDecoder(DeviceEventSink &sink);
+
+  void reset();
+
+  void feed(const CaptureFrame &f);
+
+  // Classifier verdict. DEV_UNKNOWN restarts speculation from scratch.
+  void commit(LptDevice device);
+
+  // Drop the committed decoder and run every candidate again
+  void reopen();
+
+  LptDevice committed() const { return committed_; }
+  bool speculating() const { return committed_ == DEV_UNKNOWN; }
+  bool alive(LptDevice device) const;
+  uint32_t live_candidates() const;
+
+  uint32_t switched_off() const { return switched_off_; }
+  uint32_t discarded() const { return discarded_; }
+  uint32_t reopens() const { return reopens_; }
+
+private:
+  struct Lane
+  {
+    DeviceDecoder *dec;
+    bool           alive;
+    uint32_t       head; // total events pushed
+    uint32_t       lost;
+    DeviceEvent    ring[LANE_EVENTS];
+  };
+
+  void arm(Lane &lane);
+
+  DeviceEventSink &sink_;
+
+  CovoxDecoder        covox_;
+  DssDecoder          dss_;
+  Opl2LptDecoder      opl2lpt_;
+  TndLptDecoder       tndlpt_;
+  CmsLptDeviceDecoder cmslpt_;
+
+  Lane          lanes_[CANDIDATES]; // index = LptDevice - 1
+  LptDevice     committed_;
+  ViolationRate committed_rate_;
+
+  uint32_t switched_off_;
+  uint32_t discarded_;
+  uint32_t reopens_;
+};
@@ -0,0 +1,53 @@
+/*
+ * PARALAX - USB Audio Class 1 packetisation, 48 kHz 16-bit stereo
+ * ThisOldCPU Project - https://github.com/thisoldcpu
+ *
+ * Turns the output of an Asrc into isochronous IN packets, one per 1 ms
+ * USB frame. The Asrc has already converted the Pico-clocked PCM to the
+ * host's SOF clock, so every packet carries exactly 48 frames and the
+ * endpoint is synchronous.
+ *
+ * Underruns are explicit: the Asrc pads the packet by holding the last
+ * sample (no click) and counts it, and last_underran() flags the packet.
+ *
+ * Portable; the host tool tools/uac_packetize.cpp drives it on captures.
+ *
+ * License : MIT
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#include "asrc.h"
+
+class UacPacketizer
+{
+public:
+  static constexpr uint32_t RATE_HZ = 48000;
+  static constexpr uint32_t CHANNELS = Asrc::CHANNELS;
+  static constexpr uint32_t BYTES_PER_FRAME = CHANNELS * 2;
+  static constexpr uint32_t PACKET_FRAMES = RATE_HZ / 1000;
+  static constexpr uint32_t PACKET_BYTES = PACKET_FRAMES * BYTES_PER_FRAME;
+
+  explicit UacPacketizer(Asrc &source);
+
+  // Once per USB frame: fills buf (PACKET_BYTES) and returns the length
+  uint32_t next_packet(uint8_t *buf);
+
+  // Stream started or stopped: whatever is queued is stale, and nothing
+  // queues (or counts as an overrun) while stopped
+  void set_streaming(bool on) { source_.set_streaming(on); }
+
+  Asrc &source() { return source_; }
+  const Asrc &source() const { return source_; }
+
+  bool last_underran() const { return last_underran_; }
+  uint32_t packets() const { return packets_; }
+
+private:
+  Asrc    &source_;
+  int16_t  pcm_[PACKET_FRAMES * CHANNELS];
+  bool     last_underran_;
+  uint32_t packets_;
+};
@@ -0,0 +1,206 @@
+/*
+ * PARALAX - adaptive sample-rate conversion between clock domains
+ * ThisOldCPU Project - https://github.com/thisoldcpu
+ *
+ * License : MIT
+ */
+
+#include "asrc.h"
+
+static constexpr int64_t ONE_Q32 = 1LL << 32;
+static constexpr int64_t PPM_Q32 = 4295; // 2^32 / 1e6
+
+// Loop gains (tools/asrc_drift): ~0.05 Hz bandwidth, close to critically
+// damped. KP keeps a 500 ppm step within one packet of the target while
+// the integrator catches up; KI is per frame of error per update.
+static constexpr int64_t KP = 10 * PPM_Q32;
+static constexpr int64_t KI = 11;
+static constexpr int64_t MAX_CORR = (int64_t)Asrc::MAX_PPM * PPM_Q32;
+
+Asrc::Asrc()
+{
+  reset();
+}
+
+void Asrc::reset()
+{
+  head_.store(0, std::memory_order_relaxed);
+  tail_.store(0, std::memory_order_relaxed);
+  streaming_.store(true, std::memory_order_relaxed);
+  frames_in_ = 0;
+  overruns_ = 0;
+  priming_ = true;
+  hist_ = 0;
+  last_out_ = 0;
+  phase_ = 0;
+  step_ = ONE_Q32;
+  integ_ = 0;
+  fill_q8_ = (int32_t)(TARGET_FRAMES << 8);
+  until_control_ = CONTROL_FRAMES;
+  frames_out_ = 0;
+  underruns_ = 0;
+  padded_ = 0;
+  skipped_ = 0;
+}
+
+uint32_t Asrc::fill() const
+{
+  return head_.load(std::memory_order_acquire) - tail_.load(std::memory_order_acquire);
+}
+
+int32_t Asrc::ratio_ppm() const
+{
+  return (int32_t)((step_ - ONE_Q32) / PPM_Q32);
+}
+
+int32_t Asrc::clock_ppm() const
+{
+  return (int32_t)((integ_ >> 8) / PPM_Q32);
+}
+
+void Asrc::on_sample(int16_t left, int16_t right)
+{
+  // Nobody listening: a full FIFO is the normal state, not an overrun
+  if (!streaming_.load(std::memory_order_acquire))
+    return;
+  uint32_t head = head_.load(std::memory_order_relaxed);
+  if (head - tail_.load(std::memory_order_acquire) >= FIFO_FRAMES)
+  {
+    overruns_++;
+    return;
+  }
+  fifo_[head & (FIFO_FRAMES - 1)] = (uint16_t)left | ((uint32_t)(uint16_t)right << 16);
+  head_.store(head + 1, std::memory_order_release);
+  frames_in_++;
+}
+
+void Asrc::flush()
+{
+  tail_.store(head_.load(std::memory_order_acquire), std::memory_order_release);
+  priming_ = true;
+}
+
+void Asrc::set_streaming(bool on)
+{
+  flush();
+  streaming_.store(on, std::memory_order_release);
+}
+
+int16_t Asrc::interpolate(int32_t p0, int32_t p1, int32_t p2, int32_t p3, int32_t t)
+{
+  // Catmull-Rom: p1 + t/2 * (c1 + t * (c2 + t * c3)), t in Q15
+  int32_t c1 = p2 - p0;
+  int32_t c2 = 2 * p0 - 5 * p1 + 4 * p2 - p3;
+  int32_t c3 = 3 * (p1 - p2) + p3 - p0;
+
+  int64_t acc = ((int64_t)c3 * t) >> 15;
+  acc = ((c2 + acc) * t) >> 15;
+  acc = ((c1 + acc) * t) >> 15;
+  int32_t y = p1 + (int32_t)(acc >> 1);
+
+  if (y > 32767)
+    return 32767;
+  if (y < -32768)
+    return -32768;
+  return (int16_t)y;
+}
+
+void Asrc::control()
+{
+  uint32_t avail = fill();
+  if (avail > TARGET_FRAMES + RESYNC_FRAMES)
+  {
+    // A burst after a producer stall: skip to the target instead of
+    // draining it slowly through the loop (and winding the integrator up)
+    uint32_t tail = tail_.load(std::memory_order_relaxed) + (avail - TARGET_FRAMES);
+    hist_ = fifo_[(tail - 1) & (FIFO_FRAMES - 1)];
+    tail_.store(tail, std::memory_order_release);
+    skipped_ += avail - TARGET_FRAMES;
+    fill_q8_ = (int32_t)(TARGET_FRAMES << 8);
+    return;
+  }
+
+  // Fill as a position: the part of the tail frame already consumed is gone
+  int32_t fill_q8 = (int32_t)(avail << 8) - (int32_t)(phase_ >> 24);
+  fill_q8_ += (fill_q8 - fill_q8_) >> 4;
+
+  int32_t err_q8 = fill_q8_ - (int32_t)(TARGET_FRAMES << 8);
+  integ_ += (int64_t)err_q8 * KI;
+  if (integ_ > (MAX_CORR << 8))
+    integ_ = MAX_CORR << 8;
+  if (integ_ < -(MAX_CORR << 8))
+    integ_ = -(MAX_CORR << 8);
+
+  int64_t corr = (((int64_t)err_q8 * KP) >> 8) + (integ_ >> 8);
+  if (corr > MAX_CORR)
+    corr = MAX_CORR;
+  if (corr < -MAX_CORR)
+    corr = -MAX_CORR;
+  step_ = ONE_Q32 + corr;
+}
+
+void Asrc::pull(int16_t *out, uint32_t frames)
+{
+  for (uint32_t i = 0; i < frames; ++i)
+  {
+    uint32_t tail = tail_.load(std::memory_order_relaxed);
+    uint32_t avail = head_.load(std::memory_order_acquire) - tail;
+
+    if (priming_)
+    {
+      if (avail < TARGET_FRAMES)
+      {
+        // Still filling: hold the last frame so the sink hears no step
+        out[i * 2] = (int16_t)last_out_;
+        out[i * 2 + 1] = (int16_t)(last_out_ >> 16);
+        continue;
+      }
+      priming_ = false;
+      hist_ = fifo_[tail & (FIFO_FRAMES - 1)];
+      phase_ = 0;
+      fill_q8_ = (int32_t)(avail << 8);
+    }
+
+    if (avail < 3)
+    {
+      for (uint32_t j = i; j < frames; ++j)
+      {
+        out[j * 2] = (int16_t)last_out_;
+        out[j * 2 + 1] = (int16_t)(last_out_ >> 16);
+      }
+      padded_ += frames - i;
+      underruns_++;
+      priming_ = true;
+      return;
+    }
+
+    uint32_t p0 = hist_;
+    uint32_t p1 = fifo_[tail & (FIFO_FRAMES - 1)];
+    uint32_t p2 = fifo_[(tail + 1) & (FIFO_FRAMES - 1)];
+    uint32_t p3 = fifo_[(tail + 2) & (FIFO_FRAMES - 1)];
+    int32_t t = (int32_t)(phase_ >> 17);
+
+    int16_t l = interpolate((int16_t)p0, (int16_t)p1, (int16_t)p2, (int16_t)p3, t);
+    int16_t r = interpolate((int16_t)(p0 >> 16), (int16_t)(p1 >> 16), (int16_t)(p2 >> 16), (int16_t)(p3 >> 16), t);
+    out[i * 2] = l;
+    out[i * 2 + 1] = r;
+    last_out_ = (uint16_t)l | ((uint32_t)(uint16_t)r << 16);
+    frames_out_++;
+
+    // step_ stays within 1 +- MAX_PPM, so at most two input frames go by
+    uint64_t pos = (uint64_t)phase_ + (uint64_t)step_;
+    uint32_t adv = (uint32_t)(pos >> 32);
+    phase_ = (uint32_t)pos;
+    if (adv)
+    {
+      hist_ = fifo_[(tail + adv - 1) & (FIFO_FRAMES - 1)];
+      tail_.store(tail + adv, std::memory_order_release);
+    }
+
+    if (--until_control_ == 0)
+    {
+      until_control_ = CONTROL_FRAMES;
+      control();
+    }
+  }
+}
@@ -0,0 +1,87 @@
+/*
+ * PARALAX - change-capture PIO program
+ * ThisOldCPU Project - https://github.com/thisoldcpu
+ *
+ * Hand-written: there is no .pio source in the tree and the build does not
+ * run pioasm. The program is assembled by hand from the listing below and
+ * laid out the way pioasm lays out its headers, so the two stay easy to
+ * compare. Edit the listing and the encodings together.
+ *
+ * change_capture_idle_cycles / _change_cycles are not pioasm output: they
+ * are the cycle counts of the two paths, which pio_capture.cpp needs to
+ * turn the down-counter back into time.
+ *
+ * License : MIT
+ */
+
+#pragma once
+
+#if !PICO_NO_HARDWARE
+#include "hardware/pio.h"
+#endif
+
+// -------------- //
+// change_capture //
+// -------------- //
+//
+// .program change_capture
+// ; Samples GP2..GP21 every loop and pushes two words whenever any pin changes:
+// ;   word 0 = 0xFFF00000 | pins[19:0]     (tagged: top bit set)
+// ;   word 1 = down-counter[30:0]          (top bit clear)
+// ; Y holds the previous sample, OSR the free-running loop down-counter.
+// ; Idle loop = 7 cycles (counter decrements), change path = 9 cycles (it does not).
+// .wrap_target
+// sample:
+//     mov isr, ~null
+//     in pins, 20
+//     mov x, isr
+//     jmp x!=y changed
+//     mov x, osr
+//     jmp x-- tick
+// tick:
+//     mov osr, x
+// .wrap
+// changed:
+//     mov y, x
+//     push noblock
+//     in osr, 31
+//     push noblock
+//     jmp sample
+
+#define change_capture_wrap_target 0
+#define change_capture_wrap 6
+
+// Cycles per pass: idle loop 0-6, change path 0-3 then 7-11
+#define change_capture_idle_cycles 7
+#define change_capture_change_cycles 9
+
+static const uint16_t change_capture_program_instructions[] = {
+            //     .wrap_target
+    0xa0cb, //  0: mov    isr, ~null
+    0x4014, //  1: in     pins, 20
+    0xa026, //  2: mov    x, isr
+    0x00a7, //  3: jmp    x != y, 7
+    0xa027, //  4: mov    x, osr
+    0x0046, //  5: jmp    x--, 6
+    0xa0e1, //  6: mov    osr, x
+            //     .wrap
+    0xa041, //  7: mov    y, x
+    0x8000, //  8: push   noblock
+    0x40ff, //  9: in     osr, 31
+    0x8000, // 10: push   noblock
+    0x0000, // 11: jmp    0
+};
+
+#if !PICO_NO_HARDWARE
+static const struct pio_program change_capture_program = {
+    .instructions = change_capture_program_instructions,
+    .length = 12,
+    .origin = -1,
+};
+
+static inline pio_sm_config change_capture_program_get_default_config(uint offset) {
+    pio_sm_config c = pio_get_default_sm_config();
+    sm_config_set_wrap(&c, offset + change_capture_wrap_target, offset + change_capture_wrap);
+    return c;
+}
+#endif
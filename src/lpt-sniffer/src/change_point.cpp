@@ -0,0 +1,170 @@
+/*
+ * PARALAX - streaming change-point detection over classifier windows
+ * ThisOldCPU Project - https://github.com/thisoldcpu
+ *
+ * License : MIT
+ */
+
+#include "change_point.h"
+
+#include <string.h>
+
+ChangePointDetector::ChangePointDetector()
+{
+  reset();
+}
+
+void ChangePointDetector::reset()
+{
+  clear(seg_);
+  clear(pend_);
+  cusum_ = 0;
+  segments_ = 0;
+}
+
+void ChangePointDetector::clear(Accum &a)
+{
+  memset(&a, 0, sizeof(a));
+}
+
+void ChangePointDetector::features(const DeviceWindow &w, uint32_t *out)
+{
+  for (uint8_t d = 0; d < DEV_COUNT; ++d)
+    out[d] = w.scores[d];
+
+  // Rate on a log scale, weighted below the scores: 4 per octave
+  uint32_t octaves = w.event_hz ? 32u - (uint32_t)__builtin_clz(w.event_hz) : 0;
+  out[DEV_COUNT] = octaves * 4u;
+}
+
+void ChangePointDetector::add_window(Accum &a, const DeviceWindow &w, const uint32_t *feat)
+{
+  if (a.n == 0)
+  {
+    a.start_us = w.start_us;
+    a.first_frame = w.first_frame;
+  }
+  a.end_us = w.end_us;
+  for (uint32_t i = 0; i < FEATURES; ++i)
+    a.sum[i] += feat[i];
+  a.n++;
+}
+
+void ChangePointDetector::merge(Accum &into, const Accum &from)
+{
+  if (from.n == 0)
+    return;
+  if (into.n == 0)
+  {
+    into = from;
+    return;
+  }
+  into.end_us = from.end_us;
+  for (uint32_t i = 0; i < FEATURES; ++i)
+    into.sum[i] += from.sum[i];
+  into.n += from.n;
+}
+
+bool ChangePointDetector::close(CaptureSegment &out)
+{
+  if (seg_.n == 0)
+    return false;
+
+  // Label from the mean scores, with the classifier's commit rule
+  uint8_t best = DEV_COVOX;
+  for (uint8_t d = DEV_COVOX; d < DEV_COUNT; ++d)
+    if (seg_.sum[d] > seg_.sum[best])
+      best = d;
+  uint32_t runner_up = 0;
+  for (uint8_t d = DEV_COVOX; d < DEV_COUNT; ++d)
+    if (d != best && seg_.sum[d] > runner_up)
+      runner_up = seg_.sum[d];
+
+  uint32_t mean = seg_.sum[best] / seg_.n;
+  out.start_us = seg_.start_us;
+  out.end_us = seg_.end_us;
+  out.first_frame = seg_.first_frame;
+  out.windows = seg_.n;
+  if (mean >= DeviceClassifier::COMMIT_SCORE)
+  {
+    out.device = (LptDevice)best;
+    out.confidence = (uint8_t)(mean - runner_up / seg_.n / 2);
+  }
+  else
+  {
+    out.device = DEV_UNKNOWN;
+    out.confidence = (uint8_t)(100 - mean);
+  }
+
+  segments_++;
+  clear(seg_);
+  return true;
+}
+
+bool ChangePointDetector::add(const DeviceWindow &w, CaptureSegment &out)
+{
+  uint32_t feat[FEATURES];
+  features(w, feat);
+
+  if (seg_.n == 0)
+  {
+    add_window(seg_, w, feat);
+    return false;
+  }
+
+  // Long silence: whatever comes next is a new segment
+  uint32_t last_end = pend_.n ? pend_.end_us : seg_.end_us;
+  if (w.start_us - last_end > GAP_US)
+  {
+    merge(seg_, pend_);
+    clear(pend_);
+    cusum_ = 0;
+    bool closed = close(out);
+    add_window(seg_, w, feat);
+    return closed;
+  }
+
+  uint32_t dist = 0;
+  for (uint32_t i = 0; i < FEATURES; ++i)
+  {
+    uint32_t mean = seg_.sum[i] / seg_.n;
+    dist += feat[i] > mean ? feat[i] - mean : mean - feat[i];
+  }
+
+  if (dist > DRIFT)
+  {
+    cusum_ += dist - DRIFT;
+    add_window(pend_, w, feat);
+    if (cusum_ < THRESHOLD)
+      return false;
+
+    // Change point: the drift began with the first pending window
+    bool closed = close(out);
+    seg_ = pend_;
+    clear(pend_);
+    cusum_ = 0;
+    return closed;
+  }
+
+  cusum_ = (cusum_ > DRIFT - dist) ? cusum_ - (DRIFT - dist) : 0;
+  if (cusum_ == 0)
+  {
+    // The excursion was noise: it belongs to the segment after all
+    merge(seg_, pend_);
+    clear(pend_);
+    add_window(seg_, w, feat);
+  }
+  else
+  {
+    add_window(pend_, w, feat);
+  }
+  return false;
+}
+
+bool ChangePointDetector::finish(CaptureSegment &out)
+{
+  merge(seg_, pend_);
+  clear(pend_);
+  cusum_ = 0;
+  return close(out);
+}
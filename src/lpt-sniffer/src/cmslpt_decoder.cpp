@@ -0,0 +1,86 @@
+/*
+ * PARALAX - CMSLPT decoder (Creative Music System / twin SAA1099 over LPT)
+ * ThisOldCPU Project - https://github.com/thisoldcpu
+ *
+ * License : MIT
+ */
+
+#include "cmslpt_decoder.h"
+
+CmsLptDecoder::CmsLptDecoder(const CmsLptWiring &wiring)
+    : wiring_(wiring)
+{
+  reset();
+}
+
+void CmsLptDecoder::reset()
+{
+  primed_ = false;
+  prev_bits_ = FRAME_BITS_IDLE;
+  for (uint8_t chip = 0; chip < 2; ++chip)
+  {
+    addr_[chip] = 0;
+    addr_valid_[chip] = false;
+    addr_writes_[chip] = 0;
+    data_writes_[chip] = 0;
+  }
+  violations_ = 0;
+}
+
+bool CmsLptDecoder::feed(const CaptureFrame &f, CmsWrite &out)
+{
+  if (!primed_)
+  {
+    // No edge on the first frame: a line already held low did not just fall
+    primed_ = true;
+    prev_bits_ = f.bits;
+    return false;
+  }
+
+  uint16_t prev = prev_bits_;
+  uint16_t cur = f.bits;
+  prev_bits_ = cur;
+
+  bool wr0 = bit_fell(prev, cur, wiring_.wr_bit[0]);
+  bool wr1 = bit_fell(prev, cur, wiring_.wr_bit[1]);
+  if (!wr0 && !wr1)
+    return false;
+
+  if (wr0 && wr1)
+  {
+    // Both chips strobed at once: not something the adapter can do
+    violations_++;
+    return false;
+  }
+
+  uint8_t chip = wr1 ? 1 : 0;
+
+  if (bit_at(cur, wiring_.a0_bit))
+  {
+    // Address latch
+    addr_writes_[chip]++;
+    if (f.data >= SAA1099_REG_COUNT)
+    {
+      violations_++;
+      addr_valid_[chip] = false;
+      return false;
+    }
+    addr_[chip] = f.data;
+    addr_valid_[chip] = true;
+    return false;
+  }
+
+  // Data write: SAA1099 keeps the address latched between data writes
+  data_writes_[chip]++;
+  if (!addr_valid_[chip])
+  {
+    violations_++;
+    return false;
+  }
+
+  out.t_us = f.t_us;
+  out.chip = chip;
+  out.reg = addr_[chip];
+  out.value = f.data;
+  return true;
+}
@@ -0,0 +1,137 @@
+/*
+ * PARALAX - Covox / DSS events to a 48 kHz PCM stream
+ * ThisOldCPU Project - https://github.com/thisoldcpu
+ *
+ * License : MIT
+ */
+
+#include "dac_pcm.h"
+
+DacPcmSource::DacPcmSource(PcmSink &sink)
+    : sink_(sink)
+{
+  reset();
+}
+
+void DacPcmSource::reset()
+{
+  started_ = false;
+  device_ = DEV_UNKNOWN;
+  held_ = 0x80;
+  last_t_ = 0;
+  now_us_ = 0;
+  grid_ = 0;
+  dss_phase_ = 0;
+  pit_.reset();
+  dss_head_ = 0;
+  dss_count_ = 0;
+  samples_ = 0;
+  late_ = 0;
+  dss_overflows_ = 0;
+  resyncs_ = 0;
+}
+
+void DacPcmSource::start(uint32_t t_us)
+{
+  started_ = true;
+  last_t_ = t_us;
+  now_us_ = t_us;
+  grid_ = (uint64_t)t_us * RATE_HZ;
+}
+
+// end is in us * RATE_HZ, like grid_
+void DacPcmSource::run_until(uint64_t end)
+{
+  while (grid_ <= end)
+  {
+    if (device_ == DEV_DSS)
+    {
+      dss_phase_ += DSS_RATE_HZ;
+      if (dss_phase_ >= RATE_HZ)
+      {
+        dss_phase_ -= RATE_HZ;
+        if (dss_count_)
+        {
+          held_ = dss_fifo_[dss_head_];
+          dss_head_ = (uint8_t)((dss_head_ + 1) & (DSS_FIFO - 1));
+          dss_count_--;
+        }
+      }
+    }
+
+    int16_t v = (int16_t)(((int32_t)held_ - 128) * 256);
+    sink_.on_sample(v, v);
+    samples_++;
+    grid_ += 1000000;
+  }
+}
+
+void DacPcmSource::advance(uint32_t t_us)
+{
+  advance_to(t_us, 0);
+}
+
+// Up to t_us plus an offset in 1/65536 us: a write snapped onto the PIT grid
+void DacPcmSource::advance_to(uint32_t t_us, int32_t offset_q16)
+{
+  if (!started_)
+  {
+    start(t_us);
+    return;
+  }
+
+  int32_t delta = (int32_t)(t_us - last_t_);
+  if (delta <= 0)
+    return;
+
+  last_t_ = t_us;
+  now_us_ += (uint32_t)delta;
+  if ((uint32_t)delta > MAX_GAP_US)
+  {
+    // Nobody kept time (no events, no advance): pick up from here
+    grid_ = now_us_ * RATE_HZ;
+    resyncs_++;
+    return;
+  }
+  run_until(now_us_ * RATE_HZ + (uint64_t)(((int64_t)offset_q16 * RATE_HZ) >> 16));
+}
+
+void DacPcmSource::on_event(const DeviceEvent &e)
+{
+  if (e.device != DEV_COVOX && e.device != DEV_DSS)
+    return;
+
+  if (started_ && (int32_t)(e.t_us - last_t_) < 0)
+    late_++;
+  else
+  {
+    int32_t offset_q16 = 0;
+    if (e.device == DEV_COVOX)
+      pit_.on_write(e.t_us, offset_q16);
+    advance_to(e.t_us, offset_q16);
+  }
+
+  if (e.device != device_)
+  {
+    if (device_ == DEV_COVOX)
+      pit_.reset();
+    device_ = e.device;
+    dss_head_ = 0;
+    dss_count_ = 0;
+    dss_phase_ = 0;
+  }
+
+  if (device_ == DEV_COVOX)
+  {
+    held_ = e.value;
+    return;
+  }
+
+  if (dss_count_ >= DSS_FIFO)
+  {
+    dss_overflows_++;
+    return;
+  }
+  dss_fifo_[(dss_head_ + dss_count_) & (DSS_FIFO - 1)] = e.value;
+  dss_count_++;
+}
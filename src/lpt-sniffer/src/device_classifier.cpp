@@ -0,0 +1,347 @@
+/*
+ * PARALAX - streaming LPT device classifier
+ * ThisOldCPU Project - https://github.com/thisoldcpu
+ *
+ * License : MIT
+ */
+
+#include "device_classifier.h"
+
+#include <string.h>
+
+// Control lines whose falling edge counts as a write, in falls_[] order
+static constexpr uint8_t WRITE_LINES[4] = {FB_STROBE, FB_AUTOFEED, FB_INIT, FB_SELECTIN};
+enum : uint8_t
+{
+  W_STROBE = 0,
+  W_AUTOFEED,
+  W_INIT,
+  W_SELECTIN,
+};
+
+const char *lpt_device_name(LptDevice device)
+{
+  switch (device)
+  {
+  case DEV_COVOX:
+    return "Covox";
+  case DEV_DSS:
+    return "DSS";
+  case DEV_OPL2LPT:
+    return "OPL2LPT";
+  case DEV_TNDLPT:
+    return "TNDLPT";
+  case DEV_CMSLPT:
+    return "CMSLPT";
+  default:
+    return "unknown";
+  }
+}
+
+static inline uint8_t gap_bucket(uint32_t gap_us)
+{
+  if (gap_us == 0)
+    return 0;
+  uint32_t b = 32u - (uint32_t)__builtin_clz(gap_us); // 1 -> 1, 2..3 -> 2, ...
+  return (uint8_t)(b < 15 ? b : 15);
+}
+
+DeviceClassifier::DeviceClassifier()
+{
+  reset();
+}
+
+void DeviceClassifier::reset()
+{
+  clear_window();
+  primed_ = false;
+  prev_bits_ = FRAME_BITS_IDLE;
+  prev_data_ = 0;
+  last_change_us_ = 0;
+  have_change_ = false;
+  last_init_a0_ = 1;
+  last_cms_a0_ = 1;
+
+  memset(&window_, 0, sizeof(window_));
+  frames_ = 0;
+  leader_ = DEV_UNKNOWN;
+  leader_conf_ = 0;
+  streak_ = 0;
+  device_ = DEV_UNKNOWN;
+  confidence_ = 0;
+  windows_ = 0;
+}
+
+void DeviceClassifier::clear_window()
+{
+  first_event_us_ = 0;
+  first_event_frame_ = 0;
+  last_event_us_ = 0;
+  events_ = 0;
+  data_changes_ = 0;
+  memset(falls_, 0, sizeof(falls_));
+  status_edges_ = 0;
+  memset(gap_hist_, 0, sizeof(gap_hist_));
+  memset(seen_, 0, sizeof(seen_));
+  distinct_ = 0;
+  init_a0_flips_ = 0;
+  init_addr_ok_ = 0;
+  init_addr_ = 0;
+  init_latch_ = 0;
+  cms_a0_flips_ = 0;
+  cms_addr_ok_ = 0;
+  cms_addr_ = 0;
+}
+
+bool DeviceClassifier::feed(const CaptureFrame &f, DeviceGuess &out)
+{
+  uint32_t frame = frames_++;
+
+  if (!primed_)
+  {
+    primed_ = true;
+    prev_bits_ = f.bits;
+    prev_data_ = f.data;
+    return false;
+  }
+
+  uint16_t prev = prev_bits_;
+  uint16_t cur = f.bits;
+  prev_bits_ = cur;
+
+  // A window that never filled is scored (or dropped) before this frame
+  // starts the next one
+  bool verdict = false;
+  if (events_ && (f.t_us - first_event_us_) >= WINDOW_MAX_US)
+  {
+    if (events_ >= MIN_EVENTS)
+      verdict = evaluate(f.t_us, out);
+    clear_window();
+  }
+
+  bool event = false;
+
+  if (f.data != prev_data_)
+  {
+    prev_data_ = f.data;
+    event = true;
+    data_changes_++;
+    if (have_change_)
+      gap_hist_[gap_bucket(f.t_us - last_change_us_)]++;
+    last_change_us_ = f.t_us;
+    have_change_ = true;
+
+    uint32_t &word = seen_[f.data >> 5];
+    uint32_t mask = 1u << (f.data & 31u);
+    if (!(word & mask))
+    {
+      word |= mask;
+      distinct_++;
+    }
+  }
+
+  for (uint8_t i = 0; i < 4; ++i)
+  {
+    if (!bit_fell(prev, cur, WRITE_LINES[i]))
+      continue;
+    event = true;
+    falls_[i]++;
+
+    if (i == W_INIT)
+    {
+      // OPL2LPT / TNDLPT: INIT is /WR, STROBE is A0 (low = address)
+      uint8_t a0 = (uint8_t)bit_at(cur, FB_STROBE);
+      if (a0 != last_init_a0_)
+        init_a0_flips_++;
+      last_init_a0_ = a0;
+      if (!a0)
+      {
+        init_addr_++;
+        if (f.data <= 0xF5)
+          init_addr_ok_++;
+      }
+      if (f.data & 0x80)
+        init_latch_++;
+    }
+    else if (i == W_STROBE || i == W_AUTOFEED)
+    {
+      // CMSLPT: STROBE / AUTOFEED are per-chip /WR, INIT is A0 (high = address)
+      uint8_t a0 = (uint8_t)bit_at(cur, FB_INIT);
+      if (a0 != last_cms_a0_)
+        cms_a0_flips_++;
+      last_cms_a0_ = a0;
+      if (a0)
+      {
+        cms_addr_++;
+        if (f.data < 0x20)
+          cms_addr_ok_++;
+      }
+    }
+  }
+
+  if (((prev ^ cur) >> FB_ACK) & 1u)
+    status_edges_++;
+  if (((prev ^ cur) >> FB_BUSY) & 1u)
+    status_edges_++;
+
+  if (!event)
+    return verdict;
+
+  if (events_ == 0)
+  {
+    first_event_us_ = f.t_us;
+    first_event_frame_ = frame;
+  }
+  last_event_us_ = f.t_us;
+  events_++;
+
+  if (events_ < WINDOW_EVENTS)
+    return verdict;
+
+  bool changed = evaluate(f.t_us, out);
+  clear_window();
+  return verdict || changed;
+}
+
+void DeviceClassifier::score_window()
+{
+  window_.start_us = first_event_us_;
+  window_.end_us = last_event_us_;
+  window_.first_frame = first_event_frame_;
+  window_.events = events_;
+
+  uint32_t span = last_event_us_ - first_event_us_;
+  window_.event_hz = span ? (uint32_t)((uint64_t)(events_ - 1) * 1000000u / span) : 0;
+
+  uint32_t falls = (uint32_t)falls_[W_STROBE] + falls_[W_AUTOFEED] + falls_[W_INIT] + falls_[W_SELECTIN];
+  uint32_t init = falls_[W_INIT];
+  uint32_t cms = (uint32_t)falls_[W_STROBE] + falls_[W_AUTOFEED];
+  uint32_t sel = falls_[W_SELECTIN];
+
+  // Share of data-change gaps in the busiest pair of adjacent buckets
+  uint32_t gaps = 0, best_pair = 0;
+  for (uint8_t b = 0; b < 16; ++b)
+  {
+    gaps += gap_hist_[b];
+    uint32_t pair = gap_hist_[b] + (b < 15 ? gap_hist_[b + 1] : 0);
+    if (pair > best_pair)
+      best_pair = pair;
+  }
+  bool regular = gaps >= 8 && best_pair * 10 >= gaps * 6;
+
+  // Control-line usage is the signature; the rest only adds weight once
+  // it matches, so one line pattern cannot score for two devices
+  uint8_t covox = 0;
+  if (falls * 8 <= data_changes_)
+  {
+    covox = 40;
+    if (window_.event_hz >= 4000 && window_.event_hz <= 48000)
+      covox += 20;
+    if (regular)
+      covox += 25;
+    if (distinct_ >= 16)
+      covox += 15;
+  }
+
+  uint8_t dss = 0;
+  if (sel * 2 >= events_ && sel * 2 >= falls)
+  {
+    dss = 50;
+    if (status_edges_)
+      dss += 20;
+    if (sel == falls)
+      dss += 15;
+    if (distinct_ >= 8)
+      dss += 15;
+  }
+
+  bool init_writes = init && init * 2 >= falls;
+
+  uint8_t opl = 0;
+  if (init_writes && init_a0_flips_ * 10 >= init * 7)
+  {
+    opl = 80;
+    if (init_addr_ && init_addr_ok_ * 10 >= init_addr_ * 9)
+      opl += 20;
+  }
+
+  uint8_t tnd = 0;
+  if (init_writes && init_a0_flips_ * 5 <= init)
+  {
+    tnd = 70;
+    if (init_latch_ * 4 >= init)
+      tnd += 30;
+  }
+
+  uint8_t cmslpt = 0;
+  if (cms && cms * 2 >= falls && cms_a0_flips_ * 2 >= cms)
+  {
+    cmslpt = 80;
+    if (cms_addr_ && cms_addr_ok_ * 10 >= cms_addr_ * 9)
+      cmslpt += 20;
+  }
+
+  window_.scores[DEV_COVOX] = covox;
+  window_.scores[DEV_DSS] = dss;
+  window_.scores[DEV_OPL2LPT] = opl;
+  window_.scores[DEV_TNDLPT] = tnd;
+  window_.scores[DEV_CMSLPT] = cmslpt;
+
+  uint8_t best = 0;
+  for (uint8_t d = DEV_COVOX; d < DEV_COUNT; ++d)
+    if (window_.scores[d] > best)
+      best = window_.scores[d];
+  window_.scores[DEV_UNKNOWN] = (uint8_t)(100 - best);
+}
+
+bool DeviceClassifier::evaluate(uint32_t t_us, DeviceGuess &out)
+{
+  score_window();
+  windows_++;
+
+  LptDevice best = DEV_UNKNOWN;
+  for (uint8_t d = DEV_COVOX; d < DEV_COUNT; ++d)
+    if (window_.scores[d] > window_.scores[best] || best == DEV_UNKNOWN)
+      best = (LptDevice)d;
+  LptDevice winner = window_.scores[best] >= COMMIT_SCORE ? best : DEV_UNKNOWN;
+
+  // Confidence is the winning score less half the runner-up's
+  uint8_t runner_up = 0;
+  for (uint8_t d = DEV_COVOX; d < DEV_COUNT; ++d)
+    if (d != best && window_.scores[d] > runner_up)
+      runner_up = window_.scores[d];
+  uint8_t score = (winner == DEV_UNKNOWN) ? window_.scores[DEV_UNKNOWN] : (uint8_t)(window_.scores[best] - runner_up / 2);
+
+  if (winner == leader_)
+  {
+    leader_conf_ = (uint8_t)(((uint32_t)leader_conf_ * 3 + score) / 4);
+    if (streak_ < 255)
+      streak_++;
+  }
+  else
+  {
+    leader_ = winner;
+    leader_conf_ = score;
+    streak_ = 1;
+  }
+
+  if (winner == device_)
+  {
+    confidence_ = leader_conf_;
+    return false;
+  }
+
+  // A challenger has to hold the lead before the announcement changes
+  confidence_ = (uint8_t)(((uint32_t)confidence_ * 3) / 4);
+  if (streak_ < COMMIT_WINDOWS)
+    return false;
+
+  device_ = winner;
+  confidence_ = leader_conf_;
+
+  out.t_us = t_us;
+  out.device = device_;
+  out.confidence = confidence_;
+  out.event_hz = window_.event_hz;
+  return true;
+}
@@ -0,0 +1,211 @@
+/*
+ * PARALAX - per-device decoders behind one interface
+ * ThisOldCPU Project - https://github.com/thisoldcpu
+ *
+ * License : MIT
+ */
+
+#include "device_decoders.h"
+
+static inline bool any_fell(uint16_t prev, uint16_t cur, uint16_t mask)
+{
+  return (prev & ~cur & mask) != 0;
+}
+
+static constexpr uint16_t M_STROBE = 1u << FB_STROBE;
+static constexpr uint16_t M_AUTOFEED = 1u << FB_AUTOFEED;
+static constexpr uint16_t M_INIT = 1u << FB_INIT;
+static constexpr uint16_t M_SELECTIN = 1u << FB_SELECTIN;
+
+static inline void make_event(DeviceEvent &out, const CaptureFrame &f, LptDevice device, uint8_t reg, uint8_t value)
+{
+  out.t_us = f.t_us;
+  out.device = device;
+  out.chip = 0;
+  out.reg = reg;
+  out.value = value;
+}
+
+// ---------------------------------------------------------------------------
+// Covox
+// ---------------------------------------------------------------------------
+
+void CovoxDecoder::reset()
+{
+  primed_ = false;
+  prev_data_ = 0;
+  prev_bits_ = FRAME_BITS_IDLE;
+  violations_ = 0;
+}
+
+bool CovoxDecoder::feed(const CaptureFrame &f, DeviceEvent &out)
+{
+  if (!primed_)
+  {
+    // The first frame only tells us what the DAC and the lines already hold
+    primed_ = true;
+    prev_data_ = f.data;
+    prev_bits_ = f.bits;
+    return false;
+  }
+
+  uint16_t prev = prev_bits_;
+  prev_bits_ = f.bits;
+
+  // A bare DAC has no use for the other write lines
+  if (any_fell(prev, f.bits, M_AUTOFEED | M_INIT | M_SELECTIN))
+    violations_++;
+
+  if (f.data == prev_data_)
+    return false;
+  prev_data_ = f.data;
+
+  make_event(out, f, DEV_COVOX, 0, f.data);
+  return true;
+}
+
+// ---------------------------------------------------------------------------
+// Disney Sound Source
+// ---------------------------------------------------------------------------
+
+void DssDecoder::reset()
+{
+  primed_ = false;
+  prev_bits_ = FRAME_BITS_IDLE;
+  violations_ = 0;
+}
+
+bool DssDecoder::feed(const CaptureFrame &f, DeviceEvent &out)
+{
+  if (!primed_)
+  {
+    // No edge on the first frame: a line already held low did not just fall
+    primed_ = true;
+    prev_bits_ = f.bits;
+    return false;
+  }
+
+  uint16_t prev = prev_bits_;
+  prev_bits_ = f.bits;
+
+  if (any_fell(prev, f.bits, M_STROBE | M_AUTOFEED | M_INIT))
+    violations_++;
+
+  if (!bit_fell(prev, f.bits, FB_SELECTIN))
+    return false;
+
+  make_event(out, f, DEV_DSS, 0, f.data);
+  return true;
+}
+
+// ---------------------------------------------------------------------------
+// OPL2LPT
+// ---------------------------------------------------------------------------
+
+void Opl2LptDecoder::reset()
+{
+  primed_ = false;
+  prev_bits_ = FRAME_BITS_IDLE;
+  addr_ = 0;
+  addr_valid_ = false;
+  violations_ = 0;
+}
+
+bool Opl2LptDecoder::feed(const CaptureFrame &f, DeviceEvent &out)
+{
+  if (!primed_)
+  {
+    // No edge on the first frame: a line already held low did not just fall
+    primed_ = true;
+    prev_bits_ = f.bits;
+    return false;
+  }
+
+  uint16_t prev = prev_bits_;
+  prev_bits_ = f.bits;
+
+  if (any_fell(prev, f.bits, M_SELECTIN))
+    violations_++;
+
+  if (!bit_fell(prev, f.bits, FB_INIT))
+    return false;
+
+  if (!bit_at(f.bits, FB_STROBE))
+  {
+    // Address write; YM3812 has nothing above 0xF5
+    addr_valid_ = f.data <= 0xF5;
+    addr_ = f.data;
+    if (!addr_valid_)
+      violations_++;
+    return false;
+  }
+
+  if (!addr_valid_)
+  {
+    violations_++;
+    return false;
+  }
+
+  make_event(out, f, DEV_OPL2LPT, addr_, f.data);
+  return true;
+}
+
+// ---------------------------------------------------------------------------
+// TNDLPT
+// ---------------------------------------------------------------------------
+
+void TndLptDecoder::reset()
+{
+  primed_ = false;
+  prev_bits_ = FRAME_BITS_IDLE;
+  latched_ = false;
+  violations_ = 0;
+}
+
+bool TndLptDecoder::feed(const CaptureFrame &f, DeviceEvent &out)
+{
+  if (!primed_)
+  {
+    // No edge on the first frame: a line already held low did not just fall
+    primed_ = true;
+    prev_bits_ = f.bits;
+    return false;
+  }
+
+  uint16_t prev = prev_bits_;
+  prev_bits_ = f.bits;
+
+  // STROBE moving means an A0 line, which the SN76489 does not have
+  if (any_fell(prev, f.bits, M_STROBE | M_AUTOFEED | M_SELECTIN))
+    violations_++;
+
+  if (!bit_fell(prev, f.bits, FB_INIT))
+    return false;
+
+  // A data byte (bit 7 clear) only means something after a latch byte
+  if (f.data & 0x80)
+    latched_ = true;
+  else if (!latched_)
+    violations_++;
+
+  make_event(out, f, DEV_TNDLPT, 0, f.data);
+  return true;
+}
+
+// ---------------------------------------------------------------------------
+// CMSLPT
+// ---------------------------------------------------------------------------
+
+bool CmsLptDeviceDecoder::feed(const CaptureFrame &f, DeviceEvent &out)
+{
+  CmsWrite w;
+  if (!dec_.feed(f, w))
+    return false;
+
+  out.t_us = w.t_us;
+  out.device = DEV_CMSLPT;
+  out.chip = w.chip;
+  out.reg = w.reg;
+  out.value = w.value;
+  return true;
+}
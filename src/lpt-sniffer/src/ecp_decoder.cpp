@@ -0,0 +1,142 @@
+/*
+ * PARALAX - IEEE 1284 ECP decoder with run-length expansion
+ * ThisOldCPU Project - https://github.com/thisoldcpu
+ *
+ * License : MIT
+ */
+
+#include "ecp_decoder.h"
+
+EcpDecoder::EcpDecoder()
+{
+  reset();
+}
+
+void EcpDecoder::reset()
+{
+  prev_bits_ = FRAME_BITS_IDLE;
+  phase_ = ECP_FORWARD;
+  in_cycle_ = false;
+  cycle_is_cmd_ = false;
+  cycle_value_ = 0;
+  cycle_us_ = 0;
+  cycle_sub_ = 0;
+  cycle_ticks_ = 0;
+  for (uint8_t dir = 0; dir < 2; ++dir)
+  {
+    pending_run_[dir] = 0;
+    wire_cycles_[dir] = 0;
+    rle_commands_[dir] = 0;
+    logical_bytes_[dir] = 0;
+  }
+  phase_changes_ = 0;
+  violations_ = 0;
+}
+
+void EcpDecoder::resync(uint16_t bits)
+{
+  prev_bits_ = bits;
+  in_cycle_ = false;
+  pending_run_[ECP_FORWARD] = pending_run_[ECP_REVERSE] = 0;
+  phase_ = ECP_FORWARD;
+}
+
+void EcpDecoder::update_phase(uint16_t cur)
+{
+  bool reverse_req = !bit_at(cur, FB_INIT);
+  bool reverse_ack = !bit_at(cur, FB_PAPER_OUT);
+
+  EcpPhase next;
+  if (!reverse_req && !reverse_ack)
+    next = ECP_FORWARD;
+  else if (reverse_req && reverse_ack)
+    next = ECP_REVERSE;
+  else
+    next = ECP_TURNAROUND;
+
+  if (next == phase_)
+    return;
+
+  // A pending run-length count does not survive a direction change
+  if (pending_run_[ECP_FORWARD] || pending_run_[ECP_REVERSE])
+    violations_++;
+  pending_run_[ECP_FORWARD] = pending_run_[ECP_REVERSE] = 0;
+  in_cycle_ = false;
+  phase_ = next;
+  phase_changes_++;
+}
+
+bool EcpDecoder::feed(const CaptureFrame &f, EcpEvent &out)
+{
+  uint16_t prev = prev_bits_;
+  uint16_t cur = f.bits;
+  prev_bits_ = cur;
+
+  update_phase(cur);
+  if (phase_ == ECP_TURNAROUND)
+    return false;
+
+  uint8_t dir = phase_;
+  uint8_t clk_bit = (dir == ECP_FORWARD) ? FB_STROBE : FB_ACK;
+
+  if (!in_cycle_)
+  {
+    if (!bit_fell(prev, cur, clk_bit))
+    {
+      // The other side's clock should be quiet in this phase
+      uint8_t other = (dir == ECP_FORWARD) ? FB_ACK : FB_STROBE;
+      if (bit_fell(prev, cur, other))
+        violations_++;
+      return false;
+    }
+
+    in_cycle_ = true;
+    // Forward: HostAck low = command. Reverse: PeriphAck low = command.
+    cycle_is_cmd_ = !bit_at(cur, (dir == ECP_FORWARD) ? FB_AUTOFEED : FB_BUSY);
+    cycle_value_ = f.data;
+    cycle_us_ = f.t_us;
+    cycle_sub_ = f.t_sub;
+    cycle_ticks_ = frame_ticks(f);
+    return false;
+  }
+
+  if (!bit_rose(prev, cur, clk_bit))
+    return false;
+
+  in_cycle_ = false;
+  wire_cycles_[dir]++;
+
+  if (cycle_is_cmd_ && !(cycle_value_ & 0x80u))
+  {
+    // Run-length count: applies to the next data byte
+    if (pending_run_[dir])
+      violations_++;
+    pending_run_[dir] = (uint8_t)(cycle_value_ + 1u);
+    rle_commands_[dir]++;
+    return false;
+  }
+
+  out.t_us = cycle_us_;
+  out.t_sub = cycle_sub_;
+  out.dir = dir;
+  out.value = cycle_is_cmd_ ? (uint8_t)(cycle_value_ & 0x7Fu) : cycle_value_;
+  out.cycle_ns = ticks_to_ns(frame_ticks(f) - cycle_ticks_);
+
+  if (cycle_is_cmd_)
+  {
+    out.item = ECP_ITEM_CHANNEL;
+    out.run = 0;
+    if (pending_run_[dir])
+    {
+      violations_++;
+      pending_run_[dir] = 0;
+    }
+    return true;
+  }
+
+  out.item = ECP_ITEM_DATA;
+  out.run = pending_run_[dir] ? pending_run_[dir] : 1;
+  pending_run_[dir] = 0;
+  logical_bytes_[dir] += out.run;
+  return true;
+}
@@ -0,0 +1,111 @@
+/*
+ * PARALAX - IEEE 1284 EPP cycle decoder
+ * ThisOldCPU Project - https://github.com/thisoldcpu
+ *
+ * License : MIT
+ */
+
+#include "epp_decoder.h"
+
+EppDecoder::EppDecoder()
+{
+  reset();
+}
+
+void EppDecoder::reset()
+{
+  prev_bits_ = FRAME_BITS_IDLE;
+  in_cycle_ = false;
+  acked_ = false;
+  type_ = EPP_DATA;
+  dir_ = EPP_WRITE;
+  value_ = 0;
+  start_us_ = 0;
+  start_sub_ = 0;
+  start_ticks_ = 0;
+  ack_ticks_ = 0;
+  for (auto &row : cycles_)
+    row[0] = row[1] = 0;
+  timeouts_ = 0;
+  violations_ = 0;
+}
+
+void EppDecoder::resync(uint16_t bits)
+{
+  prev_bits_ = bits;
+  in_cycle_ = false;
+}
+
+bool EppDecoder::feed(const CaptureFrame &f, EppCycle &out)
+{
+  uint16_t prev = prev_bits_;
+  uint16_t cur = f.bits;
+  prev_bits_ = cur;
+
+  if (!in_cycle_)
+  {
+    bool ds = bit_fell(prev, cur, FB_AUTOFEED);
+    bool as = bit_fell(prev, cur, FB_SELECTIN);
+    if (!ds && !as)
+      return false;
+    if (ds && as)
+    {
+      violations_++;
+      return false;
+    }
+
+    in_cycle_ = true;
+    acked_ = false;
+    type_ = as ? EPP_ADDR : EPP_DATA;
+    dir_ = bit_at(cur, FB_STROBE) ? EPP_READ : EPP_WRITE;
+    value_ = f.data;
+    start_us_ = f.t_us;
+    start_sub_ = f.t_sub;
+    start_ticks_ = frame_ticks(f);
+    ack_ticks_ = start_ticks_;
+
+    // Fast peripherals can already show nWait high in the strobe frame
+    if (bit_at(cur, FB_BUSY))
+      acked_ = true;
+    return false;
+  }
+
+  uint8_t strobe_bit = (type_ == EPP_ADDR) ? FB_SELECTIN : FB_AUTOFEED;
+  uint32_t now = frame_ticks(f);
+
+  if (!acked_ && bit_rose(prev, cur, FB_BUSY))
+  {
+    acked_ = true;
+    ack_ticks_ = now;
+  }
+
+  if (!bit_rose(prev, cur, strobe_bit))
+  {
+    if (bit_at(cur, FB_STROBE) != (dir_ == EPP_READ))
+    {
+      // nWrite must be stable for the whole cycle
+      violations_++;
+      in_cycle_ = false;
+      return false;
+    }
+    // Reads: peripheral drives the bus once it acknowledges
+    if (dir_ == EPP_READ && acked_)
+      value_ = f.data;
+    return false;
+  }
+
+  in_cycle_ = false;
+  if (!acked_)
+    timeouts_++;
+  cycles_[type_][dir_]++;
+
+  out.t_us = start_us_;
+  out.t_sub = start_sub_;
+  out.type = type_;
+  out.dir = dir_;
+  out.value = value_;
+  out.acked = acked_;
+  out.ack_ns = acked_ ? ticks_to_ns(ack_ticks_ - start_ticks_) : 0;
+  out.cycle_ns = ticks_to_ns(now - start_ticks_);
+  return true;
+}
@@ -0,0 +1,270 @@
+/*
+ * PARALAX - IEEE 1284 negotiation tracker and mode-switching session
+ * ThisOldCPU Project - https://github.com/thisoldcpu
+ *
+ * License : MIT
+ */
+
+#include "ieee1284_tracker.h"
+
+const char *ieee1284_mode_name(Ieee1284Mode mode)
+{
+  switch (mode)
+  {
+  case M1284_COMPAT:
+    return "COMPAT";
+  case M1284_NIBBLE:
+    return "NIBBLE";
+  case M1284_BYTE:
+    return "BYTE";
+  case M1284_ECP:
+    return "ECP";
+  case M1284_EPP:
+    return "EPP";
+  }
+  return "?";
+}
+
+Ieee1284Mode ieee1284_mode_from_ext(uint8_t ext)
+{
+  if (ext & EXT_EPP_MODE)
+    return M1284_EPP;
+  if (ext & EXT_ECP_MODE)
+    return M1284_ECP;
+  if (ext & EXT_BYTE_MODE)
+    return M1284_BYTE;
+  return M1284_NIBBLE;
+}
+
+// ---------------------------------------------------------------------------
+// Ieee1284Tracker
+// ---------------------------------------------------------------------------
+
+Ieee1284Tracker::Ieee1284Tracker()
+{
+  reset();
+}
+
+void Ieee1284Tracker::reset()
+{
+  prev_bits_ = FRAME_BITS_IDLE;
+  mode_ = M1284_COMPAT;
+  neg_ = NEG_IDLE;
+  ext_ = 0;
+  neg_start_us_ = 0;
+  last_ = Ieee1284Transition{0, M1284_COMPAT, M1284_COMPAT, 0, true, false};
+  negotiations_ = 0;
+  refusals_ = 0;
+  aborts_ = 0;
+}
+
+void Ieee1284Tracker::cancel()
+{
+  if (neg_ == NEG_IDLE)
+    return;
+  neg_ = NEG_IDLE;
+  aborts_++;
+}
+
+Ieee1284Step Ieee1284Tracker::switch_to(const CaptureFrame &f, Ieee1284Mode to, uint8_t ext, bool accepted)
+{
+  last_.t_us = f.t_us;
+  last_.from = mode_;
+  last_.to = to;
+  last_.ext = ext;
+  last_.accepted = accepted;
+  last_.device_id = (ext & EXT_DEVICE_ID) != 0;
+  mode_ = to;
+  return STEP_SWITCHED;
+}
+
+Ieee1284Step Ieee1284Tracker::feed(const CaptureFrame &f)
+{
+  uint16_t prev = prev_bits_;
+  uint16_t cur = f.bits;
+  prev_bits_ = cur;
+
+  if (mode_ != M1284_COMPAT)
+  {
+    // EPP uses SELECTIN as nAddrStrobe, so it terminates through nInit
+    uint8_t term_bit = (mode_ == M1284_EPP) ? FB_INIT : FB_SELECTIN;
+    if (bit_fell(prev, cur, term_bit))
+      return switch_to(f, M1284_COMPAT, 0, true);
+    return STEP_NONE;
+  }
+
+  if (neg_ == NEG_IDLE)
+  {
+    // Event 0: SELECTIN high with AUTOFEED low, entered on this frame
+    bool req = bit_at(cur, FB_SELECTIN) && !bit_at(cur, FB_AUTOFEED);
+    bool was = bit_at(prev, FB_SELECTIN) && !bit_at(prev, FB_AUTOFEED);
+    if (!req || was)
+      return STEP_NONE;
+
+    neg_ = NEG_REQUESTED;
+    ext_ = f.data;
+    neg_start_us_ = f.t_us;
+    negotiations_++;
+    return STEP_NEGOTIATING;
+  }
+
+  // Host drops nSelectIn to give up; a silent peripheral times out
+  if (!bit_at(cur, FB_SELECTIN) || (f.t_us - neg_start_us_) > NEGOTIATION_TIMEOUT_US)
+  {
+    neg_ = NEG_IDLE;
+    aborts_++;
+    return STEP_ABORTED;
+  }
+
+  if (neg_ == NEG_REQUESTED)
+  {
+    // Event 2: a 1284 peripheral answers with ACK low, PAPER_OUT/SELECT/ERROR high
+    if (!bit_at(cur, FB_ACK) && bit_at(cur, FB_PAPER_OUT) && bit_at(cur, FB_SELECT) && bit_at(cur, FB_ERROR))
+    {
+      neg_ = NEG_ACKED;
+    }
+    else if (bit_at(cur, FB_AUTOFEED))
+    {
+      // Not a negotiation after all (AUTOFEED released before any answer)
+      neg_ = NEG_IDLE;
+      aborts_++;
+      return STEP_ABORTED;
+    }
+  }
+
+  if (neg_ == NEG_ACKED && bit_fell(prev, cur, FB_STROBE))
+  {
+    // Event 3: the extensibility byte is latched here
+    ext_ = f.data;
+    neg_ = NEG_LATCHED;
+    return STEP_NEGOTIATING;
+  }
+
+  if (neg_ == NEG_LATCHED && bit_at(cur, FB_STROBE) && bit_at(cur, FB_AUTOFEED))
+    neg_ = NEG_RELEASED;
+
+  if (neg_ == NEG_RELEASED && bit_at(cur, FB_ACK))
+  {
+    // Event 6: SELECT carries XFlag. Nibble mode is mandatory, so it is
+    // accepted whatever XFlag says.
+    neg_ = NEG_IDLE;
+    Ieee1284Mode want = ieee1284_mode_from_ext(ext_);
+    bool accepted = (want == M1284_NIBBLE) || bit_at(cur, FB_SELECT);
+    if (!accepted)
+      refusals_++;
+    return switch_to(f, accepted ? want : M1284_COMPAT, ext_, accepted);
+  }
+
+  return STEP_NEGOTIATING;
+}
+
+// ---------------------------------------------------------------------------
+// Ieee1284Session
+// ---------------------------------------------------------------------------
+
+Ieee1284Session::Ieee1284Session(Ieee1284Sink &sink)
+    : sink_(sink)
+{
+  reset();
+}
+
+void Ieee1284Session::reset()
+{
+  tracker_.reset();
+  epp_.reset();
+  ecp_.reset();
+  rev_.reset();
+  prev_bits_ = FRAME_BITS_IDLE;
+  held_count_ = 0;
+  hold_overflows_ = 0;
+}
+
+void Ieee1284Session::route(const CaptureFrame &f)
+{
+  switch (tracker_.mode())
+  {
+  case M1284_COMPAT:
+    sink_.on_compat_frame(f);
+    break;
+  case M1284_NIBBLE:
+  case M1284_BYTE:
+  {
+    ReverseByte b;
+    if (rev_.feed(f, b))
+      sink_.on_reverse(tracker_.mode(), b);
+    break;
+  }
+  case M1284_EPP:
+  {
+    EppCycle c;
+    if (epp_.feed(f, c))
+      sink_.on_epp(c);
+    break;
+  }
+  case M1284_ECP:
+  {
+    EcpEvent e;
+    if (ecp_.feed(f, e))
+      sink_.on_ecp(e);
+    break;
+  }
+  }
+}
+
+void Ieee1284Session::release_held()
+{
+  // Negotiation only starts from compatibility mode, so that is where
+  // the frames of an abandoned one belong
+  for (uint32_t i = 0; i < held_count_; ++i)
+    sink_.on_compat_frame(held_[i]);
+  held_count_ = 0;
+}
+
+void Ieee1284Session::feed(const CaptureFrame &f)
+{
+  uint16_t prev = prev_bits_;
+  prev_bits_ = f.bits;
+
+  switch (tracker_.feed(f))
+  {
+  case STEP_NONE:
+    route(f);
+    break;
+
+  case STEP_NEGOTIATING:
+    if (held_count_ < HOLD_FRAMES)
+    {
+      held_[held_count_++] = f;
+      break;
+    }
+    // Far longer than any real negotiation: treat it as ordinary traffic
+    hold_overflows_++;
+    tracker_.cancel();
+    release_held();
+    route(f);
+    break;
+
+  case STEP_ABORTED:
+    release_held();
+    route(f);
+    break;
+
+  case STEP_SWITCHED:
+  {
+    // Held frames were the handshake itself, not traffic
+    held_count_ = 0;
+    const Ieee1284Transition &t = tracker_.transition();
+    if (t.to == M1284_EPP)
+      epp_.resync(prev);
+    else if (t.to == M1284_ECP)
+      ecp_.resync(prev);
+    else if (t.to == M1284_NIBBLE)
+      rev_.resync(REVERSE_NIBBLE, prev);
+    else if (t.to == M1284_BYTE)
+      rev_.resync(REVERSE_BYTE, prev);
+    sink_.on_transition(t);
+    route(f);
+    break;
+  }
+  }
+}
@@ -0,0 +1,65 @@
+/*
+ * PARALAX LPT Sniffer - as-built pin map and bus snapshot helpers
+ * ThisOldCPU Project - https://github.com/thisoldcpu
+ *
+ * Shared by every capture path (IRQ edge, PIO) so a frame means the same
+ * thing no matter which profile produced it.
+ *
+ * License : MIT
+ */
+
+#pragma once
+
+#include <Arduino.h>
+
+#include "hardware/structs/sio.h"
+
+#include "capture_frame.h"
+
+// -------------------- AS-BUILT PIN MAP --------------------
+static constexpr uint PIN_D0_D7_BASE = 2; // GP2..GP9
+static constexpr uint PIN_STROBE = 10;    // DB25-1
+static constexpr uint PIN_ACK = 11;       // DB25-10
+static constexpr uint PIN_BUSY = 12;      // DB25-11
+
+static constexpr uint PIN_AUTOFEED = 21;       // DB25-14
+static constexpr uint PIN_INIT = 19;           // DB25-16 (RESET/INIT)
+static constexpr uint PIN_SELECT_PRINTER = 18; // DB25-17 (SELECTIN)
+
+static constexpr uint PIN_PAPER_OUT = 14;     // DB25-12
+static constexpr uint PIN_SELECT_STATUS = 15; // DB25-13 (SELECT)
+static constexpr uint PIN_ERROR = 20;         // DB25-15
+
+static constexpr uint PIN_PWM_AUDIO = 22; // headphone monitor, through an RC filter
+// ----------------------------------------------------------
+
+// PIO capture samples the contiguous block GP2..GP21
+static constexpr uint PIN_CAPTURE_BASE = PIN_D0_D7_BASE;
+static constexpr uint PIN_CAPTURE_COUNT = 20;
+
+static inline uint32_t gpio_snapshot()
+{
+  return sio_hw->gpio_in;
+}
+
+static inline uint8_t read_data_bus(uint32_t snap)
+{
+  return (uint8_t)((snap >> PIN_D0_D7_BASE) & 0xFFu);
+}
+
+static inline uint16_t pack_bits(uint32_t snap)
+{
+  uint16_t b = 0;
+  b |= ((snap >> PIN_STROBE) & 1u) << 0;
+  b |= ((snap >> PIN_ACK) & 1u) << 1;
+  b |= ((snap >> PIN_BUSY) & 1u) << 2;
+
+  b |= ((snap >> PIN_AUTOFEED) & 1u) << 3;
+  b |= ((snap >> PIN_INIT) & 1u) << 4;
+  b |= ((snap >> PIN_SELECT_PRINTER) & 1u) << 5;
+
+  b |= ((snap >> PIN_PAPER_OUT) & 1u) << 6;
+  b |= ((snap >> PIN_SELECT_STATUS) & 1u) << 7;
+  b |= ((snap >> PIN_ERROR) & 1u) << 8;
+  return b;
+}
@@ -10,6 +10,25 @@
  *
  * Output  : t_us,data_hex,strobe,ack,busy,autofeed,init,selectin,paper_out,select,error
  *
+ * Profiles: IRQ_EDGE  - GPIO IRQ per edge, 1 us stamps (default, low rates)
+ *           PIO_CHANGE - PIO polls all pins, DMA ring, ~53 ns stamps (EPP/ECP);
+ *                        t_us is printed as t_us.nnn
+ *
+ * Devices : Covox/DSS/OPL2LPT/TNDLPT/CMSLPT are classified on core 1 while
+ *           every candidate decoder runs speculatively; verdicts are
+ *           announced as "# device: NAME (NN%)" comment lines, and device
+ *           changes close "# segment: START-END us NAME (NN%)" lines
+ *
+ * USB     : composite CDC console + "PARALAX Audio" (UAC1, 48 kHz stereo)
+ *           carrying the decoded Covox/DSS output through an ASRC locked
+ *           to the host clock; underruns are announced as
+ *           "# audio: underrun" lines
+ *
+ * Meters  : four times a second core 1 reduces the same stream to levels,
+ *           a 16-band spectrum and the OPL keys held/struck, printed as
+ *           "# meter: " + 54 hex digits (see pcm_meter.h); console
+ *           "meter on|off" toggles them
+ *
  * 
  * TODO - Add device list: Unlatched Covox-style DAC
  * 
@@ -25,24 +44,30 @@
 
 #include "pico/time.h"
 
-// -------------------- AS-BUILT PIN MAP --------------------
-static constexpr uint PIN_D0_D7_BASE = 2; // GP2..GP9
-static constexpr uint PIN_STROBE = 10;    // DB25-1
-static constexpr uint PIN_ACK = 11;       // DB25-10
-static constexpr uint PIN_BUSY = 12;      // DB25-11
-
-static constexpr uint PIN_AUTOFEED = 21;       // DB25-14
-static constexpr uint PIN_INIT = 19;           // DB25-16 (RESET/INIT)
-static constexpr uint PIN_SELECT_PRINTER = 18; // DB25-17 (SELECTIN)
-
-static constexpr uint PIN_PAPER_OUT = 14;     // DB25-12
-static constexpr uint PIN_SELECT_STATUS = 15; // DB25-13 (SELECT)
-static constexpr uint PIN_ERROR = 20;         // DB25-15
-// ----------------------------------------------------------
+#include "asrc.h"
+#include "capture_frame.h"
+#include "change_point.h"
+#include "dac_pcm.h"
+#include "device_classifier.h"
+#include "ieee1284_tracker.h"
+#include "lpt_pins.h"
+#include "opl2_pcm.h"
+#include "opl_scheduler.h"
+#include "opl_write_cache.h"
+#include "pcm_interp.h"
+#include "pcm_meter.h"
+#include "pio_capture.h"
+#include "pwm_audio.h"
+#include "pwm_monitor.h"
+#include "speculative_decoder.h"
+#include "spsc_ring.h"
+#include "uac_packetizer.h"
+#include "usb_audio.h"
 
 // Output controls
 static constexpr bool PRINT_HEADER_ON_BOOT = true;
 static constexpr bool PRINT_HEARTBEAT_IDLE = true;
+static constexpr bool PRINT_METERS_ON_BOOT = true;
 
 // Serial speed (CSV is heavy; go fast)
 static constexpr uint32_t SERIAL_BAUD = 921600;
@@ -51,26 +76,29 @@ static constexpr uint32_t SERIAL_BAUD = 921600;
 static constexpr uint32_t RB_SIZE = 4096;
 static_assert((RB_SIZE & (RB_SIZE - 1)) == 0, "RB_SIZE must be power-of-two");
 
+// Capture profile selected at boot
+enum CaptureProfile : uint8_t
+{
+  PROFILE_IRQ_EDGE = 0,
+  PROFILE_PIO_CHANGE = 1,
+};
+static constexpr CaptureProfile BOOT_CAPTURE_PROFILE = PROFILE_IRQ_EDGE;
+
+// Follow IEEE 1284 negotiations: PIO_CHANGE for EPP/ECP, IRQ_EDGE otherwise.
+// Console "profile irq|pio|auto" overrides at runtime.
+static constexpr bool AUTO_PROFILE_ON_1284 = true;
+
+// Unclassified compatibility-mode traffic faster than this moves to PIO_CHANGE
+static constexpr uint32_t IRQ_EDGE_MAX_EVENT_HZ = 100000;
+
 // Frame coalescing deadband (microseconds)
 // Prevents multi-frame spam from bit-skew/ripple during a single write.
 static constexpr uint32_t FRAME_DEADBAND_US = 3;
 
-struct CaptureFrame
-{
-  uint32_t t_us; // timestamp since start
-  uint8_t  data; // D0..D7
-  uint16_t bits; // packed 9-bit control/status snapshot
-  // bits layout:
-  // 0 STROBE
-  // 1 ACK
-  // 2 BUSY
-  // 3 AUTOFEED
-  // 4 INIT
-  // 5 SELECTIN
-  // 6 PAPER_OUT
-  // 7 SELECT
-  // 8 ERROR
-};
+// A quiet bus gives PIO no frame past the switch; stop waiting for one after
+// this. The IRQ ring holds the new profile's frames meanwhile (100 per ms at
+// IRQ_EDGE_MAX_EVENT_HZ, against RB_SIZE).
+static constexpr uint32_t PIO_DRAIN_TIMEOUT_US = 1000;
 
 // NOTE: buffer is NOT volatile; only indices are volatile.
 // ISR is the only writer; loop() is the only reader.
@@ -79,45 +107,117 @@ static volatile uint32_t rb_w = 0;
 static volatile uint32_t rb_r = 0;
 static volatile uint32_t dropped = 0;
 
-static uint32_t start_us = 0;
-static uint32_t frames_captured = 0;
-static uint32_t last_frame_ms = 0;
+static CaptureProfile active_profile = PROFILE_IRQ_EDGE;
+static bool auto_profile = AUTO_PROFILE_ON_1284;
 
-// For deadband coalescing
-static volatile uint32_t last_frame_t_us = 0;
+// Make-before-break profile switch: the old profile is drained up to
+// switch_t_us, the new one already captures from that point on
+static bool draining_irq = false;
+static bool draining_pio = false;
+static bool pio_drained = false; // a PIO frame at or after switch_t_us was seen
+static uint32_t switch_t_us = 0;
+static bool frame_from_pio = false;
 
-static inline uint32_t gpio_snapshot()
-{
-  return sio_hw->gpio_in;
-}
+static Ieee1284Tracker mode_tracker;
+
+// ---- Core 1: device classification + speculative decoding ----
+// Core 0 hands over compatibility-mode frames; core 1 runs every candidate
+// decoder on them until the classifier commits, and reports verdicts back.
+static constexpr uint32_t SPEC_QUEUE_FRAMES = 2048;
 
-static inline uint8_t read_data_bus(uint32_t snap)
+class DecodeStats : public DeviceEventSink
 {
-  return (uint8_t)((snap >> PIN_D0_D7_BASE) & 0xFFu);
-}
+public:
+  void on_event(const DeviceEvent &e) override;
 
-static inline uint16_t pack_bits(uint32_t snap)
+  void on_commit(LptDevice device, uint32_t replayed_events, uint32_t lost_events) override
+  {
+    (void)device;
+    replayed += replayed_events;
+    lost += lost_events;
+  }
+
+  void on_reopen() override;
+
+  volatile uint32_t events = 0;
+  volatile uint32_t replayed = 0;
+  volatile uint32_t lost = 0;
+};
+
+static SpscRing<CaptureFrame, SPEC_QUEUE_FRAMES> spec_frames; // core 0 -> core 1
+static SpscRing<DeviceGuess, 16> spec_verdicts;               // core 1 -> core 0
+static SpscRing<CaptureSegment, 8> spec_segments;             // core 1 -> core 0
+static SpscRing<MeterRecord, 4> meter_records;                // core 1 -> core 0
+static DecodeStats decode_stats;
+static DeviceClassifier device_classifier;                    // core 1 only
+static ChangePointDetector change_points;                      // core 1 only
+static uint32_t windows_seen = 0;                              // core 1 only, classifier windows handed on
+static SpeculativeDecoder speculative(decode_stats);           // core 1 only
+static DeviceGuess last_guess = {0, DEV_UNKNOWN, 0, 0};       // core 0 only
+
+// ---- USB audio: core 1 produces 48 kHz PCM, the USB task on core 0 sends it ----
+// The Asrc carries the stream from the Pico's clock to the host's SOF clock.
+// The same stream goes to the PWM headphone monitor, refilled on core 1,
+// and to the meters.
+static Asrc usb_asrc;
+static UacPacketizer usb_packetizer(usb_asrc);
+static PwmMonitor pwm_monitor;
+static PcmMeter pcm_meter;                  // core 1 only
+static PcmTee pcm_local(pwm_monitor, pcm_meter);
+static PcmTee pcm_out(usb_asrc, pcm_local);
+static DacPcmSource dac_pcm(pcm_out);       // core 1 only
+static Opl2PcmSource opl2_pcm(pcm_out);     // core 1 only, soft OPL2
+
+// OPL2LPT writes reach the soft OPL2 at the pace a real YM3812 takes them
+class Opl2ChipSink : public OplWriteSink
 {
-  uint16_t b = 0;
-  b |= ((snap >> PIN_STROBE) & 1u) << 0;
-  b |= ((snap >> PIN_ACK) & 1u) << 1;
-  b |= ((snap >> PIN_BUSY) & 1u) << 2;
-
-  b |= ((snap >> PIN_AUTOFEED) & 1u) << 3;
-  b |= ((snap >> PIN_INIT) & 1u) << 4;
-  b |= ((snap >> PIN_SELECT_PRINTER) & 1u) << 5;
-
-  b |= ((snap >> PIN_PAPER_OUT) & 1u) << 6;
-  b |= ((snap >> PIN_SELECT_STATUS) & 1u) << 7;
-  b |= ((snap >> PIN_ERROR) & 1u) << 8;
-  return b;
+public:
+  void on_opl_write(uint64_t t_ns, uint16_t reg, uint8_t value) override
+  {
+    DeviceEvent e = {(uint32_t)(t_ns / 1000), DEV_OPL2LPT, 0, (uint8_t)reg, value};
+    opl2_pcm.on_event(e);
+  }
+};
+static Opl2ChipSink opl2_chip;
+static OplScheduler opl_sched(opl2_chip);   // core 1 only
+static OplWriteCache opl_cache;             // core 1 only, drops repeats before the scheduler
+static uint8_t pcm_device = DEV_UNKNOWN;    // core 1 only, source feeding the Asrc
+static volatile uint32_t opl2_path_us = 0;  // core 1 time in write cache, scheduler and synth
+static volatile bool capture_armed = false; // setup() done, start_us valid
+static bool print_meters = PRINT_METERS_ON_BOOT; // core 0 only
+static volatile uint32_t interp_mismatches = 0; // SIO interpolators vs the model, at boot
+
+void DecodeStats::on_event(const DeviceEvent &e)
+{
+  events++;
+  pcm_device = e.device;
+  if (e.device != DEV_OPL2LPT)
+  {
+    dac_pcm.on_event(e);
+    return;
+  }
+
+  uint32_t t0 = time_us_32();
+  if (opl_cache.pass(e.reg, e.value))
+    opl_sched.push(e.t_us, e.reg, e.value);
+  opl2_path_us += time_us_32() - t0;
 }
 
-static inline uint8_t bit_at(uint16_t bits, uint8_t idx)
+void DecodeStats::on_reopen()
 {
-  return (uint8_t)((bits >> idx) & 1u);
+  // The committed decoder no longer fits the traffic: ask again. Its window
+  // count starts over, so every window from here on is a new one.
+  device_classifier.reset();
+  windows_seen = 0;
 }
 
+static uint32_t start_us = 0;
+static uint32_t frames_captured = 0;
+static uint32_t last_frame_ms = 0;
+
+// For deadband coalescing
+static volatile uint32_t last_frame_t_us = 0;
+
 // ---- IRQ handler: ANY edge on ANY monitored pin -> enqueue a FRAME ----
 static void __not_in_flash_func(any_irq)(uint gpio, uint32_t events)
 {
@@ -147,6 +247,7 @@ static void __not_in_flash_func(any_irq)(uint gpio, uint32_t events)
   }
 
   rb[w].t_us = t;
+  rb[w].t_sub = 0;
   rb[w].data = read_data_bus(snap);
   rb[w].bits = pack_bits(snap);
 
@@ -202,6 +303,69 @@ static void arm_all_irqs()
   gpio_set_irq_enabled(PIN_ERROR,          GPIO_IRQ_EDGE_RISE | GPIO_IRQ_EDGE_FALL, true);
 }
 
+static void disarm_all_irqs()
+{
+  gpio_set_irq_enabled(PIN_STROBE, GPIO_IRQ_EDGE_RISE | GPIO_IRQ_EDGE_FALL, false);
+
+  // DATA bus GP2..GP9
+  for (uint pin = PIN_D0_D7_BASE; pin < PIN_D0_D7_BASE + 8; ++pin)
+  {
+    gpio_set_irq_enabled(pin, GPIO_IRQ_EDGE_RISE | GPIO_IRQ_EDGE_FALL, false);
+  }
+
+  // Control/status pins
+  gpio_set_irq_enabled(PIN_ACK,            GPIO_IRQ_EDGE_RISE | GPIO_IRQ_EDGE_FALL, false);
+  gpio_set_irq_enabled(PIN_BUSY,           GPIO_IRQ_EDGE_RISE | GPIO_IRQ_EDGE_FALL, false);
+  gpio_set_irq_enabled(PIN_AUTOFEED,       GPIO_IRQ_EDGE_RISE | GPIO_IRQ_EDGE_FALL, false);
+  gpio_set_irq_enabled(PIN_INIT,           GPIO_IRQ_EDGE_RISE | GPIO_IRQ_EDGE_FALL, false);
+  gpio_set_irq_enabled(PIN_SELECT_PRINTER, GPIO_IRQ_EDGE_RISE | GPIO_IRQ_EDGE_FALL, false);
+  gpio_set_irq_enabled(PIN_PAPER_OUT,      GPIO_IRQ_EDGE_RISE | GPIO_IRQ_EDGE_FALL, false);
+  gpio_set_irq_enabled(PIN_SELECT_STATUS,  GPIO_IRQ_EDGE_RISE | GPIO_IRQ_EDGE_FALL, false);
+  gpio_set_irq_enabled(PIN_ERROR,          GPIO_IRQ_EDGE_RISE | GPIO_IRQ_EDGE_FALL, false);
+}
+
+static void start_profile(CaptureProfile profile)
+{
+  active_profile = profile;
+  if (profile == PROFILE_PIO_CHANGE && pio_capture_start(0))
+    return;
+
+  // IRQ edge capture is also the fallback if PIO/DMA resources are taken
+  active_profile = PROFILE_IRQ_EDGE;
+  arm_all_irqs();
+}
+
+static void switch_profile(CaptureProfile to)
+{
+  if (to == active_profile || draining_irq || draining_pio)
+    return;
+
+  // Start the new capture before stopping the old one so no edge falls
+  // in between; next_frame() trims the overlap by timestamp
+  uint32_t t_now = time_us_32() - start_us;
+  if (to == PROFILE_PIO_CHANGE)
+  {
+    if (!pio_capture_start(t_now))
+      return;
+    disarm_all_irqs();
+    draining_irq = true;
+  }
+  else
+  {
+    last_frame_t_us = t_now;
+    arm_all_irqs();
+    draining_pio = true;
+    pio_drained = false;
+  }
+  switch_t_us = t_now;
+  active_profile = to;
+}
+
+static const char *profile_name(CaptureProfile profile)
+{
+  return (profile == PROFILE_PIO_CHANGE) ? "PIO_CHANGE" : "IRQ_EDGE";
+}
+
 static void print_banner()
 {
   Serial.println();
@@ -214,6 +378,8 @@ static void print_banner()
   Serial.println("CSV: t_us,data_hex,strobe,ack,busy,autofeed,init,selectin,paper_out,select,error");
   Serial.print("Deadband(us): ");
   Serial.println((uint32_t)FRAME_DEADBAND_US);
+  Serial.print("Profile: ");
+  Serial.println(profile_name(BOOT_CAPTURE_PROFILE));
   Serial.println();
 }
 
@@ -236,12 +402,158 @@ static bool rb_pop(CaptureFrame &out)
   return true;
 }
 
+static inline bool before_switch(const CaptureFrame &f)
+{
+  return (int32_t)(f.t_us - switch_t_us) < 0;
+}
+
+static bool next_frame(CaptureFrame &out)
+{
+  if (draining_irq)
+  {
+    // IRQs are off: whatever is left in the ring is finite
+    frame_from_pio = false;
+    while (rb_pop(out))
+    {
+      if (before_switch(out))
+        return true;
+    }
+    draining_irq = false;
+  }
+
+  if (draining_pio)
+  {
+    // PIO keeps running until it reaches frames the IRQ path also has. An
+    // empty ring is not the end: DMA may still be moving frames stamped
+    // before the switch, and the IRQ path waits behind them to keep order.
+    frame_from_pio = true;
+    if (pio_capture_pop(out))
+    {
+      if (before_switch(out))
+        return true;
+      pio_drained = true; // the IRQ path has this one too
+    }
+    if (!pio_drained && time_us_32() - start_us - switch_t_us < PIO_DRAIN_TIMEOUT_US)
+      return false;
+    pio_capture_stop();
+    draining_pio = false;
+  }
+
+  frame_from_pio = (active_profile == PROFILE_PIO_CHANGE);
+  if (frame_from_pio)
+    return pio_capture_pop(out);
+  return rb_pop(out);
+}
+
+static void track_1284_mode(const CaptureFrame &ev)
+{
+  if (mode_tracker.feed(ev) != STEP_SWITCHED)
+    return;
+
+  const Ieee1284Transition &t = mode_tracker.transition();
+  Serial.print("# 1284: ");
+  Serial.print(ieee1284_mode_name(t.from));
+  Serial.print(" -> ");
+  Serial.print(ieee1284_mode_name(t.to));
+  if (t.ext || !t.accepted)
+  {
+    Serial.print(" (ext 0x");
+    Serial.print(t.ext, HEX);
+    Serial.print(t.accepted ? ")" : ", refused)");
+  }
+  Serial.println();
+
+  if (auto_profile)
+    switch_profile((t.to == M1284_EPP || t.to == M1284_ECP) ? PROFILE_PIO_CHANGE : PROFILE_IRQ_EDGE);
+}
+
+static void classify_device(const CaptureFrame &ev)
+{
+  // 1284 modes have their own protocols; only compatibility traffic is a device
+  if (mode_tracker.mode() == M1284_COMPAT)
+    spec_frames.push(ev);
+}
+
+static void poll_verdicts()
+{
+  DeviceGuess g;
+  while (spec_verdicts.pop(g))
+  {
+    last_guess = g;
+    Serial.print("# device: ");
+    Serial.print(lpt_device_name(g.device));
+    Serial.print(" (");
+    Serial.print(g.confidence);
+    Serial.println("%)");
+
+    if (!auto_profile)
+      continue;
+
+    // Every known device is well within IRQ_EDGE rates and wants its 1 us stamps
+    if (g.device != DEV_UNKNOWN)
+      switch_profile(PROFILE_IRQ_EDGE);
+    else if (g.event_hz > IRQ_EDGE_MAX_EVENT_HZ)
+      switch_profile(PROFILE_PIO_CHANGE);
+  }
+
+  CaptureSegment s;
+  while (spec_segments.pop(s))
+  {
+    Serial.print("# segment: ");
+    Serial.print(s.start_us);
+    Serial.print("-");
+    Serial.print(s.end_us);
+    Serial.print(" us ");
+    Serial.print(lpt_device_name(s.device));
+    Serial.print(" (");
+    Serial.print(s.confidence);
+    Serial.println("%)");
+  }
+}
+
+static void poll_meters()
+{
+  static const char HEX_DIGITS[] = "0123456789ABCDEF";
+  MeterRecord r;
+  while (meter_records.pop(r))
+  {
+    if (!print_meters)
+      continue;
+    uint8_t bytes[PcmMeter::RECORD_BYTES];
+    PcmMeter::pack(r, bytes);
+    char line[9 + PcmMeter::RECORD_BYTES * 2 + 1] = "# meter: ";
+    for (uint32_t i = 0; i < PcmMeter::RECORD_BYTES; ++i)
+    {
+      line[9 + i * 2] = HEX_DIGITS[bytes[i] >> 4];
+      line[10 + i * 2] = HEX_DIGITS[bytes[i] & 15];
+    }
+    line[sizeof(line) - 1] = 0;
+    Serial.println(line);
+  }
+}
+
+static void print_timestamp(const CaptureFrame &ev)
+{
+  Serial.print(ev.t_us);
+  if (!frame_from_pio)
+    return;
+
+  // Sub-microsecond part as .nnn nanoseconds
+  uint32_t ns = ((uint32_t)ev.t_sub * 1000u) >> 8;
+  Serial.print(".");
+  if (ns < 100)
+    Serial.print("0");
+  if (ns < 10)
+    Serial.print("0");
+  Serial.print(ns);
+}
+
 static void drain_and_print()
 {
   CaptureFrame ev;
-  while (rb_pop(ev))
+  while (next_frame(ev))
   {
-    Serial.print(ev.t_us);
+    print_timestamp(ev);
     Serial.print(",");
 
     if (ev.data < 0x10)
@@ -267,17 +579,50 @@ static void drain_and_print()
     Serial.print(",");
     Serial.println(bit_at(ev.bits, 8));
 
+    track_1284_mode(ev);
+    classify_device(ev);
+
     frames_captured++;
     last_frame_ms = millis();
   }
 }
 
+static void poll_audio()
+{
+  // Underruns are counted on every packet but announced at most once a second
+  static uint32_t reported = 0;
+  static uint32_t last_ms = 0;
+  uint32_t underruns = usb_asrc.underruns();
+  if (underruns == reported || (millis() - last_ms) < 1000)
+    return;
+
+  Serial.print("# audio: underrun (");
+  Serial.print(underruns - reported);
+  Serial.print(" since last, ");
+  Serial.print(usb_asrc.padded_frames());
+  Serial.println(" frames padded)");
+  reported = underruns;
+  last_ms = millis();
+}
+
 static void print_stats_periodic()
 {
   static uint32_t last_stats_ms = 0;
+  static uint32_t last_path_us = 0;
+  static uint32_t last_opl_in = 0;
+  static uint32_t last_opl_out = 0;
   uint32_t now = millis();
   if (now - last_stats_ms < 5000)
     return;
+  uint32_t path_us = opl2_path_us;
+  uint32_t opl2_load = (path_us - last_path_us) / ((now - last_stats_ms) * 10); // percent of core 1
+  last_path_us = path_us;
+  uint32_t opl_in = opl_cache.writes();
+  uint32_t opl_out = opl_cache.passed();
+  uint32_t opl_in_rate = (opl_in - last_opl_in) * 1000 / (now - last_stats_ms);
+  uint32_t opl_out_rate = (opl_out - last_opl_out) * 1000 / (now - last_stats_ms);
+  last_opl_in = opl_in;
+  last_opl_out = opl_out;
   last_stats_ms = now;
 
   Serial.println();
@@ -286,11 +631,163 @@ static void print_stats_periodic()
   Serial.println(frames_captured);
   Serial.print("Ring dropped   : ");
   Serial.println((uint32_t)dropped);
+  Serial.print("PIO dropped    : ");
+  Serial.println(pio_capture_dropped());
+  Serial.print("Device         : ");
+  Serial.print(lpt_device_name(last_guess.device));
+  Serial.print(" (");
+  Serial.print(last_guess.confidence);
+  Serial.println("%)");
+  Serial.print("Decoded events : ");
+  Serial.print((uint32_t)decode_stats.events);
+  Serial.print(" (");
+  Serial.print((uint32_t)decode_stats.replayed);
+  Serial.print(" replayed, ");
+  Serial.print((uint32_t)decode_stats.lost);
+  Serial.println(" lost)");
+  Serial.print("Core 1 dropped : ");
+  Serial.println(spec_frames.dropped());
+  Serial.print("USB audio      : ");
+  Serial.print(usb_audio_streaming() ? "streaming, " : "idle, ");
+  Serial.print(usb_packetizer.packets());
+  Serial.print(" packets, ");
+  Serial.print(usb_asrc.underruns());
+  Serial.print(" underruns, ");
+  Serial.print(usb_asrc.overruns());
+  Serial.println(" overruns");
+  Serial.print("Audio clock    : ");
+  Serial.print(usb_asrc.clock_ppm());
+  Serial.print(" ppm, latency ");
+  Serial.print(usb_asrc.latency_frames() * 1000 / UacPacketizer::RATE_HZ);
+  Serial.print(".");
+  Serial.print(usb_asrc.latency_frames() * 10000 / UacPacketizer::RATE_HZ % 10);
+  Serial.println(" ms");
+  Serial.print("PIT clock      : ");
+  const PitClock &pit = dac_pcm.pit();
+  if (pit.locked())
+  {
+    Serial.print("divisor ");
+    Serial.print(pit.divisor());
+    Serial.print(" (");
+    Serial.print(pit.rate_mhz() / 1000);
+    Serial.print(" Hz), ");
+    uint32_t jitter_tenths = (uint32_t)(((uint64_t)pit.jitter_q16() * 10) >> 16);
+    Serial.print(jitter_tenths / 10);
+    Serial.print(".");
+    Serial.print(jitter_tenths % 10);
+    Serial.println(" us write jitter");
+  }
+  else
+    Serial.println("not locked");
+  Serial.print("Soft OPL2      : ");
+  Serial.print(opl2_pcm.writes());
+  Serial.print(" writes, ");
+  Serial.print(opl2_pcm.synth().keyed());
+  Serial.print(" voices keyed, ");
+  Serial.print(opl2_load);
+  Serial.println("% of core 1 (cache, scheduler, synth)");
+  Serial.print("OPL write cache: ");
+  Serial.print(opl_in_rate);
+  Serial.print(" writes/s in, ");
+  Serial.print(opl_out_rate);
+  Serial.print(" out, ");
+  Serial.print(opl_cache.bytes_saved());
+  Serial.println(" bus bytes saved");
+  Serial.print("OPL scheduler  : depth ");
+  Serial.print(opl_sched.depth());
+  Serial.print(" (max ");
+  Serial.print(opl_sched.max_depth());
+  Serial.print("), ");
+  Serial.print(opl_sched.delayed());
+  Serial.print(" delayed, late max ");
+  Serial.print(opl_sched.max_late_us());
+  Serial.print(" us, ");
+  Serial.print(opl_sched.forced());
+  Serial.println(" forced");
+  Serial.print("Interpolator   : ");
+  Serial.print(PCM_INTERP_HW ? "SIO, " : "software, ");
+  Serial.print(interp_mismatches);
+  Serial.println(" mismatches at boot");
+  Serial.print("PWM monitor    : ");
+  Serial.print(pwm_audio_running() ? "GP" : "off, GP");
+  Serial.print(PIN_PWM_AUDIO);
+  Serial.print(", ");
+  Serial.print(pwm_monitor.underruns());
+  Serial.print(" underruns, clock ");
+  Serial.print(pwm_monitor.clock_ppm());
+  Serial.println(" ppm");
+  Serial.print("Meters         : ");
+  Serial.print(print_meters ? "on, " : "off, ");
+  Serial.print(pcm_meter.records());
+  Serial.print(" records, ");
+  Serial.print(meter_records.dropped());
+  Serial.println(" dropped");
   Serial.println("------------------");
 }
 
+// ---- Console: one command per line from the host ----
+static void run_command(const char *cmd)
+{
+  if (!strcmp(cmd, "profile irq"))
+  {
+    auto_profile = false;
+    switch_profile(PROFILE_IRQ_EDGE);
+  }
+  else if (!strcmp(cmd, "profile pio"))
+  {
+    auto_profile = false;
+    switch_profile(PROFILE_PIO_CHANGE);
+  }
+  else if (!strcmp(cmd, "profile auto"))
+  {
+    auto_profile = true;
+  }
+  else if (!strcmp(cmd, "meter on") || !strcmp(cmd, "meter off"))
+  {
+    print_meters = !strcmp(cmd, "meter on");
+    Serial.print("# meters: ");
+    Serial.println(print_meters ? "on" : "off");
+    return;
+  }
+  else
+  {
+    Serial.print("# unknown command: ");
+    Serial.println(cmd);
+    return;
+  }
+
+  Serial.print("# profile: ");
+  Serial.print(profile_name(active_profile));
+  Serial.println(auto_profile ? " (auto)" : "");
+}
+
+static void poll_console()
+{
+  static char line[32];
+  static uint8_t len = 0;
+
+  while (Serial.available() > 0)
+  {
+    int c = Serial.read();
+    if (c == '\r' || c == '\n')
+    {
+      if (len)
+      {
+        line[len] = 0;
+        run_command(line);
+        len = 0;
+      }
+    }
+    else if (len < sizeof(line) - 1)
+    {
+      line[len++] = (char)c;
+    }
+  }
+}
+
 void setup()
 {
+  usb_audio_begin(usb_packetizer);
   Serial.begin(SERIAL_BAUD);
   uint32_t s = millis();
   while (!Serial && (millis() - s) < 3000)
@@ -305,7 +802,8 @@ void setup()
   if (PRINT_HEADER_ON_BOOT)
     print_banner();
 
-  arm_all_irqs();
+  start_profile(BOOT_CAPTURE_PROFILE);
+  capture_armed = true;
 
   Serial.println("# Armed: waiting for ANY bus activity...");
   Serial.println();
@@ -314,6 +812,10 @@ void setup()
 void loop()
 {
   drain_and_print();
+  poll_verdicts();
+  poll_audio();
+  poll_meters();
+  poll_console();
 
   if (PRINT_HEARTBEAT_IDLE)
   {
@@ -331,3 +833,64 @@ void loop()
     print_stats_periodic();
   }
 }
+
+// ---- Core 1 (the core starts because loop1() exists) ----
+void setup1()
+{
+  // Interpolators are per core: the PCM path uses core 1's pair
+  pcm_interp_init();
+  interp_mismatches = pcm_interp_check(4096);
+
+  // The monitor's DMA IRQ is taken by the core that enables it: keep it off core 0
+  pwm_audio_begin(pwm_monitor, PIN_PWM_AUDIO);
+}
+
+void loop1()
+{
+  if (!capture_armed)
+    return;
+
+  CaptureFrame f;
+  while (spec_frames.pop(f))
+  {
+    // Decode first so a verdict on this frame replays it too
+    speculative.feed(f);
+
+    DeviceGuess g;
+    if (device_classifier.feed(f, g))
+    {
+      speculative.commit(g.device);
+      spec_verdicts.push(g);
+    }
+
+    if (device_classifier.windows() != windows_seen)
+    {
+      windows_seen = device_classifier.windows();
+      CaptureSegment s;
+      if (change_points.add(device_classifier.last_window(), s))
+        spec_segments.push(s);
+    }
+  }
+
+  // Keep the output flowing through silence; one source at a time feeds the Asrc
+  uint32_t now = time_us_32();
+  if (pcm_device == DEV_OPL2LPT)
+  {
+    opl_sched.advance(now - start_us);
+    opl2_pcm.advance(now - start_us - Opl2PcmSource::HOLDBACK_US);
+    opl2_path_us += time_us_32() - now;
+  }
+  else
+    dac_pcm.advance(now - start_us - DacPcmSource::HOLDBACK_US);
+
+  // The FFT runs here, between refills, not inside the sample path
+  MeterRecord r;
+  if (pcm_meter.take(r))
+  {
+    r.device = pcm_device;
+    r.keys = opl_cache.keys();
+    r.key_ons = opl_cache.key_ons();
+    opl_cache.clear_key_ons();
+    meter_records.push(r);
+  }
+}
@@ -0,0 +1,101 @@
+/*
+ * PARALAX - OPL2LPT register stream to a 48 kHz PCM stream
+ * ThisOldCPU Project - https://github.com/thisoldcpu
+ *
+ * License : MIT
+ */
+
+#include "opl2_pcm.h"
+
+#include "pcm_interp.h"
+
+Opl2PcmSource::Opl2PcmSource(PcmSink &sink)
+    : sink_(sink)
+{
+  reset();
+}
+
+void Opl2PcmSource::reset()
+{
+  synth_.reset();
+  started_ = false;
+  last_t_ = 0;
+  now_us_ = 0;
+  grid_ = 0;
+  frac_ = 0;
+  prev_ = 0;
+  cur_ = 0;
+  samples_ = 0;
+  native_ = 0;
+  writes_ = 0;
+  late_ = 0;
+  resyncs_ = 0;
+}
+
+void Opl2PcmSource::start(uint32_t t_us)
+{
+  started_ = true;
+  last_t_ = t_us;
+  now_us_ = t_us;
+  grid_ = (uint64_t)t_us * RATE_HZ;
+}
+
+void Opl2PcmSource::run_until(uint64_t t_us)
+{
+  uint64_t end = t_us * RATE_HZ;
+  while (grid_ <= end)
+  {
+    frac_ += STEP_NUM;
+    while (frac_ >= STEP_DEN)
+    {
+      frac_ -= STEP_DEN;
+      prev_ = cur_;
+      cur_ = synth_.sample();
+      native_++;
+    }
+
+    uint32_t alpha = ((frac_ >> ALPHA_SHIFT) * ALPHA_MUL) >> 24;
+    int32_t v = pcm_blend(prev_, cur_, alpha);
+    sink_.on_sample((int16_t)v, (int16_t)v);
+    samples_++;
+    grid_ += 1000000;
+  }
+}
+
+void Opl2PcmSource::advance(uint32_t t_us)
+{
+  if (!started_)
+  {
+    start(t_us);
+    return;
+  }
+
+  int32_t delta = (int32_t)(t_us - last_t_);
+  if (delta <= 0)
+    return;
+
+  last_t_ = t_us;
+  now_us_ += (uint32_t)delta;
+  if ((uint32_t)delta > MAX_GAP_US)
+  {
+    // Nobody kept time (no events, no advance): pick up from here
+    grid_ = now_us_ * RATE_HZ;
+    resyncs_++;
+    return;
+  }
+  run_until(now_us_);
+}
+
+void Opl2PcmSource::on_event(const DeviceEvent &e)
+{
+  if (e.device != DEV_OPL2LPT)
+    return;
+
+  if (started_ && (int32_t)(e.t_us - last_t_) < 0)
+    late_++;
+  else
+    advance(e.t_us);
+
+  synth_.write(e.reg, e.value);
+  writes_++;
+}
@@ -0,0 +1,622 @@
+/*
+ * PARALAX - fixed-point YM3812 (OPL2) synthesis
+ * ThisOldCPU Project - https://github.com/thisoldcpu
+ *
+ * Derived from Nuked-OPL3 by Nuke.YKT (https://github.com/nukeykt/Nuked-OPL3),
+ * Copyright (C) 2013-2020 Nuke.YKT. The envelope generator (its increment
+ * table and rate gating), the phase generator and the rhythm phase taps
+ * follow its OPL3_EnvelopeCalc and OPL3_PhaseGenerate, cut down to OPL2
+ * and renamed; the ROM tables are the chip's own.
+ *
+ * This file is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 2.1 of the License, or
+ * (at your option) any later version. It is distributed in the hope that
+ * it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See
+ * LICENSE-LGPL-2.1 for details.
+ *
+ * License : LGPL-2.1-or-later (unlike the rest of PARALAX, which is MIT)
+ */
+
+#include "opl2_synth.h"
+
+// ---- ROMs ----
+// Not const on purpose: initialised data lands in RAM, so the per-sample
+// lookups never wait on XIP flash.
+
+// -log2(sin((i + 0.5) * pi / 512)) * 256, first quarter of the sine
+static uint16_t logsin_rom[256] = {
+    0x859, 0x6c3, 0x607, 0x58b, 0x52e, 0x4e4, 0x4a6, 0x471, 0x443, 0x41a, 0x3f5, 0x3d3,
+    0x3b5, 0x398, 0x37e, 0x365, 0x34e, 0x339, 0x324, 0x311, 0x2ff, 0x2ed, 0x2dc, 0x2cd,
+    0x2bd, 0x2af, 0x2a0, 0x293, 0x286, 0x279, 0x26d, 0x261, 0x256, 0x24b, 0x240, 0x236,
+    0x22c, 0x222, 0x218, 0x20f, 0x206, 0x1fd, 0x1f5, 0x1ec, 0x1e4, 0x1dc, 0x1d4, 0x1cd,
+    0x1c5, 0x1be, 0x1b7, 0x1b0, 0x1a9, 0x1a2, 0x19b, 0x195, 0x18f, 0x188, 0x182, 0x17c,
+    0x177, 0x171, 0x16b, 0x166, 0x160, 0x15b, 0x155, 0x150, 0x14b, 0x146, 0x141, 0x13c,
+    0x137, 0x133, 0x12e, 0x129, 0x125, 0x121, 0x11c, 0x118, 0x114, 0x10f, 0x10b, 0x107,
+    0x103, 0x0ff, 0x0fb, 0x0f8, 0x0f4, 0x0f0, 0x0ec, 0x0e9, 0x0e5, 0x0e2, 0x0de, 0x0db,
+    0x0d7, 0x0d4, 0x0d1, 0x0cd, 0x0ca, 0x0c7, 0x0c4, 0x0c1, 0x0be, 0x0bb, 0x0b8, 0x0b5,
+    0x0b2, 0x0af, 0x0ac, 0x0a9, 0x0a7, 0x0a4, 0x0a1, 0x09f, 0x09c, 0x099, 0x097, 0x094,
+    0x092, 0x08f, 0x08d, 0x08a, 0x088, 0x086, 0x083, 0x081, 0x07f, 0x07d, 0x07a, 0x078,
+    0x076, 0x074, 0x072, 0x070, 0x06e, 0x06c, 0x06a, 0x068, 0x066, 0x064, 0x062, 0x060,
+    0x05e, 0x05c, 0x05b, 0x059, 0x057, 0x055, 0x053, 0x052, 0x050, 0x04e, 0x04d, 0x04b,
+    0x04a, 0x048, 0x046, 0x045, 0x043, 0x042, 0x040, 0x03f, 0x03e, 0x03c, 0x03b, 0x039,
+    0x038, 0x037, 0x035, 0x034, 0x033, 0x031, 0x030, 0x02f, 0x02e, 0x02d, 0x02b, 0x02a,
+    0x029, 0x028, 0x027, 0x026, 0x025, 0x024, 0x023, 0x022, 0x021, 0x020, 0x01f, 0x01e,
+    0x01d, 0x01c, 0x01b, 0x01a, 0x019, 0x018, 0x017, 0x017, 0x016, 0x015, 0x014, 0x014,
+    0x013, 0x012, 0x011, 0x011, 0x010, 0x00f, 0x00f, 0x00e, 0x00d, 0x00d, 0x00c, 0x00c,
+    0x00b, 0x00a, 0x00a, 0x009, 0x009, 0x008, 0x008, 0x007, 0x007, 0x007, 0x006, 0x006,
+    0x005, 0x005, 0x005, 0x004, 0x004, 0x004, 0x003, 0x003, 0x003, 0x002, 0x002, 0x002,
+    0x002, 0x001, 0x001, 0x001, 0x001, 0x001, 0x001, 0x001, 0x000, 0x000, 0x000, 0x000,
+    0x000, 0x000, 0x000, 0x000,
+};
+
+// 2^((255 - i) / 256) * 1024, mantissa of the output exponent
+static uint16_t exp_rom[256] = {
+    0x7fa, 0x7f5, 0x7ef, 0x7ea, 0x7e4, 0x7df, 0x7da, 0x7d4, 0x7cf, 0x7c9, 0x7c4, 0x7bf,
+    0x7b9, 0x7b4, 0x7ae, 0x7a9, 0x7a4, 0x79f, 0x799, 0x794, 0x78f, 0x78a, 0x784, 0x77f,
+    0x77a, 0x775, 0x770, 0x76a, 0x765, 0x760, 0x75b, 0x756, 0x751, 0x74c, 0x747, 0x742,
+    0x73d, 0x738, 0x733, 0x72e, 0x729, 0x724, 0x71f, 0x71a, 0x715, 0x710, 0x70b, 0x706,
+    0x702, 0x6fd, 0x6f8, 0x6f3, 0x6ee, 0x6e9, 0x6e5, 0x6e0, 0x6db, 0x6d6, 0x6d2, 0x6cd,
+    0x6c8, 0x6c4, 0x6bf, 0x6ba, 0x6b5, 0x6b1, 0x6ac, 0x6a8, 0x6a3, 0x69e, 0x69a, 0x695,
+    0x691, 0x68c, 0x688, 0x683, 0x67f, 0x67a, 0x676, 0x671, 0x66d, 0x668, 0x664, 0x65f,
+    0x65b, 0x657, 0x652, 0x64e, 0x649, 0x645, 0x641, 0x63c, 0x638, 0x634, 0x630, 0x62b,
+    0x627, 0x623, 0x61e, 0x61a, 0x616, 0x612, 0x60e, 0x609, 0x605, 0x601, 0x5fd, 0x5f9,
+    0x5f5, 0x5f0, 0x5ec, 0x5e8, 0x5e4, 0x5e0, 0x5dc, 0x5d8, 0x5d4, 0x5d0, 0x5cc, 0x5c8,
+    0x5c4, 0x5c0, 0x5bc, 0x5b8, 0x5b4, 0x5b0, 0x5ac, 0x5a8, 0x5a4, 0x5a0, 0x59c, 0x599,
+    0x595, 0x591, 0x58d, 0x589, 0x585, 0x581, 0x57e, 0x57a, 0x576, 0x572, 0x56f, 0x56b,
+    0x567, 0x563, 0x560, 0x55c, 0x558, 0x554, 0x551, 0x54d, 0x549, 0x546, 0x542, 0x53e,
+    0x53b, 0x537, 0x534, 0x530, 0x52c, 0x529, 0x525, 0x522, 0x51e, 0x51b, 0x517, 0x514,
+    0x510, 0x50c, 0x509, 0x506, 0x502, 0x4ff, 0x4fb, 0x4f8, 0x4f4, 0x4f1, 0x4ed, 0x4ea,
+    0x4e7, 0x4e3, 0x4e0, 0x4dc, 0x4d9, 0x4d6, 0x4d2, 0x4cf, 0x4cc, 0x4c8, 0x4c5, 0x4c2,
+    0x4be, 0x4bb, 0x4b8, 0x4b5, 0x4b1, 0x4ae, 0x4ab, 0x4a8, 0x4a4, 0x4a1, 0x49e, 0x49b,
+    0x498, 0x494, 0x491, 0x48e, 0x48b, 0x488, 0x485, 0x482, 0x47e, 0x47b, 0x478, 0x475,
+    0x472, 0x46f, 0x46c, 0x469, 0x466, 0x463, 0x460, 0x45d, 0x45a, 0x457, 0x454, 0x451,
+    0x44e, 0x44b, 0x448, 0x445, 0x442, 0x43f, 0x43c, 0x439, 0x436, 0x433, 0x430, 0x42d,
+    0x42a, 0x428, 0x425, 0x422, 0x41f, 0x41c, 0x419, 0x416, 0x414, 0x411, 0x40e, 0x40b,
+    0x408, 0x406, 0x403, 0x400,
+};
+
+// Frequency multiplier, x2 (MULT 0 is 0.5)
+static uint8_t mult_rom[16] = {1, 2, 4, 6, 8, 10, 12, 14, 16, 18, 20, 20, 24, 24, 30, 30};
+
+// Level key scaling by the top four FNUM bits, 0.75 dB steps at block 7
+static uint8_t ksl_rom[16] = {0, 32, 40, 45, 48, 51, 53, 55, 56, 58, 59, 60, 61, 62, 63, 64};
+
+// KSL 0, 3, 1.5, 6 dB/octave
+static uint8_t ksl_shift[4] = {8, 1, 2, 0};
+
+// Extra envelope steps for rates 48+, by rate low bits and counter phase
+static uint8_t eg_incstep[4][4] = {
+    {0, 0, 0, 0},
+    {1, 0, 0, 0},
+    {1, 0, 1, 0},
+    {1, 1, 1, 0},
+};
+
+// Register offset (low five bits) to slot, -1 where there is none
+static const int8_t slot_of_offset[32] = {
+    0,  1,  2,  3,  4,  5,  -1, -1, 6,  7,  8,  9,  10, 11, -1, -1,
+    12, 13, 14, 15, 16, 17, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+};
+
+// Rhythm slots: hi-hat and tom are channel 7/8 modulators, snare and
+// cymbal their carriers
+static constexpr uint8_t SLOT_HH = 13;
+static constexpr uint8_t SLOT_TOM = 14;
+static constexpr uint8_t SLOT_SD = 16;
+static constexpr uint8_t SLOT_TC = 17;
+
+Opl2Synth::Opl2Synth()
+{
+  reset();
+}
+
+void Opl2Synth::reset()
+{
+  zero_ = 0;
+  wse_ = false;
+  nts_ = 0;
+  rhythm_ = 0;
+  timer_ = 0;
+  tremolo_pos_ = 0;
+  tremolo_ = 0;
+  tremolo_shift_ = 4;
+  vib_pos_ = 0;
+  vib_shift_ = 1;
+  eg_timer_ = 0;
+  eg_state_ = 0;
+  eg_add_ = 0;
+  eg_timer_lo_ = 0;
+  noise_ = 1;
+  hh_bit2_ = hh_bit3_ = hh_bit7_ = hh_bit8_ = 0;
+  tc_bit3_ = tc_bit5_ = 0;
+
+  for (uint8_t i = 0; i < SLOTS; ++i)
+  {
+    Slot &s = slots_[i];
+    s = Slot();
+    s.eg_rout = 0x1ff;
+    s.eg_out = 0x1ff;
+    s.eg_state = EG_RELEASE;
+    s.mod = &zero_;
+    s.index = i;
+  }
+
+  for (uint8_t c = 0; c < CHANNELS; ++c)
+  {
+    Channel &ch = channels_[c];
+    ch = Channel();
+    uint8_t m = (uint8_t)((c / 3) * 6 + c % 3);
+    ch.mod_slot = &slots_[m];
+    ch.car_slot = &slots_[m + 3];
+    ch.mod_slot->ch = &ch;
+    ch.car_slot->ch = &ch;
+    setup_channel(c);
+  }
+}
+
+// ---- Register writes ----
+
+void Opl2Synth::update_level(Slot &s)
+{
+  s.eg_level = (uint16_t)((s.tl << 2) + (s.eg_ksl >> ksl_shift[s.ksl]));
+}
+
+void Opl2Synth::update_rates(Slot &s)
+{
+  // The envelope picks one of these per sample; key scaling is already in
+  uint8_t ks = s.ch->ksv >> ((s.ksr ^ 1) << 1);
+  uint8_t regs[4] = {s.ar, s.dr, (uint8_t)(s.egt ? 0 : s.rr), s.rr};
+  for (uint8_t i = 0; i < 4; ++i)
+    s.eg_rate[i] = (uint8_t)((regs[i] ? 0x80 : 0) | (ks + (regs[i] << 2)));
+}
+
+void Opl2Synth::update_ksv(Channel &c)
+{
+  c.ksv = (uint8_t)((c.block << 1) | ((c.fnum >> (9 - nts_)) & 1));
+  update_rates(*c.mod_slot);
+  update_rates(*c.car_slot);
+}
+
+void Opl2Synth::update_ksl(Channel &c)
+{
+  int32_t ksl = ((int32_t)ksl_rom[c.fnum >> 6] << 2) - ((8 - c.block) << 5);
+  uint8_t v = (uint8_t)(ksl < 0 ? 0 : ksl);
+  c.mod_slot->eg_ksl = v;
+  c.car_slot->eg_ksl = v;
+  update_level(*c.mod_slot);
+  update_level(*c.car_slot);
+}
+
+void Opl2Synth::setup_channel(uint8_t c)
+{
+  Channel &ch = channels_[c];
+  Slot &m = *ch.mod_slot;
+  Slot &k = *ch.car_slot;
+  bool drum = (rhythm_ & 0x20) && c >= 6;
+
+  // Modulation inputs
+  m.mod = &m.fbmod;
+  k.mod = ch.cnt ? &zero_ : &m.out;
+  if (drum && c != 6)
+  {
+    m.mod = &zero_;
+    k.mod = &zero_;
+  }
+
+  // Outputs; rhythm voices are summed twice, as on the chip
+  for (uint8_t i = 0; i < 4; ++i)
+    ch.out[i] = &zero_;
+  if (!drum)
+  {
+    ch.out[0] = ch.cnt ? &m.out : &k.out;
+    if (ch.cnt)
+      ch.out[1] = &k.out;
+  }
+  else if (c == 6)
+  {
+    ch.out[0] = &k.out;
+    ch.out[1] = &k.out;
+  }
+  else
+  {
+    ch.out[0] = &m.out;
+    ch.out[1] = &m.out;
+    ch.out[2] = &k.out;
+    ch.out[3] = &k.out;
+  }
+}
+
+void Opl2Synth::key(Slot &s, uint8_t type, bool on)
+{
+  if (on)
+    s.key |= type;
+  else
+    s.key &= (uint8_t)~type;
+}
+
+void Opl2Synth::update_rhythm(uint8_t value)
+{
+  rhythm_ = value & 0x3f;
+  tremolo_shift_ = (value & 0x80) ? 2 : 4;
+  vib_shift_ = (value & 0x40) ? 0 : 1;
+
+  for (uint8_t c = 6; c < CHANNELS; ++c)
+    setup_channel(c);
+
+  bool on = (rhythm_ & 0x20) != 0;
+  key(slots_[SLOT_HH], KEY_DRUM, on && (rhythm_ & 0x01));
+  key(slots_[SLOT_TC], KEY_DRUM, on && (rhythm_ & 0x02));
+  key(slots_[SLOT_TOM], KEY_DRUM, on && (rhythm_ & 0x04));
+  key(slots_[SLOT_SD], KEY_DRUM, on && (rhythm_ & 0x08));
+  key(*channels_[6].mod_slot, KEY_DRUM, on && (rhythm_ & 0x10));
+  key(*channels_[6].car_slot, KEY_DRUM, on && (rhythm_ & 0x10));
+}
+
+void Opl2Synth::write(uint8_t reg, uint8_t value)
+{
+  switch (reg & 0xf0)
+  {
+  case 0x00:
+    if (reg == 0x01)
+    {
+      wse_ = (value & 0x20) != 0;
+      for (Slot &s : slots_)
+        s.wf = wse_ ? s.wf_reg : 0;
+    }
+    else if (reg == 0x08)
+    {
+      nts_ = (value >> 6) & 1;
+      for (Channel &c : channels_)
+        update_ksv(c);
+    }
+    return;
+
+  case 0x20:
+  case 0x30:
+  case 0x40:
+  case 0x50:
+  case 0x60:
+  case 0x70:
+  case 0x80:
+  case 0x90:
+  case 0xe0:
+  case 0xf0:
+  {
+    int8_t n = slot_of_offset[reg & 0x1f];
+    if (n < 0)
+      return;
+    Slot &s = slots_[n];
+    switch (reg & 0xe0)
+    {
+    case 0x20:
+      s.am = (value >> 7) & 1;
+      s.vib = (value >> 6) & 1;
+      s.egt = (value >> 5) & 1;
+      s.ksr = (value >> 4) & 1;
+      s.mult = value & 0x0f;
+      update_rates(s);
+      break;
+    case 0x40:
+      s.ksl = (value >> 6) & 3;
+      s.tl = value & 0x3f;
+      update_level(s);
+      break;
+    case 0x60:
+      s.ar = value >> 4;
+      s.dr = value & 0x0f;
+      update_rates(s);
+      break;
+    case 0x80:
+      s.sl = value >> 4;
+      if (s.sl == 0x0f)
+        s.sl = 0x1f;
+      s.rr = value & 0x0f;
+      update_rates(s);
+      break;
+    case 0xe0:
+      s.wf_reg = value & 3;
+      s.wf = wse_ ? s.wf_reg : 0;
+      break;
+    }
+    return;
+  }
+
+  case 0xa0:
+  case 0xb0:
+  {
+    if (reg == 0xbd)
+    {
+      update_rhythm(value);
+      return;
+    }
+    uint8_t c = reg & 0x0f;
+    if (c >= CHANNELS)
+      return;
+    Channel &ch = channels_[c];
+    if (reg < 0xb0)
+      ch.fnum = (uint16_t)((ch.fnum & 0x300) | value);
+    else
+    {
+      ch.fnum = (uint16_t)((ch.fnum & 0xff) | ((value & 3) << 8));
+      ch.block = (value >> 2) & 7;
+      ch.key_reg = (value >> 5) & 1;
+      key(*ch.mod_slot, KEY_NORMAL, ch.key_reg);
+      key(*ch.car_slot, KEY_NORMAL, ch.key_reg);
+    }
+    update_ksl(ch);
+    update_ksv(ch);
+    return;
+  }
+
+  case 0xc0:
+  {
+    uint8_t c = reg & 0x0f;
+    if (c >= CHANNELS)
+      return;
+    channels_[c].fb = (value >> 1) & 7;
+    channels_[c].cnt = value & 1;
+    setup_channel(c);
+    return;
+  }
+  }
+}
+
+uint32_t Opl2Synth::keyed() const
+{
+  uint32_t n = 0;
+  uint8_t melodic = (rhythm_ & 0x20) ? 6 : CHANNELS;
+  for (uint8_t c = 0; c < melodic; ++c)
+    n += channels_[c].key_reg;
+  if (rhythm_ & 0x20)
+    for (uint8_t b = 0; b < 5; ++b)
+      n += (rhythm_ >> b) & 1;
+  return n;
+}
+
+// ---- Envelope generator ----
+// After Nuked-OPL3's OPL3_EnvelopeCalc
+
+void Opl2Synth::envelope(Slot &s)
+{
+  uint32_t out = (uint32_t)s.eg_rout + s.eg_level + (s.am ? tremolo_ : 0);
+  s.eg_out = (uint16_t)(out > 0x1ff ? 0x1ff : out);
+
+  // Key on while releasing restarts the attack (and the phase)
+  bool reset = s.key && s.eg_state == EG_RELEASE;
+  s.phase_reset = reset;
+
+  uint8_t r = s.eg_rate[reset ? (uint8_t)EG_ATTACK : s.eg_state];
+  uint8_t rate_hi = (r & 0x7f) >> 2;
+  uint8_t rate_lo = r & 3;
+  if (rate_hi & 0x10)
+    rate_hi = 0x0f;
+
+  // Steps this sample: the counter's lowest set bit gates slow rates,
+  // fast rates step every sample with a per-rate pattern
+  uint8_t shift = 0;
+  if (r & 0x80)
+  {
+    if (rate_hi < 12)
+    {
+      if (eg_state_)
+      {
+        switch (rate_hi + eg_add_)
+        {
+        case 12:
+          shift = 1;
+          break;
+        case 13:
+          shift = (rate_lo >> 1) & 1;
+          break;
+        case 14:
+          shift = rate_lo & 1;
+          break;
+        }
+      }
+    }
+    else
+    {
+      shift = (uint8_t)((rate_hi & 3) + eg_incstep[rate_lo][eg_timer_lo_]);
+      if (shift & 4)
+        shift = 3;
+      if (!shift)
+        shift = eg_state_;
+    }
+  }
+
+  int32_t rout = s.eg_rout;
+  int32_t inc = 0;
+  bool off = (s.eg_rout & 0x1f8) == 0x1f8;
+
+  if (reset && rate_hi == 0x0f)
+    rout = 0;
+  if (s.eg_state != EG_ATTACK && !reset && off)
+    rout = 0x1ff;
+
+  switch (s.eg_state)
+  {
+  case EG_ATTACK:
+    if (!s.eg_rout)
+      s.eg_state = EG_DECAY;
+    else if (s.key && shift && rate_hi != 0x0f)
+      inc = ~(int32_t)s.eg_rout >> (4 - shift);
+    break;
+  case EG_DECAY:
+    if ((s.eg_rout >> 4) == s.sl)
+      s.eg_state = EG_SUSTAIN;
+    else if (!off && !reset && shift)
+      inc = 1 << (shift - 1);
+    break;
+  default:
+    if (!off && !reset && shift)
+      inc = 1 << (shift - 1);
+    break;
+  }
+  s.eg_rout = (uint16_t)((rout + inc) & 0x1ff);
+
+  if (reset)
+    s.eg_state = EG_ATTACK;
+  if (!s.key)
+    s.eg_state = EG_RELEASE;
+}
+
+// ---- Phase generator ----
+// After Nuked-OPL3's OPL3_PhaseGenerate, hi-hat / cymbal taps included
+
+void Opl2Synth::phase(Slot &s)
+{
+  uint16_t fnum = s.ch->fnum;
+  if (s.vib)
+  {
+    int32_t range = (fnum >> 7) & 7;
+    if (!(vib_pos_ & 3))
+      range = 0;
+    else if (vib_pos_ & 1)
+      range >>= 1;
+    range >>= vib_shift_;
+    if (vib_pos_ & 4)
+      range = -range;
+    fnum = (uint16_t)(fnum + range);
+  }
+
+  uint32_t base = ((uint32_t)fnum << s.ch->block) >> 1;
+  uint16_t p = (uint16_t)(s.phase >> 9);
+  if (s.phase_reset)
+    s.phase = 0;
+  s.phase += (base * mult_rom[s.mult]) >> 1;
+  s.phase_out = p;
+
+  if (rhythm_ & 0x20)
+  {
+    if (s.index == SLOT_HH)
+    {
+      hh_bit2_ = (p >> 2) & 1;
+      hh_bit3_ = (p >> 3) & 1;
+      hh_bit7_ = (p >> 7) & 1;
+      hh_bit8_ = (p >> 8) & 1;
+    }
+    else if (s.index == SLOT_TC)
+    {
+      tc_bit3_ = (p >> 3) & 1;
+      tc_bit5_ = (p >> 5) & 1;
+    }
+
+    uint8_t x = (uint8_t)((hh_bit2_ ^ hh_bit7_) | (hh_bit3_ ^ tc_bit5_) | (tc_bit3_ ^ tc_bit5_));
+    switch (s.index)
+    {
+    case SLOT_HH:
+      s.phase_out = (uint16_t)((x << 9) | (((x ^ noise_) & 1) ? 0xd0 : 0x34));
+      break;
+    case SLOT_SD:
+      s.phase_out = (uint16_t)((hh_bit8_ << 9) | (((hh_bit8_ ^ noise_) & 1) << 8));
+      break;
+    case SLOT_TC:
+      s.phase_out = (uint16_t)((x << 9) | 0x80);
+      break;
+    }
+  }
+
+  // 23-bit noise LFSR, clocked once per operator
+  uint32_t bit = ((noise_ >> 14) ^ noise_) & 1;
+  noise_ = (noise_ >> 1) | (bit << 22);
+}
+
+// ---- Operator ----
+
+// Callers keep level below 0x1fff (log-sine plus up to 72 dB)
+int16_t Opl2Synth::exp_level(uint32_t level)
+{
+  return (int16_t)((exp_rom[level & 0xff] << 1) >> (level >> 8));
+}
+
+int16_t Opl2Synth::operator_out(uint8_t wf, uint16_t phase, uint16_t eg_out)
+{
+  uint32_t env = (uint32_t)eg_out << 3;
+
+  // 72 dB down or more: every waveform has shifted out to zero
+  if (env >= 0xc00)
+    return (wf == 0 && (phase & 0x200)) ? -1 : 0;
+
+  // Second and fourth quarters read the table backwards
+  uint16_t idx = (uint16_t)((phase ^ (0u - ((phase >> 8) & 1))) & 0xff);
+
+  // Below, the silent parts (level 0x1000 + env) shift out to 0 as well
+  switch (wf)
+  {
+  case 0: // sine; one's complement for the negative half
+    return (int16_t)(exp_level(logsin_rom[idx] + env) ^ (0 - ((phase >> 9) & 1)));
+  case 1: // half sine
+    return (phase & 0x200) ? 0 : exp_level(logsin_rom[idx] + env);
+  case 2: // absolute sine
+    return exp_level(logsin_rom[idx] + env);
+  default: // quarter sine pulses
+    return (phase & 0x100) ? 0 : exp_level(logsin_rom[phase & 0xff] + env);
+  }
+}
+
+// ---- Per sample ----
+
+void Opl2Synth::tick_timers()
+{
+  if ((timer_ & 0x3f) == 0x3f)
+    tremolo_pos_ = (uint8_t)((tremolo_pos_ + 1) % 210);
+  tremolo_ = (uint8_t)((tremolo_pos_ < 105 ? tremolo_pos_ : 210 - tremolo_pos_) >> tremolo_shift_);
+  if ((timer_ & 0x3ff) == 0x3ff)
+    vib_pos_ = (vib_pos_ + 1) & 7;
+  timer_++;
+
+  if (eg_state_)
+  {
+    uint8_t shift = 0;
+    while (shift < 13 && ((eg_timer_ >> shift) & 1) == 0)
+      shift++;
+    eg_add_ = shift > 12 ? 0 : (uint8_t)(shift + 1);
+    eg_timer_lo_ = (uint8_t)(eg_timer_ & 3);
+    eg_timer_ = (eg_timer_ + 1) & 0xfffffffffull; // 36 bits
+  }
+  eg_state_ ^= 1;
+}
+
+int16_t Opl2Synth::sample()
+{
+  for (Slot &s : slots_)
+  {
+    // Feedback averages the modulator's last two outputs
+    if (s.ch->fb && &s == s.ch->mod_slot)
+      s.fbmod = (int16_t)((s.prev_out + s.out) >> (9 - s.ch->fb));
+    else
+      s.fbmod = 0;
+    s.prev_out = s.out;
+
+    // A released, silent operator has nothing to update
+    if (s.eg_state == EG_RELEASE && !s.key && s.eg_rout == 0x1ff)
+    {
+      s.eg_out = 0x1ff;
+      s.phase_reset = false;
+    }
+    else
+      envelope(s);
+    phase(s);
+    s.out = operator_out(s.wf, (uint16_t)(s.phase_out + *s.mod), s.eg_out);
+  }
+
+  int32_t mix = 0;
+  for (const Channel &c : channels_)
+    mix += *c.out[0] + *c.out[1] + *c.out[2] + *c.out[3];
+
+  tick_timers();
+
+  if (mix > 32767)
+    mix = 32767;
+  else if (mix < -32768)
+    mix = -32768;
+  return (int16_t)mix;
+}
+
+void Opl2Synth::render(int16_t *out, uint32_t count)
+{
+  for (uint32_t i = 0; i < count; ++i)
+    out[i] = sample();
+}
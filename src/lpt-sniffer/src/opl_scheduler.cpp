@@ -0,0 +1,135 @@
+/*
+ * PARALAX - OPL register writes paced to chip timing
+ * ThisOldCPU Project - https://github.com/thisoldcpu
+ *
+ * License : MIT
+ */
+
+#include "opl_scheduler.h"
+
+OplScheduler::OplScheduler(OplWriteSink &sink, const OplTiming &timing)
+    : sink_(sink), timing_(timing)
+{
+  reset();
+}
+
+void OplScheduler::set_timing(const OplTiming &timing)
+{
+  timing_ = timing;
+}
+
+void OplScheduler::reset()
+{
+  head_ = 0;
+  count_ = 0;
+  started_ = false;
+  last_t_ = 0;
+  now_ns_ = 0;
+  free_ns_ = 0;
+  prev_in_ = 0;
+  max_depth_ = 0;
+  writes_ = 0;
+  tight_ = 0;
+  delayed_ = 0;
+  forced_ = 0;
+  over_bound_ = 0;
+  max_late_ns_ = 0;
+  sum_late_ns_ = 0;
+}
+
+uint32_t OplScheduler::mean_late_us() const
+{
+  return delayed_ ? (uint32_t)(sum_late_ns_ / delayed_ / 1000) : 0;
+}
+
+void OplScheduler::emit(uint64_t t_ns)
+{
+  const Entry &e = queue_[head_];
+  if (t_ns < free_ns_)
+    forced_++;
+  if (t_ns > e.t_ns)
+  {
+    uint64_t late = t_ns - e.t_ns;
+    delayed_++;
+    sum_late_ns_ += late;
+    if (late > max_late_ns_)
+      max_late_ns_ = late;
+    if (late > (uint64_t)LATE_BOUND_US * 1000)
+      over_bound_++;
+  }
+
+  sink_.on_opl_write(t_ns, e.reg, e.value);
+  uint64_t next = t_ns + timing_.addr_ns + timing_.data_ns;
+  if (next > free_ns_)
+    free_ns_ = next;
+
+  head_ = (head_ + 1) & (QUEUE_WRITES - 1);
+  count_--;
+}
+
+void OplScheduler::release(uint64_t now_ns)
+{
+  while (count_)
+  {
+    uint64_t due = queue_[head_].t_ns;
+    if (free_ns_ > due)
+      due = free_ns_;
+    if (due > now_ns)
+      break;
+    emit(due);
+  }
+}
+
+void OplScheduler::push(uint32_t t_us, uint16_t reg, uint8_t value)
+{
+  if (!started_)
+  {
+    started_ = true;
+    last_t_ = t_us;
+    now_ns_ = (uint64_t)t_us * 1000;
+  }
+  else
+  {
+    // Out-of-order times (a replayed prefix) queue at the latest time seen
+    int32_t delta = (int32_t)(t_us - last_t_);
+    if (delta > 0)
+    {
+      last_t_ = t_us;
+      now_ns_ += (uint64_t)delta * 1000;
+    }
+  }
+
+  if (writes_ && now_ns_ - prev_in_ < (uint64_t)timing_.addr_ns + timing_.data_ns)
+    tight_++;
+  prev_in_ = now_ns_;
+  writes_++;
+
+  release(now_ns_);
+  if (count_ == QUEUE_WRITES)
+    emit(now_ns_);
+
+  Entry &e = queue_[(head_ + count_) & (QUEUE_WRITES - 1)];
+  e.t_ns = now_ns_;
+  e.reg = reg;
+  e.value = value;
+  count_++;
+  if (count_ > max_depth_)
+    max_depth_ = count_;
+
+  release(now_ns_);
+}
+
+void OplScheduler::advance(uint32_t t_us)
+{
+  if (!started_)
+    return;
+
+  // Times ahead of the last push extend the timeline; behind it, use it as is
+  int32_t delta = (int32_t)(t_us - last_t_);
+  release(now_ns_ + (delta > 0 ? (uint64_t)delta * 1000 : 0));
+}
+
+void OplScheduler::flush()
+{
+  release(UINT64_MAX);
+}
@@ -0,0 +1,66 @@
+/*
+ * PARALAX - shadow registers that drop OPL writes which change nothing
+ * ThisOldCPU Project - https://github.com/thisoldcpu
+ *
+ * License : MIT
+ */
+
+#include "opl_write_cache.h"
+
+void OplWriteCache::reset()
+{
+  for (uint32_t &k : known_)
+    k = 0;
+  writes_ = 0;
+  dropped_ = 0;
+  key_ons_ = 0;
+}
+
+bool OplWriteCache::acts(uint16_t reg)
+{
+  uint8_t r = (uint8_t)reg;
+  if (r <= 0x08)
+    return true; // 0x00-0x08: test, timers, CSM; 0x104/0x105 on the second set
+  if (r >= 0xb0 && r <= 0xb8)
+    return true;
+  return r == 0xbd;
+}
+
+bool OplWriteCache::pass(uint16_t reg, uint8_t value)
+{
+  writes_++;
+  reg &= REGS - 1;
+
+  uint32_t bit = 1u << (reg & 31);
+  uint32_t &known = known_[reg >> 5];
+  uint8_t old = (known & bit) ? shadow_[reg] : 0;
+  if ((known & bit) && old == value && !acts(reg))
+  {
+    dropped_++;
+    return false;
+  }
+
+  // Key bits going up
+  if (reg >= 0xb0 && reg <= 0xb8 && (value & ~old & 0x20))
+    key_ons_ |= (uint16_t)(1u << (reg - 0xb0));
+  else if (reg == 0xbd && (value & 0x20))
+    key_ons_ |= (uint16_t)((value & ~((old & 0x20) ? old : 0) & 0x1f) << 9);
+
+  known |= bit;
+  shadow_[reg] = value;
+  return true;
+}
+
+uint16_t OplWriteCache::keys() const
+{
+  uint16_t keys = 0;
+  for (uint16_t c = 0; c < 9; ++c)
+  {
+    uint16_t reg = 0xb0 + c;
+    if ((known_[reg >> 5] >> (reg & 31) & 1) && (shadow_[reg] & 0x20))
+      keys |= (uint16_t)(1u << c);
+  }
+  if ((known_[0xbd >> 5] >> (0xbd & 31) & 1) && (shadow_[0xbd] & 0x20))
+    keys |= (uint16_t)((shadow_[0xbd] & 0x1f) << 9);
+  return keys;
+}
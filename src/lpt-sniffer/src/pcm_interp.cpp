@@ -0,0 +1,77 @@
+/*
+ * PARALAX - SIO interpolator operations for the PCM path
+ * ThisOldCPU Project - https://github.com/thisoldcpu
+ *
+ * License : MIT
+ */
+
+#include "pcm_interp.h"
+
+#if !defined(PARALAX_SIO_INTERP)
+
+// Set up at load, so host tools need no pcm_interp_init()
+SoftInterp soft_interp0 = {{0, 0}, {0, 0, 0}, {INTERP0_LANE0, INTERP0_LANE1}};
+SoftInterp soft_interp1 = {{0, 0}, {0, 0, (uint32_t)MIX_BIAS}, {INTERP1_LANE0, INTERP1_LANE1}};
+
+void pcm_interp_init()
+{
+  soft_interp0 = SoftInterp();
+  soft_interp0.lane[0] = INTERP0_LANE0;
+  soft_interp0.lane[1] = INTERP0_LANE1;
+  soft_interp1 = SoftInterp();
+  soft_interp1.lane[0] = INTERP1_LANE0;
+  soft_interp1.lane[1] = INTERP1_LANE1;
+  soft_interp1.base[2] = (uint32_t)MIX_BIAS;
+}
+
+#endif
+
+static uint32_t check_one(SoftInterp &m0, SoftInterp &m1, int32_t a, int32_t b, uint32_t frac8)
+{
+  uint32_t bad = 0;
+
+  m0.base[0] = (uint32_t)a;
+  m0.base[1] = (uint32_t)b;
+  m0.accum[1] = frac8;
+  int32_t blend = pcm_blend(a, b, frac8);
+  if (blend != (int32_t)m0.peek(1) || blend != a + (((b - a) * (int32_t)frac8) >> 8))
+    bad++;
+
+  m1.accum[0] = (uint32_t)a;
+  m1.accum[1] = (uint32_t)b;
+  int32_t mix = pcm_mix(a, b);
+  if (mix != (int32_t)m1.peek_full() || mix != a + b + MIX_BIAS)
+    bad++;
+  return bad;
+}
+
+uint32_t pcm_interp_check(uint32_t vectors)
+{
+  // Own models, so the check works whichever implementation is active
+  SoftInterp m0;
+  m0.lane[0] = INTERP0_LANE0;
+  m0.lane[1] = INTERP0_LANE1;
+  SoftInterp m1;
+  m1.lane[0] = INTERP1_LANE0;
+  m1.lane[1] = INTERP1_LANE1;
+  m1.base[2] = (uint32_t)MIX_BIAS;
+
+  static const int32_t edges[] = {-32768, -32767, -1, 0, 1, 32766, 32767};
+  static const uint32_t fracs[] = {0, 1, 127, 128, 255};
+  uint32_t bad = 0;
+  for (int32_t a : edges)
+    for (int32_t b : edges)
+      for (uint32_t f : fracs)
+        bad += check_one(m0, m1, a, b, f);
+
+  uint32_t s = 0x2545f491u;
+  for (uint32_t i = 0; i < vectors; ++i)
+  {
+    s = s * 1664525u + 1013904223u;
+    int32_t a = (int16_t)(s >> 16);
+    s = s * 1664525u + 1013904223u;
+    int32_t b = (int16_t)(s >> 16);
+    bad += check_one(m0, m1, a, b, (s >> 8) & 0xffu);
+  }
+  return bad;
+}
@@ -0,0 +1,222 @@
+/*
+ * PARALAX - level meters and spectrum of the decoded PCM, as telemetry
+ * ThisOldCPU Project - https://github.com/thisoldcpu
+ *
+ * License : MIT
+ */
+
+#include "pcm_meter.h"
+
+#include <string.h>
+
+// sin(i * pi / 256) in Q15, a quarter wave of the FFT_N-point circle
+static const int16_t SIN_Q15[129] = {
+      0,   402,   804,  1206,  1608,  2009,  2411,  2811,  3212,  3612,  4011,  4410,
+   4808,  5205,  5602,  5998,  6393,  6787,  7180,  7571,  7962,  8351,  8740,  9127,
+   9512,  9896, 10279, 10660, 11039, 11417, 11793, 12167, 12540, 12910, 13279, 13646,
+  14010, 14373, 14733, 15091, 15447, 15800, 16151, 16500, 16846, 17190, 17531, 17869,
+  18205, 18538, 18868, 19195, 19520, 19841, 20160, 20475, 20788, 21097, 21403, 21706,
+  22006, 22302, 22595, 22884, 23170, 23453, 23732, 24008, 24279, 24548, 24812, 25073,
+  25330, 25583, 25833, 26078, 26320, 26557, 26791, 27020, 27246, 27467, 27684, 27897,
+  28106, 28311, 28511, 28707, 28899, 29086, 29269, 29448, 29622, 29792, 29957, 30118,
+  30274, 30425, 30572, 30715, 30853, 30986, 31114, 31238, 31357, 31471, 31581, 31686,
+  31786, 31881, 31972, 32058, 32138, 32214, 32286, 32352, 32413, 32470, 32522, 32568,
+  32610, 32647, 32679, 32706, 32729, 32746, 32758, 32766, 32767,
+};
+
+static_assert(PcmMeter::FFT_N == 512, "SIN_Q15 is a quarter of a 512-point circle");
+
+// Roughly two bands per octave: 94, 188, 281, 375, 469, 563, 750, 1031 Hz, ...
+const uint16_t PcmMeter::BAND_EDGES[BANDS + 1] = {1,  2,  3,  4,  5,   6,   8,   11, 16,
+                                                  23, 32, 45, 64, 91, 128, 181, 256};
+
+// Full scale, as log2 of the power: a peak of 32768, a sine of that
+// amplitude (mean square 2^29), and its bin after the window and the FFT
+static constexpr uint32_t PEAK_REF_LOG2 = 30;
+static constexpr uint32_t RMS_REF_LOG2 = 29;
+static constexpr uint32_t BIN_REF_LOG2 = 26;
+
+PcmMeter::PcmMeter()
+{
+  reset();
+}
+
+void PcmMeter::reset()
+{
+  fill_ = 0;
+  count_ = 0;
+  for (uint32_t c = 0; c < 2; ++c)
+  {
+    peak_[c] = 0;
+    sum_sq_[c] = 0;
+  }
+  due_ = false;
+  seq_ = 0;
+}
+
+void PcmMeter::on_sample(int16_t left, int16_t right)
+{
+  int32_t v[2] = {left, right};
+  for (uint32_t c = 0; c < 2; ++c)
+  {
+    uint32_t a = (uint32_t)(v[c] < 0 ? -v[c] : v[c]);
+    if (a > peak_[c])
+      peak_[c] = a;
+    sum_sq_[c] += (uint32_t)(v[c] * v[c]);
+  }
+  if (fill_ < FFT_N)
+    block_[fill_++] = (int16_t)((v[0] + v[1]) >> 1);
+  if (++count_ < RECORD_SAMPLES)
+    return;
+
+  // Hand the record over; one not taken yet is replaced
+  memcpy(re_, block_, sizeof(re_));
+  for (uint32_t c = 0; c < 2; ++c)
+  {
+    due_peak_[c] = peak_[c];
+    due_sum_sq_[c] = sum_sq_[c];
+    peak_[c] = 0;
+    sum_sq_[c] = 0;
+  }
+  due_ = true;
+  fill_ = 0;
+  count_ = 0;
+}
+
+bool PcmMeter::take(MeterRecord &out)
+{
+  if (!due_)
+    return false;
+  due_ = false;
+
+  // Hann window, (1 - cos) / 2
+  for (uint32_t n = 0; n < FFT_N; ++n)
+  {
+    int32_t w = (32767 - sin_q15(n + FFT_N / 4)) >> 1;
+    re_[n] = (int16_t)((re_[n] * w) >> 15);
+    im_[n] = 0;
+  }
+  fft(re_, im_);
+
+  for (uint32_t b = 0; b < BANDS; ++b)
+  {
+    uint32_t strongest = 0;
+    for (uint32_t k = BAND_EDGES[b]; k < BAND_EDGES[b + 1]; ++k)
+    {
+      uint32_t p = (uint32_t)(re_[k] * re_[k]) + (uint32_t)(im_[k] * im_[k]);
+      if (p > strongest)
+        strongest = p;
+    }
+    out.bands[b] = level(strongest, BIN_REF_LOG2);
+  }
+  for (uint32_t c = 0; c < 2; ++c)
+  {
+    out.peak[c] = level((uint64_t)due_peak_[c] * due_peak_[c], PEAK_REF_LOG2);
+    out.rms[c] = level(due_sum_sq_[c] / RECORD_SAMPLES, RMS_REF_LOG2);
+  }
+  out.seq = seq_++;
+  out.device = 0;
+  out.keys = 0;
+  out.key_ons = 0;
+  return true;
+}
+
+int32_t PcmMeter::sin_q15(uint32_t index)
+{
+  uint32_t q = index & (FFT_N - 1);
+  if (q < 128)
+    return SIN_Q15[q];
+  if (q < 256)
+    return SIN_Q15[256 - q];
+  if (q < 384)
+    return -SIN_Q15[q - 256];
+  return -SIN_Q15[512 - q];
+}
+
+void PcmMeter::fft(int16_t *re, int16_t *im)
+{
+  // Bit-reversed order
+  for (uint32_t i = 1, j = 0; i < FFT_N; ++i)
+  {
+    uint32_t bit = FFT_N >> 1;
+    for (; j & bit; bit >>= 1)
+      j ^= bit;
+    j ^= bit;
+    if (i < j)
+    {
+      int16_t t = re[i];
+      re[i] = re[j];
+      re[j] = t;
+      t = im[i];
+      im[i] = im[j];
+      im[j] = t;
+    }
+  }
+
+  // Halving every stage, rounded, keeps each magnitude within the input's
+  for (uint32_t half = 1; half < FFT_N; half <<= 1)
+  {
+    uint32_t step = FFT_N / (half * 2);
+    for (uint32_t k = 0; k < half; ++k)
+    {
+      int32_t wr = sin_q15(k * step + FFT_N / 4);
+      int32_t wi = -sin_q15(k * step);
+      for (uint32_t a = k; a < FFT_N; a += half * 2)
+      {
+        uint32_t b = a + half;
+        int32_t tr = (re[b] * wr - im[b] * wi + 16384) >> 15;
+        int32_t ti = (re[b] * wi + im[b] * wr + 16384) >> 15;
+        re[b] = (int16_t)((re[a] - tr + 1) >> 1);
+        im[b] = (int16_t)((im[a] - ti + 1) >> 1);
+        re[a] = (int16_t)((re[a] + tr + 1) >> 1);
+        im[a] = (int16_t)((im[a] + ti + 1) >> 1);
+      }
+    }
+  }
+}
+
+uint8_t PcmMeter::level(uint64_t power, uint32_t ref_log2)
+{
+  if (!power)
+    return 0;
+
+  // log2 in Q8: the top bit, then the mantissa with a parabolic correction
+  uint32_t msb = 63 - (uint32_t)__builtin_clzll(power);
+  uint32_t m = (uint32_t)(msb >= 8 ? power >> (msb - 8) : power << (8 - msb)) & 0xff;
+  uint32_t log2_q8 = (msb << 8) + m + ((m * (256 - m) * 92) >> 16);
+  if (log2_q8 >= ref_log2 << 8)
+    return 255;
+
+  // 20 log10(2) = 6.0206 half-dB steps per octave of power: 1541 / 65536 per Q8 step
+  uint32_t steps = (((ref_log2 << 8) - log2_q8) * 1541 + 32768) >> 16;
+  return (uint8_t)(steps > 255 ? 0 : 255 - steps);
+}
+
+void PcmMeter::pack(const MeterRecord &r, uint8_t *out)
+{
+  out[0] = (uint8_t)r.seq;
+  out[1] = (uint8_t)(r.seq >> 8);
+  out[2] = r.device;
+  out[3] = r.peak[0];
+  out[4] = r.peak[1];
+  out[5] = r.rms[0];
+  out[6] = r.rms[1];
+  memcpy(out + 7, r.bands, BANDS);
+  out[23] = (uint8_t)r.keys;
+  out[24] = (uint8_t)(r.keys >> 8);
+  out[25] = (uint8_t)r.key_ons;
+  out[26] = (uint8_t)(r.key_ons >> 8);
+}
+
+void PcmMeter::unpack(const uint8_t *in, MeterRecord &r)
+{
+  r.seq = (uint16_t)(in[0] | (in[1] << 8));
+  r.device = in[2];
+  r.peak[0] = in[3];
+  r.peak[1] = in[4];
+  r.rms[0] = in[5];
+  r.rms[1] = in[6];
+  memcpy(r.bands, in + 7, BANDS);
+  r.keys = (uint16_t)(in[23] | (in[24] << 8));
+  r.key_ons = (uint16_t)(in[25] | (in[26] << 8));
+}
@@ -0,0 +1,211 @@
+/*
+ * PARALAX LPT Sniffer - PIO change-capture profile
+ * ThisOldCPU Project - https://github.com/thisoldcpu
+ *
+ * License : MIT
+ */
+
+#include "pio_capture.h"
+
+#include <Arduino.h>
+
+#include "hardware/clocks.h"
+#include "hardware/dma.h"
+#include "hardware/pio.h"
+
+#include "change_capture.pio.h"
+#include "lpt_pins.h"
+
+// DMA ring (bytes = 1 << RING_BITS, must be aligned to its size; 15 is the max)
+static constexpr uint32_t RING_BITS = 15;
+static constexpr uint32_t RING_WORDS = (1u << RING_BITS) / sizeof(uint32_t);
+static constexpr uint32_t RING_MASK = RING_WORDS - 1;
+
+// Transfer count loaded into the data channel; the control channel reloads it
+static constexpr uint32_t REARM_COUNT = 0xFFFFFFFFu;
+
+static constexpr uint32_t PIN_WORD_TAG = 0x80000000u;
+static constexpr uint32_t COUNTER_MASK = 0x7FFFFFFFu;
+
+static uint32_t ring[RING_WORDS] __attribute__((aligned(1u << RING_BITS)));
+static const uint32_t rearm_count = REARM_COUNT;
+
+static PIO cap_pio = pio0;
+static int cap_sm = -1;
+static uint cap_offset = 0;
+static int dma_data = -1;
+static int dma_ctrl = -1;
+
+// Word accounting (free-running, modulo 2^32)
+static uint32_t produced = 0;
+static uint32_t consumed = 0;
+static uint32_t last_remaining = REARM_COUNT;
+static uint32_t dropped_pairs = 0;
+
+// Timestamp reconstruction
+static uint32_t sys_hz = 0;
+static uint32_t t0_us_base = 0;
+static uint64_t cycles = 0;
+static uint32_t last_counter = 0;
+static bool have_frame = false;
+
+static void update_produced()
+{
+  uint32_t remaining = dma_hw->ch[dma_data].transfer_count;
+  uint32_t delta;
+  if (remaining <= last_remaining)
+    delta = last_remaining - remaining;
+  else
+    delta = last_remaining + (REARM_COUNT - remaining); // control channel re-armed
+  last_remaining = remaining;
+  produced += delta;
+
+  // Lapped: skip ahead to the oldest half of the ring that is still intact
+  uint32_t backlog = produced - consumed;
+  if (backlog > RING_WORDS - 16)
+  {
+    uint32_t skip = backlog - RING_WORDS / 2;
+    dropped_pairs += skip / 2;
+    consumed += skip;
+  }
+}
+
+static void cycles_to_time(uint64_t cyc, CaptureFrame &out)
+{
+  // 1/256 us units, split to keep the intermediate product in 64 bits
+  uint64_t whole = cyc / sys_hz;
+  uint64_t frac = ((cyc % sys_hz) * 256000000ull) / sys_hz;
+  uint64_t t256 = whole * 256000000ull + frac;
+  out.t_us = t0_us_base + (uint32_t)(t256 >> 8);
+  out.t_sub = (uint8_t)(t256 & 0xFFu);
+}
+
+bool pio_capture_start(uint32_t t0_us)
+{
+  if (cap_sm >= 0)
+    return true;
+
+  if (!pio_can_add_program(cap_pio, &change_capture_program))
+    return false;
+  cap_sm = pio_claim_unused_sm(cap_pio, false);
+  if (cap_sm < 0)
+    return false;
+  cap_offset = pio_add_program(cap_pio, &change_capture_program);
+
+  dma_data = dma_claim_unused_channel(true);
+  dma_ctrl = dma_claim_unused_channel(true);
+
+  pio_sm_config c = change_capture_program_get_default_config(cap_offset);
+  sm_config_set_in_pins(&c, PIN_CAPTURE_BASE);
+  sm_config_set_in_shift(&c, false, false, 32); // shift left, no autopush
+  sm_config_set_fifo_join(&c, PIO_FIFO_JOIN_RX);
+  pio_sm_init(cap_pio, cap_sm, cap_offset, &c);
+
+  // Counter starts at 0; Y = 0 never matches a tagged sample, so the
+  // first loop emits the initial bus state as frame 0
+  pio_sm_exec(cap_pio, cap_sm, pio_encode_mov(pio_osr, pio_null));
+  pio_sm_exec(cap_pio, cap_sm, pio_encode_mov(pio_y, pio_null));
+
+  // Data channel: RX FIFO -> ring, chains to the control channel when done
+  dma_channel_config dc = dma_channel_get_default_config(dma_data);
+  channel_config_set_transfer_data_size(&dc, DMA_SIZE_32);
+  channel_config_set_read_increment(&dc, false);
+  channel_config_set_write_increment(&dc, true);
+  channel_config_set_ring(&dc, true, RING_BITS);
+  channel_config_set_dreq(&dc, pio_get_dreq(cap_pio, cap_sm, false));
+  channel_config_set_chain_to(&dc, dma_ctrl);
+  dma_channel_configure(dma_data, &dc, ring, &cap_pio->rxf[cap_sm], REARM_COUNT, false);
+
+  // Control channel: reload the count and retrigger, write address carries on
+  dma_channel_config cc = dma_channel_get_default_config(dma_ctrl);
+  channel_config_set_transfer_data_size(&cc, DMA_SIZE_32);
+  channel_config_set_read_increment(&cc, false);
+  channel_config_set_write_increment(&cc, false);
+  dma_channel_configure(dma_ctrl, &cc, &dma_hw->ch[dma_data].al1_transfer_count_trig, &rearm_count, 1, false);
+
+  produced = 0;
+  consumed = 0;
+  last_remaining = REARM_COUNT;
+  dropped_pairs = 0;
+  sys_hz = clock_get_hz(clk_sys);
+  t0_us_base = t0_us;
+  cycles = 0;
+  last_counter = 0;
+  have_frame = false;
+
+  dma_channel_start(dma_data);
+  pio_sm_set_enabled(cap_pio, cap_sm, true);
+  return true;
+}
+
+void pio_capture_stop()
+{
+  if (cap_sm < 0)
+    return;
+
+  pio_sm_set_enabled(cap_pio, cap_sm, false);
+  dma_channel_abort(dma_ctrl);
+  dma_channel_abort(dma_data);
+  dma_channel_unclaim(dma_ctrl);
+  dma_channel_unclaim(dma_data);
+  pio_remove_program(cap_pio, &change_capture_program, cap_offset);
+  pio_sm_unclaim(cap_pio, cap_sm);
+
+  dma_ctrl = dma_data = -1;
+  cap_sm = -1;
+}
+
+bool pio_capture_running()
+{
+  return cap_sm >= 0;
+}
+
+bool pio_capture_pop(CaptureFrame &out)
+{
+  if (cap_sm < 0)
+    return false;
+
+  update_produced();
+
+  while (produced - consumed >= 2)
+  {
+    uint32_t pins = ring[consumed & RING_MASK];
+    if (!(pins & PIN_WORD_TAG))
+    {
+      // Resync onto a pin word after a lap
+      consumed++;
+      continue;
+    }
+    uint32_t counter = ring[(consumed + 1) & RING_MASK];
+    if (counter & PIN_WORD_TAG)
+    {
+      // FIFO overflowed between the two pushes: counter word lost
+      consumed++;
+      dropped_pairs++;
+      continue;
+    }
+    consumed += 2;
+
+    // Down-counter: loops elapsed since the previous change, each idle loop
+    // is 7 cycles and the previous change path itself took 9.
+    // Gaps over 2^31 loops (~110 s at 133 MHz) with no edge fold.
+    uint32_t loops = (last_counter - counter) & COUNTER_MASK;
+    if (have_frame)
+      cycles += change_capture_change_cycles;
+    have_frame = true;
+    cycles += (uint64_t)loops * change_capture_idle_cycles;
+    last_counter = counter;
+
+    uint32_t snap = (pins & ((1u << PIN_CAPTURE_COUNT) - 1u)) << PIN_CAPTURE_BASE;
+    cycles_to_time(cycles, out);
+    out.data = read_data_bus(snap);
+    out.bits = pack_bits(snap);
+    return true;
+  }
+  return false;
+}
+
+uint32_t pio_capture_dropped()
+{
+  return dropped_pairs;
+}
@@ -0,0 +1,28 @@
+/*
+ * PARALAX LPT Sniffer - PIO change-capture profile
+ * ThisOldCPU Project - https://github.com/thisoldcpu
+ *
+ * One PIO state machine polls GP2..GP21 every 7 system clocks and pushes
+ * a (pins, counter) word pair on every change; DMA drains it into a RAM
+ * ring with no CPU involvement. Resolution is ~53 ns at 133 MHz and no
+ * edge is lost while the ring has room, which the IRQ-per-edge path
+ * cannot offer above a few hundred kHz of edges (EPP, ECP, fast nibble).
+ *
+ * License : MIT
+ */
+
+#pragma once
+
+#include "capture_frame.h"
+
+// Claim a PIO state machine + DMA channels and start sampling.
+// Frame timestamps start at t0_us so they continue another profile's clock.
+bool pio_capture_start(uint32_t t0_us = 0);
+void pio_capture_stop();
+bool pio_capture_running();
+
+// Next captured frame, oldest first. Timestamps are relative to start.
+bool pio_capture_pop(CaptureFrame &out);
+
+// Word pairs lost because the ring was lapped before it was drained
+uint32_t pio_capture_dropped();
@@ -0,0 +1,301 @@
+/*
+ * PARALAX - PIT divisor inference for DAC writes
+ * ThisOldCPU Project - https://github.com/thisoldcpu
+ *
+ * License : MIT
+ */
+
+#include "pit_clock.h"
+
+static constexpr uint32_t MAX_K = 8;       // periods one acquisition interval may span
+static constexpr uint32_t PHASE_SHIFT = 7; // loop gains: 1/128 phase, 1/65536 period
+static constexpr uint32_t FREQ_SHIFT = 16;
+
+// Arithmetic shift rounding to nearest: a floor would bias the loop
+static inline int64_t shift_round(int64_t v, uint32_t n)
+{
+  return (v + ((int64_t)1 << (n - 1))) >> n;
+}
+
+PitClock::PitClock()
+{
+  reset();
+}
+
+void PitClock::reset()
+{
+  started_ = false;
+  locked_ = false;
+  last_t_ = 0;
+  now_q16_ = 0;
+  count_ = 0;
+  candidate_ = 0;
+  agree_ = 0;
+  acc_dt_ = 0;
+  acc_k_ = 0;
+  divisor_ = 0;
+  nominal_ = 0;
+  period_ = 0;
+  grid_ = 0;
+  misses_ = 0;
+  slots_ = 0;
+  jitter_q16_ = 0;
+  max_jitter_q16_ = 0;
+  writes_ = 0;
+  locks_ = 0;
+  unlocks_ = 0;
+  relocks_ = 0;
+  skipped_ = 0;
+  collisions_ = 0;
+}
+
+int64_t PitClock::nominal_q16(uint32_t divisor)
+{
+  return (int64_t)((((uint64_t)divisor * 1000000u << 16) + PIT_HZ / 2) / PIT_HZ);
+}
+
+uint32_t PitClock::rate_mhz() const
+{
+  if (!divisor_)
+    return 0;
+  return (uint32_t)(((uint64_t)PIT_HZ * 1000u + divisor_ / 2) / divisor_);
+}
+
+int32_t PitClock::clock_ppm() const
+{
+  if (!nominal_)
+    return 0;
+  return (int32_t)((period_ - nominal_) * 1000000 / nominal_);
+}
+
+// Sorts v in place and returns v[at]
+static uint32_t sorted_at(uint32_t *v, uint32_t n, uint32_t at)
+{
+  for (uint32_t i = 1; i < n; ++i)
+  {
+    uint32_t x = v[i];
+    uint32_t j = i;
+    for (; j > 0 && v[j - 1] > x; --j)
+      v[j] = v[j - 1];
+    v[j] = x;
+  }
+  return v[at];
+}
+
+bool PitClock::estimate(uint32_t &divisor, uint64_t &sum_dt, uint64_t &sum_k)
+{
+  // Lower quartile: intervals over repeated bytes span several periods
+  uint32_t s[ACQ_INTERVALS];
+  for (uint32_t i = 0; i < ACQ_INTERVALS; ++i)
+    s[i] = dt_[i];
+  uint32_t p0 = sorted_at(s, ACQ_INTERVALS, ACQ_INTERVALS / 4);
+  if (!p0)
+    return false;
+
+  // Whole periods per interval; the total telescopes, so the jitter of the
+  // writes in between drops out
+  uint32_t k[ACQ_INTERVALS];
+  sum_dt = 0;
+  sum_k = 0;
+  for (uint32_t i = 0; i < ACQ_INTERVALS; ++i)
+  {
+    k[i] = (dt_[i] + p0 / 2) / p0;
+    if (k[i] < 1 || k[i] > MAX_K)
+      return false;
+    sum_dt += dt_[i];
+    sum_k += k[i];
+  }
+
+  // A timer keeps every write within its jitter of the fitted grid; writes
+  // without one drift off it as the rounding errors add up
+  int64_t period = (int64_t)((sum_dt << 16) / sum_k);
+  int64_t t = 0;
+  int64_t n = 0;
+  int32_t e[ACQ_INTERVALS];
+  for (uint32_t i = 0; i < ACQ_INTERVALS; ++i)
+  {
+    t += (int64_t)dt_[i] << 16;
+    n += k[i];
+    e[i] = (int32_t)(t - n * period);
+  }
+  for (uint32_t i = 0; i < ACQ_INTERVALS; ++i)
+    s[i] = (uint32_t)e[i] ^ 0x80000000u; // signed order as unsigned
+  int32_t mid = (int32_t)(sorted_at(s, ACQ_INTERVALS, ACQ_INTERVALS / 2) ^ 0x80000000u);
+  uint32_t good = 0;
+  for (uint32_t i = 0; i < ACQ_INTERVALS; ++i)
+  {
+    int64_t d = (int64_t)e[i] - mid;
+    if ((d < 0 ? -d : d) * 4 <= period)
+      good++;
+  }
+  if (good * 10 < ACQ_INTERVALS * 9)
+    return false; // not paced by a timer
+
+  // One window is short: it only has to be near a whole divisor
+  divisor = nearest_divisor(sum_dt, sum_k, 100);
+  return divisor != 0;
+}
+
+// Nearest divisor for a total time over a number of periods, 0 unless it
+// is within 1/tolerance of it
+uint32_t PitClock::nearest_divisor(uint64_t sum_dt, uint64_t sum_k, uint32_t tolerance)
+{
+  uint64_t num = sum_dt * PIT_HZ;
+  uint64_t den = sum_k * 1000000u;
+  uint64_t d = (num + den / 2) / den;
+  if (d < MIN_DIVISOR || d > 65535)
+    return 0;
+
+  uint64_t fit = d * den;
+  uint64_t err = num > fit ? num - fit : fit - num;
+  if (err * tolerance > fit)
+    return 0;
+  return (uint32_t)d;
+}
+
+void PitClock::acquire(uint32_t dt_us)
+{
+  dt_[count_++] = dt_us;
+  if (count_ < ACQ_INTERVALS)
+    return;
+  count_ = 0;
+
+  uint32_t d = 0;
+  uint64_t sum_dt = 0;
+  uint64_t sum_k = 0;
+  if (!estimate(d, sum_dt, sum_k))
+  {
+    agree_ = 0;
+    return;
+  }
+  if (d == candidate_ && agree_)
+  {
+    agree_++;
+    acc_dt_ += sum_dt;
+    acc_k_ += sum_k;
+  }
+  else
+  {
+    candidate_ = d;
+    agree_ = 1;
+    acc_dt_ = sum_dt;
+    acc_k_ = sum_k;
+  }
+  if (agree_ < CONFIRM)
+    return;
+
+  // Over the confirming windows together the rate must be the divisor's,
+  // give or take the crystals and the jitter left at the window edges
+  agree_ = 0;
+  if (nearest_divisor(acc_dt_, acc_k_, CONFIRM_TOLERANCE) != d)
+    return;
+
+  locked_ = true;
+  locks_++;
+  divisor_ = d;
+  nominal_ = nominal_q16(d);
+  misses_ = 0;
+
+  // Start from the measured period: it already holds the crystal offset
+  period_ = (int64_t)((acc_dt_ << 16) / acc_k_);
+  clamp_period();
+}
+
+void PitClock::clamp_period()
+{
+  int64_t limit = nominal_ * MAX_PPM / 1000000;
+  if (period_ > nominal_ + limit)
+    period_ = nominal_ + limit;
+  else if (period_ < nominal_ - limit)
+    period_ = nominal_ - limit;
+}
+
+bool PitClock::on_write(uint32_t t_us, int32_t &offset_q16)
+{
+  offset_q16 = 0;
+  writes_++;
+
+  if (!started_)
+  {
+    started_ = true;
+    last_t_ = t_us;
+    now_q16_ = (uint64_t)t_us << 16;
+    return false;
+  }
+
+  uint32_t dt = t_us - last_t_;
+  if ((int32_t)dt < 0)
+    return false; // out of order, leave the grid alone
+  last_t_ = t_us;
+  now_q16_ += (uint64_t)dt << 16;
+  int64_t now = (int64_t)now_q16_;
+
+  if (!locked_)
+  {
+    if (dt > MAX_GAP_US)
+    {
+      count_ = 0;
+      agree_ = 0;
+    }
+    else if (dt)
+      acquire(dt);
+    if (!locked_)
+      return false;
+
+    // Just locked: anchor the grid here
+    grid_ = now;
+    return true;
+  }
+
+  if (dt > MAX_GAP_US)
+  {
+    grid_ = now;
+    relocks_++;
+    misses_ = 0;
+    return true;
+  }
+
+  int64_t since = now - grid_;
+  int64_t k = since + period_ / 2 < 0 ? 0 : (since + period_ / 2) / period_;
+  int64_t r = since - k * period_;
+  uint32_t mag = (uint32_t)(r < 0 ? -r : r);
+
+  // Leaky count of writes off the grid: a new rate also lands on it now and then
+  if (k == 0 || (int64_t)mag * 4 > period_)
+  {
+    misses_ += 2;
+    if (misses_ >= UNLOCK_MISSES * 2)
+    {
+      locked_ = false;
+      unlocks_++;
+      count_ = 0;
+      agree_ = 0;
+      misses_ = 0;
+      return false;
+    }
+  }
+  else if (misses_)
+    misses_--;
+
+  if (k == 0)
+  {
+    // Second write in the same slot
+    collisions_++;
+    offset_q16 = (int32_t)(grid_ - now);
+    return true;
+  }
+
+  jitter_q16_ += (int32_t)(mag - jitter_q16_) >> 6;
+  if (mag > max_jitter_q16_)
+    max_jitter_q16_ = mag;
+  skipped_ += (uint32_t)(k - 1);
+  slots_ += (uint64_t)k;
+
+  // Snap to the predicted slot, then let the loop follow the writes
+  int64_t slot = grid_ + k * period_;
+  offset_q16 = (int32_t)(slot - now);
+  grid_ = slot + shift_round(r, PHASE_SHIFT);
+  period_ += shift_round(r, FREQ_SHIFT) / k;
+  clamp_period();
+  return true;
+}
@@ -0,0 +1,153 @@
+/*
+ * PARALAX - PLIP (4-bit "LapLink" cable) frame decoder
+ * ThisOldCPU Project - https://github.com/thisoldcpu
+ *
+ * License : MIT
+ */
+
+#include "plip_decoder.h"
+
+PlipDecoder::PlipDecoder()
+{
+  reset();
+}
+
+void PlipDecoder::reset()
+{
+  primed_ = false;
+  prev_d4_ = 0;
+  prev_busy_ = 0;
+  for (Lane &lane : lane_)
+  {
+    restart(lane);
+    lane.last_us = 0;
+    lane.frames = 0;
+    lane.bad_sums = 0;
+  }
+  timeouts_ = 0;
+  violations_ = 0;
+}
+
+void PlipDecoder::restart(Lane &lane)
+{
+  lane.state = LANE_LEN_LO;
+  lane.have_low = false;
+  lane.low = 0;
+  lane.length = 0;
+  lane.count = 0;
+  lane.sum = 0;
+}
+
+bool PlipDecoder::feed(const CaptureFrame &f, PlipFrame &out)
+{
+  uint8_t d4 = (f.data >> 4) & 1u;
+  uint8_t busy = (uint8_t)bit_at(f.bits, FB_BUSY);
+
+  if (!primed_)
+  {
+    primed_ = true;
+    prev_d4_ = d4;
+    prev_busy_ = busy;
+    return false;
+  }
+
+  bool d4_moved = d4 != prev_d4_;
+  bool busy_moved = busy != prev_busy_;
+  bool settled = prev_d4_ == prev_busy_;
+  prev_d4_ = d4;
+  prev_busy_ = busy;
+
+  if (!settled || d4_moved == busy_moved)
+  {
+    // Receiver catching up (an ack), no change, or both at once
+    if (settled && d4_moved)
+      violations_++;
+    return false;
+  }
+
+  if (d4_moved)
+    return nibble(PLIP_TX, f, f.data & 0x0Fu, d4 != 0, out);
+  return nibble(PLIP_RX, f, status_nibble(f.bits), busy != 0, out);
+}
+
+bool PlipDecoder::nibble(uint8_t dir, const CaptureFrame &f, uint8_t nib, bool rising, PlipFrame &out)
+{
+  Lane &lane = lane_[dir];
+
+  bool mid_frame = lane.have_low || lane.state != LANE_LEN_LO;
+  if (mid_frame && (f.t_us - lane.last_us) > NIBBLE_TIMEOUT_US)
+  {
+    timeouts_++;
+    restart(lane);
+  }
+  lane.last_us = f.t_us;
+
+  if (rising)
+  {
+    if (lane.state == LANE_LEN_LO && !lane.have_low)
+    {
+      lane.start_us = f.t_us;
+      lane.start_sub = f.t_sub;
+      lane.start_ticks = frame_ticks(f);
+    }
+    lane.have_low = true;
+    lane.low = nib;
+    return false;
+  }
+
+  // A high nibble without its low half: capture started mid-byte
+  if (!lane.have_low)
+    return false;
+  lane.have_low = false;
+  return byte(dir, f, (uint8_t)(lane.low | (nib << 4)), out);
+}
+
+bool PlipDecoder::byte(uint8_t dir, const CaptureFrame &f, uint8_t value, PlipFrame &out)
+{
+  Lane &lane = lane_[dir];
+
+  switch (lane.state)
+  {
+  case LANE_LEN_LO:
+    lane.length = value;
+    lane.state = LANE_LEN_HI;
+    return false;
+
+  case LANE_LEN_HI:
+    lane.length |= (uint16_t)(value << 8);
+    if (lane.length == 0 || lane.length > MAX_FRAME)
+    {
+      violations_++;
+      restart(lane);
+      return false;
+    }
+    lane.count = 0;
+    lane.sum = 0;
+    lane.state = LANE_DATA;
+    return false;
+
+  case LANE_DATA:
+    lane.buf[lane.count++] = value;
+    lane.sum = (uint8_t)(lane.sum + value);
+    if (lane.count == lane.length)
+      lane.state = LANE_SUM;
+    return false;
+
+  case LANE_SUM:
+    break;
+  }
+
+  out.t_us = lane.start_us;
+  out.t_sub = lane.start_sub;
+  out.dir = dir;
+  out.checksum_ok = value == lane.sum;
+  out.length = lane.length;
+  out.payload = lane.buf;
+  out.transfer_ns = ticks_to_ns(frame_ticks(f) - lane.start_ticks);
+
+  lane.frames++;
+  if (!out.checksum_ok)
+    lane.bad_sums++;
+  restart(lane);
+  return true;
+}
@@ -0,0 +1,78 @@
+/*
+ * PARALAX LPT Sniffer - PWM headphone monitor output
+ * ThisOldCPU Project - https://github.com/thisoldcpu
+ *
+ * License : MIT
+ */
+
+#include "pwm_audio.h"
+
+#include "hardware/clocks.h"
+#include "hardware/dma.h"
+#include "hardware/gpio.h"
+#include "hardware/irq.h"
+#include "hardware/pwm.h"
+
+static constexpr uint32_t BLOCK_LEVELS = PWM_AUDIO_BLOCK_FRAMES * PwmMonitor::OVERSAMPLE;
+
+static PwmMonitor *source_ = nullptr;
+static uint16_t block_[2][BLOCK_LEVELS];
+static int dma_[2] = {-1, -1};
+
+// A block has played: refill it and point its channel back at the start.
+// The other channel is already running, chained from this one.
+static void __not_in_flash_func(pwm_dma_irq)()
+{
+  for (uint8_t i = 0; i < 2; ++i)
+  {
+    if (!dma_channel_get_irq1_status(dma_[i]))
+      continue;
+    dma_channel_acknowledge_irq1(dma_[i]);
+    source_->fill(block_[i], PWM_AUDIO_BLOCK_FRAMES);
+    dma_channel_set_read_addr(dma_[i], block_[i], false);
+  }
+}
+
+void pwm_audio_begin(PwmMonitor &source, uint pin)
+{
+  source_ = &source;
+  source.set_top(PwmMonitor::top_for_clock(clock_get_hz(clk_sys)));
+
+  uint slice = pwm_gpio_to_slice_num(pin);
+  gpio_set_function(pin, GPIO_FUNC_PWM);
+  pwm_config pc = pwm_get_default_config();
+  pwm_config_set_clkdiv_int(&pc, 1);
+  pwm_config_set_wrap(&pc, source.top());
+  pwm_init(slice, &pc, false);
+  pwm_set_gpio_level(pin, (uint16_t)((source.top() + 1) / 2));
+
+  for (uint8_t i = 0; i < 2; ++i)
+  {
+    dma_[i] = dma_claim_unused_channel(true);
+    source.fill(block_[i], PWM_AUDIO_BLOCK_FRAMES);
+  }
+
+  // A 16-bit write to CC lands in both halves, so A or B either way
+  for (uint8_t i = 0; i < 2; ++i)
+  {
+    dma_channel_config dc = dma_channel_get_default_config(dma_[i]);
+    channel_config_set_transfer_data_size(&dc, DMA_SIZE_16);
+    channel_config_set_read_increment(&dc, true);
+    channel_config_set_write_increment(&dc, false);
+    channel_config_set_dreq(&dc, pwm_get_dreq(slice));
+    channel_config_set_chain_to(&dc, dma_[i ^ 1]);
+    dma_channel_configure(dma_[i], &dc, &pwm_hw->slice[slice].cc, block_[i], BLOCK_LEVELS, false);
+    dma_channel_set_irq1_enabled(dma_[i], true);
+  }
+
+  irq_set_exclusive_handler(DMA_IRQ_1, pwm_dma_irq);
+  irq_set_enabled(DMA_IRQ_1, true);
+
+  dma_channel_start(dma_[0]);
+  pwm_set_enabled(slice, true);
+}
+
+bool pwm_audio_running()
+{
+  return dma_[0] >= 0;
+}
@@ -0,0 +1,32 @@
+/*
+ * PARALAX LPT Sniffer - PWM headphone monitor output
+ * ThisOldCPU Project - https://github.com/thisoldcpu
+ *
+ * Plays the decoded stream on one GPIO for a quick listen on the bench:
+ * a PWM slice at ~192 kHz whose compare level is written by DMA, paced by
+ * the slice's wrap DREQ. Two chained DMA channels ping-pong over two short
+ * blocks; the completion IRQ refills the idle one from a PwmMonitor.
+ *
+ * Call pwm_audio_begin() from setup1() so the IRQ lands on core 1: core 0
+ * and its capture path never see it, and the DMA traffic (one halfword per
+ * PWM period) is noise on the bus next to the capture.
+ *
+ * Filter: 1k + 10n to ground (~16 kHz) then a coupling cap to the
+ * headphones; the carrier is three octaves above the corner.
+ *
+ * License : MIT
+ */
+
+#pragma once
+
+#include <Arduino.h>
+
+#include "pwm_monitor.h"
+
+// Frames per DMA block, ~0.67 ms at 48 kHz
+static constexpr uint32_t PWM_AUDIO_BLOCK_FRAMES = 32;
+
+// Claim a PWM slice and two DMA channels and start playing `source`
+void pwm_audio_begin(PwmMonitor &source, uint pin);
+
+bool pwm_audio_running();
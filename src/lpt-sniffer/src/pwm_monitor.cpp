@@ -0,0 +1,68 @@
+/*
+ * PARALAX - PCM to PWM levels for the local headphone monitor
+ * ThisOldCPU Project - https://github.com/thisoldcpu
+ *
+ * License : MIT
+ */
+
+#include "pwm_monitor.h"
+
+#include "pcm_interp.h"
+
+uint16_t PwmMonitor::top_for_clock(uint32_t sys_hz)
+{
+  uint32_t per_frame = RATE_HZ * OVERSAMPLE;
+  uint32_t steps = (sys_hz + per_frame / 2) / per_frame;
+  if (steps < 2)
+    steps = 2;
+  if (steps > 65536)
+    steps = 65536;
+  return (uint16_t)(steps - 1);
+}
+
+PwmMonitor::PwmMonitor(uint16_t top)
+{
+  set_top(top);
+}
+
+void PwmMonitor::set_top(uint16_t top)
+{
+  steps_ = (uint32_t)top + 1;
+  reset();
+}
+
+void PwmMonitor::reset()
+{
+  asrc_.reset();
+  error_ = 0;
+}
+
+void PwmMonitor::on_sample(int16_t left, int16_t right)
+{
+  asrc_.on_sample(left, right);
+}
+
+void PwmMonitor::convert(int16_t left, int16_t right, uint16_t *levels)
+{
+  // Offset binary 0..65535, then Q16 steps; the sum fits in 32 bits
+  uint32_t u = (uint32_t)pcm_mix(left, right) >> 1;
+  uint32_t target = u * steps_;
+  for (uint32_t i = 0; i < OVERSAMPLE; ++i)
+  {
+    uint32_t acc = target + error_;
+    levels[i] = (uint16_t)(acc >> 16);
+    error_ = acc & 0xffff;
+  }
+}
+
+void PwmMonitor::fill(uint16_t *levels, uint32_t frames)
+{
+  while (frames)
+  {
+    uint32_t n = frames < PULL_FRAMES ? frames : PULL_FRAMES;
+    asrc_.pull(pcm_, n);
+    for (uint32_t i = 0; i < n; ++i, levels += OVERSAMPLE)
+      convert(pcm_[i * 2], pcm_[i * 2 + 1], levels);
+    frames -= n;
+  }
+}
@@ -0,0 +1,83 @@
+/*
+ * PARALAX - IEEE 1284 nibble / byte mode reverse-channel decoder
+ * ThisOldCPU Project - https://github.com/thisoldcpu
+ *
+ * License : MIT
+ */
+
+#include "reverse_decoder.h"
+
+ReverseChannelDecoder::ReverseChannelDecoder()
+{
+  reset();
+}
+
+void ReverseChannelDecoder::reset()
+{
+  mode_ = REVERSE_NIBBLE;
+  prev_bits_ = FRAME_BITS_IDLE;
+  have_low_ = false;
+  low_ = 0;
+  start_us_ = 0;
+  start_sub_ = 0;
+  start_ticks_ = 0;
+  bytes_ = 0;
+  violations_ = 0;
+}
+
+void ReverseChannelDecoder::resync(ReverseMode mode, uint16_t bits)
+{
+  mode_ = mode;
+  prev_bits_ = bits;
+  have_low_ = false;
+}
+
+bool ReverseChannelDecoder::feed(const CaptureFrame &f, ReverseByte &out)
+{
+  uint16_t prev = prev_bits_;
+  uint16_t cur = f.bits;
+  prev_bits_ = cur;
+
+  // Event 9: PtrClk low, data valid on the status lines / data bus
+  if (!bit_fell(prev, cur, FB_ACK))
+    return false;
+
+  if (bit_at(cur, FB_AUTOFEED))
+  {
+    // Event 7 (HostBusy low) never happened
+    violations_++;
+    have_low_ = false;
+    return false;
+  }
+
+  uint32_t now = frame_ticks(f);
+
+  if (mode_ == REVERSE_BYTE)
+  {
+    out.t_us = f.t_us;
+    out.t_sub = f.t_sub;
+    out.value = f.data;
+    out.byte_ns = 0;
+    bytes_++;
+    return true;
+  }
+
+  uint8_t nib = status_nibble(cur);
+  if (!have_low_)
+  {
+    have_low_ = true;
+    low_ = nib;
+    start_us_ = f.t_us;
+    start_sub_ = f.t_sub;
+    start_ticks_ = now;
+    return false;
+  }
+
+  have_low_ = false;
+  out.t_us = start_us_;
+  out.t_sub = start_sub_;
+  out.value = (uint8_t)(low_ | (nib << 4));
+  out.byte_ns = ticks_to_ns(now - start_ticks_);
+  bytes_++;
+  return true;
+}
@@ -0,0 +1,157 @@
+/*
+ * PARALAX - speculative decoding while the device is being classified
+ * ThisOldCPU Project - https://github.com/thisoldcpu
+ *
+ * License : MIT
+ */
+
+#include "speculative_decoder.h"
+
+SpeculativeDecoder::SpeculativeDecoder(DeviceEventSink &sink)
+    : sink_(sink)
+{
+  lanes_[DEV_COVOX - 1].dec = &covox_;
+  lanes_[DEV_DSS - 1].dec = &dss_;
+  lanes_[DEV_OPL2LPT - 1].dec = &opl2lpt_;
+  lanes_[DEV_TNDLPT - 1].dec = &tndlpt_;
+  lanes_[DEV_CMSLPT - 1].dec = &cmslpt_;
+  reset();
+}
+
+void SpeculativeDecoder::reset()
+{
+  for (Lane &lane : lanes_)
+    arm(lane);
+  committed_ = DEV_UNKNOWN;
+  committed_rate_.reset(0);
+  switched_off_ = 0;
+  discarded_ = 0;
+  reopens_ = 0;
+}
+
+void SpeculativeDecoder::arm(Lane &lane)
+{
+  lane.dec->reset();
+  lane.alive = true;
+  lane.head = 0;
+  lane.lost = 0;
+}
+
+bool SpeculativeDecoder::alive(LptDevice device) const
+{
+  if (device == DEV_UNKNOWN || device >= DEV_COUNT)
+    return false;
+  return lanes_[device - 1].alive;
+}
+
+uint32_t SpeculativeDecoder::live_candidates() const
+{
+  uint32_t n = 0;
+  for (const Lane &lane : lanes_)
+    n += lane.alive ? 1u : 0u;
+  return n;
+}
+
+void SpeculativeDecoder::feed(const CaptureFrame &f)
+{
+  DeviceEvent e;
+
+  if (committed_ != DEV_UNKNOWN)
+  {
+    Lane &lane = lanes_[committed_ - 1];
+    if (lane.dec->feed(f, e))
+      sink_.on_event(e);
+    if (committed_rate_.over(lane.dec->violations()))
+      reopen();
+    return;
+  }
+
+  for (Lane &lane : lanes_)
+  {
+    if (!lane.alive)
+      continue;
+
+    if (lane.dec->feed(f, e))
+    {
+      // Oldest events fall out if the verdict takes longer than the ring
+      if (lane.head >= LANE_EVENTS)
+        lane.lost++;
+      lane.ring[lane.head & (LANE_EVENTS - 1)] = e;
+      lane.head++;
+    }
+
+    if (lane.dec->violations() >= VIOLATION_LIMIT)
+    {
+      lane.alive = false;
+      discarded_ += lane.head - lane.lost;
+      switched_off_++;
+    }
+  }
+}
+
+void SpeculativeDecoder::commit(LptDevice device)
+{
+  if (device == DEV_UNKNOWN || device >= DEV_COUNT)
+  {
+    if (committed_ != DEV_UNKNOWN)
+      reopen();
+    return;
+  }
+  if (device == committed_)
+    return;
+
+  if (committed_ != DEV_UNKNOWN)
+  {
+    // Straight from one committed device to another: no prefix to replay
+    Lane &lane = lanes_[device - 1];
+    arm(lane);
+    lanes_[committed_ - 1].alive = false;
+    committed_ = device;
+    committed_rate_.reset(0);
+    sink_.on_commit(device, 0, 0);
+    return;
+  }
+
+  uint32_t replayed = 0;
+  uint32_t lost = 0;
+  for (uint8_t i = 0; i < CANDIDATES; ++i)
+  {
+    Lane &lane = lanes_[i];
+    uint32_t held = lane.head - lane.lost;
+
+    if (i != device - 1)
+    {
+      if (lane.alive)
+        discarded_ += held;
+      lane.alive = false;
+      continue;
+    }
+
+    if (lane.alive)
+    {
+      for (uint32_t n = lane.head - held; n < lane.head; ++n)
+        sink_.on_event(lane.ring[n & (LANE_EVENTS - 1)]);
+      replayed = held;
+      lost = lane.lost;
+    }
+    else
+    {
+      // Switched off earlier; the classifier outvotes it, from here on
+      arm(lane);
+    }
+    lane.alive = true;
+    committed_rate_.reset(lane.dec->violations());
+  }
+
+  committed_ = device;
+  sink_.on_commit(device, replayed, lost);
+}
+
+void SpeculativeDecoder::reopen()
+{
+  for (Lane &lane : lanes_)
+    arm(lane);
+  committed_ = DEV_UNKNOWN;
+  reopens_++;
+  sink_.on_reopen();
+}
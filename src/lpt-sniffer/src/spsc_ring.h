@@ -0,0 +1,57 @@
+/*
+ * PARALAX LPT Sniffer - single-producer single-consumer ring between cores
+ * ThisOldCPU Project - https://github.com/thisoldcpu
+ *
+ * One core pushes, the other pops. The slot is written before the index is
+ * published, with a memory barrier in between, so no lock is needed.
+ *
+ * License : MIT
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#include "hardware/sync.h"
+
+template <typename T, uint32_t N>
+class SpscRing
+{
+  static_assert((N & (N - 1)) == 0, "N must be power-of-two");
+
+public:
+  bool push(const T &v)
+  {
+    uint32_t w = w_;
+    uint32_t next = (w + 1) & (N - 1);
+    if (next == r_)
+    {
+      dropped_++;
+      return false;
+    }
+    buf_[w] = v;
+    __dmb();
+    w_ = next;
+    return true;
+  }
+
+  bool pop(T &out)
+  {
+    uint32_t r = r_;
+    if (r == w_)
+      return false;
+    __dmb();
+    out = buf_[r];
+    __dmb();
+    r_ = (r + 1) & (N - 1);
+    return true;
+  }
+
+  uint32_t dropped() const { return dropped_; }
+
+private:
+  T                 buf_[N];
+  volatile uint32_t w_ = 0;
+  volatile uint32_t r_ = 0;
+  volatile uint32_t dropped_ = 0;
+};
@@ -0,0 +1,30 @@
+/*
+ * PARALAX - USB Audio Class 1 packetisation, 48 kHz 16-bit stereo
+ * ThisOldCPU Project - https://github.com/thisoldcpu
+ *
+ * License : MIT
+ */
+
+#include "uac_packetizer.h"
+
+UacPacketizer::UacPacketizer(Asrc &source)
+    : source_(source), last_underran_(false), packets_(0)
+{
+}
+
+uint32_t UacPacketizer::next_packet(uint8_t *buf)
+{
+  uint32_t underruns = source_.underruns();
+  source_.pull(pcm_, PACKET_FRAMES);
+  last_underran_ = source_.underruns() != underruns;
+  packets_++;
+
+  // Little-endian 16-bit, left then right
+  for (uint32_t i = 0; i < PACKET_FRAMES * CHANNELS; ++i)
+  {
+    uint16_t v = (uint16_t)pcm_[i];
+    buf[i * 2] = (uint8_t)v;
+    buf[i * 2 + 1] = (uint8_t)(v >> 8);
+  }
+  return PACKET_BYTES;
+}
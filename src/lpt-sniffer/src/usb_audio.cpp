@@ -0,0 +1,257 @@
+/*
+ * PARALAX LPT Sniffer - USB Audio Class 1 capture function
+ * ThisOldCPU Project - https://github.com/thisoldcpu
+ *
+ * The descriptor block comes from an Adafruit_USBD_Interface, which gets
+ * interface and endpoint numbers allocated around the CDC console. The
+ * requests and transfers are served by a TinyUSB application class driver
+ * (usbd_app_driver_get_cb), since the stock audio driver is UAC2 only.
+ *
+ * No controls are declared (no feature unit, fixed sample rate), so the
+ * only requests are SET/GET_INTERFACE on the streaming interface.
+ *
+ * License : MIT
+ */
+
+#include "usb_audio.h"
+
+#include <string.h>
+
+#include <Arduino.h>
+#include <Adafruit_TinyUSB.h>
+
+#include "device/usbd_pvt.h"
+
+// ---- UAC1 descriptor constants ----
+static constexpr uint8_t UAC_SUBCLASS_CONTROL = 0x01;
+static constexpr uint8_t UAC_SUBCLASS_STREAMING = 0x02;
+static constexpr uint8_t UAC_CS_INTERFACE = 0x24;
+static constexpr uint8_t UAC_CS_ENDPOINT = 0x25;
+static constexpr uint8_t UAC_AC_HEADER = 0x01;
+static constexpr uint8_t UAC_AC_INPUT_TERMINAL = 0x02;
+static constexpr uint8_t UAC_AC_OUTPUT_TERMINAL = 0x03;
+static constexpr uint8_t UAC_AS_GENERAL = 0x01;
+static constexpr uint8_t UAC_AS_FORMAT_TYPE = 0x02;
+static constexpr uint8_t UAC_FORMAT_TYPE_I = 0x01;
+static constexpr uint8_t UAC_EP_GENERAL = 0x01;
+
+static constexpr uint8_t TERMINAL_LINE_IN = 1; // external line connector
+static constexpr uint8_t TERMINAL_USB_OUT = 2; // USB streaming, to the host
+
+static constexpr uint16_t AC_TOTAL_LEN = 9 + 12 + 9;
+static constexpr uint16_t AUDIO_DESC_LEN = 8 + 9 + AC_TOTAL_LEN + 9 + 9 + 7 + 11 + 9 + 7;
+
+static UacPacketizer *source_ = nullptr;
+static uint8_t itf_control_ = 0;
+static uint8_t ep_in_ = 0;
+static uint8_t alt_ = 0;
+static bool busy_ = false;
+static uint8_t packet_[2][UacPacketizer::PACKET_BYTES];
+static uint8_t packet_idx_ = 0;
+
+// ---- Descriptor ----
+static uint16_t build_descriptor(uint8_t *d, uint8_t itf, uint8_t ep, uint8_t str)
+{
+  const uint8_t as_itf = (uint8_t)(itf + 1);
+  const uint16_t mps = UacPacketizer::PACKET_BYTES;
+  const uint32_t rate = UacPacketizer::RATE_HZ;
+
+  const uint8_t desc[AUDIO_DESC_LEN] = {
+    // Interface association: control + streaming
+    8, TUSB_DESC_INTERFACE_ASSOCIATION, itf, 2, TUSB_CLASS_AUDIO, 0x00, 0x00, str,
+
+    // Audio control, no endpoints
+    9, TUSB_DESC_INTERFACE, itf, 0, 0, TUSB_CLASS_AUDIO, UAC_SUBCLASS_CONTROL, 0x00, str,
+    9, UAC_CS_INTERFACE, UAC_AC_HEADER, 0x00, 0x01, (uint8_t)AC_TOTAL_LEN, (uint8_t)(AC_TOTAL_LEN >> 8), 1, as_itf,
+    12, UAC_CS_INTERFACE, UAC_AC_INPUT_TERMINAL, TERMINAL_LINE_IN, 0x03, 0x06, 0, 2, 0x03, 0x00, 0, 0,
+    9, UAC_CS_INTERFACE, UAC_AC_OUTPUT_TERMINAL, TERMINAL_USB_OUT, 0x01, 0x01, 0, TERMINAL_LINE_IN, 0,
+
+    // Streaming alt 0: zero bandwidth
+    9, TUSB_DESC_INTERFACE, as_itf, 0, 0, TUSB_CLASS_AUDIO, UAC_SUBCLASS_STREAMING, 0x00, 0,
+
+    // Streaming alt 1: PCM, 2 x 16-bit, one discrete rate
+    9, TUSB_DESC_INTERFACE, as_itf, 1, 1, TUSB_CLASS_AUDIO, UAC_SUBCLASS_STREAMING, 0x00, 0,
+    7, UAC_CS_INTERFACE, UAC_AS_GENERAL, TERMINAL_USB_OUT, 1, 0x01, 0x00,
+    11, UAC_CS_INTERFACE, UAC_AS_FORMAT_TYPE, UAC_FORMAT_TYPE_I, UacPacketizer::CHANNELS, 2, 16, 1,
+    (uint8_t)rate, (uint8_t)(rate >> 8), (uint8_t)(rate >> 16),
+
+    // Isochronous synchronous IN (the ASRC locks to SOF); UAC1 endpoints are
+    // 9 bytes (bRefresh, bSynchAddress)
+    9, TUSB_DESC_ENDPOINT, ep, 0x0D, (uint8_t)mps, (uint8_t)(mps >> 8), 1, 0, 0,
+    7, UAC_CS_ENDPOINT, UAC_EP_GENERAL, 0x00, 0, 0x00, 0x00,
+  };
+
+  memcpy(d, desc, sizeof(desc));
+  return sizeof(desc);
+}
+
+class UsbAudioInterface : public Adafruit_USBD_Interface
+{
+public:
+  uint16_t getInterfaceDescriptor(uint8_t itfnum_deprecated, uint8_t *buf, uint16_t bufsize) override
+  {
+    (void)itfnum_deprecated;
+
+    // A null buffer only asks for the length
+    if (!buf)
+      return AUDIO_DESC_LEN;
+    if (bufsize < AUDIO_DESC_LEN)
+      return 0;
+
+    itf_control_ = TinyUSBDevice.allocInterface(2);
+    ep_in_ = TinyUSBDevice.allocEndpoint(TUSB_DIR_IN);
+    return build_descriptor(buf, itf_control_, ep_in_, _strid);
+  }
+};
+
+static UsbAudioInterface audio_interface;
+
+// ---- Streaming ----
+static void queue_packet(uint8_t rhport)
+{
+  uint8_t *buf = packet_[packet_idx_];
+  packet_idx_ ^= 1;
+  uint16_t len = (uint16_t)source_->next_packet(buf);
+  busy_ = usbd_edpt_xfer(rhport, ep_in_, buf, len);
+}
+
+static void set_alt(uint8_t rhport, uint8_t alt)
+{
+  alt_ = alt;
+
+  // Whatever queued up before is stale; at alt 0 nothing queues
+  source_->set_streaming(alt_ != 0);
+  if (alt_ && !busy_)
+    queue_packet(rhport);
+}
+
+// ---- Class driver ----
+static void audio_init(void)
+{
+  alt_ = 0;
+  busy_ = false;
+  if (source_)
+    source_->set_streaming(false);
+}
+
+static void audio_reset(uint8_t rhport)
+{
+  (void)rhport;
+  audio_init();
+}
+
+static uint16_t audio_open(uint8_t rhport, tusb_desc_interface_t const *itf_desc, uint16_t max_len)
+{
+  if (itf_desc->bInterfaceClass != TUSB_CLASS_AUDIO || itf_desc->bInterfaceSubClass != UAC_SUBCLASS_CONTROL ||
+      itf_desc->bInterfaceNumber != itf_control_)
+    return 0;
+
+  // Claim everything up to the next function: both interfaces, all alt settings
+  uint8_t const *p = (uint8_t const *)itf_desc;
+  uint8_t const *end = p + max_len;
+  uint16_t len = 0;
+  while (p < end)
+  {
+    uint8_t type = tu_desc_type(p);
+    if (type == TUSB_DESC_INTERFACE_ASSOCIATION)
+      break;
+    if (type == TUSB_DESC_INTERFACE)
+    {
+      uint8_t n = ((tusb_desc_interface_t const *)p)->bInterfaceNumber;
+      if (n != itf_control_ && n != itf_control_ + 1)
+        break;
+    }
+    if (type == TUSB_DESC_ENDPOINT)
+      TU_ASSERT(usbd_edpt_open(rhport, (tusb_desc_endpoint_t const *)p), 0);
+
+    len = (uint16_t)(len + tu_desc_len(p));
+    p = tu_desc_next(p);
+  }
+  return len;
+}
+
+static bool audio_control(uint8_t rhport, uint8_t stage, tusb_control_request_t const *req)
+{
+  if (stage != CONTROL_STAGE_SETUP)
+    return true;
+
+  // No class controls are declared; anything else is stalled
+  if (req->bmRequestType_bit.type != TUSB_REQ_TYPE_STANDARD ||
+      req->bmRequestType_bit.recipient != TUSB_REQ_RCPT_INTERFACE)
+    return false;
+
+  static uint8_t alt_reply;
+  uint8_t itf = tu_u16_low(req->wIndex);
+  uint8_t alt = tu_u16_low(req->wValue);
+
+  switch (req->bRequest)
+  {
+  case TUSB_REQ_SET_INTERFACE:
+    if (itf == itf_control_ + 1 && alt <= 1)
+      set_alt(rhport, alt);
+    else if (itf != itf_control_ || alt != 0)
+      return false;
+    return tud_control_status(rhport, req);
+
+  case TUSB_REQ_GET_INTERFACE:
+    alt_reply = (itf == itf_control_ + 1) ? alt_ : 0;
+    return tud_control_xfer(rhport, req, &alt_reply, 1);
+
+  default:
+    return false;
+  }
+}
+
+static bool audio_xfer(uint8_t rhport, uint8_t ep_addr, xfer_result_t result, uint32_t xferred_bytes)
+{
+  (void)result;
+  (void)xferred_bytes;
+
+  if (ep_addr != ep_in_)
+    return false;
+
+  busy_ = false;
+  if (alt_)
+    queue_packet(rhport);
+  return true;
+}
+
+extern "C" usbd_class_driver_t const *usbd_app_driver_get_cb(uint8_t *driver_count)
+{
+  static usbd_class_driver_t driver;
+  driver.init = audio_init;
+  driver.reset = audio_reset;
+  driver.open = audio_open;
+  driver.control_xfer_cb = audio_control;
+  driver.xfer_cb = audio_xfer;
+  driver.sof = nullptr;
+
+  *driver_count = 1;
+  return &driver;
+}
+
+// ---- Public ----
+void usb_audio_begin(UacPacketizer &source)
+{
+  source_ = &source;
+  source.set_streaming(false); // until the host picks alt 1
+
+  if (!TinyUSBDevice.isInitialized())
+    TinyUSBDevice.begin(0);
+
+  audio_interface.setStringDescriptor("PARALAX Audio");
+  TinyUSBDevice.addInterface(audio_interface);
+
+  // Already enumerated with the console only: enumerate again
+  if (TinyUSBDevice.mounted())
+  {
+    TinyUSBDevice.detach();
+    delay(10);
+    TinyUSBDevice.attach();
+  }
+}
+
+bool usb_audio_streaming()
+{
+  return alt_ != 0;
+}
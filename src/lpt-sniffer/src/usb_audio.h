@@ -0,0 +1,28 @@
+/*
+ * PARALAX LPT Sniffer - USB Audio Class 1 capture function
+ * ThisOldCPU Project - https://github.com/thisoldcpu
+ *
+ * Adds "PARALAX Audio" next to the CDC console: one UAC1 streaming
+ * interface, 48 kHz 16-bit stereo on a synchronous isochronous IN
+ * endpoint. Hosts see a plain line-in capture device, no driver needed.
+ *
+ * Packets come from a UacPacketizer, pulled once per USB frame from the
+ * TinyUSB task on core 0; core 1 feeds its Asrc from the decoded DAC
+ * stream, and the Asrc follows the host's SOF clock.
+ *
+ * Needs Adafruit TinyUSB (build flag USE_TINYUSB).
+ *
+ * License : MIT
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#include "uac_packetizer.h"
+
+// Register the audio function; call at the start of setup()
+void usb_audio_begin(UacPacketizer &source);
+
+// Host has selected the streaming alternate setting
+bool usb_audio_streaming();
@@ -0,0 +1,362 @@
+/*
+ * PARALAX - capture analyzer (host)
+ * ThisOldCPU Project - https://github.com/thisoldcpu
+ *
+ * The report of analyze_capture.py (timing, data values, device
+ * identification, recommendations) in one streaming pass, for captures of
+ * any length. Nothing is kept per frame:
+ *
+ *   - mean and standard deviation of the write period by Welford's update
+ *   - median and percentiles from a log-linear histogram of periods: exact
+ *     to 1/256 us below 256 us, within 0.4% above, a fixed 600 KB
+ *   - data values as 256 counters
+ *   - the firmware's DeviceClassifier on the same frames, next to the
+ *     script's rate heuristics
+ *
+ * Timestamps are unwrapped (t_us wraps every 71 minutes) and keep their
+ * PIO .nnn fraction, so periods are exact where the script truncated them.
+ * CSV is read through CsvCaptureReader in 1 MB chunks; a .plx capture
+ * (tools/plx.h) is read chunk by chunk, about six times smaller and with
+ * its times unwrapped already. Throughput goes to stderr.
+ *
+ * Build:
+ *   g++ -std=c++17 -O2 -Iinclude -o analyze_capture tools/analyze_capture.cpp src/device_classifier.cpp
+ *
+ * Usage:
+ *   analyze_capture <capture.csv | capture.plx | ->
+ *
+ * License : MIT
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <chrono>
+#include <vector>
+
+#include "capture_csv.h"
+#include "device_classifier.h"
+#include "plx.h"
+
+// Running mean, variance, min and max (Welford)
+class StreamStats
+{
+public:
+  void add(double x)
+  {
+    n_++;
+    double d = x - mean_;
+    mean_ += d / (double)n_;
+    m2_ += d * (x - mean_);
+    if (n_ == 1 || x < min_)
+      min_ = x;
+    if (n_ == 1 || x > max_)
+      max_ = x;
+  }
+
+  uint64_t count() const { return n_; }
+  double mean() const { return mean_; }
+  double stdev() const { return n_ > 1 ? sqrt(m2_ / (double)(n_ - 1)) : 0.0; } // sample, as statistics.stdev
+  double min() const { return min_; }
+  double max() const { return max_; }
+
+private:
+  uint64_t n_ = 0;
+  double   mean_ = 0.0;
+  double   m2_ = 0.0;
+  double   min_ = 0.0;
+  double   max_ = 0.0;
+};
+
+// Counts of non-negative integers: one bucket per value below 2^EXACT_BITS,
+// then 2^SUB_BITS buckets per power of two
+class QuantileHistogram
+{
+public:
+  static constexpr uint32_t EXACT_BITS = 16;
+  static constexpr uint32_t SUB_BITS = 8;
+
+  QuantileHistogram() : counts_(bucket(~0ull) + 1, 0) {}
+
+  void add(uint64_t v)
+  {
+    counts_[bucket(v)]++;
+    n_++;
+  }
+
+  // Smallest value with at least q of the counts at or below it
+  uint64_t quantile(double q) const
+  {
+    if (!n_)
+      return 0;
+    uint64_t rank = (uint64_t)ceil(q * (double)n_);
+    if (rank < 1)
+      rank = 1;
+    uint64_t seen = 0;
+    for (uint32_t b = 0; b < counts_.size(); ++b)
+    {
+      seen += counts_[b];
+      if (seen >= rank)
+        return middle(b);
+    }
+    return middle((uint32_t)counts_.size() - 1);
+  }
+
+private:
+  static uint32_t bucket(uint64_t v)
+  {
+    if (v < (1ull << EXACT_BITS))
+      return (uint32_t)v;
+    uint32_t msb = 63 - (uint32_t)__builtin_clzll(v);
+    uint32_t sub = (uint32_t)(v >> (msb - SUB_BITS)) & ((1u << SUB_BITS) - 1);
+    return (1u << EXACT_BITS) + ((msb - EXACT_BITS) << SUB_BITS) + sub;
+  }
+
+  static uint64_t middle(uint32_t b)
+  {
+    if (b < (1u << EXACT_BITS))
+      return b;
+    uint32_t i = b - (1u << EXACT_BITS);
+    uint32_t msb = EXACT_BITS + (i >> SUB_BITS);
+    uint64_t lo = (1ull << msb) | ((uint64_t)(i & ((1u << SUB_BITS) - 1)) << (msb - SUB_BITS));
+    return lo + (1ull << (msb - SUB_BITS)) / 2;
+  }
+
+  std::vector<uint64_t> counts_;
+  uint64_t n_ = 0;
+};
+
+struct CaptureReport
+{
+  uint64_t samples = 0;
+  uint64_t first_ticks = 0; // 1/256 us, unwrapped
+  uint64_t last_ticks = 0;
+  StreamStats       period;  // us
+  QuantileHistogram period_ticks;
+  uint64_t values[256] = {};
+  uint64_t first_seen[256] = {}; // sample index, for ordering ties
+  uint64_t value_sum = 0;
+  DeviceGuess verdict = {0, DEV_UNKNOWN, 0, 0}; // the last one
+  uint64_t    verdict_ticks = 0;
+  uint32_t    verdicts = 0;
+};
+
+static double ticks_us(uint64_t ticks)
+{
+  return (double)ticks / 256.0;
+}
+
+static void print_report(const CaptureReport &r)
+{
+  printf("Captured %llu samples\n\n", (unsigned long long)r.samples);
+
+  double avg = r.period.mean();
+  double median = ticks_us(r.period_ticks.quantile(0.5));
+  double stdev = r.period.stdev();
+  double min_delta = r.period.min();
+  double max_delta = r.period.max();
+  double sample_rate = avg > 0 ? 1e6 / avg : 0.0;
+
+  printf("=== Timing Analysis ===\n");
+  printf("Average period: %.1f μs\n", avg);
+  printf("Median period:  %.1f μs\n", median);
+  printf("Std deviation:  %.1f μs\n", stdev);
+  printf("Min period:     %g μs\n", min_delta);
+  printf("Max period:     %g μs\n", max_delta);
+  printf("1%% / 99%%:       %.1f / %.1f μs\n", ticks_us(r.period_ticks.quantile(0.01)),
+         ticks_us(r.period_ticks.quantile(0.99)));
+  printf("Sample rate:    %.0f Hz (%.1f kHz)\n\n", sample_rate, sample_rate / 1000.0);
+
+  uint32_t lo = 255, hi = 0, unique = 0;
+  for (uint32_t v = 0; v < 256; ++v)
+  {
+    if (!r.values[v])
+      continue;
+    unique++;
+    if (v < lo)
+      lo = v;
+    if (v > hi)
+      hi = v;
+  }
+
+  printf("=== Data Analysis ===\n");
+  printf("Min value: 0x%02X (%u)\n", lo, lo);
+  printf("Max value: 0x%02X (%u)\n", hi, hi);
+  printf("Mean value: %.1f\n", (double)r.value_sum / (double)r.samples);
+  printf("Unique values: %u\n", unique);
+
+  // Five most common; ties go to the value seen first, as with Counter
+  printf("Most common values:\n");
+  bool shown[256] = {};
+  for (uint32_t k = 0; k < 5 && k < unique; ++k)
+  {
+    uint32_t best = 256;
+    for (uint32_t v = 0; v < 256; ++v)
+      if (!shown[v] && r.values[v] &&
+          (best == 256 || r.values[v] > r.values[best] ||
+           (r.values[v] == r.values[best] && r.first_seen[v] < r.first_seen[best])))
+        best = v;
+    shown[best] = true;
+    printf("  0x%02X: %llu times (%.1f%%)\n", best, (unsigned long long)r.values[best],
+           r.values[best] * 100.0 / (double)r.samples);
+  }
+  printf("\n");
+
+  printf("=== Device Identification ===\n");
+  if (sample_rate > 20000 && sample_rate < 24000)
+  {
+    printf("✓ COVOX SPEECH THING detected\n");
+    printf("  - Sample rate matches 22 kHz typical Covox output\n");
+    printf("  - Continuous streaming DAC\n");
+  }
+  else if (sample_rate > 6000 && sample_rate < 8000)
+  {
+    printf("✓ DISNEY SOUND SOURCE detected\n");
+    printf("  - Sample rate matches 7 kHz typical DSS output\n");
+    printf("  - FIFO-based DAC\n");
+  }
+  else if (avg > 50 && max_delta > 500)
+  {
+    printf("? Possible OPL2LPT detected\n");
+    printf("  - Irregular timing suggests register writes\n");
+    printf("  - Need paired address/data analysis\n");
+
+    // OPL2 writes come in pairs: address (0x00-0xF5), then data
+    uint64_t addresses = 0;
+    for (uint32_t v = 0; v <= 0xf5; ++v)
+      addresses += r.values[v];
+    if (addresses * 100.0 / (double)r.samples > 50.0)
+      printf("  ✓ OPL2 register write pattern detected\n");
+  }
+  else
+  {
+    printf("? UNKNOWN DEVICE\n");
+    printf("  - Timing doesn't match known patterns\n");
+    printf("  - May need additional analysis\n");
+  }
+  if (r.verdicts)
+    printf("  - Classifier: %s (%u%%) at %.3f s, %u verdict%s\n", lpt_device_name(r.verdict.device),
+           r.verdict.confidence, ticks_us(r.verdict_ticks - r.first_ticks) / 1e6, r.verdicts,
+           r.verdicts == 1 ? "" : "s");
+  else
+    printf("  - Classifier: no verdict\n");
+  printf("\n");
+
+  printf("=== Recommendations ===\n");
+  if (stdev > avg * 0.1)
+  {
+    printf("⚠ High timing variance detected\n");
+    printf("  - Check for system interrupts on DOS machine\n");
+    printf("  - Verify STROBE connection quality\n");
+  }
+  if (unique < 16)
+  {
+    printf("⚠ Low data diversity\n");
+    printf("  - May indicate poor connection on data lines\n");
+    printf("  - Verify D0-D7 wiring\n");
+  }
+  double duration = ticks_us(r.last_ticks - r.first_ticks) / 1e6;
+  printf("✓ Capture duration: %.2f seconds\n", duration);
+  if (duration < 1.0)
+    printf("  - Consider longer capture for better analysis\n");
+}
+
+static bool is_plx(const char *path)
+{
+  size_t n = strlen(path);
+  return n > 4 && strcmp(path + n - 4, ".plx") == 0;
+}
+
+int main(int argc, char **argv)
+{
+  if (argc < 2)
+  {
+    fprintf(stderr, "Usage: analyze_capture <capture.csv | capture.plx | ->\n\n"
+                    "Analyzes PARALAX LPT capture data to identify device type\n");
+    return 1;
+  }
+  const char *in_path = argv[1];
+
+  CsvCaptureReader reader;
+  PlxReader plx;
+  bool binary = is_plx(in_path);
+  if (binary ? !plx.open(in_path) : !reader.open(in_path))
+  {
+    printf("Error: File '%s' not found\n", in_path);
+    return 1;
+  }
+  printf("Reading %s...\n", in_path);
+
+  auto t0 = std::chrono::steady_clock::now();
+  CaptureReport r;
+  DeviceClassifier cls;
+  uint64_t prev = 0;
+  auto add = [&](const CaptureFrame &f, uint64_t ticks) {
+    if (r.samples)
+    {
+      // A capture restarted mid-file steps back; that is no period
+      uint64_t delta = ticks >= prev ? ticks - prev : 0;
+      r.period.add(ticks_us(delta));
+      r.period_ticks.add(delta);
+    }
+    else
+      r.first_ticks = ticks;
+    prev = ticks;
+    r.last_ticks = ticks;
+    if (!r.values[f.data])
+      r.first_seen[f.data] = r.samples;
+    r.samples++;
+    r.values[f.data]++;
+    r.value_sum += f.data;
+
+    DeviceGuess g;
+    if (cls.feed(f, g))
+    {
+      r.verdict = g;
+      r.verdict_ticks = ticks;
+      r.verdicts++;
+    }
+  };
+
+  uint64_t bytes = 0, frames = 0, skipped = 0;
+  if (binary)
+  {
+    // Times come unwrapped already; a corrupt chunk ends the analysis there
+    PlxFrames cols;
+    for (uint32_t i = 0; i < plx.chunks() && plx.read(i, PLX_COLS_ALL, cols); ++i)
+      for (uint32_t k = 0; k < cols.count; ++k)
+        add(cols.frame(k), cols.ticks[k]);
+    bytes = plx.file_bytes();
+    frames = r.samples;
+    if (frames != plx.frames())
+      fprintf(stderr, "Corrupt chunk: %llu of %llu frames read\n", (unsigned long long)frames,
+              (unsigned long long)plx.frames());
+  }
+  else
+  {
+    TimeUnwrapper clock;
+    CaptureFrame f;
+    while (reader.next(f))
+      add(f, (clock.extend(f.t_us) << 8) | f.t_sub);
+    bytes = reader.bytes_read();
+    frames = reader.frames();
+    skipped = reader.skipped_lines();
+  }
+  double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+
+  if (r.samples < 2)
+  {
+    printf("Error: Not enough samples captured\n");
+    return 1;
+  }
+  print_report(r);
+
+  fprintf(stderr, "=== Analyzer ===\n");
+  fprintf(stderr, "Bytes read      : %llu\n", (unsigned long long)bytes);
+  fprintf(stderr, "Frames          : %llu (%llu lines skipped)\n", (unsigned long long)frames,
+          (unsigned long long)skipped);
+  fprintf(stderr, "Throughput      : %.1f MB/s, %.1f M frames/s\n", secs > 0 ? bytes / secs / 1e6 : 0.0,
+          secs > 0 ? frames / secs / 1e6 : 0.0);
+  return 0;
+}
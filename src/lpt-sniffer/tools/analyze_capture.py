@@ -25,7 +25,7 @@ def analyze_capture(filename):
                     continue
                 
                 try:
-                    timestamp = int(row[0])
+                    timestamp = int(row[0].split(".")[0])  # PIO profile: t_us.nnn
                     data = int(row[1], 16)
                     samples.append((timestamp, data))
                 except (ValueError, IndexError):
@@ -0,0 +1,182 @@
+/*
+ * PARALAX - ASRC clock-drift simulation (host)
+ * ThisOldCPU Project - https://github.com/thisoldcpu
+ *
+ * Drives Asrc the way the firmware does: a producer on one clock pushes a
+ * 48 kHz sine in bursts (core 1 working through its queue), a sink on
+ * another clock pulls one 48-frame packet per millisecond (the USB
+ * endpoint). The producer clock is off by a given ppm and can wander
+ * (-r, ppm per minute, reversing every ten minutes like a warming case).
+ *
+ * Each run simulates the given duration and fails on any underrun,
+ * overrun or skipped frame, on latency leaving TARGET +- 2 ms once the loop has settled,
+ * or (for a fixed drift) on the loop's clock estimate ending more than
+ * 5 ppm off.
+ * Without -p a sweep from -500 to +500 ppm is run. Exit status is non-zero
+ * if any run failed.
+ *
+ * Build:
+ *   g++ -std=c++17 -O2 -Iinclude -o asrc_drift tools/asrc_drift.cpp src/asrc.cpp
+ *
+ * Usage:
+ *   asrc_drift [-p ppm] [-r ppm_per_min] [-m minutes] [-j jitter_us]
+ *     one row per run on stdout:
+ *     ppm,ramp,underruns,overruns,skipped,lat_min_ms,lat_max_ms,clock_ppm,result
+ *
+ * License : MIT
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <vector>
+
+#include "asrc.h"
+
+static constexpr uint32_t RATE_HZ = 48000;
+static constexpr uint32_t PACKET_FRAMES = RATE_HZ / 1000;
+static constexpr uint32_t SETTLE_S = 60;
+static constexpr uint32_t BURST_US = 1000;
+static constexpr double PI = 3.14159265358979323846;
+
+struct RunResult
+{
+  uint32_t underruns;
+  uint32_t overruns;
+  uint32_t skipped;
+  double   lat_min_ms;
+  double   lat_max_ms;
+  int32_t  clock_ppm;
+  bool     pass;
+};
+
+static RunResult run(double ppm, double ramp_ppm_min, uint32_t minutes, uint32_t jitter_us)
+{
+  static Asrc asrc; // large FIFO, keep it off the stack
+  asrc.reset();
+
+  const uint64_t total_us = (uint64_t)minutes * 60 * 1000000;
+  const double frames_per_ms = RATE_HZ / 1000.0;
+  int16_t packet[PACKET_FRAMES * Asrc::CHANNELS];
+
+  double src_pos = 0.0;   // producer frames owed, fractional
+  double src_phase = 0.0; // sine phase
+  uint64_t next_burst_us = BURST_US;
+  uint32_t lat_min = UINT32_MAX;
+  uint32_t lat_max = 0;
+  srand(1);
+
+  for (uint64_t t_us = 0; t_us < total_us; t_us += 1000)
+  {
+    // Producer clock: drift, optionally wandering back and forth
+    double minute = (double)t_us / 60e6;
+    double drift = ppm;
+    if (ramp_ppm_min != 0.0)
+    {
+      double cycle = fmod(minute, 20.0);
+      drift += ramp_ppm_min * (cycle < 10.0 ? cycle : 20.0 - cycle);
+    }
+
+    // The producer works in bursts, late by up to jitter_us
+    src_pos += frames_per_ms * (1.0 + drift * 1e-6);
+    if (t_us + 1000 >= next_burst_us)
+    {
+      uint32_t n = (uint32_t)src_pos;
+      src_pos -= n;
+      for (uint32_t i = 0; i < n; ++i)
+      {
+        int16_t v = (int16_t)(16000.0 * sin(src_phase));
+        src_phase += 2.0 * PI * 1000.0 / RATE_HZ;
+        if (src_phase > 2.0 * PI)
+          src_phase -= 2.0 * PI;
+        asrc.on_sample(v, (int16_t)-v);
+      }
+      next_burst_us += BURST_US + (jitter_us ? (uint32_t)(rand() % (jitter_us + 1)) : 0);
+    }
+
+    // Sink clock: one packet per ms
+    asrc.pull(packet, PACKET_FRAMES);
+
+    if (t_us >= (uint64_t)SETTLE_S * 1000000)
+    {
+      uint32_t lat = asrc.fill();
+      if (lat < lat_min)
+        lat_min = lat;
+      if (lat > lat_max)
+        lat_max = lat;
+    }
+  }
+
+  RunResult r;
+  r.underruns = asrc.underruns();
+  r.overruns = asrc.overruns();
+  r.skipped = asrc.skipped_frames();
+  r.lat_min_ms = lat_min == UINT32_MAX ? 0.0 : lat_min / frames_per_ms;
+  r.lat_max_ms = lat_max / frames_per_ms;
+  r.clock_ppm = asrc.clock_ppm();
+
+  const double target_ms = Asrc::TARGET_FRAMES / frames_per_ms;
+  r.pass = r.underruns == 0 && r.overruns == 0 && r.skipped == 0 && r.lat_min_ms >= target_ms - 2.0 &&
+           r.lat_max_ms <= target_ms + 2.0;
+  if (ramp_ppm_min == 0.0 && fabs(r.clock_ppm - ppm) > 5.0)
+    r.pass = false;
+  return r;
+}
+
+int main(int argc, char **argv)
+{
+  bool single = false;
+  double ppm = 0.0;
+  double ramp = 0.0;
+  uint32_t minutes = 120;
+  uint32_t jitter_us = 500;
+
+  for (int i = 1; i < argc; ++i)
+  {
+    if (!strcmp(argv[i], "-p") && i + 1 < argc)
+    {
+      ppm = atof(argv[++i]);
+      single = true;
+    }
+    else if (!strcmp(argv[i], "-r") && i + 1 < argc)
+      ramp = atof(argv[++i]);
+    else if (!strcmp(argv[i], "-m") && i + 1 < argc)
+      minutes = (uint32_t)atoi(argv[++i]);
+    else if (!strcmp(argv[i], "-j") && i + 1 < argc)
+      jitter_us = (uint32_t)atoi(argv[++i]);
+    else
+    {
+      fprintf(stderr, "Usage: asrc_drift [-p ppm] [-r ppm_per_min] [-m minutes] [-j jitter_us]\n");
+      return 1;
+    }
+  }
+  if (minutes * 60 <= SETTLE_S)
+  {
+    fprintf(stderr, "Error: run must be longer than the %u s settling time\n", SETTLE_S);
+    return 1;
+  }
+
+  std::vector<double> drifts;
+  if (single)
+    drifts.push_back(ppm);
+  else
+    drifts = {-500, -200, -50, 0, 50, 200, 500};
+
+  uint32_t failed = 0;
+  for (double d : drifts)
+  {
+    RunResult r = run(d, ramp, minutes, jitter_us);
+    printf("%.1f,%.2f,%u,%u,%u,%.2f,%.2f,%d,%s\n", d, ramp, r.underruns, r.overruns, r.skipped, r.lat_min_ms,
+           r.lat_max_ms, r.clock_ppm, r.pass ? "PASS" : "FAIL");
+    fflush(stdout);
+    failed += r.pass ? 0 : 1;
+  }
+
+  fprintf(stderr, "=== ASRC Drift ===\n");
+  fprintf(stderr, "Duration        : %u min per run (%u s settling)\n", minutes, SETTLE_S);
+  fprintf(stderr, "Target latency  : %.2f ms\n", Asrc::TARGET_FRAMES * 1000.0 / RATE_HZ);
+  fprintf(stderr, "Runs            : %zu (%u failed)\n", drifts.size(), failed);
+  return failed ? 1 : 0;
+}
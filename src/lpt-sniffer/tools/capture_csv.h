@@ -0,0 +1,230 @@
+/*
+ * PARALAX - streaming reader for sniffer CSV captures (host only)
+ * ThisOldCPU Project - https://github.com/thisoldcpu
+ *
+ * Reads t_us,data_hex,strobe,ack,busy,autofeed,init,selectin,paper_out,select,error
+ * (and the compact t_us,data_hex form) in large buffered chunks. t_us may
+ * carry a .nnn nanosecond fraction (PIO capture profile).
+ * Comments, the banner and statistics blocks are skipped: any line that does
+ * not start with a digit is not a frame.
+ *
+ * Constant memory regardless of capture length.
+ *
+ * License : MIT
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "capture_frame.h"
+
+// A .nnn fraction back to 1/256 us, rounded. The firmware prints
+// (t_sub * 1000) >> 8, which truncating here would turn back into one
+// less (t_sub 1 prints as .003).
+static inline uint8_t csv_ns_to_t_sub(uint32_t ns)
+{
+  uint32_t sub = (ns * 256u + 500u) / 1000u;
+  return (uint8_t)(sub > 255u ? 255u : sub);
+}
+
+class CsvCaptureReader
+{
+public:
+  CsvCaptureReader() : buf_(new char[BUF_SIZE]) {}
+  CsvCaptureReader(const CsvCaptureReader &) = delete;
+  CsvCaptureReader &operator=(const CsvCaptureReader &) = delete;
+  ~CsvCaptureReader()
+  {
+    close();
+    delete[] buf_;
+  }
+
+  bool open(const char *path)
+  {
+    close();
+    fp_ = (path[0] == '-' && path[1] == 0) ? stdin : fopen(path, "rb");
+    len_ = pos_ = 0;
+    eof_ = false;
+    bytes_read_ = 0;
+    frames_ = 0;
+    skipped_ = 0;
+    return fp_ != nullptr;
+  }
+
+  void close()
+  {
+    if (fp_ && fp_ != stdin)
+      fclose(fp_);
+    fp_ = nullptr;
+  }
+
+  // Next frame, or false at end of file.
+  bool next(CaptureFrame &out)
+  {
+    const char *line;
+    size_t n;
+    while (next_line(line, n))
+    {
+      if (parse_line(line, n, out))
+      {
+        frames_++;
+        return true;
+      }
+      skipped_++;
+    }
+    return false;
+  }
+
+  uint64_t bytes_read() const { return bytes_read_; }
+  uint64_t frames() const { return frames_; }
+  uint64_t skipped_lines() const { return skipped_; }
+
+  // Parse one line (no newline). Exposed for tools that do their own I/O.
+  static bool parse_line(const char *p, size_t n, CaptureFrame &out)
+  {
+    const char *end = p + n;
+    if (p == end || (unsigned)(*p - '0') > 9)
+      return false;
+
+    uint32_t t = 0;
+    while (p < end && (unsigned)(*p - '0') <= 9)
+      t = t * 10u + (uint32_t)(*p++ - '0');
+
+    // PIO-capture profiles print t_us.nnn (nanoseconds)
+    uint32_t ns = 0;
+    if (p < end && *p == '.')
+    {
+      ++p;
+      uint32_t scale = 100;
+      while (p < end && (unsigned)(*p - '0') <= 9)
+      {
+        ns += (uint32_t)(*p++ - '0') * scale;
+        scale /= 10;
+      }
+    }
+    if (p == end || *p++ != ',')
+      return false;
+
+    int hi = hex_nibble(p < end ? *p : 0);
+    int lo = hex_nibble(p + 1 < end ? p[1] : 0);
+    if (hi < 0)
+      return false;
+    uint8_t data;
+    if (lo < 0)
+    {
+      // Single-digit hex (not produced by the firmware, but cheap to accept)
+      data = (uint8_t)hi;
+      p += 1;
+    }
+    else
+    {
+      data = (uint8_t)((hi << 4) | lo);
+      p += 2;
+    }
+
+    uint16_t bits = 0;
+    uint8_t idx = 0;
+    while (p < end && idx < 9)
+    {
+      if (*p == ',')
+      {
+        ++p;
+        continue;
+      }
+      if (*p == '0' || *p == '1')
+      {
+        bits |= (uint16_t)(*p - '0') << idx;
+        ++idx;
+        ++p;
+        continue;
+      }
+      if (*p == '\r' || *p == ' ')
+        break;
+      return false;
+    }
+
+    out.t_us = t;
+    out.t_sub = csv_ns_to_t_sub(ns);
+    out.data = data;
+    // Compact captures carry no control lines: report them idle
+    out.bits = (idx == 0) ? FRAME_BITS_IDLE : bits;
+    return true;
+  }
+
+private:
+  static constexpr size_t BUF_SIZE = 1u << 20;
+
+  static int hex_nibble(char c)
+  {
+    if (c >= '0' && c <= '9')
+      return c - '0';
+    if (c >= 'A' && c <= 'F')
+      return c - 'A' + 10;
+    if (c >= 'a' && c <= 'f')
+      return c - 'a' + 10;
+    return -1;
+  }
+
+  bool fill()
+  {
+    if (eof_ || !fp_)
+      return false;
+    // Keep the unfinished tail line at the front of the buffer
+    size_t keep = len_ - pos_;
+    if (keep && pos_)
+      memmove(buf_, buf_ + pos_, keep);
+    len_ = keep;
+    pos_ = 0;
+    size_t got = fread(buf_ + len_, 1, BUF_SIZE - len_, fp_);
+    bytes_read_ += got;
+    len_ += got;
+    if (got == 0)
+      eof_ = true;
+    return got != 0;
+  }
+
+  bool next_line(const char *&line, size_t &n)
+  {
+    for (;;)
+    {
+      const char *start = buf_ + pos_;
+      const char *nl = (const char *)memchr(start, '\n', len_ - pos_);
+      if (nl)
+      {
+        line = start;
+        n = (size_t)(nl - start);
+        pos_ += n + 1;
+        return true;
+      }
+      if (len_ - pos_ == BUF_SIZE)
+      {
+        // Pathological line longer than the buffer: drop it
+        pos_ = len_;
+      }
+      if (!fill())
+      {
+        if (pos_ < len_)
+        {
+          line = buf_ + pos_;
+          n = len_ - pos_;
+          pos_ = len_;
+          return true;
+        }
+        return false;
+      }
+    }
+  }
+
+  FILE *fp_ = nullptr;
+  char *buf_;
+  size_t len_ = 0;
+  size_t pos_ = 0;
+  bool eof_ = false;
+
+  uint64_t bytes_read_ = 0;
+  uint64_t frames_ = 0;
+  uint64_t skipped_ = 0;
+};
@@ -0,0 +1,909 @@
+/*
+ * PARALAX - capture ingest daemon with segment rotation (host)
+ * ThisOldCPU Project - https://github.com/thisoldcpu
+ *
+ * Records the sniffer's serial stream to disk for hours, in place of
+ * "pio device monitor > capture.csv" or "screen -L": those stall with the
+ * terminal, process every line and grow one file without bound.
+ *
+ * A reader thread owns the device. It puts a tty into raw mode and reads
+ * straight into a fixed ring of large blocks (-m MB in BLOCK_BYTES
+ * blocks), handing a block to the writer once it is full or PUBLISH_MS
+ * after its first byte. It never waits for the writer: with every block
+ * still queued it keeps reading into a scratch block and counts the bytes
+ * as lost, so the device is never back-pressured. The writer puts each
+ * block into the current segment with pwrite() from where it was read,
+ * with no copy and no per-line work beyond counting newlines.
+ *
+ * Segments are preallocated (posix_fallocate) to -s MB and rotated at the
+ * first line end past that size, or after -r seconds, so every segment is
+ * a complete CSV on its own. Each starts with a "# ingest: segment N"
+ * comment. A segment is written as NAME.csv.part; sealing truncates it to
+ * its length, fsyncs it, renames it to NAME.csv and fsyncs the directory.
+ * After a crash the .part holds what was written, followed by zeros (not a
+ * frame to any parser). -k keeps only the newest N sealed segments.
+ *
+ * Bytes lost to a full ring cost the partial line before them and the
+ * partial line after them; the writer steps back to the last line end and
+ * notes "# ingest: N bytes lost" in their place. Memory is the ring, one
+ * scratch block and the -k list of names, however long the session. Every
+ * -i seconds, and at the end, the ingest rate goes to stderr.
+ *
+ * Plain read() on a dedicated thread rather than io_uring: the tty layer
+ * returns at most what it has buffered per call, so a submission queue
+ * would save little, and this needs no liburing.
+ *
+ * -t needs no device: it feeds the daemon through a pipe and checks that
+ * the stream comes out byte-exact across size- and time-rotated segments,
+ * that a stalled writer loses whole lines only, notes every loss (one
+ * still pending when the input ends too) and never blocks the reader, and
+ * that the resident set stays flat over 256 MB.
+ *
+ * Build:
+ *   g++ -std=c++17 -O2 -pthread -Itools -o capture_ingest tools/capture_ingest.cpp
+ *
+ * Usage:
+ *   capture_ingest <tty | -> [-o prefix] [-s segment_mb] [-r segment_s] [-k keep]
+ *                  [-m ring_mb] [-i report_s]
+ *   capture_ingest -t
+ *
+ * License : MIT
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "selftest.h"
+
+static constexpr uint32_t BLOCK_BYTES = 256 * 1024;
+static constexpr uint32_t RING_MB = 16;      // default -m
+static constexpr uint32_t SEGMENT_MB = 256;  // default -s
+static constexpr uint32_t PUBLISH_MS = 50;   // a partly filled block goes to the writer after this
+static constexpr uint32_t REPORT_S = 10;     // default -i
+
+static std::atomic<bool> stop{false};
+
+static uint64_t host_us()
+{
+  return (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+// Block numbers between the two threads; one pushes, the other pops
+class IndexRing
+{
+public:
+  explicit IndexRing(uint32_t capacity)
+  {
+    uint32_t n = 2;
+    while (n < capacity + 1)
+      n <<= 1;
+    slots_.resize(n);
+    mask_ = n - 1;
+  }
+
+  bool push(uint32_t v)
+  {
+    uint32_t w = w_.load(std::memory_order_relaxed);
+    uint32_t next = (w + 1) & mask_;
+    if (next == r_.load(std::memory_order_acquire))
+      return false;
+    slots_[w] = v;
+    w_.store(next, std::memory_order_release);
+    return true;
+  }
+
+  bool pop(uint32_t &out)
+  {
+    uint32_t r = r_.load(std::memory_order_relaxed);
+    if (r == w_.load(std::memory_order_acquire))
+      return false;
+    out = slots_[r];
+    r_.store((r + 1) & mask_, std::memory_order_release);
+    return true;
+  }
+
+  uint32_t size() const
+  {
+    return (w_.load(std::memory_order_acquire) - r_.load(std::memory_order_acquire)) & mask_;
+  }
+
+private:
+  std::vector<uint32_t> slots_;
+  uint32_t              mask_;
+  std::atomic<uint32_t> w_{0};
+  std::atomic<uint32_t> r_{0};
+};
+
+struct IngestConfig
+{
+  std::string prefix = "capture";
+  uint64_t segment_bytes = (uint64_t)SEGMENT_MB << 20;
+  uint64_t segment_us = 0; // 0: rotate on size only
+  uint32_t keep = 0;       // sealed segments kept, 0 for all
+  uint32_t block_bytes = BLOCK_BYTES;
+  uint32_t blocks = (RING_MB << 20) / BLOCK_BYTES;
+  uint32_t report_s = REPORT_S;
+  std::atomic<bool> *hold = nullptr; // self-test: the writer takes no block while set
+};
+
+class Ingest
+{
+public:
+  explicit Ingest(const IngestConfig &cfg)
+    : cfg_(cfg), ring_(new char[(size_t)cfg.blocks * cfg.block_bytes]), scratch_(new char[cfg.block_bytes]),
+      len_(cfg.blocks), lost_before_(cfg.blocks), free_(cfg.blocks), full_(cfg.blocks)
+  {
+    for (uint32_t b = 0; b < cfg.blocks; ++b)
+      free_.push(b);
+  }
+
+  // Reads fd until end of input or stop; returns false on a write error
+  bool run(int fd)
+  {
+    t0_us_ = host_us();
+    reader_done_ = false;
+    std::thread writer(&Ingest::write_loop, this);
+    read_loop(fd);
+    reader_done_ = true;
+    writer.join();
+    return !failed_;
+  }
+
+  uint64_t bytes_in() const { return bytes_in_; }
+  uint64_t bytes_lost() const { return bytes_lost_; }
+  uint64_t bytes_written() const { return bytes_written_; }
+  uint64_t lines() const { return lines_; }
+  uint32_t segments() const { return segment_; }
+  uint32_t ring_max() const { return ring_max_; }
+  uint64_t run_us() const { return end_us_ - t0_us_; }
+  const std::deque<std::string> &sealed() const { return sealed_; } // the -k newest
+  const std::string &last_sealed() const { return last_sealed_; }
+
+private:
+  char *block(uint32_t b) { return ring_.get() + (size_t)b * cfg_.block_bytes; }
+
+  // ---- Reader thread (the caller's) ----
+  void read_loop(int fd)
+  {
+    bool have = false;
+    uint32_t cur = 0;
+    uint32_t fill = 0;
+    uint64_t first_us = 0;
+    uint64_t lost = 0;
+
+    while (!stop)
+    {
+      if (!have)
+      {
+        have = free_.pop(cur);
+        fill = 0;
+      }
+
+      int timeout = PUBLISH_MS;
+      if (have && fill)
+      {
+        uint64_t age = host_us() - first_us;
+        timeout = age >= PUBLISH_MS * 1000ull ? 0 : (int)(PUBLISH_MS - age / 1000);
+      }
+      struct pollfd p = {fd, POLLIN, 0};
+      int ready = poll(&p, 1, timeout);
+      if (ready < 0 && errno != EINTR)
+        break;
+
+      if (ready > 0)
+      {
+        char *dst = have ? block(cur) + fill : scratch_.get();
+        size_t room = have ? cfg_.block_bytes - fill : cfg_.block_bytes;
+        ssize_t n = read(fd, dst, room);
+        if (n == 0 || (n < 0 && errno != EINTR && errno != EAGAIN))
+          break;
+        if (n > 0)
+        {
+          bytes_in_ += (uint64_t)n;
+          if (!have)
+          {
+            lost += (uint64_t)n;
+            bytes_lost_ += (uint64_t)n;
+          }
+          else
+          {
+            if (!fill)
+              first_us = host_us();
+            fill += (uint32_t)n;
+          }
+        }
+      }
+
+      if (have && fill && (fill == cfg_.block_bytes || host_us() - first_us >= PUBLISH_MS * 1000ull))
+      {
+        publish(cur, fill, lost);
+        have = false;
+      }
+    }
+
+    // Input ended while dropping: the loss still needs its note, so wait for
+    // the writer to free a block and hand it over empty
+    while (!have && lost && !failed_)
+    {
+      have = free_.pop(cur);
+      fill = 0;
+      if (!have)
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    if (have && (fill || lost))
+      publish(cur, fill, lost);
+    else if (have)
+      free_.push(cur);
+  }
+
+  void publish(uint32_t b, uint32_t len, uint64_t &lost)
+  {
+    len_[b] = len;
+    lost_before_[b] = lost;
+    lost = 0;
+    full_.push(b); // every block fits, so this cannot fail
+    uint32_t queued = full_.size();
+    if (queued > ring_max_)
+      ring_max_ = queued;
+  }
+
+  // ---- Writer thread ----
+  void write_loop()
+  {
+    next_report_us_ = host_us() + cfg_.report_s * 1000000ull;
+    for (;;)
+    {
+      if (cfg_.hold && *cfg_.hold)
+      {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        continue;
+      }
+      uint32_t b = 0;
+      if (!full_.pop(b))
+      {
+        if (reader_done_ && !full_.pop(b))
+          break;
+        if (!reader_done_)
+        {
+          idle();
+          std::this_thread::sleep_for(std::chrono::milliseconds(2));
+          continue;
+        }
+      }
+      write_block(b);
+      free_.push(b);
+      if (cfg_.report_s && host_us() >= next_report_us_)
+        report();
+    }
+    if (fd_ >= 0)
+      seal();
+    end_us_ = host_us();
+  }
+
+  void write_block(uint32_t b)
+  {
+    const char *p = block(b);
+    uint32_t len = len_[b];
+    uint32_t start = 0;
+
+    if (lost_before_[b])
+    {
+      // The line cut by the gap goes too: overwrite it with the note
+      if (fd_ >= 0)
+        off_ = line_end_;
+      char note[64];
+      int n = snprintf(note, sizeof(note), "# ingest: %llu bytes lost\n", (unsigned long long)lost_before_[b]);
+      if (fd_ < 0)
+        open_segment();
+      put(note, (uint32_t)n);
+      skip_partial_ = true;
+    }
+    if (skip_partial_)
+    {
+      const char *nl = (const char *)memchr(p, '\n', len);
+      if (!nl)
+        return;
+      start = (uint32_t)(nl - p) + 1;
+      skip_partial_ = false;
+    }
+
+    while (start < len && !failed_)
+    {
+      if (fd_ < 0)
+        open_segment();
+      if (rotation_due())
+      {
+        // Split at the first line end; without one, rotation waits
+        const char *nl = (const char *)memchr(p + start, '\n', len - start);
+        if (nl)
+        {
+          uint32_t n = (uint32_t)(nl - (p + start)) + 1;
+          put(p + start, n);
+          start += n;
+          seal();
+          continue;
+        }
+      }
+      put(p + start, len - start);
+      start = len;
+    }
+  }
+
+  // Time rotation with no traffic, once the segment ends on a line
+  void idle()
+  {
+    if (fd_ >= 0 && off_ == line_end_ && rotation_due())
+      seal();
+    if (cfg_.report_s && host_us() >= next_report_us_)
+      report();
+  }
+
+  bool rotation_due() const
+  {
+    return off_ >= cfg_.segment_bytes || (cfg_.segment_us && host_us() - segment_t0_us_ >= cfg_.segment_us);
+  }
+
+  void put(const char *p, uint32_t n)
+  {
+    uint64_t at = off_;
+    for (uint32_t done = 0; done < n;)
+    {
+      ssize_t w = pwrite(fd_, p + done, n - done, (off_t)(at + done));
+      if (w < 0 && errno == EINTR)
+        continue;
+      if (w <= 0)
+      {
+        fprintf(stderr, "Error: writing '%s': %s\n", part_.c_str(), strerror(errno));
+        failed_ = true;
+        stop = true;
+        return;
+      }
+      done += (uint32_t)w;
+    }
+    off_ = at + n;
+    bytes_written_ += n;
+
+    const char *last = nullptr;
+    for (const char *q = p, *end = p + n; (q = (const char *)memchr(q, '\n', end - q)); ++q)
+    {
+      lines_++;
+      last = q;
+    }
+    if (last)
+      line_end_ = at + (uint64_t)(last - p) + 1;
+  }
+
+  void open_segment()
+  {
+    time_t now = time(nullptr);
+    struct tm tm;
+    localtime_r(&now, &tm);
+    char stamp[32];
+    strftime(stamp, sizeof(stamp), "%Y%m%d-%H%M%S", &tm);
+    char name[64];
+    snprintf(name, sizeof(name), "-%s-%04u.csv", stamp, segment_);
+    path_ = cfg_.prefix + name;
+    part_ = path_ + ".part";
+
+    fd_ = open(part_.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd_ < 0)
+    {
+      fprintf(stderr, "Error: cannot write '%s': %s\n", part_.c_str(), strerror(errno));
+      failed_ = true;
+      stop = true;
+      return;
+    }
+    // Room for the last block past the size; unsupported filesystems just grow the file
+    posix_fallocate(fd_, 0, (off_t)(cfg_.segment_bytes + cfg_.block_bytes));
+    off_ = 0;
+    line_end_ = 0;
+    segment_t0_us_ = host_us();
+
+    char head[96];
+    strftime(stamp, sizeof(stamp), "%Y-%m-%d %H:%M:%S", &tm);
+    int n = snprintf(head, sizeof(head), "# ingest: segment %u, %s\n", segment_, stamp);
+    put(head, (uint32_t)n);
+    segment_++;
+  }
+
+  void seal()
+  {
+    if (ftruncate(fd_, (off_t)off_) < 0 || fsync(fd_) < 0)
+      fprintf(stderr, "Error: sealing '%s': %s\n", part_.c_str(), strerror(errno));
+    close(fd_);
+    fd_ = -1;
+    if (rename(part_.c_str(), path_.c_str()) < 0)
+    {
+      fprintf(stderr, "Error: cannot rename '%s': %s\n", part_.c_str(), strerror(errno));
+      return;
+    }
+
+    // The rename is only durable once the directory is
+    size_t slash = path_.rfind('/');
+    std::string dir = slash == std::string::npos ? "." : path_.substr(0, slash ? slash : 1);
+    int dfd = open(dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dfd >= 0)
+    {
+      fsync(dfd);
+      close(dfd);
+    }
+
+    // Only -k needs the names; keeping all of them would grow all session
+    last_sealed_ = path_;
+    if (cfg_.keep)
+      sealed_.push_back(path_);
+    while (cfg_.keep && sealed_.size() > cfg_.keep)
+    {
+      unlink(sealed_.front().c_str());
+      sealed_.pop_front();
+    }
+  }
+
+  void report()
+  {
+    uint64_t now = host_us();
+    double secs = (now - last_report_us_) / 1e6;
+    if (!last_report_us_)
+      secs = (now - t0_us_) / 1e6;
+    uint64_t in = bytes_in_;
+    fprintf(stderr, "# ingest: %.2f MB/s, %.0f lines/s, ring %u%% (max %u%%), %llu bytes lost, segment %u at %.1f MB\n",
+            (in - last_in_) / secs / 1e6, (lines_ - last_lines_) / secs, full_.size() * 100 / cfg_.blocks,
+            ring_max_.load() * 100 / cfg_.blocks, (unsigned long long)bytes_lost_.load(),
+            segment_ ? segment_ - 1 : 0, off_ / 1e6);
+    last_in_ = in;
+    last_lines_ = lines_;
+    last_report_us_ = now;
+    next_report_us_ = now + cfg_.report_s * 1000000ull;
+  }
+
+  IngestConfig cfg_;
+
+  std::unique_ptr<char[]> ring_;
+  std::unique_ptr<char[]> scratch_;
+  std::vector<uint32_t> len_;         // bytes in each published block
+  std::vector<uint64_t> lost_before_; // bytes lost just before it
+  IndexRing free_;                    // writer -> reader
+  IndexRing full_;                    // reader -> writer
+
+  std::atomic<bool>     reader_done_{false};
+  std::atomic<bool>     failed_{false};
+  std::atomic<uint64_t> bytes_in_{0};
+  std::atomic<uint64_t> bytes_lost_{0};
+  std::atomic<uint32_t> ring_max_{0};
+
+  // Writer only
+  int         fd_ = -1;
+  std::string path_;
+  std::string part_;
+  uint64_t    off_ = 0;       // segment length so far
+  uint64_t    line_end_ = 0;  // just past its last newline
+  uint64_t    segment_t0_us_ = 0;
+  uint32_t    segment_ = 0;   // segments opened
+  bool        skip_partial_ = false;
+  uint64_t    bytes_written_ = 0;
+  uint64_t    lines_ = 0;
+  std::deque<std::string> sealed_;
+  std::string             last_sealed_;
+
+  uint64_t t0_us_ = 0;
+  uint64_t end_us_ = 0;
+  uint64_t next_report_us_ = 0;
+  uint64_t last_report_us_ = 0;
+  uint64_t last_in_ = 0;
+  uint64_t last_lines_ = 0;
+};
+
+static int open_input(const char *path)
+{
+  int fd = strcmp(path, "-") ? open(path, O_RDONLY | O_NOCTTY | O_CLOEXEC) : 0;
+  if (fd < 0)
+    return -1;
+  struct termios tio;
+  if (isatty(fd) && tcgetattr(fd, &tio) == 0)
+  {
+    cfmakeraw(&tio);
+    tcsetattr(fd, TCSANOW, &tio);
+  }
+  return fd;
+}
+
+// ---- Self-test ----
+
+// Frame k of the synthetic stream, a comment every 1000th
+static uint32_t make_line(uint64_t k, char *out)
+{
+  if (k % 1000 == 999)
+    return (uint32_t)sprintf(out, "# device: Covox (%u%%)\n", (uint32_t)(k / 1000 % 100));
+  uint64_t t = k * 23;
+  return (uint32_t)sprintf(out, "%llu,%02X,1,%u,1,1,1,1,0,1,1\n", (unsigned long long)t, (uint32_t)(t * 7 & 0xff),
+                           (uint32_t)(k & 1));
+}
+
+static uint64_t fnv1a(uint64_t h, const char *p, size_t n)
+{
+  for (size_t i = 0; i < n; ++i)
+    h = (h ^ (uint8_t)p[i]) * 1099511628211ull;
+  return h;
+}
+
+static constexpr uint64_t FNV_SEED = 1469598103934665603ull;
+
+struct Produced
+{
+  uint64_t bytes = 0;
+  uint64_t hash = FNV_SEED;
+  uint64_t lines = 0;
+};
+
+// Writes the stream into fd in uneven bursts, a stretch at a time
+class Producer
+{
+public:
+  explicit Producer(int fd) : fd_(fd) {}
+
+  // Another `bytes` of the stream, pausing pause_us between bursts
+  bool write_more(uint64_t bytes, uint32_t max_burst, uint32_t pause_us)
+  {
+    std::vector<char> buf(max_burst + 64);
+    uint64_t end = p_.bytes + bytes;
+    while (p_.bytes < end)
+    {
+      // Bursts of 1 to max_burst bytes, whole lines
+      uint32_t want = 1 + (burst_++ * 2654435761u >> 8) % max_burst;
+      uint32_t fill = 0;
+      while (fill < want)
+      {
+        fill += make_line(k_++, buf.data() + fill);
+        p_.lines++;
+      }
+      p_.hash = fnv1a(p_.hash, buf.data(), fill);
+      for (uint32_t done = 0; done < fill;)
+      {
+        ssize_t n = write(fd_, buf.data() + done, fill - done);
+        if (n <= 0)
+          return false;
+        done += (uint32_t)n;
+      }
+      p_.bytes += fill;
+      if (pause_us)
+        std::this_thread::sleep_for(std::chrono::microseconds(pause_us));
+    }
+    return true;
+  }
+
+  void close_fd() { close(fd_); }
+
+  const Produced &produced() const { return p_; }
+
+private:
+  int      fd_;
+  uint64_t k_ = 0;
+  uint32_t burst_ = 0;
+  Produced p_;
+};
+
+static Produced produce(int fd, uint64_t bytes, uint32_t max_burst, uint32_t pause_us)
+{
+  Producer prod(fd);
+  prod.write_more(bytes, max_burst, pause_us);
+  prod.close_fd();
+  return prod.produced();
+}
+
+static constexpr uint32_t LINE_SLACK = 256; // a segment ends within a line of its size plus a block
+
+struct Readback
+{
+  uint64_t hash = FNV_SEED;
+  uint64_t lines = 0;
+  uint64_t notes = 0;      // "# ingest: N bytes lost"
+  uint64_t noted = 0;      // the N of all of them
+  bool     note_last = false; // the last segment ends on one
+  uint64_t bad_lines = 0;  // not a line of the stream, or out of order
+  bool     segments_ok = true;
+};
+
+// The sealed segments in order, without their "# ingest:" lines
+static Readback read_back(const Ingest &in, uint64_t max_bytes)
+{
+  Readback r;
+  char expect[64];
+  uint64_t next_k = 0;
+  std::string line;
+  for (const std::string &path : in.sealed())
+  {
+    FILE *fp = fopen(path.c_str(), "rb");
+    struct stat st;
+    if (!fp || stat(path.c_str(), &st) != 0 || (uint64_t)st.st_size > max_bytes)
+    {
+      r.segments_ok = false;
+      if (fp)
+        fclose(fp);
+      continue;
+    }
+    char buf[256];
+    bool first = true;
+    bool ended = true;
+    while (fgets(buf, sizeof(buf), fp))
+    {
+      size_t n = strlen(buf);
+      ended = n && buf[n - 1] == '\n';
+      if (first && strncmp(buf, "# ingest: segment ", 18))
+        r.segments_ok = false;
+      first = false;
+      if (!strncmp(buf, "# ingest: ", 10))
+      {
+        if (strstr(buf, "bytes lost"))
+        {
+          r.notes++;
+          r.noted += strtoull(buf + 10, nullptr, 10);
+          r.note_last = true;
+        }
+        continue;
+      }
+      r.hash = fnv1a(r.hash, buf, n);
+      r.lines++;
+      r.note_last = false;
+
+      // Every line must be one of the stream's, in order (gaps allowed)
+      if (buf[0] == '#')
+      {
+        if (strncmp(buf, "# device: Covox (", 17))
+          r.bad_lines++;
+        continue;
+      }
+      uint64_t k = strtoull(buf, nullptr, 10) / 23;
+      make_line(k, expect);
+      if (k < next_k || strcmp(buf, expect))
+        r.bad_lines++;
+      next_k = k + 1;
+    }
+    fclose(fp);
+    r.segments_ok = r.segments_ok && ended;
+  }
+  return r;
+}
+
+static uint64_t rss_kb()
+{
+  FILE *fp = fopen("/proc/self/status", "r");
+  if (!fp)
+    return 0;
+  char line[128];
+  uint64_t kb = 0;
+  while (fgets(line, sizeof(line), fp))
+    if (!strncmp(line, "VmRSS:", 6))
+      kb = strtoull(line + 6, nullptr, 10);
+  fclose(fp);
+  return kb;
+}
+
+// Until the reader has taken everything written so far
+static void wait_read(const Ingest &in, const Producer &prod)
+{
+  while (in.bytes_in() < prod.produced().bytes)
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+}
+
+// One daemon run on a pipe, the producer on its own thread; check() gets
+// whether the run itself succeeded
+template <typename Check>
+static void pipe_run(const IngestConfig &cfg, uint64_t bytes, uint32_t max_burst, uint32_t pause_us, Check check)
+{
+  int fds[2];
+  bool ran = pipe(fds) == 0;
+  Ingest in(cfg);
+  Produced p;
+  if (ran)
+  {
+    std::thread producer([&] { p = produce(fds[1], bytes, max_burst, pause_us); });
+    ran = in.run(fds[0]);
+    producer.join();
+    close(fds[0]);
+  }
+  check(in, p, ran);
+}
+
+static int selftest()
+{
+  TestDir dir("capture_ingest");
+  if (!dir.made())
+    return 1;
+  SelfTest test("Capture Ingest");
+
+  // Byte-exact through 1 MB segments
+  IngestConfig cfg;
+  cfg.prefix = dir.file("size");
+  cfg.segment_bytes = 1 << 20;
+  cfg.report_s = 0;
+  cfg.keep = 1000; // every segment's name, for the read-back
+  pipe_run(cfg, 24 << 20, 65536, 0, [&](const Ingest &in, const Produced &p, bool ran) {
+    Readback r = read_back(in, cfg.segment_bytes + cfg.block_bytes + LINE_SLACK);
+    bool pass = ran && r.segments_ok && r.hash == p.hash && r.lines == p.lines && in.bytes_lost() == 0 &&
+                in.sealed().size() >= 24;
+    test.check(pass, "Size rotation", "%zu segments, %llu lines, %.1f MB/s", in.sealed().size(),
+               (unsigned long long)r.lines, in.bytes_in() / (in.run_us() / 1e6) / 1e6);
+  });
+
+  // Time rotation over a trickle: a line at a time, 300 ms segments
+  cfg.prefix = dir.file("time");
+  cfg.segment_bytes = (uint64_t)SEGMENT_MB << 20;
+  cfg.segment_us = 300000;
+  pipe_run(cfg, 40000, 64, 2000, [&](const Ingest &in, const Produced &p, bool ran) {
+    Readback r = read_back(in, cfg.segment_bytes);
+    bool pass = ran && r.segments_ok && r.hash == p.hash && r.lines == p.lines && in.sealed().size() >= 3;
+    test.check(pass, "Time rotation", "%zu segments in %.1f s", in.sealed().size(), in.run_us() / 1e6);
+  });
+
+  // A writer held behind a 256 KB ring, let go mid-stream and held again
+  // until the input has ended: the reader drops, lines stay whole, and every
+  // loss is noted, the one still pending at the end too. The producer waits
+  // for the reader at each step, so timing cannot decide the outcome.
+  cfg.prefix = dir.file("stall");
+  cfg.segment_us = 0;
+  cfg.segment_bytes = 4 << 20;
+  cfg.block_bytes = 64 * 1024;
+  cfg.blocks = 4;
+  std::atomic<bool> hold{true};
+  cfg.hold = &hold;
+  {
+    int fds[2];
+    bool made = pipe(fds) == 0;
+    Ingest in(cfg);
+    Producer prod(fds[1]);
+    std::thread producer([&] {
+      prod.write_more(8 << 20, 65536, 0); // fills the ring, the rest is dropped
+      wait_read(in, prod);
+      hold = false;
+      prod.write_more(8 << 20, 65536, 0); // the first loss is noted in here
+      hold = true;
+      prod.write_more(8 << 20, 65536, 0); // dropped once the ring is full again
+      wait_read(in, prod);
+      prod.close_fd(); // the input ends while the reader is dropping
+      hold = false;
+    });
+    made = made && in.run(fds[0]);
+    producer.join();
+    close(fds[0]);
+
+    const Produced &p = prod.produced();
+    Readback r = read_back(in, cfg.segment_bytes + cfg.block_bytes + LINE_SLACK);
+    bool pass = made && r.segments_ok && r.notes >= 2 && r.note_last && r.noted == in.bytes_lost() &&
+                r.bad_lines == 0 && in.bytes_in() == p.bytes && r.lines > 0;
+    test.check(pass, "Writer stall", "%.1f of %.1f MB lost, %llu notes, %llu broken lines", in.bytes_lost() / 1e6,
+               p.bytes / 1e6, (unsigned long long)r.notes, (unsigned long long)r.bad_lines);
+  }
+
+  // Memory: the default ring, 256 MB through it, keeping two 32 MB segments
+  cfg = IngestConfig();
+  cfg.prefix = dir.file("rss");
+  cfg.segment_bytes = 32 << 20;
+  cfg.keep = 2;
+  cfg.report_s = 0;
+  uint64_t rss_warm = 0, rss_end = 0;
+  {
+    int fds[2];
+    bool made = pipe(fds) == 0;
+    Ingest in(cfg);
+    std::thread producer([&] {
+      produce(fds[1], 32 << 20, 65536, 0); // warms every block of the ring
+    });
+    made = made && in.run(fds[0]);
+    producer.join();
+    close(fds[0]);
+    rss_warm = rss_kb();
+
+    made = made && pipe(fds) == 0;
+    std::thread more([&] { produce(fds[1], 256 << 20, 65536, 0); });
+    made = made && in.run(fds[0]);
+    more.join();
+    close(fds[0]);
+    rss_end = rss_kb();
+
+    bool pass = made && rss_end <= rss_warm + 512 && in.sealed().size() == 2;
+    test.check(pass, "Memory", "%llu kB after warm-up, %llu kB after 256 MB, %zu segments kept",
+               (unsigned long long)rss_warm, (unsigned long long)rss_end, in.sealed().size());
+  }
+
+  return test.finish();
+}
+
+// ---- Live ----
+
+static void on_signal(int) { stop = true; }
+
+static void usage()
+{
+  fprintf(stderr, "Usage: capture_ingest <tty | -> [-o prefix] [-s segment_mb] [-r segment_s] [-k keep]\n"
+                  "                      [-m ring_mb] [-i report_s]\n"
+                  "       capture_ingest -t\n");
+}
+
+int main(int argc, char **argv)
+{
+  const char *in_path = nullptr;
+  IngestConfig cfg;
+  bool test = false;
+
+  for (int i = 1; i < argc; ++i)
+  {
+    if (!strcmp(argv[i], "-o") && i + 1 < argc)
+      cfg.prefix = argv[++i];
+    else if (!strcmp(argv[i], "-s") && i + 1 < argc)
+      cfg.segment_bytes = (uint64_t)(atof(argv[++i]) * 1048576.0);
+    else if (!strcmp(argv[i], "-r") && i + 1 < argc)
+      cfg.segment_us = (uint64_t)(atof(argv[++i]) * 1e6);
+    else if (!strcmp(argv[i], "-k") && i + 1 < argc)
+      cfg.keep = (uint32_t)atoi(argv[++i]);
+    else if (!strcmp(argv[i], "-m") && i + 1 < argc)
+      cfg.blocks = (uint32_t)(atof(argv[++i]) * 1048576.0 / cfg.block_bytes);
+    else if (!strcmp(argv[i], "-i") && i + 1 < argc)
+      cfg.report_s = (uint32_t)atoi(argv[++i]);
+    else if (!strcmp(argv[i], "-t"))
+      test = true;
+    else if (!in_path)
+      in_path = argv[i];
+    else
+    {
+      usage();
+      return 1;
+    }
+  }
+
+  if (test)
+    return selftest();
+  if (!in_path || cfg.blocks < 2 || cfg.segment_bytes < cfg.block_bytes)
+  {
+    usage();
+    return 1;
+  }
+
+  int fd = open_input(in_path);
+  if (fd < 0)
+  {
+    fprintf(stderr, "Error: cannot open '%s'\n", in_path);
+    return 1;
+  }
+
+  struct sigaction sa = {};
+  sa.sa_handler = on_signal;
+  sigaction(SIGINT, &sa, nullptr);
+  sigaction(SIGTERM, &sa, nullptr);
+
+  std::unique_ptr<Ingest> in(new Ingest(cfg));
+  bool ok = in->run(fd);
+  if (fd > 0)
+    close(fd);
+
+  double secs = in->run_us() / 1e6;
+  fprintf(stderr, "=== Capture Ingest ===\n");
+  fprintf(stderr, "Run time        : %.1f s\n", secs);
+  fprintf(stderr, "Bytes in        : %llu (%.2f MB/s)\n", (unsigned long long)in->bytes_in(),
+          secs > 0 ? in->bytes_in() / secs / 1e6 : 0.0);
+  fprintf(stderr, "Lines           : %llu (%.0f/s)\n", (unsigned long long)in->lines(),
+          secs > 0 ? in->lines() / secs : 0.0);
+  fprintf(stderr, "Lost            : %llu bytes (ring max %u of %u blocks)\n",
+          (unsigned long long)in->bytes_lost(), in->ring_max(), cfg.blocks);
+  fprintf(stderr, "Segments        : %u (%s)\n", in->segments(),
+          in->last_sealed().empty() ? "none sealed" : in->last_sealed().c_str());
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,448 @@
+/*
+ * PARALAX - captures to WAV through the chip models, in parallel (host)
+ * ThisOldCPU Project - https://github.com/thisoldcpu
+ *
+ * Takes any number of captures. Each is classified and decoded the way
+ * core 1 does it (DeviceClassifier and SpeculativeDecoder), and every
+ * music device found in it becomes a stream of register writes; each
+ * stream is rendered through chip_render.h to <capture>.<device>.wav,
+ * OPL2LPT at the chip's 49716 Hz, TNDLPT mono and CMSLPT stereo at -r Hz.
+ * Decoding runs one capture per thread, rendering one stream per thread
+ * (-j, default all cores); the streams share nothing.
+ *
+ * The summary gives each stream's length, its render time and speed
+ * against real time, and the totals: CPU time, wall time and the overall
+ * speed. -n renders without writing WAVs (a pure benchmark), -d puts the
+ * WAVs in another directory.
+ *
+ * -t checks the PSG models' pitch (SN76489 tone and periodic noise,
+ * SAA1099 tone), the SAA1099 envelopes, and that -j N renders exactly
+ * what -j 1 does, then times each chip on -b seconds of busy synthetic
+ * music.
+ *
+ * The vector ISA is fixed at compile time; nothing is dispatched at run
+ * time. The line below builds the SSE2 path, each 8-lane vector as two
+ * halves; add -mavx2 (or -march=native on an AVX2 host) for one AVX2
+ * instruction per vector. That binary needs an AVX2 CPU.
+ *
+ * Build:
+ *   g++ -std=c++17 -O2 -pthread -Iinclude -Itools -o chip_render tools/chip_render.cpp \
+ *       src/opl2_synth.cpp src/speculative_decoder.cpp src/device_classifier.cpp \
+ *       src/device_decoders.cpp src/cmslpt_decoder.cpp
+ *
+ * Usage:
+ *   chip_render <capture.csv>... [-d dir] [-j threads] [-r rate] [-n]
+ *   chip_render -t [-b seconds] [-j threads]
+ *
+ * License : MIT
+ */
+
+#include <ctype.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "capture_csv.h"
+#include "chip_render.h"
+#include "device_classifier.h"
+#include "device_decoders.h"
+#include "selftest.h"
+#include "speculative_decoder.h"
+#include "wav_writer.h"
+
+static constexpr uint32_t TAIL_US = 1000000; // releases ring out after the last write
+
+struct Stream
+{
+  size_t      capture = 0;
+  LptDevice   device = DEV_UNKNOWN;
+  std::string wav_path;
+  std::vector<RenderEvent> events;
+  RenderResult result;
+  double      secs = 0.0;
+};
+
+// Runs job(i) for every i < count on `threads` threads
+template <typename Job>
+static void parallel_for(size_t count, unsigned threads, Job job)
+{
+  std::atomic<size_t> next{0};
+  auto worker = [&]()
+  {
+    for (size_t i; (i = next++) < count;)
+      job(i);
+  };
+  std::vector<std::thread> pool;
+  for (unsigned t = 1; t < threads && t < count; ++t)
+    pool.emplace_back(worker);
+  worker();
+  for (std::thread &t : pool)
+    t.join();
+}
+
+// ---- Decoding ----
+
+class StreamCollector : public DeviceEventSink
+{
+public:
+  void on_event(const DeviceEvent &e) override
+  {
+    if (e.device != DEV_OPL2LPT && e.device != DEV_TNDLPT && e.device != DEV_CMSLPT)
+      return;
+    // Replayed events are older than the frame being fed
+    uint64_t t = frame_t - (uint32_t)(frame_us - e.t_us);
+    events[e.device].push_back({t, e.chip, e.reg, e.value});
+  }
+  void on_reopen() override { reopened = true; }
+
+  uint32_t frame_us = 0;
+  uint64_t frame_t = 0;
+  bool     reopened = false;
+  std::vector<RenderEvent> events[DEV_COUNT];
+};
+
+struct CaptureStreams
+{
+  std::vector<RenderEvent> events[DEV_COUNT];
+};
+
+static bool decode_capture(const char *path, CaptureStreams &out)
+{
+  CsvCaptureReader reader;
+  if (!reader.open(path))
+    return false;
+
+  StreamCollector sink;
+  SpeculativeDecoder speculative(sink);
+  DeviceClassifier cls;
+  TimeUnwrapper clock;
+  CaptureFrame f;
+  while (reader.next(f))
+  {
+    sink.frame_us = f.t_us;
+    sink.frame_t = clock.extend(f.t_us);
+    speculative.feed(f);
+    DeviceGuess g;
+    if (cls.feed(f, g))
+      speculative.commit(g.device);
+    if (sink.reopened)
+    {
+      cls.reset();
+      sink.reopened = false;
+    }
+  }
+
+  for (uint32_t d = 0; d < DEV_COUNT; ++d)
+  {
+    std::stable_sort(sink.events[d].begin(), sink.events[d].end(),
+                     [](const RenderEvent &a, const RenderEvent &b) { return a.t_us < b.t_us; });
+    out.events[d].swap(sink.events[d]);
+  }
+  return true;
+}
+
+static std::string wav_name(const char *capture, const char *dir, LptDevice device)
+{
+  std::string base = capture;
+  size_t slash = base.find_last_of("/\\");
+  if (dir && slash != std::string::npos)
+    base = base.substr(slash + 1);
+  size_t dot = base.rfind('.');
+  if (dot != std::string::npos && (slash == std::string::npos || dot > slash))
+    base = base.substr(0, dot);
+  std::string name = lpt_device_name(device);
+  for (char &c : name)
+    c = (char)tolower((unsigned char)c);
+  return (dir ? std::string(dir) + "/" : std::string()) + base + "." + name + ".wav";
+}
+
+static void render_job(Stream &s, uint32_t rate_hz, bool write)
+{
+  double t0 = now_secs();
+  WavWriter wav;
+  render_format(s.device, rate_hz, s.result);
+  bool open = write && wav.open(s.wav_path.c_str(), s.result.rate_hz, s.result.channels);
+  render_stream(s.device, s.events, rate_hz, TAIL_US, open ? &wav : nullptr, s.result);
+  wav.close();
+  s.secs = now_secs() - t0;
+}
+
+// ---- Self-test ----
+
+// Rising zero crossings per second in a mono or left channel
+static double pitch(const int16_t *pcm, uint32_t frames, uint32_t stride, uint32_t rate_hz)
+{
+  uint32_t rises = 0;
+  for (uint32_t i = 1; i < frames; ++i)
+    if (pcm[(i - 1) * stride] <= 0 && pcm[i * stride] > 0)
+      rises++;
+  return (double)rises * rate_hz / frames;
+}
+
+static void check_pitch(SelfTest &test, const char *name, double got, double want)
+{
+  test.check(fabs(got - want) <= 1.0, name, "%.1f Hz (want %.1f)", got, want);
+}
+
+// Busy synthetic music for one device: notes changing every 20 ms on every voice
+static void busy_stream(LptDevice device, double seconds, uint32_t seed, std::vector<RenderEvent> &ev)
+{
+  TestRng rng(seed);
+  auto rnd = [&]() { return rng.next() >> 16; };
+  for (uint64_t t = 0; t < (uint64_t)(seconds * 1e6); t += 20000)
+  {
+    if (device == DEV_OPL2LPT)
+    {
+      if (t == 0)
+      {
+        for (uint8_t c = 0; c < 9; ++c)
+        {
+          static const uint8_t mod_off[9] = {0x00, 0x01, 0x02, 0x08, 0x09, 0x0a, 0x10, 0x11, 0x12};
+          uint8_t m = mod_off[c];
+          ev.push_back({t, 0, (uint8_t)(0x20 + m), 0x21});
+          ev.push_back({t, 0, (uint8_t)(0x23 + m), 0x01});
+          ev.push_back({t, 0, (uint8_t)(0x40 + m), 0x10});
+          ev.push_back({t, 0, (uint8_t)(0x43 + m), 0x00});
+          ev.push_back({t, 0, (uint8_t)(0x60 + m), 0xf4});
+          ev.push_back({t, 0, (uint8_t)(0x63 + m), 0xf4});
+          ev.push_back({t, 0, (uint8_t)(0x80 + m), 0x26});
+          ev.push_back({t, 0, (uint8_t)(0x83 + m), 0x26});
+          ev.push_back({t, 0, (uint8_t)(0xc0 + c), 0x0e});
+        }
+      }
+      uint8_t c = (uint8_t)(rnd() % 9);
+      ev.push_back({t, 0, (uint8_t)(0xa0 + c), (uint8_t)rnd()});
+      ev.push_back({t, 0, (uint8_t)(0xb0 + c), (uint8_t)(0x20 | (rnd() & 0x1f))});
+    }
+    else if (device == DEV_TNDLPT)
+    {
+      uint8_t c = (uint8_t)(rnd() % 3);
+      uint32_t p = 40 + rnd() % 900;
+      ev.push_back({t, 0, 0, (uint8_t)(0x80 | (c << 5) | (p & 0x0f))});
+      ev.push_back({t, 0, 0, (uint8_t)(p >> 4)});
+      ev.push_back({t, 0, 0, (uint8_t)(0x90 | (c << 5) | (rnd() & 7))});
+      ev.push_back({t, 0, 0, (uint8_t)(0xe0 | (rnd() & 7))});
+      ev.push_back({t, 0, 0, (uint8_t)(0xf0 | (rnd() & 7))});
+    }
+    else
+    {
+      for (uint8_t chip = 0; chip < 2; ++chip)
+      {
+        if (t == 0)
+        {
+          ev.push_back({t, chip, 0x1c, 0x02});
+          ev.push_back({t, chip, 0x1c, 0x01});
+          ev.push_back({t, chip, 0x14, 0x3f});
+          ev.push_back({t, chip, 0x15, 0x09});
+          ev.push_back({t, chip, 0x16, 0x12});
+          ev.push_back({t, chip, 0x18, 0x8a});
+          ev.push_back({t, chip, 0x19, 0x96});
+        }
+        uint8_t c = (uint8_t)(rnd() % 6);
+        ev.push_back({t, chip, c, (uint8_t)rnd()});
+        ev.push_back({t, chip, (uint8_t)(0x08 + c), (uint8_t)rnd()});
+        ev.push_back({t, chip, (uint8_t)(0x10 + c / 2), (uint8_t)(rnd() & 0x33)});
+      }
+    }
+  }
+}
+
+static int selftest(double bench_secs, unsigned threads)
+{
+  static constexpr uint32_t RATE = 48000;
+  SelfTest test("Chip Render");
+
+  std::vector<int16_t> pcm(RATE * 2);
+
+  // SN76489: tone 0 at period 254 (440.4 Hz), then periodic noise at clock / 512 / 15
+  {
+    Sn76489Synth sn(RATE);
+    sn.write(0x8e);
+    sn.write(0x0f);
+    sn.write(0x90);
+    sn.render(pcm.data(), RATE);
+    check_pitch(test, "SN76489 tone", pitch(pcm.data(), RATE, 1, RATE), 3579545.0 / 32 / 254);
+
+    sn.reset();
+    sn.write(0xe0);
+    sn.write(0xf0);
+    sn.render(pcm.data(), RATE);
+    check_pitch(test, "SN76489 noise", pitch(pcm.data(), RATE, 1, RATE), 3579545.0 / 512 / 15);
+  }
+
+  // SAA1099: channel 0, octave 3, frequency 165
+  {
+    Saa1099Synth saa(RATE);
+    std::vector<int32_t> mix(RATE * 2, 0);
+    saa.write(0x1c, 0x01);
+    saa.write(0x14, 0x01);
+    saa.write(0x00, 0xff);
+    saa.write(0x08, 165);
+    saa.write(0x10, 0x03);
+    saa.render(mix.data(), RATE);
+    for (uint32_t i = 0; i < RATE * 2; ++i)
+      pcm[i] = (int16_t)mix[i];
+    check_pitch(test, "SAA1099 tone", pitch(pcm.data(), RATE, 2, RATE), 7159090.0 / 512 * 8 / (511 - 165));
+
+    // Channel 2 plain, then under envelope 0 at zero and at maximum amplitude
+    int32_t peak[3];
+    for (uint32_t mode = 0; mode < 3; ++mode)
+    {
+      saa.reset();
+      saa.write(0x1c, 0x01);
+      saa.write(0x14, 0x04);
+      saa.write(0x02, 0xff);
+      saa.write(0x0a, 165);
+      saa.write(0x11, 0x03);
+      if (mode)
+        saa.write(0x18, (uint8_t)(0x80 | ((mode - 1) << 1)));
+      std::fill(mix.begin(), mix.end(), 0);
+      saa.render(mix.data(), RATE / 10);
+      peak[mode] = 0;
+      for (uint32_t i = 0; i < RATE / 10 * 2; ++i)
+        peak[mode] = std::max(peak[mode], abs(mix[i]));
+    }
+    // The envelope's top level is 15/16 of full scale
+    test.check(peak[1] == 0 && peak[2] == peak[0] * 15 / 16, "SAA1099 envelope", "plain %d, zero %d, maximum %d",
+               peak[0], peak[1], peak[2]);
+  }
+
+  // Parallel rendering is deterministic
+  {
+    static const LptDevice kinds[3] = {DEV_OPL2LPT, DEV_TNDLPT, DEV_CMSLPT};
+    std::vector<Stream> a(12), b;
+    for (size_t i = 0; i < a.size(); ++i)
+    {
+      a[i].device = kinds[i % 3];
+      busy_stream(a[i].device, 2.0, (uint32_t)i + 1, a[i].events);
+    }
+    b = a;
+    parallel_for(a.size(), 1, [&](size_t i) { render_job(a[i], RATE, false); });
+    unsigned n = std::max(threads, 4u);
+    parallel_for(b.size(), n, [&](size_t i) { render_job(b[i], RATE, false); });
+    bool pass = true;
+    for (size_t i = 0; i < a.size(); ++i)
+      pass = pass && a[i].result.hash == b[i].result.hash && a[i].result.frames == b[i].result.frames;
+    test.check(pass, "Threads", "%zu streams on 1 and %u threads, same output", a.size(), n);
+  }
+
+  // Speed of each model on busy music
+  {
+    static const LptDevice kinds[3] = {DEV_OPL2LPT, DEV_TNDLPT, DEV_CMSLPT};
+    for (LptDevice d : kinds)
+    {
+      Stream s;
+      s.device = d;
+      busy_stream(d, bench_secs, 7, s.events);
+      render_job(s, RATE, false);
+      double audio = (double)s.result.frames / s.result.rate_hz;
+      test.info(lpt_device_name(d), "%.1f s in %.3f s, %.0fx real time", audio, s.secs,
+                s.secs > 0 ? audio / s.secs : 0.0);
+    }
+  }
+
+  return test.finish();
+}
+
+// ---- Captures ----
+
+int main(int argc, char **argv)
+{
+  std::vector<const char *> inputs;
+  const char *dir = nullptr;
+  unsigned threads = std::thread::hardware_concurrency();
+  uint32_t rate_hz = 48000;
+  double bench_secs = 10.0;
+  bool write = true;
+  bool test = false;
+
+  for (int i = 1; i < argc; ++i)
+  {
+    if (!strcmp(argv[i], "-d") && i + 1 < argc)
+      dir = argv[++i];
+    else if (!strcmp(argv[i], "-j") && i + 1 < argc)
+      threads = (unsigned)atoi(argv[++i]);
+    else if (!strcmp(argv[i], "-r") && i + 1 < argc)
+      rate_hz = (uint32_t)atoi(argv[++i]);
+    else if (!strcmp(argv[i], "-b") && i + 1 < argc)
+      bench_secs = atof(argv[++i]);
+    else if (!strcmp(argv[i], "-n"))
+      write = false;
+    else if (!strcmp(argv[i], "-t"))
+      test = true;
+    else
+      inputs.push_back(argv[i]);
+  }
+  if (threads == 0)
+    threads = 1;
+  if (test)
+    return selftest(bench_secs, threads);
+  if (inputs.empty() || rate_hz < 8000 || rate_hz > 192000)
+  {
+    fprintf(stderr, "Usage: chip_render <capture.csv>... [-d dir] [-j threads] [-r rate] [-n]\n"
+                    "       chip_render -t [-b seconds] [-j threads]\n");
+    return 1;
+  }
+
+  double t_start = now_secs();
+
+  // One capture per thread
+  std::vector<CaptureStreams> decoded(inputs.size());
+  std::vector<char> readable(inputs.size(), 0);
+  parallel_for(inputs.size(), threads, [&](size_t i) { readable[i] = decode_capture(inputs[i], decoded[i]); });
+  double t_decoded = now_secs();
+
+  std::vector<Stream> streams;
+  for (size_t i = 0; i < inputs.size(); ++i)
+  {
+    if (!readable[i])
+    {
+      fprintf(stderr, "Error: cannot open '%s'\n", inputs[i]);
+      return 1;
+    }
+    for (uint32_t d = 0; d < DEV_COUNT; ++d)
+    {
+      if (decoded[i].events[d].empty())
+        continue;
+      Stream s;
+      s.capture = i;
+      s.device = (LptDevice)d;
+      s.wav_path = wav_name(inputs[i], dir, s.device);
+      s.events.swap(decoded[i].events[d]);
+      streams.push_back(std::move(s));
+    }
+  }
+
+  // One stream per thread
+  parallel_for(streams.size(), threads, [&](size_t i) { render_job(streams[i], rate_hz, write); });
+  double t_end = now_secs();
+
+  fprintf(stderr, "=== Chip Render ===\n");
+  fprintf(stderr, "Captures        : %zu, decoded in %.3f s\n", inputs.size(), t_decoded - t_start);
+  fprintf(stderr, "Threads         : %u\n", threads);
+  double audio = 0.0, cpu = 0.0;
+  for (const Stream &s : streams)
+  {
+    double len = (double)s.result.frames / s.result.rate_hz;
+    audio += len;
+    cpu += s.secs;
+    fprintf(stderr, "%-16s: %s, %u writes, %.1f s at %u Hz in %.3f s (%.0fx real time)\n",
+            lpt_device_name(s.device), write ? s.wav_path.c_str() : inputs[s.capture], (uint32_t)s.events.size(),
+            len, s.result.rate_hz, s.secs, s.secs > 0 ? len / s.secs : 0.0);
+  }
+  if (streams.empty())
+    fprintf(stderr, "Streams         : none (no OPL2LPT, TNDLPT or CMSLPT writes)\n");
+  double wall = t_end - t_decoded;
+  fprintf(stderr, "Audio rendered  : %.1f s in %zu streams\n", audio, streams.size());
+  fprintf(stderr, "Render time     : %.3f s CPU, %.3f s wall\n", cpu, wall);
+  if (wall > 0 && cpu > 0)
+    fprintf(stderr, "Speed           : %.0fx real time (%.0fx per thread)\n", audio / wall, audio / cpu);
+  return 0;
+}
@@ -0,0 +1,562 @@
+/*
+ * PARALAX - multi-chip register stream renderer (host only)
+ * ThisOldCPU Project - https://github.com/thisoldcpu
+ *
+ * Renders decoded register streams to PCM far faster than real time:
+ *
+ *   OPL2LPT  the firmware's Opl2Synth, bit for bit, at the chip's 49716 Hz
+ *   TNDLPT   Sn76489Synth: three tones and the LFSR noise of the SN76496
+ *            (Tandy, 3.579545 MHz), 2 dB attenuation steps
+ *   CMSLPT   two Saa1099Synth (7.15909 MHz): six tones, two noise
+ *            generators, the envelopes on channels 2 and 5, stereo
+ *
+ * The PSG models work at eight substeps per output frame, one per SIMD
+ * lane: each tone is a 32-bit phase accumulator, so a channel's eight
+ * substeps are one vector add, its level one shift and its contribution
+ * one multiply-add, and the frame is the average of the lanes (a box
+ * filter against the aliasing of the square waves). Only the noise LFSRs
+ * and the SAA1099 envelope steps run per lane. The vectors are GCC/Clang
+ * vector extensions: SSE2 by default, AVX2 with -mavx2, NEON on ARM.
+ *
+ * Tones the PSG would play above half the substep rate (SAA1099 octaves
+ * 6-7 at the top of the range, SN76489 period 1) are inaudible there and
+ * are rendered as their average, silence.
+ *
+ * License : MIT
+ */
+
+#pragma once
+
+#include <math.h>
+#include <stdint.h>
+
+#include <vector>
+
+#include "device_classifier.h"
+#include "opl2_synth.h"
+#include "wav_writer.h"
+
+// Without AVX, GCC warns that 32-byte vectors pass differently; every
+// function taking them here is static inline, so no ABI is crossed
+#pragma GCC diagnostic ignored "-Wpsabi"
+
+typedef uint32_t u32x8 __attribute__((vector_size(32)));
+typedef int32_t  i32x8 __attribute__((vector_size(32)));
+
+static constexpr uint32_t RENDER_SUBSTEPS = 8; // lanes of u32x8
+
+static inline int32_t lane_sum(const i32x8 &v)
+{
+  int32_t s = 0;
+  for (uint32_t k = 0; k < RENDER_SUBSTEPS; ++k)
+    s += v[k];
+  return s;
+}
+
+// Phases at the eight substeps of the next frame, then moves on a frame
+static inline u32x8 dds_frame(uint32_t &phase, uint32_t inc)
+{
+  static const u32x8 steps = {1, 2, 3, 4, 5, 6, 7, 8};
+  u32x8 v = phase + inc * steps;
+  phase += inc * RENDER_SUBSTEPS;
+  return v;
+}
+
+// +1 / -1 from the top bit of each phase
+static inline i32x8 dds_sign(const u32x8 &v)
+{
+  return (i32x8)(v >> 31) * 2 - 1;
+}
+
+// Phase increment per substep for `hz` full cycles a second; 0 if too fast
+static inline uint32_t dds_inc(double hz, uint32_t substep_hz)
+{
+  double inc = hz * 4294967296.0 / substep_hz;
+  return inc < 2147483648.0 ? (uint32_t)inc : 0;
+}
+
+// ---------------------------------------------------------------------------
+// SN76489 (TNDLPT)
+// ---------------------------------------------------------------------------
+
+class Sn76489Synth
+{
+public:
+  static constexpr uint32_t CLOCK_HZ = 3579545;
+
+  explicit Sn76489Synth(uint32_t rate_hz) : sub_hz_(rate_hz * RENDER_SUBSTEPS)
+  {
+    for (uint32_t k = 0; k < 15; ++k)
+      amp_[k] = (int32_t)lrint(8191.0 * pow(10.0, -(double)k / 10.0));
+    amp_[15] = 0;
+    reset();
+  }
+
+  void reset()
+  {
+    for (uint32_t c = 0; c < 4; ++c)
+    {
+      atten_[c] = 15;
+      phase_[c] = 0;
+      inc_[c] = 0;
+    }
+    for (uint16_t &p : period_)
+      p = 0;
+    latch_ = 0;
+    noise_ = 0;
+    lfsr_ = 0x4000;
+    for (uint32_t c = 0; c < 3; ++c)
+      update_tone(c);
+    update_noise();
+  }
+
+  // One byte as written to the chip
+  void write(uint8_t data)
+  {
+    if (data & 0x80)
+      latch_ = (data >> 4) & 7;
+    uint8_t c = latch_ >> 1;
+
+    if (latch_ & 1)
+    {
+      atten_[c] = data & 0x0f;
+      return;
+    }
+    if (c == 3)
+    {
+      noise_ = data & 0x07;
+      lfsr_ = 0x4000;
+      update_noise();
+      return;
+    }
+    if (data & 0x80)
+      period_[c] = (uint16_t)((period_[c] & 0x3f0) | (data & 0x0f));
+    else
+      period_[c] = (uint16_t)((period_[c] & 0x00f) | ((data & 0x3f) << 4));
+    update_tone(c);
+    if (c == 2 && (noise_ & 3) == 3)
+      update_noise();
+  }
+
+  void render(int16_t *out, uint32_t frames)
+  {
+    for (uint32_t n = 0; n < frames; ++n)
+    {
+      i32x8 acc = {0, 0, 0, 0, 0, 0, 0, 0};
+      for (uint32_t c = 0; c < 3; ++c)
+      {
+        u32x8 v = dds_frame(phase_[c], inc_[c]);
+        int32_t a = amp_[atten_[c]];
+        if (inc_[c])
+          acc += dds_sign(v) * a;
+        else if (period_[c] == 1)
+          acc += a; // held high
+      }
+
+      u32x8 v = dds_frame(phase_[3], inc_[3]);
+      u32x8 prev = v - inc_[3];
+      i32x8 carry = v < prev;
+      int32_t a = amp_[atten_[3]];
+      for (uint32_t k = 0; k < RENDER_SUBSTEPS; ++k)
+      {
+        if (carry[k])
+          shift_noise();
+        acc[k] += (lfsr_ & 1) ? a : -a;
+      }
+
+      out[n] = (int16_t)(lane_sum(acc) / (int32_t)RENDER_SUBSTEPS);
+    }
+  }
+
+private:
+  void update_tone(uint32_t c)
+  {
+    uint32_t p = period_[c] ? period_[c] : 1024;
+    inc_[c] = p > 1 ? dds_inc((double)CLOCK_HZ / (32.0 * p), sub_hz_) : 0;
+  }
+
+  // One LFSR shift per full cycle of the selected rate
+  void update_noise()
+  {
+    static const uint32_t rates[3] = {16, 32, 64};
+    uint32_t p = (noise_ & 3) == 3 ? (period_[2] ? period_[2] : 1024) : rates[noise_ & 3];
+    inc_[3] = dds_inc((double)CLOCK_HZ / (32.0 * p), sub_hz_);
+  }
+
+  void shift_noise()
+  {
+    uint16_t fb = (noise_ & 4) ? ((lfsr_ ^ (lfsr_ >> 1)) & 1) : (lfsr_ & 1);
+    lfsr_ = (uint16_t)((lfsr_ >> 1) | (fb << 14));
+  }
+
+  uint32_t sub_hz_;
+  int32_t  amp_[16];
+
+  uint16_t period_[3];
+  uint8_t  atten_[4];
+  uint8_t  latch_;
+  uint8_t  noise_;
+  uint16_t lfsr_;
+  uint32_t phase_[4];
+  uint32_t inc_[4];
+};
+
+// ---------------------------------------------------------------------------
+// SAA1099 (CMSLPT, one chip)
+// ---------------------------------------------------------------------------
+
+class Saa1099Synth
+{
+public:
+  static constexpr uint32_t CLOCK_HZ = 7159090;
+
+  explicit Saa1099Synth(uint32_t rate_hz) : sub_hz_(rate_hz * RENDER_SUBSTEPS) { reset(); }
+
+  void reset()
+  {
+    for (uint32_t g = 0; g < 2; ++g)
+    {
+      noise_mode_[g] = 0;
+      noise_phase_[g] = 0;
+      lfsr_[g] = 0;
+      env_[g] = 0;
+      env_step_[g] = 0;
+      env_l_[g] = env_r_[g] = 0;
+    }
+    for (uint32_t c = 0; c < 6; ++c)
+    {
+      amp_l_[c] = amp_r_[c] = 0;
+      freq_[c] = 0;
+      octave_[c] = 0;
+      phase_[c] = 0;
+      update_tone(c); // and the noise rates, from channels 0 and 3
+    }
+    freq_enable_ = 0;
+    noise_enable_ = 0;
+    enabled_ = false;
+  }
+
+  void write(uint8_t reg, uint8_t value)
+  {
+    reg &= 0x1f;
+    if (reg <= 0x05)
+    {
+      amp_l_[reg] = value & 0x0f;
+      amp_r_[reg] = value >> 4;
+    }
+    else if (reg >= 0x08 && reg <= 0x0d)
+    {
+      freq_[reg - 0x08] = value;
+      update_tone(reg - 0x08);
+    }
+    else if (reg >= 0x10 && reg <= 0x12)
+    {
+      uint32_t c = (reg - 0x10) * 2;
+      octave_[c] = value & 7;
+      octave_[c + 1] = (value >> 4) & 7;
+      update_tone(c);
+      update_tone(c + 1);
+    }
+    else if (reg == 0x14)
+      freq_enable_ = value & 0x3f;
+    else if (reg == 0x15)
+      noise_enable_ = value & 0x3f;
+    else if (reg == 0x16)
+    {
+      noise_mode_[0] = value & 3;
+      noise_mode_[1] = (value >> 4) & 3;
+      update_noise(0);
+      update_noise(1);
+    }
+    else if (reg == 0x18 || reg == 0x19)
+    {
+      uint32_t g = reg - 0x18;
+      // Selecting either envelope register clocks externally clocked envelopes
+      for (uint32_t e = 0; e < 2; ++e)
+        if ((env_[e] & 0xa0) == 0xa0)
+          step_envelope(e);
+      env_[g] = value;
+      env_step_[g] = 0;
+      apply_envelope(g);
+    }
+    else if (reg == 0x1c)
+    {
+      enabled_ = (value & 1) != 0;
+      if (value & 2)
+      {
+        for (uint32_t &p : phase_)
+          p = 0;
+        for (uint32_t &p : noise_phase_)
+          p = 0;
+      }
+    }
+  }
+
+  // Adds `frames` stereo frames into mix (interleaved L, R)
+  void render(int32_t *mix, uint32_t frames)
+  {
+    if (!enabled_)
+      return;
+
+    for (uint32_t n = 0; n < frames; ++n)
+    {
+      u32x8 tone[6];
+      u32x8 prev[6];
+      for (uint32_t c = 0; c < 6; ++c)
+      {
+        tone[c] = dds_frame(phase_[c], inc_[c]);
+        prev[c] = tone[c] - inc_[c];
+      }
+
+      // Noise levels per substep (+1 / -1)
+      i32x8 noise[2];
+      for (uint32_t g = 0; g < 2; ++g)
+      {
+        u32x8 v = dds_frame(noise_phase_[g], noise_inc_[g]);
+        i32x8 carry = v < (u32x8)(v - noise_inc_[g]);
+        for (uint32_t k = 0; k < RENDER_SUBSTEPS; ++k)
+        {
+          if (carry[k])
+            shift_noise(g);
+          noise[g][k] = (lfsr_[g] & 1) ? 1 : -1;
+        }
+      }
+
+      i32x8 acc_l = {0, 0, 0, 0, 0, 0, 0, 0};
+      i32x8 acc_r = acc_l;
+      for (uint32_t c = 0; c < 6; ++c)
+      {
+        // Tone counts double: the noise goes in at half amplitude
+        i32x8 wave = {0, 0, 0, 0, 0, 0, 0, 0};
+        if ((freq_enable_ >> c) & 1 && audible_[c])
+          wave += dds_sign(tone[c]) * 2;
+        if ((noise_enable_ >> c) & 1)
+          wave += noise[c / 3];
+
+        uint32_t g = c / 3;
+        if (c % 3 == 2 && (env_[g] & 0x80))
+        {
+          // Per-substep envelope, stepped by channel 1 / 4 unless clocked externally
+          i32x8 toggled = (i32x8)((tone[c - 1] ^ prev[c - 1]) >> 31);
+          i32x8 el, er;
+          for (uint32_t k = 0; k < RENDER_SUBSTEPS; ++k)
+          {
+            if (toggled[k] && !(env_[g] & 0x20))
+              step_envelope(g);
+            el[k] = env_l_[g];
+            er[k] = env_r_[g];
+          }
+          acc_l += wave * el * amp_l_[c];
+          acc_r += wave * er * amp_r_[c];
+        }
+        else
+        {
+          acc_l += wave * (16 * amp_l_[c]);
+          acc_r += wave * (16 * amp_r_[c]);
+        }
+      }
+
+      // Full scale is 6 channels x 15 x 16 x 3 x 8 substeps; two chips stay under 26000
+      mix[2 * n] += lane_sum(acc_l) * 3 / 8;
+      mix[2 * n + 1] += lane_sum(acc_r) * 3 / 8;
+    }
+  }
+
+private:
+  void update_tone(uint32_t c)
+  {
+    // Level toggles at (clock / 256 << octave) / (511 - freq); a cycle is two
+    double hz = (double)(CLOCK_HZ / 512.0) * (1u << octave_[c]) / (511 - freq_[c]);
+    inc_[c] = dds_inc(hz, sub_hz_);
+    audible_[c] = inc_[c] != 0;
+    if (!inc_[c])
+      inc_[c] = 0x7fffffffu; // keeps stepping envelopes and mode 3 noise, at the fastest
+    if (c % 3 == 0)
+      update_noise(c / 3);
+  }
+
+  // One LFSR shift per toggle of the selected rate
+  void update_noise(uint32_t g)
+  {
+    uint32_t inc;
+    if (noise_mode_[g] == 3)
+      inc = inc_[g * 3] > 0x3fffffffu ? 0x7fffffffu : inc_[g * 3] * 2;
+    else
+      inc = dds_inc((double)CLOCK_HZ / (256u << noise_mode_[g]), sub_hz_);
+    noise_inc_[g] = inc;
+  }
+
+  void shift_noise(uint32_t g)
+  {
+    uint32_t &l = lfsr_[g];
+    if (((l & 0x4000) == 0) == ((l & 0x0040) == 0))
+      l = (l << 1) | 1;
+    else
+      l <<= 1;
+  }
+
+  static uint8_t envelope_level(uint32_t mode, uint32_t step)
+  {
+    switch (mode)
+    {
+    case 0:
+      return 0;
+    case 1:
+      return 15;
+    case 2:
+      return step < 16 ? (uint8_t)(15 - step) : 0;
+    case 3:
+      return (uint8_t)(15 - (step & 15));
+    case 4:
+      return step < 16 ? (uint8_t)step : (step < 32 ? (uint8_t)(31 - step) : 0);
+    case 5:
+      return (step & 31) < 16 ? (uint8_t)(step & 15) : (uint8_t)(31 - (step & 31));
+    case 6:
+      return step < 16 ? (uint8_t)step : 0;
+    default:
+      return (uint8_t)(step & 15);
+    }
+  }
+
+  // Steps 0..63, then loops over 32..63
+  void step_envelope(uint32_t g)
+  {
+    uint8_t s = env_step_[g];
+    env_step_[g] = (uint8_t)(((s + 1) & 0x3f) | (s & 0x20));
+    apply_envelope(g);
+  }
+
+  void apply_envelope(uint32_t g)
+  {
+    uint8_t level = envelope_level((env_[g] >> 1) & 7, env_step_[g]);
+    uint8_t mask = (env_[g] & 0x10) ? 0x0e : 0x0f;
+    env_l_[g] = level & mask;
+    env_r_[g] = (env_[g] & 1) ? (uint8_t)((15 - level) & mask) : (uint8_t)(level & mask);
+  }
+
+  uint32_t sub_hz_;
+
+  int32_t  amp_l_[6];
+  int32_t  amp_r_[6];
+  uint8_t  freq_[6];
+  uint8_t  octave_[6];
+  uint32_t phase_[6];
+  uint32_t inc_[6];
+  bool     audible_[6];
+
+  uint8_t  noise_mode_[2];
+  uint32_t noise_phase_[2];
+  uint32_t noise_inc_[2];
+  uint32_t lfsr_[2];
+
+  uint8_t  env_[2];
+  uint8_t  env_step_[2];
+  uint8_t  env_l_[2];
+  uint8_t  env_r_[2];
+
+  uint8_t  freq_enable_;
+  uint8_t  noise_enable_;
+  bool     enabled_;
+};
+
+// ---------------------------------------------------------------------------
+// Streams
+// ---------------------------------------------------------------------------
+
+struct RenderEvent
+{
+  uint64_t t_us; // unwrapped capture time
+  uint8_t  chip; // CMSLPT chip, otherwise 0
+  uint8_t  reg;
+  uint8_t  value;
+};
+
+struct RenderResult
+{
+  uint32_t rate_hz = 0;
+  uint16_t channels = 0;
+  uint64_t frames = 0;
+  uint32_t hash = 0x811c9dc5u; // FNV-1a of the samples
+};
+
+// Output format of a device's stream; `rate_hz` is used by the PSGs
+static inline void render_format(LptDevice device, uint32_t rate_hz, RenderResult &r)
+{
+  if (device == DEV_OPL2LPT)
+    r.rate_hz = (Opl2Synth::CLOCK_HZ + Opl2Synth::CLOCKS_PER_SAMPLE / 2) / Opl2Synth::CLOCKS_PER_SAMPLE;
+  else
+    r.rate_hz = rate_hz;
+  r.channels = device == DEV_CMSLPT ? 2 : 1;
+}
+
+// Renders a device's events from the first one to tail_us after the last,
+// each write landing on the frame its timestamp falls in. `wav` may be null.
+static inline bool render_stream(LptDevice device, const std::vector<RenderEvent> &events, uint32_t rate_hz,
+                                 uint32_t tail_us, WavWriter *wav, RenderResult &r)
+{
+  static constexpr uint32_t BLOCK = 1024;
+  render_format(device, rate_hz, r);
+  if (events.empty() || (device != DEV_OPL2LPT && device != DEV_TNDLPT && device != DEV_CMSLPT))
+    return false;
+
+  Opl2Synth opl;
+  Sn76489Synth sn(r.rate_hz);
+  Saa1099Synth saa0(r.rate_hz);
+  Saa1099Synth saa1(r.rate_hz);
+
+  const uint64_t t0 = events.front().t_us;
+  const uint64_t total = (events.back().t_us - t0 + tail_us) * r.rate_hz / 1000000u;
+  int16_t out[BLOCK * 2];
+  int32_t mix[BLOCK * 2];
+  size_t next = 0;
+  uint64_t pos = 0;
+
+  while (pos < total)
+  {
+    while (next < events.size() && (events[next].t_us - t0) * r.rate_hz / 1000000u <= pos)
+    {
+      const RenderEvent &e = events[next++];
+      if (device == DEV_OPL2LPT)
+        opl.write(e.reg, e.value);
+      else if (device == DEV_TNDLPT)
+        sn.write(e.value);
+      else
+        (e.chip ? saa1 : saa0).write(e.reg, e.value);
+    }
+
+    uint64_t until = total;
+    if (next < events.size())
+    {
+      uint64_t at = (events[next].t_us - t0) * r.rate_hz / 1000000u;
+      if (at < until)
+        until = at;
+    }
+    uint32_t n = until - pos > BLOCK ? BLOCK : (uint32_t)(until - pos);
+
+    if (device == DEV_OPL2LPT)
+      opl.render(out, n);
+    else if (device == DEV_TNDLPT)
+      sn.render(out, n);
+    else
+    {
+      for (uint32_t i = 0; i < 2 * n; ++i)
+        mix[i] = 0;
+      saa0.render(mix, n);
+      saa1.render(mix, n);
+      for (uint32_t i = 0; i < 2 * n; ++i)
+        out[i] = (int16_t)(mix[i] > 32767 ? 32767 : (mix[i] < -32768 ? -32768 : mix[i]));
+    }
+
+    for (uint32_t i = 0; i < n * r.channels; ++i)
+    {
+      uint16_t v = (uint16_t)out[i];
+      r.hash = (r.hash ^ (uint8_t)v) * 0x01000193u;
+      r.hash = (r.hash ^ (uint8_t)(v >> 8)) * 0x01000193u;
+    }
+    if (wav)
+      wav->write(out, n);
+    pos += n;
+  }
+  r.frames = pos;
+  return true;
+}
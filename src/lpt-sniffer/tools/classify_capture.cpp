@@ -0,0 +1,89 @@
+/*
+ * PARALAX - streaming device classifier over a capture (host)
+ * ThisOldCPU Project - https://github.com/thisoldcpu
+ *
+ * Runs the firmware's DeviceClassifier over a CSV capture and prints each
+ * announcement with the time it was made, so the on-device verdicts can be
+ * checked against recorded traffic.
+ *
+ * Build:
+ *   g++ -std=c++17 -O2 -Iinclude -o classify_capture tools/classify_capture.cpp \
+ *       src/device_classifier.cpp
+ *
+ * Usage:
+ *   classify_capture <capture.csv> [-v]
+ *     -v  print every window's scores
+ *
+ * License : MIT
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "capture_csv.h"
+#include "device_classifier.h"
+
+int main(int argc, char **argv)
+{
+  const char *in_path = nullptr;
+  bool verbose = false;
+
+  for (int i = 1; i < argc; ++i)
+  {
+    if (!strcmp(argv[i], "-v"))
+      verbose = true;
+    else if (!in_path)
+      in_path = argv[i];
+  }
+  if (!in_path)
+  {
+    fprintf(stderr, "Usage: classify_capture <capture.csv> [-v]\n");
+    return 1;
+  }
+
+  CsvCaptureReader reader;
+  if (!reader.open(in_path))
+  {
+    fprintf(stderr, "Error: cannot open '%s'\n", in_path);
+    return 1;
+  }
+
+  DeviceClassifier cls;
+  uint32_t windows = 0;
+  uint32_t first_t = 0;
+  bool have_first = false;
+
+  CaptureFrame f;
+  DeviceGuess g;
+  while (reader.next(f))
+  {
+    if (!have_first)
+    {
+      first_t = f.t_us;
+      have_first = true;
+    }
+
+    bool changed = cls.feed(f, g);
+
+    if (verbose && cls.windows() != windows)
+    {
+      windows = cls.windows();
+      printf("# %u us window %u:", f.t_us, windows);
+      for (uint8_t d = 0; d < DEV_COUNT; ++d)
+        printf(" %s=%u", lpt_device_name((LptDevice)d), cls.score((LptDevice)d));
+      printf(" (%u Hz)\n", cls.event_hz());
+    }
+
+    if (changed)
+    {
+      printf("%u us (+%u us): %s, confidence %u%%, %u events/s\n", g.t_us, g.t_us - first_t,
+             lpt_device_name(g.device), g.confidence, g.event_hz);
+    }
+  }
+
+  fprintf(stderr, "=== Classifier ===\n");
+  fprintf(stderr, "Frames          : %llu\n", (unsigned long long)reader.frames());
+  fprintf(stderr, "Windows         : %u\n", cls.windows());
+  fprintf(stderr, "Device          : %s (%u%%)\n", lpt_device_name(cls.device()), cls.confidence());
+  return 0;
+}
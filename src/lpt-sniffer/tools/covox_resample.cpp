@@ -0,0 +1,518 @@
+/*
+ * PARALAX - Covox capture to band-limited PCM (host)
+ * ThisOldCPU Project - https://github.com/thisoldcpu
+ *
+ * Turns a capture's Covox writes into clean PCM at any rate, 48 kHz by
+ * default. The writes first become one sample per slot of the rate the
+ * program played at: PitClock finds the 8253 divisor behind them (as on
+ * the firmware), and while it holds the lock each write takes the slot it
+ * counts, so timestamp jitter never reaches the audio. Slots without a
+ * write repeat the held byte, as the DAC does. That stream then goes
+ * through the windowed-sinc polyphase resampler in polyphase.h, at the
+ * exact ratio between the timer rate and the output.
+ *
+ * Writes before the lock wait in a bounded queue. A program not paced by
+ * the PIT never locks; after PENDING writes the input rate is taken from
+ * the write intervals instead, and writes are placed on that grid by
+ * time. -i sets the input rate and skips the search. Stretches the lock
+ * does not cover (a pause, a rate change) are placed by time as well.
+ *
+ * Output is a 16-bit WAV (-o) or raw signed 16-bit little-endian PCM
+ * (-p, "-" for stdout), mono. -c removes DC (a 5 Hz high-pass): a Covox
+ * idles at mid-scale only if the program leaves it there. -q picks the
+ * filter: fast, good (default) or best. The input is read once, in
+ * constant memory.
+ *
+ * -t checks the resampler's SNR against a sine at several ratios for each
+ * preset, its stopband when decimating, and a jittered timer-paced 8-bit
+ * Covox stream end to end, then times each preset against real time.
+ *
+ * Build (add -mavx2 or -march=native for 8-lane vectors):
+ *   g++ -std=c++17 -O2 -Iinclude -Itools -o covox_resample tools/covox_resample.cpp \
+ *       src/pit_clock.cpp src/device_decoders.cpp src/cmslpt_decoder.cpp
+ *
+ * Usage:
+ *   covox_resample <capture.csv> [-o out.wav | -p out.raw] [-r rate] [-i rate]
+ *                  [-q fast|good|best] [-c]
+ *   covox_resample -t
+ *
+ * License : MIT
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+#include "capture_csv.h"
+#include "device_decoders.h"
+#include "pit_clock.h"
+#include "polyphase.h"
+#include "selftest.h"
+#include "wav_writer.h"
+
+// ---- Covox writes to a uniform stream ----
+
+class CovoxResample
+{
+public:
+  static constexpr uint32_t PENDING = 4096; // writes held while the rate is unknown
+
+  // in_mhz 0: find the rate
+  CovoxResample(ResampleSink &out, uint64_t out_mhz, ResampleQuality quality, uint64_t in_mhz)
+    : out_(out), out_mhz_(out_mhz), quality_(quality), forced_mhz_(in_mhz)
+  {
+    pending_.reserve(PENDING);
+  }
+
+  void on_write(uint32_t t_us, uint8_t value)
+  {
+    writes_++;
+    uint64_t t64 = clock_.extend(t_us);
+    int32_t off = 0;
+    bool locked = pit_.on_write(t_us, off);
+    double t = t64 + off / 65536.0;
+
+    if (!rs_)
+    {
+      if (forced_mhz_)
+        start(forced_mhz_, false, t);
+      else if (locked)
+        start(pit_.rate_mhz(), true, t);
+      else
+      {
+        pending_.push_back({t64, value});
+        if (pending_.size() == PENDING)
+          start(interval_rate_mhz(), false, t);
+        return;
+      }
+    }
+
+    // On the grid of the locked divisor since the last write: place by slot
+    bool by_slot = locked && locked_ && pit_.divisor() == divisor_ && pit_.relocks() == relocks_;
+    if (by_slot)
+    {
+      for (uint64_t k = pit_.slots() - slots_; k; --k)
+        hold();
+      grid_t_ = t;
+    }
+    else
+      place(t);
+    if (locked)
+    {
+      by_slot_writes_ += by_slot;
+      locked_writes_++;
+    }
+    held_ = value;
+    locked_ = locked;
+    slots_ = pit_.slots();
+    relocks_ = pit_.relocks();
+  }
+
+  void finish()
+  {
+    if (!rs_)
+    {
+      if (pending_.size() < 2 && !forced_mhz_)
+        return;
+      start(forced_mhz_ ? forced_mhz_ : interval_rate_mhz(), false, 0.0);
+    }
+    hold(); // the last write's own slot
+    rs_->flush();
+  }
+
+  uint64_t in_mhz() const { return in_mhz_; }
+  bool     from_pit() const { return from_pit_; }
+  uint32_t divisor() const { return divisor_; }
+  uint32_t writes() const { return writes_; }
+  uint32_t locked_writes() const { return locked_writes_; }
+  uint32_t by_slot_writes() const { return by_slot_writes_; }
+  uint64_t slots() const { return rs_ ? rs_->consumed() : 0; }
+  uint32_t taps() const { return rs_ ? rs_->taps() : 0; }
+  uint32_t phases() const { return rs_ ? rs_->phases() : 0; }
+  const PitClock &pit() const { return pit_; }
+
+private:
+  struct Write
+  {
+    uint64_t t_us;
+    uint8_t  value;
+  };
+
+  // t: the write that starts it, when no writes wait
+  void start(uint64_t in_mhz, bool from_pit, double t)
+  {
+    in_mhz_ = in_mhz;
+    from_pit_ = from_pit;
+    divisor_ = from_pit ? pit_.divisor() : 0;
+    period_us_ = 1e9 / in_mhz;
+    rs_.reset(new PolyphaseResampler(in_mhz, out_mhz_, quality_, out_));
+
+    // Writes that waited for the rate go on the grid by time
+    for (size_t i = 0; i < pending_.size(); ++i)
+    {
+      if (i == 0)
+        grid_t_ = (double)pending_[0].t_us;
+      else
+        place((double)pending_[i].t_us);
+      held_ = pending_[i].value;
+    }
+    if (pending_.empty())
+      grid_t_ = t;
+    pending_.clear();
+    pending_.shrink_to_fit();
+  }
+
+  // Slots up to the one nearest t hold the previous byte
+  void place(double t)
+  {
+    while (grid_t_ + period_us_ * 0.5 <= t)
+    {
+      hold();
+      grid_t_ += period_us_;
+    }
+  }
+
+  void hold() { rs_->push(((int32_t)held_ - 128) * 256.0f); }
+
+  // Rate from the write intervals: those near the median are one period
+  uint64_t interval_rate_mhz() const
+  {
+    std::vector<uint64_t> dt;
+    for (size_t i = 1; i < pending_.size(); ++i)
+      dt.push_back(pending_[i].t_us - pending_[i - 1].t_us);
+    if (dt.empty())
+      return out_mhz_;
+    std::vector<uint64_t> sorted = dt;
+    std::nth_element(sorted.begin(), sorted.begin() + sorted.size() / 2, sorted.end());
+    uint64_t median = std::max<uint64_t>(sorted[sorted.size() / 2], 1);
+    uint64_t sum = 0, n = 0;
+    for (uint64_t d : dt)
+      if (d * 4 >= median * 3 && d * 4 <= median * 5)
+      {
+        sum += d;
+        n++;
+      }
+    // Whole hertz: without a timer there is no finer rate to recover
+    return (uint64_t)(1e6 * n / sum + 0.5) * 1000;
+  }
+
+  ResampleSink   &out_;
+  uint64_t        out_mhz_;
+  ResampleQuality quality_;
+  uint64_t        forced_mhz_;
+
+  PitClock      pit_;
+  TimeUnwrapper clock_;
+  std::vector<Write> pending_;
+  std::unique_ptr<PolyphaseResampler> rs_;
+
+  uint64_t in_mhz_ = 0;
+  bool     from_pit_ = false;
+  uint32_t divisor_ = 0;
+  double   period_us_ = 0.0;
+  double   grid_t_ = 0.0;  // time of the next slot to push
+  uint8_t  held_ = 0x80;
+  bool     locked_ = false;
+  uint64_t slots_ = 0;
+  uint32_t relocks_ = 0;
+
+  uint32_t writes_ = 0;
+  uint32_t locked_writes_ = 0;
+  uint32_t by_slot_writes_ = 0;
+};
+
+// ---- Output ----
+
+class PcmOutput : public ResampleSink
+{
+public:
+  static constexpr double DC_HZ = 5.0;
+
+  PcmOutput(uint32_t rate_hz, bool dc_removal)
+    : dc_(dc_removal), r_((float)(1.0 - 2.0 * M_PI * DC_HZ / rate_hz))
+  {
+  }
+  ~PcmOutput()
+  {
+    if (raw_ && raw_ != stdout)
+      fclose(raw_);
+  }
+
+  bool open_wav(const char *path, uint32_t rate_hz) { return wav_.open(path, rate_hz, 1); }
+
+  bool open_raw(const char *path)
+  {
+    raw_ = strcmp(path, "-") ? fopen(path, "wb") : stdout;
+    if (raw_)
+      setvbuf(raw_, nullptr, _IOFBF, 1u << 20);
+    return raw_ != nullptr;
+  }
+
+  void on_block(const float *samples, uint32_t count) override
+  {
+    int16_t pcm[PolyphaseResampler::BLOCK];
+    for (uint32_t i = 0; i < count; ++i)
+    {
+      float x = samples[i];
+      if (dc_)
+      {
+        float y = x - x1_ + r_ * y1_;
+        x1_ = x;
+        y1_ = y;
+        x = y;
+      }
+      long v = lrintf(x);
+      if (v > 32767 || v < -32768)
+      {
+        clipped_++;
+        v = v > 0 ? 32767 : -32768;
+      }
+      pcm[i] = (int16_t)v;
+    }
+    frames_ += count;
+    if (raw_)
+    {
+      uint8_t bytes[PolyphaseResampler::BLOCK * 2];
+      for (uint32_t i = 0; i < count; ++i)
+      {
+        bytes[i * 2] = (uint8_t)pcm[i];
+        bytes[i * 2 + 1] = (uint8_t)((uint16_t)pcm[i] >> 8);
+      }
+      fwrite(bytes, 2, count, raw_);
+    }
+    else
+      wav_.write(pcm, count);
+  }
+
+  uint64_t frames() const { return frames_; }
+  uint64_t clipped() const { return clipped_; }
+
+private:
+  WavWriter wav_;
+  FILE     *raw_ = nullptr;
+  bool      dc_;
+  float     r_;
+  float     x1_ = 0.0f, y1_ = 0.0f;
+  uint64_t  frames_ = 0;
+  uint64_t  clipped_ = 0;
+};
+
+// ---- Self-test ----
+
+class Collect : public ResampleSink
+{
+public:
+  void on_block(const float *samples, uint32_t count) override { out.insert(out.end(), samples, samples + count); }
+  std::vector<float> out;
+};
+
+static std::vector<float> resample_sine(double in_hz, double out_hz, double tone_hz, ResampleQuality q,
+                                        double seconds)
+{
+  Collect c;
+  PolyphaseResampler rs((uint64_t)llround(in_hz * 1000), (uint64_t)llround(out_hz * 1000), q, c);
+  uint64_t n = (uint64_t)(in_hz * seconds);
+  for (uint64_t i = 0; i < n; ++i)
+    rs.push((float)(16384.0 * sin(2 * M_PI * tone_hz / in_hz * i)));
+  rs.flush();
+  return c.out;
+}
+
+static int selftest()
+{
+  SelfTest test("Covox Resample");
+
+  // SNR floor per preset, images and passband error included
+  static const double floor_db[RESAMPLE_QUALITY_COUNT] = {55.0, 75.0, 95.0};
+  struct Case
+  {
+    double in_hz, out_hz, tone_hz;
+  };
+  static const Case cases[] = {
+      {PitClock::PIT_HZ / 54.0, 48000.0, 1000.0},
+      {PitClock::PIT_HZ / 54.0, 48000.0, 8500.0},
+      {11025.0, 48000.0, 4000.0},
+      {48000.0, 44100.0, 15000.0},
+      {44100.0, 22050.0, 7000.0},
+  };
+  for (uint32_t q = 0; q < RESAMPLE_QUALITY_COUNT; ++q)
+  {
+    for (const Case &c : cases)
+    {
+      std::vector<float> y = resample_sine(c.in_hz, c.out_hz, c.tone_hz, (ResampleQuality)q, 0.5);
+      double snr = sine_snr_db(y, c.tone_hz / c.out_hz, 256);
+      char label[32];
+      snprintf(label, sizeof(label), "%-4s %5.0f>%5.0f", RESAMPLE_PRESETS[q].name, c.in_hz, c.out_hz);
+      test.check(snr >= floor_db[q], label, "%5.0f Hz tone, SNR %.1f dB (want %.0f)", c.tone_hz, snr, floor_db[q]);
+    }
+  }
+
+  // Decimating: a tone above the new Nyquist must not fold back
+  for (uint32_t q = 0; q < RESAMPLE_QUALITY_COUNT; ++q)
+  {
+    std::vector<float> y = resample_sine(48000.0, 22050.0, 15000.0, (ResampleQuality)q, 0.5);
+    double e = 0;
+    for (size_t i = 256; i + 256 < y.size(); ++i)
+      e += (double)y[i] * y[i];
+    double rms = sqrt(e / (y.size() - 512));
+    double db = 20.0 * log10(fmax(rms, 1e-9) / (16384.0 / sqrt(2.0)));
+    char label[32];
+    snprintf(label, sizeof(label), "%-4s stopband", RESAMPLE_PRESETS[q].name);
+    test.check(db <= -floor_db[q], label, "15 kHz at 48000>22050, %.1f dB (want %.0f)", db, -floor_db[q]);
+  }
+
+  // A timer-paced 8-bit Covox player with interrupt jitter and repeated bytes
+  {
+    Collect c;
+    CovoxResample cr(c, 48000000, RESAMPLE_GOOD, 0);
+    uint32_t divisor = 54;
+    double period = divisor * 1e6 / PitClock::PIT_HZ;
+    double tone = 1000.0;
+    TestRng rng;
+    int prev = -1;
+    for (uint32_t k = 0; k < (uint32_t)(2.0e6 / period); ++k)
+    {
+      int v = (int)lround(128.0 + 100.0 * sin(2 * M_PI * tone * k * period / 1e6));
+      double jitter = rng.unit() * 8.0;
+      if (v == prev)
+        continue; // no event for a repeated byte
+      prev = v;
+      cr.on_write((uint32_t)(1000.0 + k * period + jitter), (uint8_t)v);
+    }
+    cr.finish();
+    double snr = sine_snr_db(c.out, tone / 48000.0, 4800);
+    test.check(cr.divisor() == divisor && snr >= 40.0, "Covox 8-bit",
+               "divisor %u, %u of %u writes by slot, SNR %.1f dB (want 40)", cr.divisor(), cr.by_slot_writes(),
+               cr.writes(), snr);
+  }
+
+  // Speed: a minute of 22 kHz audio to 48 kHz
+  for (uint32_t q = 0; q < RESAMPLE_QUALITY_COUNT; ++q)
+  {
+    Collect c;
+    double in_hz = PitClock::PIT_HZ / 54.0;
+    PolyphaseResampler rs((uint64_t)llround(in_hz * 1000), 48000000, (ResampleQuality)q, c);
+    uint64_t n = (uint64_t)(in_hz * 60.0);
+    double t0 = now_secs();
+    for (uint64_t i = 0; i < n; ++i)
+    {
+      rs.push((float)((int32_t)(i * 2654435761u >> 24) - 128) * 256.0f);
+      if (c.out.size() > 1u << 16)
+        c.out.clear();
+    }
+    rs.flush();
+    double secs = now_secs() - t0;
+    char label[32];
+    snprintf(label, sizeof(label), "%-4s speed", RESAMPLE_PRESETS[q].name);
+    test.info(label, "%u taps, 60 s in %.3f s, %.0fx real time", rs.taps(), secs, secs > 0 ? 60.0 / secs : 0.0);
+  }
+
+  return test.finish();
+}
+
+// ---- Capture ----
+
+int main(int argc, char **argv)
+{
+  const char *in_path = nullptr;
+  const char *wav_path = nullptr;
+  const char *raw_path = nullptr;
+  uint32_t out_hz = 48000;
+  double in_hz = 0.0;
+  ResampleQuality quality = RESAMPLE_GOOD;
+  bool dc = false;
+  bool test = false;
+  bool usage = false;
+
+  for (int i = 1; i < argc; ++i)
+  {
+    if (!strcmp(argv[i], "-o") && i + 1 < argc)
+      wav_path = argv[++i];
+    else if (!strcmp(argv[i], "-p") && i + 1 < argc)
+      raw_path = argv[++i];
+    else if (!strcmp(argv[i], "-r") && i + 1 < argc)
+      out_hz = (uint32_t)atoi(argv[++i]);
+    else if (!strcmp(argv[i], "-i") && i + 1 < argc)
+      in_hz = atof(argv[++i]);
+    else if (!strcmp(argv[i], "-q") && i + 1 < argc)
+    {
+      const char *name = argv[++i];
+      uint32_t q = 0;
+      while (q < RESAMPLE_QUALITY_COUNT && strcmp(name, RESAMPLE_PRESETS[q].name))
+        q++;
+      usage = usage || q == RESAMPLE_QUALITY_COUNT;
+      quality = (ResampleQuality)(q % RESAMPLE_QUALITY_COUNT);
+    }
+    else if (!strcmp(argv[i], "-c"))
+      dc = true;
+    else if (!strcmp(argv[i], "-t"))
+      test = true;
+    else if (!in_path)
+      in_path = argv[i];
+  }
+  if (test)
+    return selftest();
+  if (!in_path || usage || out_hz < 8000 || out_hz > 192000 || in_hz < 0.0 || (wav_path && raw_path))
+  {
+    fprintf(stderr, "Usage: covox_resample <capture.csv> [-o out.wav | -p out.raw] [-r rate] [-i rate]\n"
+                    "                      [-q fast|good|best] [-c]\n"
+                    "       covox_resample -t\n");
+    return 1;
+  }
+
+  CsvCaptureReader reader;
+  if (!reader.open(in_path))
+  {
+    fprintf(stderr, "Error: cannot open '%s'\n", in_path);
+    return 1;
+  }
+  PcmOutput out(out_hz, dc);
+  if ((wav_path && !out.open_wav(wav_path, out_hz)) || (raw_path && !out.open_raw(raw_path)))
+  {
+    fprintf(stderr, "Error: cannot write '%s'\n", wav_path ? wav_path : raw_path);
+    return 1;
+  }
+
+  double t0 = now_secs();
+  CovoxDecoder covox;
+  CovoxResample cr(out, (uint64_t)out_hz * 1000, quality, (uint64_t)llround(in_hz * 1000));
+  CaptureFrame f;
+  DeviceEvent e;
+  while (reader.next(f))
+    if (covox.feed(f, e))
+      cr.on_write(e.t_us, e.value);
+  cr.finish();
+  double secs = now_secs() - t0;
+
+  double audio = (double)out.frames() / out_hz;
+  fprintf(stderr, "=== Covox Resample ===\n");
+  fprintf(stderr, "Frames          : %llu\n", (unsigned long long)reader.frames());
+  fprintf(stderr, "Covox writes    : %u\n", cr.writes());
+  if (!cr.in_mhz())
+  {
+    fprintf(stderr, "Input rate      : none (fewer than two writes)\n");
+    return 0;
+  }
+  if (cr.from_pit())
+    fprintf(stderr, "Input rate      : %llu.%03u Hz (PIT divisor %u)\n", (unsigned long long)(cr.in_mhz() / 1000),
+            (uint32_t)(cr.in_mhz() % 1000), cr.divisor());
+  else
+    fprintf(stderr, "Input rate      : %llu Hz (%s)\n", (unsigned long long)(cr.in_mhz() / 1000),
+            in_hz > 0.0 ? "-i" : "write intervals, no PIT divisor");
+  fprintf(stderr, "Placement       : %u writes by timer slot, %u by time\n", cr.by_slot_writes(),
+          cr.writes() - cr.by_slot_writes());
+  fprintf(stderr, "Filter          : %s, %u taps, %u phases\n", RESAMPLE_PRESETS[quality].name, cr.taps(),
+          cr.phases());
+  fprintf(stderr, "Output          : %llu frames at %u Hz (%.1f s)%s, %llu clipped\n",
+          (unsigned long long)out.frames(), out_hz, audio, dc ? ", DC removed" : "",
+          (unsigned long long)out.clipped());
+  fprintf(stderr, "Speed           : %.3f s, %.0fx real time\n", secs, secs > 0 ? audio / secs : 0.0);
+  if (wav_path || raw_path)
+    fprintf(stderr, "%-16s: %s\n", wav_path ? "WAV" : "Raw PCM", wav_path ? wav_path : raw_path);
+  return 0;
+}
@@ -0,0 +1,558 @@
+/*
+ * PARALAX - CSV to columnar capture converter (host)
+ * ThisOldCPU Project - https://github.com/thisoldcpu
+ *
+ * Turns a sniffer CSV capture into a .plx file (tools/plx.h): the same
+ * frames at about 5 bytes each, in column chunks a decoder can read
+ * independently. Comments, the banner, statistics blocks and anything else
+ * that is not a frame are skipped, exactly as CsvCaptureReader skips them.
+ *
+ * The input is mapped and cut into UNIT_BYTES work units at line ends;
+ * -j worker threads take units in turn, parse them and encode their
+ * chunks, and the main thread writes the units in file order. Each unit
+ * unwraps its timestamps on its own; the writer carries the wrap across
+ * units, which only moves chunk headers since the time column holds
+ * deltas. At most WINDOW_PER_THREAD units per thread are in flight, so
+ * memory does not grow with the input.
+ *
+ * A frame line is parsed without scanning it byte by byte: after the
+ * timestamp digits, the fixed 21-byte tail ",HH,b,b,b,b,b,b,b,b,b" is
+ * loaded as one 32-byte vector, its ten commas and nine 0/1 columns are
+ * checked with one mask-and-compare, the nine lines are gathered with a
+ * multiply and an OR, the two hex digits go through a table, and the line
+ * end must follow at a fixed place. Anything else (comments, compact or
+ * single-digit lines, a short read at the end) goes the slow way: memchr()
+ * to the line end and CsvCaptureReader::parse_line().
+ *
+ * -t checks every combination of threads, unit sizes and line forms
+ * against CsvCaptureReader, frame for frame, and times a 64 MB capture.
+ *
+ * Build:
+ *   g++ -std=c++17 -O2 -march=native -pthread -Iinclude -Itools -o csv2plx tools/csv2plx.cpp
+ *
+ * Usage:
+ *   csv2plx [-j threads] [-c chunk_frames] <capture.csv> <capture.plx>
+ *   csv2plx -t
+ *
+ * License : MIT
+ */
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "capture_csv.h"
+#include "plx.h"
+#include "selftest.h"
+
+typedef uint8_t u8x32 __attribute__((vector_size(32)));
+
+static constexpr size_t UNIT_BYTES = 8u << 20;
+static constexpr uint32_t WINDOW_PER_THREAD = 2;
+
+// ---- Frame line tail: ",HH,b,b,b,b,b,b,b,b,b" then "\n" or "\r\n" ----
+
+static constexpr uint32_t TAIL_BYTES = 21;
+
+// Commas must match exactly; a 0/1 column matches '0' with its low bit masked
+static const u8x32 TAIL_MASK = {0xff, 0,    0,    0xff, 0xfe, 0xff, 0xfe, 0xff, 0xfe, 0xff, 0xfe,
+                                0xff, 0xfe, 0xff, 0xfe, 0xff, 0xfe, 0xff, 0xfe, 0xff, 0xfe};
+static const u8x32 TAIL_PATTERN = {',', 0,   0,   ',', '0', ',', '0', ',', '0', ',', '0',
+                                   ',', '0', ',', '0', ',', '0', ',', '0', ',', '0'};
+
+// Lines 0-7 land on distinct bits, so OR-ing the lanes adds them up
+static const u8x32 TAIL_WEIGHT = {0, 0, 0, 0, 1, 0, 2, 0, 4, 0, 8, 0, 16, 0, 32, 0, 64, 0, 128};
+
+struct HexTable
+{
+  uint8_t v[256];
+
+  HexTable()
+  {
+    memset(v, 0xff, sizeof(v));
+    for (uint32_t i = 0; i < 10; ++i)
+      v['0' + i] = (uint8_t)i;
+    for (uint32_t i = 0; i < 6; ++i)
+      v['A' + i] = v['a' + i] = (uint8_t)(10 + i);
+  }
+};
+
+static const HexTable HEX;
+
+static inline uint64_t or_lanes(const u8x32 &v)
+{
+  uint64_t w[4];
+  memcpy(w, &v, sizeof(w));
+  return w[0] | w[1] | w[2] | w[3];
+}
+
+// ---- One work unit ----
+
+struct UnitResult
+{
+  std::vector<PlxChunk> chunks;
+  uint64_t frames = 0;
+  uint64_t skipped = 0;
+  uint32_t first_t_us = 0;
+  uint32_t last_t_us = 0;
+  uint64_t high = 0; // the unit's own unwrap at its end
+  bool     done = false;
+};
+
+class UnitParser
+{
+public:
+  UnitParser(UnitResult &r, uint32_t chunk_frames) : r_(r), chunk_frames_(chunk_frames) {}
+
+  // Parses [p, e); p is a line start, e a line start or the end of the file
+  void parse(const char *p, const char *e)
+  {
+    while (p < e)
+    {
+      if ((unsigned)(*p - '0') <= 9)
+      {
+        const char *q = p;
+        uint32_t t = 0;
+        while (q < e && (unsigned)(*q - '0') <= 9)
+          t = t * 10u + (uint32_t)(*q++ - '0');
+        uint32_t ns = 0;
+        if (q < e && *q == '.')
+        {
+          ++q;
+          uint32_t scale = 100;
+          while (q < e && (unsigned)(*q - '0') <= 9)
+          {
+            ns += (uint32_t)(*q++ - '0') * scale;
+            scale /= 10;
+          }
+        }
+
+        if (e - q >= (ptrdiff_t)sizeof(u8x32))
+        {
+          u8x32 v;
+          memcpy(&v, q, sizeof(v));
+          uint32_t hi = HEX.v[v[1]];
+          uint32_t lo = HEX.v[v[2]];
+          size_t len = v[TAIL_BYTES] == '\n' ? TAIL_BYTES + 1
+                     : (v[TAIL_BYTES] == '\r' && v[TAIL_BYTES + 1] == '\n') ? TAIL_BYTES + 2
+                     : 0;
+          if (len && (hi | lo) < 16 && !or_lanes((v & TAIL_MASK) ^ TAIL_PATTERN))
+          {
+            uint64_t low8 = or_lanes((v & 1) * TAIL_WEIGHT);
+            low8 |= low8 >> 32;
+            low8 |= low8 >> 16;
+            low8 |= low8 >> 8;
+            uint16_t bits = (uint16_t)((low8 & 0xff) | ((v[TAIL_BYTES - 1] & 1u) << 8));
+            add(t, csv_ns_to_t_sub(ns), (uint8_t)((hi << 4) | lo), bits);
+            p = q + len;
+            continue;
+          }
+        }
+      }
+
+      const char *nl = (const char *)memchr(p, '\n', (size_t)(e - p));
+      const char *line_end = nl ? nl : e;
+      CaptureFrame f;
+      if (CsvCaptureReader::parse_line(p, (size_t)(line_end - p), f))
+        add(f.t_us, f.t_sub, f.data, f.bits);
+      else
+        r_.skipped++;
+      p = nl ? nl + 1 : e;
+    }
+    if (!r_.chunks.empty())
+      r_.chunks.back().finish();
+    r_.high = clock_.high;
+  }
+
+private:
+  void add(uint32_t t_us, uint8_t t_sub, uint8_t data, uint16_t bits)
+  {
+    if (!r_.frames)
+      r_.first_t_us = t_us;
+    r_.last_t_us = t_us;
+    r_.frames++;
+    if (r_.chunks.empty() || r_.chunks.back().frames == chunk_frames_)
+    {
+      if (!r_.chunks.empty())
+        r_.chunks.back().finish();
+      r_.chunks.emplace_back();
+      r_.chunks.back().columns[PLX_COL_TIME].reserve(chunk_frames_ * 2);
+      r_.chunks.back().columns[PLX_COL_DATA].reserve(chunk_frames_);
+    }
+    r_.chunks.back().add((clock_.extend(t_us) << 8) | t_sub, data, bits);
+  }
+
+  UnitResult   &r_;
+  uint32_t      chunk_frames_;
+  TimeUnwrapper clock_;
+};
+
+// ---- Conversion ----
+
+struct ConvertConfig
+{
+  uint32_t threads = 1;
+  uint32_t chunk_frames = PLX_CHUNK_FRAMES;
+  size_t   unit_bytes = UNIT_BYTES;
+};
+
+struct ConvertStats
+{
+  uint64_t in_bytes = 0;
+  uint64_t out_bytes = 0;
+  uint64_t frames = 0;
+  uint64_t skipped = 0;
+  uint32_t chunks = 0;
+  uint32_t units = 0;
+  double   secs = 0.0;
+};
+
+class Converter
+{
+public:
+  explicit Converter(const ConvertConfig &cfg) : cfg_(cfg) {}
+
+  bool run(const char *in_path, const char *out_path, ConvertStats &st)
+  {
+    auto t0 = std::chrono::steady_clock::now();
+    int fd = open(in_path, O_RDONLY);
+    if (fd < 0)
+    {
+      fprintf(stderr, "Cannot open %s\n", in_path);
+      return false;
+    }
+    struct stat sb;
+    if (fstat(fd, &sb) != 0)
+    {
+      close(fd);
+      return false;
+    }
+    size_ = (size_t)sb.st_size;
+    base_ = nullptr;
+    if (size_)
+    {
+      void *m = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (m == MAP_FAILED)
+      {
+        fprintf(stderr, "Cannot map %s\n", in_path);
+        close(fd);
+        return false;
+      }
+      base_ = (const char *)m;
+      madvise(m, size_, MADV_SEQUENTIAL);
+    }
+    close(fd);
+
+    PlxWriter out;
+    if (!out.create(out_path, cfg_.chunk_frames))
+    {
+      fprintf(stderr, "Cannot create %s\n", out_path);
+      unmap();
+      return false;
+    }
+
+    units_ = (uint32_t)((size_ + cfg_.unit_bytes - 1) / cfg_.unit_bytes);
+    results_.assign(units_, UnitResult());
+    next_unit_ = 0;
+    written_ = 0;
+
+    uint32_t threads = cfg_.threads ? cfg_.threads : 1;
+    std::vector<std::thread> workers;
+    for (uint32_t i = 0; i < threads; ++i)
+      workers.emplace_back(&Converter::work, this, threads);
+
+    // Units in file order, the wrap carried from one to the next
+    TimeUnwrapper clock;
+    for (uint32_t u = 0; u < units_; ++u)
+    {
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        done_cv_.wait(lock, [&] { return results_[u].done; });
+      }
+      UnitResult &r = results_[u];
+      if (r.frames)
+      {
+        clock.extend(r.first_t_us);
+        uint64_t offset = clock.high;
+        for (PlxChunk &c : r.chunks)
+        {
+          c.shift(offset << 8);
+          out.write_chunk(c);
+        }
+        clock.high = offset + r.high;
+        clock.last = r.last_t_us;
+      }
+      st.frames += r.frames;
+      st.skipped += r.skipped;
+      r = UnitResult();
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        written_ = u + 1;
+      }
+      window_cv_.notify_all();
+    }
+    for (std::thread &w : workers)
+      w.join();
+
+    st.chunks = out.chunks();
+    bool ok = out.close();
+    st.out_bytes = out.bytes();
+    st.in_bytes = size_;
+    st.units = units_;
+    st.secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    unmap();
+    if (!ok)
+      fprintf(stderr, "Write failed: %s\n", out_path);
+    return ok;
+  }
+
+private:
+  // First line start at or after byte u * unit_bytes
+  size_t unit_start(uint32_t u) const
+  {
+    if (u == 0)
+      return 0;
+    size_t at = (size_t)u * cfg_.unit_bytes;
+    if (at >= size_)
+      return size_;
+    const char *nl = (const char *)memchr(base_ + at - 1, '\n', size_ - (at - 1));
+    return nl ? (size_t)(nl - base_) + 1 : size_;
+  }
+
+  void work(uint32_t threads)
+  {
+    for (;;)
+    {
+      uint32_t u = next_unit_.fetch_add(1);
+      if (u >= units_)
+        return;
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        window_cv_.wait(lock, [&] { return u < written_ + threads * WINDOW_PER_THREAD; });
+      }
+      UnitResult r;
+      size_t a = unit_start(u);
+      size_t b = unit_start(u + 1);
+      if (a < b)
+      {
+        UnitParser parser(r, cfg_.chunk_frames);
+        parser.parse(base_ + a, base_ + b);
+      }
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        r.done = true;
+        results_[u] = std::move(r);
+      }
+      done_cv_.notify_all();
+    }
+  }
+
+  void unmap()
+  {
+    if (base_)
+      munmap((void *)base_, size_);
+    base_ = nullptr;
+  }
+
+  ConvertConfig cfg_;
+  const char   *base_ = nullptr;
+  size_t        size_ = 0;
+  uint32_t      units_ = 0;
+
+  std::vector<UnitResult> results_;
+  std::atomic<uint32_t>   next_unit_{0};
+  uint32_t                written_ = 0;
+  std::mutex              mutex_;
+  std::condition_variable done_cv_;
+  std::condition_variable window_cv_;
+};
+
+static void print_stats(const ConvertConfig &cfg, const ConvertStats &st)
+{
+  fprintf(stderr, "=== CSV to PLX ===\n");
+  fprintf(stderr, "Input           : %llu bytes\n", (unsigned long long)st.in_bytes);
+  fprintf(stderr, "Frames          : %llu (%llu lines skipped)\n", (unsigned long long)st.frames,
+          (unsigned long long)st.skipped);
+  fprintf(stderr, "Chunks          : %u of up to %u frames\n", st.chunks, cfg.chunk_frames);
+  fprintf(stderr, "Output          : %llu bytes, %.2f bytes/frame (%.1f%% of the CSV)\n",
+          (unsigned long long)st.out_bytes, st.frames ? (double)st.out_bytes / (double)st.frames : 0.0,
+          st.in_bytes ? st.out_bytes * 100.0 / (double)st.in_bytes : 0.0);
+  fprintf(stderr, "Threads         : %u, %u units of %zu KB\n", cfg.threads, st.units, cfg.unit_bytes >> 10);
+  fprintf(stderr, "Time            : %.2f s, %.1f MB/s, %.1f M frames/s\n", st.secs,
+          st.secs > 0 ? st.in_bytes / st.secs / 1e6 : 0.0, st.secs > 0 ? st.frames / st.secs / 1e6 : 0.0);
+}
+
+// ---- Self-test ----
+
+struct TestFrame
+{
+  uint64_t ticks;
+  uint8_t  data;
+  uint16_t bits;
+
+  bool operator==(const TestFrame &o) const { return ticks == o.ticks && data == o.data && bits == o.bits; }
+};
+
+// Every chunk through PlxReader; false on any inconsistency, or if the
+// trailer had to be recovered
+static bool decode_plx(const std::vector<uint8_t> &f, std::vector<TestFrame> &frames)
+{
+  frames.clear();
+  PlxReader reader;
+  if (!reader.open(f.data(), f.size()) || reader.recovered())
+    return false;
+  PlxFrames cols;
+  for (uint32_t i = 0; i < reader.chunks(); ++i)
+  {
+    if (!reader.read(i, PLX_COLS_ALL, cols))
+      return false;
+    for (uint32_t k = 0; k < cols.count; ++k)
+      frames.push_back({cols.ticks[k], cols.data[k], cols.bits[k]});
+  }
+  return frames.size() == reader.frames();
+}
+
+static int self_test()
+{
+  TestDir dir("csv2plx");
+  if (!dir.made())
+    return 1;
+  std::string csv_path = dir.file("test.csv");
+  std::string plx_path = dir.file("test.plx");
+  SelfTest test("CSV to PLX");
+
+  std::string csv = make_test_csv(200000, 0x1234567u);
+  write_file(csv_path, csv.data(), csv.size());
+
+  // The reference: the reader every other tool uses
+  std::vector<TestFrame> want;
+  CsvCaptureReader reader;
+  reader.open(csv_path.c_str());
+  TimeUnwrapper clock;
+  CaptureFrame f;
+  while (reader.next(f))
+    want.push_back({(clock.extend(f.t_us) << 8) | f.t_sub, f.data, f.bits});
+  uint64_t want_skipped = reader.skipped_lines();
+  reader.close();
+  test.info("Reference", "%zu frames, %llu lines skipped", want.size(), (unsigned long long)want_skipped);
+
+  std::vector<uint8_t> first_file;
+  const uint32_t thread_counts[] = {1, 2, 5};
+  const size_t unit_sizes[] = {4096, 65536, UNIT_BYTES};
+  for (size_t unit : unit_sizes)
+  {
+    for (uint32_t threads : thread_counts)
+    {
+      ConvertConfig cfg;
+      cfg.threads = threads;
+      cfg.chunk_frames = 1000;
+      cfg.unit_bytes = unit;
+      ConvertStats st;
+      Converter conv(cfg);
+      bool pass = conv.run(csv_path.c_str(), plx_path.c_str(), st);
+      std::vector<uint8_t> file = read_file(plx_path);
+      std::vector<TestFrame> got;
+      pass = pass && decode_plx(file, got) && got == want && st.skipped == want_skipped;
+      if (threads == thread_counts[0])
+        first_file = file;
+      else
+        pass = pass && file == first_file; // the thread count never shows
+      char label[32];
+      snprintf(label, sizeof(label), "Units %zu KB x%u", unit >> 10, threads);
+      test.check(pass, label, "%llu frames, %llu skipped, %u chunks", (unsigned long long)st.frames,
+                 (unsigned long long)st.skipped, st.chunks);
+    }
+  }
+
+  // A flipped bit anywhere in a chunk is caught
+  {
+    std::vector<uint8_t> file = read_file(plx_path);
+    uint32_t checked = 0, caught = 0;
+    for (size_t at = PLX_FILE_HEADER_BYTES; at < PLX_FILE_HEADER_BYTES + 4096; at += 37, ++checked)
+    {
+      file[at] ^= 0x10;
+      std::vector<TestFrame> got;
+      if (!decode_plx(file, got))
+        caught++;
+      file[at] ^= 0x10;
+    }
+    test.check(caught == checked, "Corruption", "%u of %u caught", caught, checked);
+  }
+
+  // Throughput on firmware-style lines
+  {
+    std::string big;
+    big.reserve(72u << 20);
+    TestRng rng(99);
+    uint32_t t = 0;
+    char line[64];
+    while (big.size() < (64u << 20))
+    {
+      t += 45;
+      snprintf(line, sizeof(line), "%u,%02X,1,1,0,1,1,0,0,1,0\n", t, rng.next() & 0xff);
+      big += line;
+    }
+    write_file(csv_path, big.data(), big.size());
+    big = std::string();
+
+    ConvertConfig cfg;
+    cfg.threads = std::thread::hardware_concurrency() ? std::thread::hardware_concurrency() : 1;
+    ConvertStats st;
+    Converter conv(cfg);
+    bool pass = conv.run(csv_path.c_str(), plx_path.c_str(), st);
+    print_stats(cfg, st);
+    test.check(pass, "Throughput", "64 MB of firmware lines");
+  }
+
+  return test.finish();
+}
+
+int main(int argc, char **argv)
+{
+  ConvertConfig cfg;
+  cfg.threads = std::thread::hardware_concurrency() ? std::thread::hardware_concurrency() : 1;
+  int opt;
+  while ((opt = getopt(argc, argv, "j:c:t")) != -1)
+  {
+    switch (opt)
+    {
+    case 'j':
+      cfg.threads = (uint32_t)atoi(optarg);
+      break;
+    case 'c':
+      cfg.chunk_frames = (uint32_t)atoi(optarg);
+      break;
+    case 't':
+      return self_test();
+    default:
+      argc = 0;
+      break;
+    }
+  }
+  if (argc - optind != 2 || cfg.threads < 1 || cfg.chunk_frames < 1)
+  {
+    fprintf(stderr, "Usage: csv2plx [-j threads] [-c chunk_frames] <capture.csv> <capture.plx>\n"
+                    "       csv2plx -t\n\n"
+                    "Converts a PARALAX CSV capture to the columnar .plx format\n");
+    return 1;
+  }
+
+  ConvertStats st;
+  Converter conv(cfg);
+  if (!conv.run(argv[optind], argv[optind + 1], st))
+    return 1;
+  print_stats(cfg, st);
+  return 0;
+}
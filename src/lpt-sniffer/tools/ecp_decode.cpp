@@ -0,0 +1,141 @@
+/*
+ * PARALAX - IEEE 1284 ECP capture decoder (host)
+ * ThisOldCPU Project - https://github.com/thisoldcpu
+ *
+ * Tracks forward/reverse phases, separates command from data cycles,
+ * expands run-length commands and writes the logical byte stream of each
+ * direction. Reports wire vs logical volume, compression ratio and
+ * effective throughput. Capture with the PIO_CHANGE profile.
+ *
+ * Build:
+ *   g++ -std=c++17 -O2 -Iinclude -o ecp_decode tools/ecp_decode.cpp src/ecp_decoder.cpp
+ *
+ * Usage:
+ *   ecp_decode <capture.csv> [-f forward.bin] [-r reverse.bin] [-l]
+ *     -f/-r  write the expanded forward/reverse byte stream
+ *     -l     list events as t_us,dir,item,value,run,cycle_ns on stdout
+ *
+ * License : MIT
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "capture_csv.h"
+#include "ecp_decoder.h"
+
+int main(int argc, char **argv)
+{
+  const char *in_path = nullptr;
+  const char *out_path[2] = {nullptr, nullptr};
+  bool list = false;
+
+  for (int i = 1; i < argc; ++i)
+  {
+    if (!strcmp(argv[i], "-f") && i + 1 < argc)
+      out_path[ECP_FORWARD] = argv[++i];
+    else if (!strcmp(argv[i], "-r") && i + 1 < argc)
+      out_path[ECP_REVERSE] = argv[++i];
+    else if (!strcmp(argv[i], "-l"))
+      list = true;
+    else if (!in_path)
+      in_path = argv[i];
+  }
+  if (!in_path)
+  {
+    fprintf(stderr, "Usage: ecp_decode <capture.csv> [-f forward.bin] [-r reverse.bin] [-l]\n");
+    return 1;
+  }
+
+  CsvCaptureReader reader;
+  if (!reader.open(in_path))
+  {
+    fprintf(stderr, "Error: cannot open '%s'\n", in_path);
+    return 1;
+  }
+
+  FILE *out[2] = {nullptr, nullptr};
+  for (uint8_t dir = 0; dir < 2; ++dir)
+  {
+    if (out_path[dir] && !(out[dir] = fopen(out_path[dir], "wb")))
+    {
+      fprintf(stderr, "Error: cannot write '%s'\n", out_path[dir]);
+      return 1;
+    }
+  }
+
+  static const char *DIR_NAME[2] = {"forward", "reverse"};
+
+  EcpDecoder dec;
+  TimeUnwrapper clock;
+  uint64_t first_t[2] = {0, 0}, last_t[2] = {0, 0};
+  uint64_t cycle_ns_sum[2] = {0, 0};
+  uint32_t data_cycles[2] = {0, 0}, channels[2] = {0, 0};
+  uint8_t run_buf[128];
+
+  CaptureFrame f;
+  EcpEvent e;
+  while (reader.next(f))
+  {
+    uint64_t t = clock.extend(f.t_us);
+    if (!dec.feed(f, e))
+      continue;
+
+    if (data_cycles[e.dir] + channels[e.dir] == 0)
+      first_t[e.dir] = t;
+    last_t[e.dir] = t;
+    cycle_ns_sum[e.dir] += e.cycle_ns;
+
+    if (e.item == ECP_ITEM_CHANNEL)
+    {
+      channels[e.dir]++;
+    }
+    else
+    {
+      data_cycles[e.dir]++;
+      if (out[e.dir])
+      {
+        memset(run_buf, e.value, e.run);
+        fwrite(run_buf, 1, e.run, out[e.dir]);
+      }
+    }
+
+    if (list)
+    {
+      printf("%u.%03u,%s,%s,%02X,%u,%u\n", e.t_us, ((uint32_t)e.t_sub * 1000u) >> 8, DIR_NAME[e.dir],
+             e.item == ECP_ITEM_CHANNEL ? "channel" : "data", e.value, e.run, e.cycle_ns);
+    }
+  }
+
+  for (uint8_t dir = 0; dir < 2; ++dir)
+    if (out[dir])
+      fclose(out[dir]);
+
+  fprintf(stderr, "=== ECP Decode ===\n");
+  fprintf(stderr, "Phase changes   : %u\n", dec.phase_changes());
+  fprintf(stderr, "Violations      : %u\n", dec.violations());
+
+  for (uint8_t dir = 0; dir < 2; ++dir)
+  {
+    uint32_t wire = dec.wire_cycles(dir);
+    if (wire == 0)
+      continue;
+
+    // Wire bytes include run-length and channel commands
+    uint64_t logical = dec.logical_bytes(dir);
+    double span_s = (double)(last_t[dir] - first_t[dir]) / 1e6;
+
+    fprintf(stderr, "\n=== %s ===\n", dir == ECP_FORWARD ? "Forward (host -> peripheral)" : "Reverse (peripheral -> host)");
+    fprintf(stderr, "Wire cycles     : %u (%u data, %u RLE, %u channel)\n", wire, data_cycles[dir],
+            dec.rle_commands(dir), channels[dir]);
+    fprintf(stderr, "Logical bytes   : %llu\n", (unsigned long long)logical);
+    fprintf(stderr, "Compression     : %.2f : 1\n", (double)logical / (double)wire);
+    fprintf(stderr, "Mean cycle      : %.0f ns\n", (double)cycle_ns_sum[dir] / (double)(data_cycles[dir] + channels[dir]));
+    if (span_s > 0)
+    {
+      fprintf(stderr, "Wire rate       : %.0f KB/s\n", (double)wire / span_s / 1e3);
+      fprintf(stderr, "Effective rate  : %.0f KB/s\n", (double)logical / span_s / 1e3);
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,249 @@
+/*
+ * PARALAX - IEEE 1284 multi-mode capture decoder (host)
+ * ThisOldCPU Project - https://github.com/thisoldcpu
+ *
+ * Follows negotiations through a capture and switches decoders at the
+ * frame where each mode takes effect: compatibility bytes are counted,
+ * nibble/byte mode reverse data and EPP/ECP traffic are decoded, every
+ * transition is listed. A negotiation that requests the Device ID is
+ * followed by the ID string, which is printed.
+ *
+ * Build:
+ *   g++ -std=c++17 -O2 -Iinclude -o ieee1284_decode tools/ieee1284_decode.cpp \
+ *       src/ieee1284_tracker.cpp src/epp_decoder.cpp src/ecp_decoder.cpp \
+ *       src/reverse_decoder.cpp
+ *
+ * Usage:
+ *   ieee1284_decode <capture.csv> [-r reverse.bin] [-l]
+ *     -r  write the nibble/byte mode reverse stream (Device IDs included)
+ *     -l  also list decoded reverse/EPP/ECP events on stdout
+ *
+ * License : MIT
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "capture_csv.h"
+#include "ieee1284_tracker.h"
+
+// Bytes moved in one direction, all modes together
+struct DirStats
+{
+  uint64_t bytes = 0;
+  uint64_t first_t = 0;
+  uint64_t last_t = 0;
+  TimeUnwrapper clock;
+
+  void add(uint32_t t_us, uint32_t n)
+  {
+    uint64_t t = clock.extend(t_us);
+    if (bytes == 0)
+      first_t = t;
+    last_t = t;
+    bytes += n;
+  }
+};
+
+class ReportSink : public Ieee1284Sink
+{
+public:
+  ReportSink(bool list, FILE *rev_out) : list_(list), rev_out_(rev_out) {}
+
+  void on_transition(const Ieee1284Transition &t) override
+  {
+    if (id_active_)
+      print_device_id(true);
+
+    printf("# %u us: %s -> %s", t.t_us, ieee1284_mode_name(t.from), ieee1284_mode_name(t.to));
+    if (t.from == M1284_COMPAT)
+    {
+      printf(" (ext 0x%02X%s%s)", t.ext, t.device_id ? ", device ID" : "", t.accepted ? "" : ", refused");
+    }
+    printf("\n");
+
+    // The ID follows in whichever reverse mode carried the request
+    if (t.device_id && t.accepted && (t.to == M1284_NIBBLE || t.to == M1284_BYTE))
+    {
+      id_active_ = true;
+      id_len_ = 0;
+    }
+    compat_prev_ = FRAME_BITS_IDLE;
+  }
+
+  void on_compat_frame(const CaptureFrame &f) override
+  {
+    compat_frames++;
+    if (bit_fell(compat_prev_, f.bits, FB_STROBE))
+      forward.add(f.t_us, 1);
+    compat_prev_ = f.bits;
+  }
+
+  void on_reverse(Ieee1284Mode mode, const ReverseByte &b) override
+  {
+    events[mode]++;
+    reverse.add(b.t_us, 1);
+    if (rev_out_)
+      fputc(b.value, rev_out_);
+
+    if (id_active_)
+    {
+      if (id_len_ < sizeof(id_))
+        id_[id_len_] = b.value;
+      id_len_++;
+      if (id_len_ >= 2 && id_len_ >= device_id_length())
+        print_device_id(false);
+    }
+
+    if (list_)
+    {
+      printf("%u.%03u,%s,%02X,%u\n", b.t_us, ((uint32_t)b.t_sub * 1000u) >> 8, ieee1284_mode_name(mode), b.value,
+             b.byte_ns);
+    }
+  }
+
+  void on_epp(const EppCycle &c) override
+  {
+    events[M1284_EPP]++;
+    (c.dir == EPP_READ ? reverse : forward).add(c.t_us, 1);
+    if (list_)
+    {
+      printf("%u,EPP,%s,%s,%02X,%u\n", c.t_us, c.type == EPP_ADDR ? "addr" : "data",
+             c.dir == EPP_READ ? "read" : "write", c.value, c.cycle_ns);
+    }
+  }
+
+  void on_ecp(const EcpEvent &e) override
+  {
+    events[M1284_ECP]++;
+    if (e.item == ECP_ITEM_DATA)
+      (e.dir == ECP_REVERSE ? reverse : forward).add(e.t_us, e.run);
+    if (list_)
+    {
+      printf("%u,ECP,%s,%s,%02X,%u\n", e.t_us, e.dir == ECP_REVERSE ? "reverse" : "forward",
+             e.item == ECP_ITEM_CHANNEL ? "channel" : "data", e.value, e.run);
+    }
+  }
+
+  void finish()
+  {
+    if (id_active_)
+      print_device_id(true);
+  }
+
+  uint64_t compat_frames = 0;
+  uint64_t events[5] = {0, 0, 0, 0, 0};
+  uint32_t device_ids = 0;
+  DirStats forward;
+  DirStats reverse;
+
+private:
+  // Big-endian length prefix, counting the two length bytes themselves
+  uint32_t device_id_length() const { return ((uint32_t)id_[0] << 8) | id_[1]; }
+
+  void print_device_id(bool truncated)
+  {
+    id_active_ = false;
+    if (id_len_ < 2)
+      return;
+    device_ids++;
+
+    uint32_t n = id_len_ < sizeof(id_) ? id_len_ : (uint32_t)sizeof(id_);
+    printf("# Device ID (%u bytes%s): ", device_id_length(), truncated ? ", truncated" : "");
+    for (uint32_t i = 2; i < n; ++i)
+    {
+      uint8_t c = id_[i];
+      if (c >= 0x20 && c < 0x7F)
+        putchar(c);
+      else
+        printf("\\x%02X", c);
+    }
+    printf("\n");
+  }
+
+  bool     list_;
+  FILE    *rev_out_;
+  uint16_t compat_prev_ = FRAME_BITS_IDLE;
+
+  bool     id_active_ = false;
+  uint32_t id_len_ = 0;
+  uint8_t  id_[1024];
+};
+
+static void print_rate(const char *name, const DirStats &s)
+{
+  fprintf(stderr, "%-16s: %llu bytes", name, (unsigned long long)s.bytes);
+  double span_s = (double)(s.last_t - s.first_t) / 1e6;
+  if (span_s > 0)
+    fprintf(stderr, ", %.1f KB/s over %.3f ms", (double)s.bytes / span_s / 1e3, span_s * 1e3);
+  fprintf(stderr, "\n");
+}
+
+int main(int argc, char **argv)
+{
+  const char *in_path = nullptr;
+  const char *rev_path = nullptr;
+  bool list = false;
+
+  for (int i = 1; i < argc; ++i)
+  {
+    if (!strcmp(argv[i], "-l"))
+      list = true;
+    else if (!strcmp(argv[i], "-r") && i + 1 < argc)
+      rev_path = argv[++i];
+    else if (!in_path)
+      in_path = argv[i];
+  }
+  if (!in_path)
+  {
+    fprintf(stderr, "Usage: ieee1284_decode <capture.csv> [-r reverse.bin] [-l]\n");
+    return 1;
+  }
+
+  CsvCaptureReader reader;
+  if (!reader.open(in_path))
+  {
+    fprintf(stderr, "Error: cannot open '%s'\n", in_path);
+    return 1;
+  }
+
+  FILE *rev_out = nullptr;
+  if (rev_path && !(rev_out = fopen(rev_path, "wb")))
+  {
+    fprintf(stderr, "Error: cannot write '%s'\n", rev_path);
+    return 1;
+  }
+
+  static ReportSink sink(list, rev_out);
+  static Ieee1284Session session(sink);
+
+  CaptureFrame f;
+  while (reader.next(f))
+    session.feed(f);
+  sink.finish();
+
+  if (rev_out)
+    fclose(rev_out);
+
+  const Ieee1284Tracker &tr = session.tracker();
+  fprintf(stderr, "=== IEEE 1284 Session ===\n");
+  fprintf(stderr, "Negotiations    : %u (%u refused, %u aborted)\n", tr.negotiations(), tr.refusals(), tr.aborts());
+  fprintf(stderr, "Final mode      : %s\n", ieee1284_mode_name(tr.mode()));
+  fprintf(stderr, "COMPAT frames   : %llu\n", (unsigned long long)sink.compat_frames);
+  fprintf(stderr, "NIBBLE bytes    : %llu\n", (unsigned long long)sink.events[M1284_NIBBLE]);
+  fprintf(stderr, "BYTE bytes      : %llu\n", (unsigned long long)sink.events[M1284_BYTE]);
+  fprintf(stderr, "Reverse viol.   : %u\n", session.reverse().violations());
+  fprintf(stderr, "EPP cycles      : %llu (%u violations)\n", (unsigned long long)sink.events[M1284_EPP],
+          session.epp().violations());
+  fprintf(stderr, "ECP events      : %llu (%u violations)\n", (unsigned long long)sink.events[M1284_ECP],
+          session.ecp().violations());
+  if (session.hold_overflows())
+    fprintf(stderr, "Hold overflows  : %u\n", session.hold_overflows());
+  if (sink.device_ids)
+    fprintf(stderr, "Device IDs      : %u\n", sink.device_ids);
+
+  fprintf(stderr, "\n=== Throughput ===\n");
+  print_rate("Forward", sink.forward);
+  print_rate("Reverse", sink.reverse);
+  return 0;
+}
@@ -0,0 +1,706 @@
+/*
+ * PARALAX - live audio source for JACK / PipeWire (host)
+ * ThisOldCPU Project - https://github.com/thisoldcpu
+ *
+ * Reads the live capture stream from the sniffer's serial port and
+ * publishes the decoded audio as a JACK client, so OBS or a DAW records
+ * it as it plays. Under PipeWire the same client is a PipeWire node
+ * (through pipewire-jack). The path is the firmware's: DeviceClassifier
+ * and SpeculativeDecoder, DacPcmSource for Covox / DSS, the write cache,
+ * OplScheduler and Opl2PcmSource for OPL2LPT, all onto the 48 kHz grid,
+ * then the Asrc into the server's process callback.
+ *
+ * Two clocks meet here. The sources run on device time: a reader thread
+ * maps the host clock onto it with the smallest delay seen between a
+ * frame's timestamp and its arrival (LEAK_US lets that delay grow, so a
+ * device clock slower than the host is followed too), and keeps the
+ * sources advancing -l ms behind that estimate, which absorbs the USB
+ * serial link's batching. The Asrc then carries the stream onto the
+ * server's clock, steering its FIFO to TARGET_FRAMES. Added latency is
+ * the holdback, the FIFO and one server period: about 3 + 4 + 2.7 ms at
+ * the defaults and 128 frames.
+ *
+ * libjack is loaded at run time (dlopen), so the tool builds with no audio
+ * headers or libraries installed. Without a server, -p writes the stream
+ * as raw S16_LE stereo to a file or stdout instead, paced by whatever
+ * reads it: aplay into an ALSA loopback (snd-aloop) device gives the same
+ * live source to any ALSA application. The server must run at 48 kHz.
+ *
+ * The input is a tty (put into raw mode), "-" for stdin, or with -x a
+ * capture file replayed in real time (-s skews its clock by ppm), which
+ * with JACK's dummy backend tests the whole path with no hardware:
+ *
+ *   jackd -d dummy -r 48000 -p 128 &
+ *   live_source capture.csv -x -s 200
+ *
+ * -t needs neither: it simulates 1 ms serial batches with jitter, a
+ * device clock off by +-300 ppm and server periods of 64 to 256 frames,
+ * and checks that the stream plays through with no underrun once the loop
+ * has settled, that latency stays near target and that the loop finds the
+ * clock offset.
+ *
+ * Build:
+ *   g++ -std=c++17 -O2 -pthread -Iinclude -Itools -o live_source tools/live_source.cpp \
+ *       src/asrc.cpp src/dac_pcm.cpp src/pit_clock.cpp src/opl2_pcm.cpp src/opl2_synth.cpp \
+ *       src/pcm_interp.cpp src/opl_scheduler.cpp src/opl_write_cache.cpp \
+ *       src/speculative_decoder.cpp src/device_classifier.cpp src/device_decoders.cpp \
+ *       src/cmslpt_decoder.cpp -ldl
+ *
+ * Usage:
+ *   live_source <tty | - | capture.csv -x [-s ppm]> [-p out.raw | -] [-n name] [-a]
+ *               [-l holdback_ms] [-v]
+ *   live_source -t
+ *
+ * License : MIT
+ */
+
+#include <dlfcn.h>
+#include <fcntl.h>
+#include <math.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "asrc.h"
+#include "capture_csv.h"
+#include "dac_pcm.h"
+#include "device_classifier.h"
+#include "opl2_pcm.h"
+#include "opl_scheduler.h"
+#include "opl_write_cache.h"
+#include "selftest.h"
+#include "speculative_decoder.h"
+
+static constexpr uint32_t RATE_HZ = DacPcmSource::RATE_HZ;
+static constexpr uint32_t HOLDBACK_US = 3000;  // default -l
+static constexpr uint32_t LEAK_US = 1000;      // the link delay may grow 1 us per ms (1000 ppm)
+static constexpr uint32_t MAX_PERIOD = 256;    // server periods beyond this outrun the Asrc FIFO target
+static constexpr uint32_t PIPE_FRAMES = 48;    // -p writes 1 ms at a time
+
+static std::atomic<bool> stop{false};
+
+static uint64_t host_us()
+{
+  return (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+// ---- Decoding: the firmware's core 1 path, with device time from the link ----
+
+class LivePipeline : public DeviceEventSink, public OplWriteSink
+{
+public:
+  explicit LivePipeline(uint32_t holdback_us)
+    : holdback_us_(holdback_us), dac_(asrc_), opl2_(asrc_), sched_(*this), speculative_(*this)
+  {
+  }
+
+  // ---- Producer (reader thread) ----
+  void on_frame(const CaptureFrame &f, uint64_t host_us)
+  {
+    // Smallest arrival delay so far, allowed to grow slowly
+    int64_t lead = (int64_t)(host_us - clock_.extend(f.t_us));
+    if (!frames_)
+    {
+      lead_ = lead;
+      lead_at_ = host_us;
+    }
+    uint64_t rise = (host_us - lead_at_) / LEAK_US;
+    lead_ += (int64_t)rise;
+    lead_at_ += rise * LEAK_US;
+    if (lead < lead_)
+      lead_ = lead;
+    frames_++;
+
+    speculative_.feed(f);
+    DeviceGuess g;
+    if (cls_.feed(f, g))
+    {
+      speculative_.commit(g.device);
+      committed = g.device;
+    }
+    if (reopened_)
+    {
+      cls_.reset();
+      reopened_ = false;
+    }
+  }
+
+  // Keeps the output flowing through silence; one source at a time feeds the Asrc
+  void advance(uint64_t host_us)
+  {
+    if (!frames_)
+      return;
+    uint32_t now = (uint32_t)(host_us - lead_);
+    if (pcm_device_ == DEV_OPL2LPT)
+    {
+      sched_.advance(now);
+      opl2_.advance(now - holdback_us_);
+    }
+    else
+      dac_.advance(now - holdback_us_);
+  }
+
+  // ---- Consumer (server thread) ----
+  void pull(int16_t *out, uint32_t frames) { asrc_.pull(out, frames); }
+
+  // ---- DeviceEventSink ----
+  void on_event(const DeviceEvent &e) override
+  {
+    events++;
+    pcm_device_ = e.device;
+    if (e.device != DEV_OPL2LPT)
+      dac_.on_event(e);
+    else if (cache_.pass(e.reg, e.value))
+      sched_.push(e.t_us, e.reg, e.value);
+  }
+  void on_reopen() override { reopened_ = true; }
+
+  // ---- OplWriteSink ----
+  void on_opl_write(uint64_t t_ns, uint16_t reg, uint8_t value) override
+  {
+    DeviceEvent e = {(uint32_t)(t_ns / 1000), DEV_OPL2LPT, 0, (uint8_t)reg, value};
+    opl2_.on_event(e);
+  }
+
+  const Asrc &asrc() const { return asrc_; }
+  uint64_t frames() const { return frames_; }
+  uint32_t late_events() const { return dac_.late_events() + opl2_.late_events(); }
+  uint32_t samples() const { return dac_.samples() + opl2_.samples(); }
+
+  std::atomic<uint32_t> events{0};
+  std::atomic<int>      committed{DEV_UNKNOWN};
+
+private:
+  uint32_t holdback_us_;
+
+  Asrc           asrc_;
+  DacPcmSource   dac_;
+  Opl2PcmSource  opl2_;
+  OplScheduler   sched_;
+  OplWriteCache  cache_;
+  SpeculativeDecoder speculative_;
+  DeviceClassifier cls_;
+  bool           reopened_ = false;
+  uint8_t        pcm_device_ = DEV_UNKNOWN;
+
+  TimeUnwrapper clock_;
+  int64_t  lead_ = 0;    // host time minus device time, the link's smallest delay
+  uint64_t lead_at_ = 0; // host time the leak was last applied
+  uint64_t frames_ = 0;
+};
+
+// ---- Input ----
+
+class LineInput
+{
+public:
+  ~LineInput()
+  {
+    if (fd_ > 0)
+      close(fd_);
+  }
+
+  bool open_port(const char *path)
+  {
+    fd_ = strcmp(path, "-") ? open(path, O_RDONLY | O_NOCTTY) : 0;
+    if (fd_ < 0)
+      return false;
+    struct termios tio;
+    if (isatty(fd_) && tcgetattr(fd_, &tio) == 0)
+    {
+      cfmakeraw(&tio);
+      tcsetattr(fd_, TCSANOW, &tio);
+    }
+    return true;
+  }
+
+  // Frames that arrived within timeout_ms; false at end of input
+  template <typename Frame>
+  bool read_frames(int timeout_ms, Frame on_frame)
+  {
+    struct pollfd p = {fd_, POLLIN, 0};
+    if (poll(&p, 1, timeout_ms) <= 0)
+      return true;
+    ssize_t n = read(fd_, buf_ + len_, sizeof(buf_) - len_);
+    if (n <= 0)
+      return false;
+    len_ += (size_t)n;
+
+    size_t start = 0;
+    for (size_t i = 0; i < len_; ++i)
+    {
+      if (buf_[i] != '\n')
+        continue;
+      size_t end = i;
+      if (end > start && buf_[end - 1] == '\r')
+        end--;
+      CaptureFrame f;
+      if (CsvCaptureReader::parse_line(buf_ + start, end - start, f))
+        on_frame(f);
+      start = i + 1;
+    }
+    // A line longer than the buffer is noise: drop it
+    len_ = start || len_ < sizeof(buf_) ? len_ - start : 0;
+    memmove(buf_, buf_ + start, len_);
+    return true;
+  }
+
+private:
+  int    fd_ = -1;
+  char   buf_[4096];
+  size_t len_ = 0;
+};
+
+static void read_live(LivePipeline &pipe, const char *path, bool verbose)
+{
+  LineInput in;
+  if (!in.open_port(path))
+  {
+    fprintf(stderr, "Error: cannot open '%s'\n", path);
+    stop = true;
+    return;
+  }
+  uint64_t next_status = host_us() + 1000000;
+  while (!stop)
+  {
+    uint64_t now = host_us();
+    if (!in.read_frames(1, [&](const CaptureFrame &f) { pipe.on_frame(f, now); }))
+      break;
+    pipe.advance(host_us());
+    if (verbose && host_us() >= next_status)
+    {
+      next_status += 1000000;
+      fprintf(stderr, "%s: %llu frames, FIFO %.2f ms, clock %+d ppm, %u underruns\n",
+              lpt_device_name((LptDevice)pipe.committed.load()), (unsigned long long)pipe.frames(),
+              pipe.asrc().latency_frames() * 1000.0 / RATE_HZ, pipe.asrc().clock_ppm(), pipe.asrc().underruns());
+    }
+  }
+  stop = true;
+}
+
+// A capture file in real time, its clock skewed by ppm
+static void read_replay(LivePipeline &pipe, const char *path, double ppm)
+{
+  CsvCaptureReader reader;
+  if (!reader.open(path))
+  {
+    fprintf(stderr, "Error: cannot open '%s'\n", path);
+    stop = true;
+    return;
+  }
+  CaptureFrame f;
+  TimeUnwrapper clock;
+  uint64_t t0_host = host_us();
+  uint64_t t0_dev = 0;
+  bool have = reader.next(f);
+  if (have)
+    t0_dev = clock.extend(f.t_us);
+  while (!stop && have)
+  {
+    // One batch per millisecond, as the USB serial link delivers them
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    uint64_t now = host_us();
+    double due = (now - t0_host) * (1.0 + ppm * 1e-6);
+    while (have && (double)(clock.extend(f.t_us) - t0_dev) <= due)
+    {
+      pipe.on_frame(f, now);
+      have = reader.next(f);
+    }
+    pipe.advance(now);
+  }
+  // Let the tail play out
+  for (uint32_t i = 0; i < 200 && !stop; ++i)
+  {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    pipe.advance(host_us());
+  }
+  stop = true;
+}
+
+// ---- JACK, loaded at run time ----
+
+typedef struct _jack_client jack_client_t;
+typedef struct _jack_port   jack_port_t;
+typedef uint32_t            jack_nframes_t;
+
+struct JackApi
+{
+  static constexpr int NO_START_SERVER = 0x01;   // JackNoStartServer
+  static constexpr unsigned long PORT_INPUT = 0x1; // JackPortIsInput
+  static constexpr unsigned long PORT_OUTPUT = 0x2;
+  static constexpr unsigned long PORT_PHYSICAL = 0x4;
+  static constexpr const char *AUDIO_TYPE = "32 bit float mono audio"; // JACK_DEFAULT_AUDIO_TYPE
+
+  jack_client_t *(*client_open)(const char *, int, int *, ...);
+  int (*client_close)(jack_client_t *);
+  int (*set_process_callback)(jack_client_t *, int (*)(jack_nframes_t, void *), void *);
+  void (*on_shutdown)(jack_client_t *, void (*)(void *), void *);
+  jack_port_t *(*port_register)(jack_client_t *, const char *, const char *, unsigned long, unsigned long);
+  void *(*port_get_buffer)(jack_port_t *, jack_nframes_t);
+  const char *(*port_name)(const jack_port_t *);
+  jack_nframes_t (*get_sample_rate)(jack_client_t *);
+  jack_nframes_t (*get_buffer_size)(jack_client_t *);
+  int (*activate)(jack_client_t *);
+  int (*deactivate)(jack_client_t *);
+  const char **(*get_ports)(jack_client_t *, const char *, const char *, unsigned long);
+  int (*connect)(jack_client_t *, const char *, const char *);
+  void (*free)(void *);
+
+  bool load()
+  {
+    void *lib = dlopen("libjack.so.0", RTLD_NOW);
+    if (!lib)
+      lib = dlopen("libjack.so", RTLD_NOW);
+    if (!lib)
+      return false;
+    bool ok = true;
+    auto sym = [&](auto &fn, const char *name)
+    {
+      *(void **)&fn = dlsym(lib, name);
+      ok = ok && fn;
+    };
+    sym(client_open, "jack_client_open");
+    sym(client_close, "jack_client_close");
+    sym(set_process_callback, "jack_set_process_callback");
+    sym(on_shutdown, "jack_on_shutdown");
+    sym(port_register, "jack_port_register");
+    sym(port_get_buffer, "jack_port_get_buffer");
+    sym(port_name, "jack_port_name");
+    sym(get_sample_rate, "jack_get_sample_rate");
+    sym(get_buffer_size, "jack_get_buffer_size");
+    sym(activate, "jack_activate");
+    sym(deactivate, "jack_deactivate");
+    sym(get_ports, "jack_get_ports");
+    sym(connect, "jack_connect");
+    sym(free, "jack_free");
+    return ok;
+  }
+};
+
+static JackApi jack;
+
+struct JackOutput
+{
+  LivePipeline *pipe;
+  jack_port_t  *port[Asrc::CHANNELS];
+};
+
+static int jack_process(jack_nframes_t nframes, void *arg)
+{
+  JackOutput *o = (JackOutput *)arg;
+  float *out[Asrc::CHANNELS];
+  for (uint32_t c = 0; c < Asrc::CHANNELS; ++c)
+    out[c] = (float *)jack.port_get_buffer(o->port[c], nframes);
+
+  int16_t pcm[MAX_PERIOD * Asrc::CHANNELS];
+  for (jack_nframes_t done = 0; done < nframes;)
+  {
+    uint32_t n = nframes - done < MAX_PERIOD ? nframes - done : MAX_PERIOD;
+    o->pipe->pull(pcm, n);
+    for (uint32_t i = 0; i < n; ++i)
+      for (uint32_t c = 0; c < Asrc::CHANNELS; ++c)
+        out[c][done + i] = pcm[i * Asrc::CHANNELS + c] * (1.0f / 32768.0f);
+    done += n;
+  }
+  return 0;
+}
+
+static void jack_shutdown(void *) { stop = true; }
+
+// Registers the client; false (and a message) if there is no server to use
+static bool jack_start(jack_client_t *&client, JackOutput &out, const char *name, bool autoconnect)
+{
+  if (!jack.load())
+  {
+    fprintf(stderr, "Error: libjack not found (install jack or pipewire-jack, or use -p)\n");
+    return false;
+  }
+  int status = 0;
+  client = jack.client_open(name, JackApi::NO_START_SERVER, &status);
+  if (!client)
+  {
+    fprintf(stderr, "Error: no JACK / PipeWire server (status 0x%x); use -p for a pipe\n", status);
+    return false;
+  }
+  jack_nframes_t rate = jack.get_sample_rate(client);
+  if (rate != RATE_HZ)
+  {
+    fprintf(stderr, "Error: server runs at %u Hz; PARALAX audio is %u Hz\n", rate, RATE_HZ);
+    jack.client_close(client);
+    return false;
+  }
+  if (jack.get_buffer_size(client) > MAX_PERIOD)
+    fprintf(stderr, "Warning: %u-frame periods are longer than %u; expect underruns\n",
+            jack.get_buffer_size(client), MAX_PERIOD);
+
+  static const char *names[Asrc::CHANNELS] = {"out_left", "out_right"};
+  for (uint32_t c = 0; c < Asrc::CHANNELS; ++c)
+    out.port[c] = jack.port_register(client, names[c], JackApi::AUDIO_TYPE, JackApi::PORT_OUTPUT, 0);
+  jack.set_process_callback(client, jack_process, &out);
+  jack.on_shutdown(client, jack_shutdown, nullptr);
+  if (jack.activate(client))
+  {
+    fprintf(stderr, "Error: cannot activate the JACK client\n");
+    jack.client_close(client);
+    return false;
+  }
+
+  if (autoconnect)
+  {
+    const char **ports = jack.get_ports(client, nullptr, JackApi::AUDIO_TYPE,
+                                        JackApi::PORT_INPUT | JackApi::PORT_PHYSICAL);
+    for (uint32_t c = 0; ports && c < Asrc::CHANNELS && ports[c]; ++c)
+      jack.connect(client, jack.port_name(out.port[c]), ports[c]);
+    if (ports)
+      jack.free(ports);
+  }
+  return true;
+}
+
+// ---- Pipe output: paced by the reader ----
+
+static void write_pipe(LivePipeline &pipe, FILE *fp)
+{
+  int16_t pcm[PIPE_FRAMES * Asrc::CHANNELS];
+  uint8_t bytes[sizeof(pcm)];
+  uint64_t next = host_us();
+  while (!stop)
+  {
+    pipe.pull(pcm, PIPE_FRAMES);
+    for (uint32_t i = 0; i < PIPE_FRAMES * Asrc::CHANNELS; ++i)
+    {
+      bytes[i * 2] = (uint8_t)pcm[i];
+      bytes[i * 2 + 1] = (uint8_t)((uint16_t)pcm[i] >> 8);
+    }
+    // Blocks while the reader's buffer is full; a file is written in real time
+    if (fwrite(bytes, sizeof(bytes), 1, fp) != 1)
+      break;
+    fflush(fp);
+    next += 1000;
+    uint64_t now = host_us();
+    if (next > now + 1000)
+      std::this_thread::sleep_for(std::chrono::microseconds(next - now - 1000));
+  }
+  stop = true;
+}
+
+// ---- Self-test ----
+
+struct SimResult
+{
+  uint32_t underruns = 0;   // after settling
+  uint32_t late = 0;        // events behind the holdback, after settling (the
+                            // speculative replay at the commit is always late)
+  double   fifo_min_ms = 1e9;
+  double   fifo_max_ms = 0.0;
+  int32_t  clock_ppm = 0;
+  double   rms = 0.0;       // output level after settling
+};
+
+// A Covox player at divisor 54 on a device clock off by ppm; 1 ms serial
+// batches up to jitter_us late; the server pulls `period` frames at a time
+static SimResult simulate(double ppm, uint32_t period, uint32_t jitter_us, uint32_t seconds, uint32_t settle_s)
+{
+  std::unique_ptr<LivePipeline> pipe(new LivePipeline(HOLDBACK_US));
+  SimResult r;
+  std::vector<int16_t> pcm(period * Asrc::CHANNELS);
+
+  double slot_us = 54 * 1e6 / PitClock::PIT_HZ;
+  uint64_t slot = 0;
+  TestRng rng;
+  uint64_t batch = 1;           // batch k holds device time up to k ms
+  uint64_t deliver_at = 1000;   // ... and arrives up to jitter_us later
+  double pull_us = period * 1e6 / RATE_HZ;
+  double next_pull = 0.0;
+  uint64_t settle_us = (uint64_t)settle_s * 1000000;
+  uint32_t underruns_before = UINT32_MAX;
+  uint32_t late_before = 0;
+  double sum2 = 0.0;
+  uint64_t n2 = 0;
+  int prev = -1;
+
+  for (uint64_t host = 0; host < (uint64_t)seconds * 1000000; host += 50)
+  {
+    if (host >= deliver_at)
+    {
+      double dev_now = batch * 1000.0 * (1.0 + ppm * 1e-6);
+      for (; slot * slot_us <= dev_now; ++slot)
+      {
+        int v = (int)lround(128.0 + 96.0 * sin(2 * M_PI * 440.0 * slot * slot_us / 1e6));
+        if (v == prev)
+          continue; // no event for a repeated byte
+        prev = v;
+        CaptureFrame f = {(uint32_t)(1000.0 + slot * slot_us), (uint8_t)v, 0, FRAME_BITS_IDLE};
+        pipe->on_frame(f, host);
+      }
+      batch++;
+      deliver_at = batch * 1000 + (jitter_us ? rng.next() % jitter_us : 0);
+    }
+    pipe->advance(host);
+
+    if ((double)host >= next_pull)
+    {
+      next_pull += pull_us;
+      pipe->pull(pcm.data(), period);
+      if (host < settle_us)
+        continue;
+      if (underruns_before == UINT32_MAX)
+      {
+        underruns_before = pipe->asrc().underruns();
+        late_before = pipe->late_events();
+      }
+      double ms = pipe->asrc().latency_frames() * 1000.0 / RATE_HZ;
+      r.fifo_min_ms = fmin(r.fifo_min_ms, ms);
+      r.fifo_max_ms = fmax(r.fifo_max_ms, ms);
+      for (uint32_t i = 0; i < period; ++i)
+      {
+        sum2 += (double)pcm[i * Asrc::CHANNELS] * pcm[i * Asrc::CHANNELS];
+        n2++;
+      }
+    }
+  }
+  r.underruns = pipe->asrc().underruns() - underruns_before;
+  r.late = pipe->late_events() - late_before;
+  r.clock_ppm = pipe->asrc().clock_ppm();
+  r.rms = n2 ? sqrt(sum2 / n2) : 0.0;
+  return r;
+}
+
+static int selftest()
+{
+  SelfTest test("Live Source");
+  static const uint32_t periods[] = {64, 128, 256};
+  static const double offsets[] = {-300.0, 300.0};
+  const double target_ms = Asrc::TARGET_FRAMES * 1000.0 / RATE_HZ;
+  for (uint32_t period : periods)
+  {
+    for (double ppm : offsets)
+    {
+      SimResult r = simulate(ppm, period, 800, 150, 90);
+      bool pass = r.underruns == 0 && r.late == 0 && r.fifo_min_ms >= target_ms - 2.0 &&
+                  r.fifo_max_ms <= target_ms + 2.0 && fabs(r.clock_ppm - ppm) < 10.0 &&
+                  r.rms > 10000.0;
+      char label[32];
+      snprintf(label, sizeof(label), "Period %-3u %+4.0f", period, ppm);
+      test.check(pass, label, "FIFO %.2f-%.2f ms, clock %+d ppm, %u underruns, %u late, level %.0f rms", r.fifo_min_ms,
+                 r.fifo_max_ms, r.clock_ppm, r.underruns, r.late, r.rms);
+    }
+  }
+  test.info("Added latency", "%.1f ms holdback + %.1f ms FIFO + one period", HOLDBACK_US / 1000.0, target_ms);
+  return test.finish();
+}
+
+// ---- Live ----
+
+static void on_signal(int) { stop = true; }
+
+int main(int argc, char **argv)
+{
+  const char *in_path = nullptr;
+  const char *pipe_path = nullptr;
+  const char *name = "paralax";
+  uint32_t holdback_us = HOLDBACK_US;
+  double skew_ppm = 0.0;
+  bool replay = false;
+  bool autoconnect = false;
+  bool verbose = false;
+  bool test = false;
+
+  for (int i = 1; i < argc; ++i)
+  {
+    if (!strcmp(argv[i], "-p") && i + 1 < argc)
+      pipe_path = argv[++i];
+    else if (!strcmp(argv[i], "-n") && i + 1 < argc)
+      name = argv[++i];
+    else if (!strcmp(argv[i], "-l") && i + 1 < argc)
+      holdback_us = (uint32_t)(atof(argv[++i]) * 1000.0);
+    else if (!strcmp(argv[i], "-s") && i + 1 < argc)
+      skew_ppm = atof(argv[++i]);
+    else if (!strcmp(argv[i], "-x"))
+      replay = true;
+    else if (!strcmp(argv[i], "-a"))
+      autoconnect = true;
+    else if (!strcmp(argv[i], "-v"))
+      verbose = true;
+    else if (!strcmp(argv[i], "-t"))
+      test = true;
+    else if (!in_path)
+      in_path = argv[i];
+  }
+  if (test)
+    return selftest();
+  if (!in_path)
+  {
+    fprintf(stderr, "Usage: live_source <tty | - | capture.csv -x [-s ppm]> [-p out.raw | -] [-n name] [-a]\n"
+                    "                   [-l holdback_ms] [-v]\n"
+                    "       live_source -t\n");
+    return 1;
+  }
+
+  signal(SIGINT, on_signal);
+  signal(SIGTERM, on_signal);
+  signal(SIGPIPE, SIG_IGN);
+
+  std::unique_ptr<LivePipeline> pipe(new LivePipeline(holdback_us));
+  jack_client_t *client = nullptr;
+  JackOutput out = {pipe.get(), {nullptr, nullptr}};
+  FILE *fp = nullptr;
+  if (pipe_path)
+  {
+    fp = strcmp(pipe_path, "-") ? fopen(pipe_path, "wb") : stdout;
+    if (!fp)
+    {
+      fprintf(stderr, "Error: cannot write '%s'\n", pipe_path);
+      return 1;
+    }
+  }
+  else if (!jack_start(client, out, name, autoconnect))
+    return 1;
+
+  uint64_t t0 = host_us();
+  std::thread writer;
+  if (fp)
+    writer = std::thread(write_pipe, std::ref(*pipe), fp);
+  if (replay)
+    read_replay(*pipe, in_path, skew_ppm);
+  else
+    read_live(*pipe, in_path, verbose);
+  stop = true;
+  if (writer.joinable())
+    writer.join();
+  if (client)
+  {
+    jack.deactivate(client);
+    jack.client_close(client);
+  }
+  if (fp && fp != stdout)
+    fclose(fp);
+
+  const Asrc &asrc = pipe->asrc();
+  const double frames_per_ms = RATE_HZ / 1000.0;
+  fprintf(stderr, "=== Live Source ===\n");
+  fprintf(stderr, "Output          : %s\n", fp ? (strcmp(pipe_path, "-") ? pipe_path : "stdout") : name);
+  fprintf(stderr, "Run time        : %.1f s\n", (host_us() - t0) / 1e6);
+  fprintf(stderr, "Frames          : %llu (%u events)\n", (unsigned long long)pipe->frames(), pipe->events.load());
+  fprintf(stderr, "Device          : %s\n", lpt_device_name((LptDevice)pipe->committed.load()));
+  fprintf(stderr, "PCM samples     : %u (%u late events)\n", pipe->samples(), pipe->late_events());
+  fprintf(stderr, "Clock offset    : %d ppm (loop estimate)\n", asrc.clock_ppm());
+  fprintf(stderr, "Latency         : %.1f ms holdback + %.2f ms FIFO\n", holdback_us / 1000.0,
+          asrc.latency_frames() / frames_per_ms);
+  fprintf(stderr, "Underruns       : %u (%u frames padded)\n", asrc.underruns(), asrc.padded_frames());
+  fprintf(stderr, "Overruns        : %u (%u frames skipped to restore latency)\n", asrc.overruns(),
+          asrc.skipped_frames());
+  return 0;
+}
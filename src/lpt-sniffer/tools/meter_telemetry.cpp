@@ -0,0 +1,566 @@
+/*
+ * PARALAX - level meter and spectrum telemetry (host)
+ * ThisOldCPU Project - https://github.com/thisoldcpu
+ *
+ * The firmware's meters (PcmMeter, pcm_meter.h) as a host tool, both ends:
+ *
+ *   - with a capture, runs core 1's path on it (classifier, speculative
+ *     decoder, DacPcmSource for Covox / DSS, write cache, OplScheduler and
+ *     Opl2PcmSource for OPL2LPT) into PcmMeter, a millisecond of device
+ *     time per loop as loop1() would, and prints the records it would send;
+ *     -x prints them as the firmware's "# meter:" lines instead
+ *   - with -d, decodes the "# meter:" lines out of a serial log (every other
+ *     line is ignored) and reports lost records from the sequence numbers
+ *
+ * Records come out as CSV on stdout, one per quarter second: time (the
+ * record's end for a capture, its index in a log), device, peak and RMS per
+ * channel in dBFS, the 16 bands in dBFS and the OPL key bits in hex.
+ *
+ * -t checks the meter itself:
+ *   - the Q15 FFT against a double DFT of the same windowless block
+ *   - level() against 20 log10 over the whole range, to one half-dB step
+ *   - a full-scale sine at each band's centre reads within 2 dB of 0 in
+ *     that band and at least 30 dB less in bands three bins or more away;
+ *     peak and RMS read 0 dB, and a sine 20 dB down reads -20 dB
+ *   - pack() / unpack() and the hex line round-trip
+ *   - the write cache's held keys and key-ons, rhythm mode included
+ *
+ * Build:
+ *   g++ -std=c++17 -O2 -Iinclude -Itools -o meter_telemetry tools/meter_telemetry.cpp src/pcm_meter.cpp \
+ *       src/dac_pcm.cpp src/pit_clock.cpp src/opl2_pcm.cpp src/opl2_synth.cpp src/pcm_interp.cpp \
+ *       src/opl_scheduler.cpp src/opl_write_cache.cpp src/speculative_decoder.cpp \
+ *       src/device_classifier.cpp src/device_decoders.cpp src/cmslpt_decoder.cpp
+ *
+ * Usage:
+ *   meter_telemetry <capture.csv> [-x]
+ *   meter_telemetry -d <serial.log>
+ *   meter_telemetry -t
+ *
+ * License : MIT
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <vector>
+
+#include "capture_csv.h"
+#include "dac_pcm.h"
+#include "device_classifier.h"
+#include "opl2_pcm.h"
+#include "opl_scheduler.h"
+#include "opl_write_cache.h"
+#include "pcm_meter.h"
+#include "selftest.h"
+#include "speculative_decoder.h"
+
+static constexpr char METER_PREFIX[] = "# meter: ";
+static constexpr uint32_t HEX_DIGITS = PcmMeter::RECORD_BYTES * 2;
+
+static double to_db(uint8_t level)
+{
+  return ((int32_t)level - 255) / 2.0;
+}
+
+// ---- Records as text ----
+
+static void print_csv_header()
+{
+  printf("t_s,device,peak_l,peak_r,rms_l,rms_r");
+  for (uint32_t b = 0; b < PcmMeter::BANDS; ++b)
+    printf(",band%u", b);
+  printf(",keys,key_ons\n");
+}
+
+static void print_csv(double t_s, const MeterRecord &r)
+{
+  printf("%.2f,%s,%.1f,%.1f,%.1f,%.1f", t_s, lpt_device_name((LptDevice)r.device), to_db(r.peak[0]),
+         to_db(r.peak[1]), to_db(r.rms[0]), to_db(r.rms[1]));
+  for (uint32_t b = 0; b < PcmMeter::BANDS; ++b)
+    printf(",%.1f", to_db(r.bands[b]));
+  printf(",%04x,%04x\n", r.keys, r.key_ons);
+}
+
+// The firmware's line, without the newline
+static void format_line(const MeterRecord &r, char *out)
+{
+  static const char DIGITS[] = "0123456789ABCDEF";
+  uint8_t bytes[PcmMeter::RECORD_BYTES];
+  PcmMeter::pack(r, bytes);
+  memcpy(out, METER_PREFIX, sizeof(METER_PREFIX) - 1);
+  out += sizeof(METER_PREFIX) - 1;
+  for (uint32_t i = 0; i < PcmMeter::RECORD_BYTES; ++i)
+  {
+    *out++ = DIGITS[bytes[i] >> 4];
+    *out++ = DIGITS[bytes[i] & 15];
+  }
+  *out = 0;
+}
+
+static int hex_value(char c)
+{
+  if (c >= '0' && c <= '9')
+    return c - '0';
+  if (c >= 'a' && c <= 'f')
+    return c - 'a' + 10;
+  if (c >= 'A' && c <= 'F')
+    return c - 'A' + 10;
+  return -1;
+}
+
+// A "# meter:" line with exactly RECORD_BYTES of hex; anything else is not a record
+static bool parse_line(const char *line, MeterRecord &r)
+{
+  if (strncmp(line, METER_PREFIX, sizeof(METER_PREFIX) - 1))
+    return false;
+  line += sizeof(METER_PREFIX) - 1;
+
+  uint8_t bytes[PcmMeter::RECORD_BYTES];
+  for (uint32_t i = 0; i < PcmMeter::RECORD_BYTES; ++i)
+  {
+    int hi = hex_value(line[i * 2]);
+    int lo = hi < 0 ? -1 : hex_value(line[i * 2 + 1]);
+    if (lo < 0)
+      return false;
+    bytes[i] = (uint8_t)(hi << 4 | lo);
+  }
+  const char *end = line + HEX_DIGITS;
+  if (*end && *end != '\r' && *end != '\n')
+    return false;
+  PcmMeter::unpack(bytes, r);
+  return true;
+}
+
+// ---- Decoding: core 1's path into the meter ----
+
+class MeterPipeline : public DeviceEventSink, public OplWriteSink
+{
+public:
+  MeterPipeline() : dac_(meter_), opl2_(meter_), sched_(*this), speculative_(*this) {}
+
+  void feed(const CaptureFrame &f)
+  {
+    speculative_.feed(f);
+    DeviceGuess g;
+    if (cls_.feed(f, g))
+    {
+      speculative_.commit(g.device);
+      committed = g.device;
+    }
+    if (reopened_)
+    {
+      cls_.reset();
+      reopened_ = false;
+    }
+  }
+
+  // As loop1(): advance the source feeding the stream, then take a due record
+  bool advance(uint32_t now_us, MeterRecord &r)
+  {
+    if (pcm_device_ == DEV_OPL2LPT)
+    {
+      sched_.advance(now_us);
+      opl2_.advance(now_us - Opl2PcmSource::HOLDBACK_US);
+    }
+    else
+      dac_.advance(now_us - DacPcmSource::HOLDBACK_US);
+
+    if (!meter_.take(r))
+      return false;
+    r.device = pcm_device_;
+    r.keys = cache_.keys();
+    r.key_ons = cache_.key_ons();
+    cache_.clear_key_ons();
+    return true;
+  }
+
+  // ---- DeviceEventSink ----
+  void on_event(const DeviceEvent &e) override
+  {
+    pcm_device_ = e.device;
+    if (e.device != DEV_OPL2LPT)
+      dac_.on_event(e);
+    else if (cache_.pass(e.reg, e.value))
+      sched_.push(e.t_us, e.reg, e.value);
+  }
+  void on_reopen() override { reopened_ = true; }
+
+  // ---- OplWriteSink ----
+  void on_opl_write(uint64_t t_ns, uint16_t reg, uint8_t value) override
+  {
+    DeviceEvent e = {(uint32_t)(t_ns / 1000), DEV_OPL2LPT, 0, (uint8_t)reg, value};
+    opl2_.on_event(e);
+  }
+
+  LptDevice committed = DEV_UNKNOWN;
+
+private:
+  PcmMeter       meter_;
+  DacPcmSource   dac_;
+  Opl2PcmSource  opl2_;
+  OplScheduler   sched_;
+  OplWriteCache  cache_;
+  SpeculativeDecoder speculative_;
+  DeviceClassifier cls_;
+  bool           reopened_ = false;
+  uint8_t        pcm_device_ = DEV_UNKNOWN;
+};
+
+static int run_capture(const char *path, bool lines)
+{
+  CsvCaptureReader reader;
+  if (!reader.open(path))
+  {
+    fprintf(stderr, "Error: cannot open '%s'\n", path);
+    return 1;
+  }
+
+  CaptureFrame f;
+  bool have = reader.next(f);
+  if (!have)
+  {
+    fprintf(stderr, "Error: no frames in '%s'\n", path);
+    return 1;
+  }
+
+  // Device time in 1 ms steps; frames up to each step are fed first
+  MeterPipeline pipe;
+  TimeUnwrapper clock;
+  uint64_t frame_us = clock.extend(f.t_us);
+  uint64_t now_us = frame_us;
+  uint64_t drain_until_us = 0;
+  uint32_t records = 0;
+  uint32_t held_max = 0;
+  uint32_t key_ons = 0;
+  double loudest = -127.5;
+  if (!lines)
+    print_csv_header();
+
+  for (;;)
+  {
+    now_us += 1000;
+    while (have && frame_us <= now_us)
+    {
+      pipe.feed(f);
+      have = reader.next(f);
+      if (have)
+        frame_us = clock.extend(f.t_us);
+    }
+
+    MeterRecord r;
+    if (pipe.advance((uint32_t)now_us, r))
+    {
+      records++;
+      if (lines)
+      {
+        char line[sizeof(METER_PREFIX) + HEX_DIGITS];
+        format_line(r, line);
+        puts(line);
+      }
+      else
+        print_csv(now_us / 1e6, r);
+
+      uint32_t held = (uint32_t)__builtin_popcount(r.keys);
+      if (held > held_max)
+        held_max = held;
+      key_ons += (uint32_t)__builtin_popcount(r.key_ons);
+      for (uint32_t c = 0; c < 2; ++c)
+        if (to_db(r.peak[c]) > loudest)
+          loudest = to_db(r.peak[c]);
+    }
+
+    // A second past the last frame flushes the holdback and the last record
+    if (!have && drain_until_us == 0)
+      drain_until_us = now_us + 1000000;
+    if (drain_until_us && now_us >= drain_until_us)
+      break;
+  }
+
+  fprintf(stderr, "=== Meter Telemetry ===\n");
+  fprintf(stderr, "Frames          : %llu\n", (unsigned long long)reader.frames());
+  fprintf(stderr, "Device          : %s\n", lpt_device_name(pipe.committed));
+  fprintf(stderr, "Records         : %u (%u bytes as lines, %.0f B/s)\n", records,
+          records * (uint32_t)(sizeof(METER_PREFIX) + HEX_DIGITS), (sizeof(METER_PREFIX) + HEX_DIGITS) * 4.0);
+  fprintf(stderr, "Peak            : %.1f dBFS\n", loudest);
+  fprintf(stderr, "OPL keys        : %u held at most, %u struck\n", held_max, key_ons);
+  return 0;
+}
+
+static int run_log(const char *path)
+{
+  FILE *fp = !strcmp(path, "-") ? stdin : fopen(path, "r");
+  if (!fp)
+  {
+    fprintf(stderr, "Error: cannot open '%s'\n", path);
+    return 1;
+  }
+
+  char line[256];
+  uint32_t records = 0;
+  uint32_t lost = 0;
+  uint32_t bad = 0;
+  uint16_t expect = 0;
+  print_csv_header();
+  while (fgets(line, sizeof(line), fp))
+  {
+    MeterRecord r;
+    if (!parse_line(line, r))
+    {
+      // Console replies share the prefix, "# meters: on" does not
+      if (!strncmp(line, METER_PREFIX, sizeof(METER_PREFIX) - 1))
+        bad++;
+      continue;
+    }
+    // A smaller sequence number is a reset: nothing lost
+    if (records && r.seq > expect)
+      lost += (uint16_t)(r.seq - expect);
+    expect = (uint16_t)(r.seq + 1);
+    print_csv(r.seq / 4.0, r);
+    records++;
+  }
+  if (fp != stdin)
+    fclose(fp);
+
+  fprintf(stderr, "=== Meter Telemetry ===\n");
+  fprintf(stderr, "Records         : %u\n", records);
+  fprintf(stderr, "Lost            : %u\n", lost);
+  fprintf(stderr, "Malformed       : %u\n", bad);
+  return 0;
+}
+
+// ---- Self-test ----
+
+static bool test_fft(double &worst)
+{
+  // A mix of three tones and a ramp, well inside full scale
+  int16_t re[PcmMeter::FFT_N], im[PcmMeter::FFT_N];
+  std::vector<double> x(PcmMeter::FFT_N);
+  for (uint32_t n = 0; n < PcmMeter::FFT_N; ++n)
+  {
+    x[n] = 9000.0 * sin(2.0 * M_PI * 5.0 * n / PcmMeter::FFT_N) +
+           6000.0 * cos(2.0 * M_PI * 37.3 * n / PcmMeter::FFT_N) +
+           4000.0 * sin(2.0 * M_PI * 200.0 * n / PcmMeter::FFT_N + 1.0) + 8.0 * n - 2048.0;
+    re[n] = (int16_t)lrint(x[n]);
+    im[n] = 0;
+  }
+  PcmMeter::fft(re, im);
+
+  worst = 0.0;
+  for (uint32_t k = 0; k < PcmMeter::FFT_N; ++k)
+  {
+    double sr = 0.0, si = 0.0;
+    for (uint32_t n = 0; n < PcmMeter::FFT_N; ++n)
+    {
+      double a = -2.0 * M_PI * k * n / PcmMeter::FFT_N;
+      sr += lrint(x[n]) * cos(a);
+      si += lrint(x[n]) * sin(a);
+    }
+    sr /= PcmMeter::FFT_N;
+    si /= PcmMeter::FFT_N;
+    double err = hypot(re[k] - sr, im[k] - si);
+    if (err > worst)
+      worst = err;
+  }
+  // Truncation at each of the nine stages, in output LSBs
+  return worst <= 4.0;
+}
+
+static bool test_level(uint32_t &bad)
+{
+  bad = 0;
+  for (uint32_t ref = 20; ref <= 40; ref += 10)
+    for (double db = 0.0; db < 130.0; db += 0.01)
+    {
+      uint64_t power = (uint64_t)llround(ldexp(1.0, (int)ref) * pow(10.0, -db / 10.0));
+      if (!power)
+        continue;
+      double exact = 10.0 * log10((double)power / ldexp(1.0, (int)ref));
+      double want = 255.0 + 2.0 * exact;
+      uint8_t got = PcmMeter::level(power, ref);
+      if (want < 0.0 ? got > 1 : fabs(got - want) > 1.0)
+        bad++;
+    }
+  return bad == 0;
+}
+
+// One record of a sine on both channels
+static MeterRecord meter_sine(double hz, double amplitude)
+{
+  PcmMeter m;
+  for (uint32_t i = 0; i < PcmMeter::RECORD_SAMPLES; ++i)
+  {
+    int16_t v = (int16_t)lrint(amplitude * sin(2.0 * M_PI * hz * i / PcmMeter::RATE_HZ));
+    m.on_sample(v, v);
+  }
+  MeterRecord r;
+  if (!m.take(r))
+    memset(&r, 0, sizeof(r));
+  return r;
+}
+
+static bool test_bands(double &in_band, double &rejection, double &rms, double &quiet)
+{
+  const double bin_hz = (double)PcmMeter::RATE_HZ / PcmMeter::FFT_N;
+  bool ok = true;
+  in_band = 0.0;
+  rejection = 1e9;
+  rms = 0.0;
+  for (uint32_t b = 0; b < PcmMeter::BANDS; ++b)
+  {
+    double centre = sqrt((double)PcmMeter::BAND_EDGES[b] * PcmMeter::BAND_EDGES[b + 1]) * bin_hz;
+    MeterRecord r = meter_sine(centre, 32767.0);
+    double level = to_db(r.bands[b]);
+    if (-level > in_band)
+      in_band = -level;
+    ok = ok && level >= -2.0;
+    // The window's main lobe is four bins wide: judge only bands clear of it
+    double tone_bin = centre / bin_hz;
+    for (uint32_t o = 0; o < PcmMeter::BANDS; ++o)
+      if (PcmMeter::BAND_EDGES[o + 1] - 1 + 3.0 <= tone_bin || PcmMeter::BAND_EDGES[o] >= tone_bin + 3.0)
+      {
+        double drop = level - to_db(r.bands[o]);
+        if (drop < rejection)
+          rejection = drop;
+      }
+    ok = ok && r.peak[0] >= 254 && r.peak[1] >= 254;
+    for (uint32_t c = 0; c < 2; ++c)
+      if (-to_db(r.rms[c]) > rms)
+        rms = -to_db(r.rms[c]);
+  }
+  ok = ok && rejection >= 30.0 && rms <= 0.5;
+
+  MeterRecord r = meter_sine(1000.0, 3276.7);
+  quiet = to_db(r.rms[0]);
+  return ok && fabs(quiet + 20.0) <= 0.5;
+}
+
+static bool test_pack()
+{
+  MeterRecord a;
+  a.seq = 0xbeef;
+  a.device = DEV_OPL2LPT;
+  a.peak[0] = 250;
+  a.peak[1] = 1;
+  a.rms[0] = 128;
+  a.rms[1] = 0;
+  for (uint32_t b = 0; b < PcmMeter::BANDS; ++b)
+    a.bands[b] = (uint8_t)(b * 17);
+  a.keys = 0x3e01;
+  a.key_ons = 0x0102;
+
+  char line[sizeof(METER_PREFIX) + HEX_DIGITS];
+  format_line(a, line);
+  MeterRecord b;
+  if (strlen(line) != sizeof(METER_PREFIX) - 1 + HEX_DIGITS || !parse_line(line, b))
+    return false;
+  MeterRecord bad;
+  if (parse_line("# meters: on", bad) || parse_line("# meter: 00", bad))
+    return false;
+  return a.seq == b.seq && a.device == b.device && !memcmp(a.peak, b.peak, 2) && !memcmp(a.rms, b.rms, 2) &&
+         !memcmp(a.bands, b.bands, PcmMeter::BANDS) && a.keys == b.keys && a.key_ons == b.key_ons;
+}
+
+static bool test_keys()
+{
+  OplWriteCache c;
+  bool ok = true;
+
+  // Channel 0 keyed, then the same write again: held, struck once
+  c.pass(0xb0, 0x21);
+  c.pass(0xb0, 0x21);
+  ok = ok && c.keys() == 0x0001 && c.key_ons() == 0x0001;
+  c.clear_key_ons();
+  ok = ok && c.key_ons() == 0;
+
+  // A short note on channel 8, released before anyone looks: struck, not held
+  c.pass(0xb8, 0x31);
+  c.pass(0xb8, 0x11);
+  ok = ok && c.keys() == 0x0001 && c.key_ons() == 0x0100;
+  c.clear_key_ons();
+
+  // Frequency change with the key still down is no new note
+  c.pass(0xb0, 0x25);
+  ok = ok && c.key_ons() == 0;
+
+  // Rhythm: bass drum and hi-hat on, then snare added
+  c.pass(0xbd, 0x31);
+  ok = ok && c.keys() == 0x2201 && c.key_ons() == 0x2200;
+  c.clear_key_ons();
+  c.pass(0xbd, 0x39);
+  ok = ok && c.keys() == 0x3201 && c.key_ons() == 0x1000;
+  c.clear_key_ons();
+
+  // Rhythm mode off: the drums drop out of keys() and strike nothing
+  c.pass(0xbd, 0x19);
+  ok = ok && c.keys() == 0x0001 && c.key_ons() == 0;
+
+  // Back on with the same bits: all five struck again
+  c.pass(0xbd, 0x39);
+  ok = ok && c.key_ons() == 0x3200;
+
+  c.reset();
+  return ok && c.keys() == 0 && c.key_ons() == 0;
+}
+
+static int selftest()
+{
+  SelfTest test("Meter Telemetry");
+  double fft_err = 0.0;
+  bool pass = test_fft(fft_err);
+  test.check(pass, "FFT vs DFT", "%.2f LSB worst", fft_err);
+  uint32_t level_bad = 0;
+  pass = test_level(level_bad);
+  test.check(pass, "Levels", "%u off by more than a step", level_bad);
+  double in_band = 0.0, rejection = 0.0, rms = 0.0, quiet = 0.0;
+  pass = test_bands(in_band, rejection, rms, quiet);
+  test.check(pass, "Bands", "-%.1f dB worst in band, %.1f dB down 3 bins away", in_band, rejection);
+  test.info("RMS", "-%.1f dB full scale, %.1f dB for -20 dB", rms, quiet);
+  test.check(test_pack(), "Pack / lines", "record and hex line round-trip");
+  test.check(test_keys(), "OPL keys", "held keys and key-ons, rhythm mode included");
+  return test.finish();
+}
+
+static void usage()
+{
+  fprintf(stderr, "Usage: meter_telemetry <capture.csv> [-x]\n"
+                  "       meter_telemetry -d <serial.log | ->\n"
+                  "       meter_telemetry -t\n");
+}
+
+int main(int argc, char **argv)
+{
+  const char *in_path = nullptr;
+  const char *log_path = nullptr;
+  bool lines = false;
+  bool test = false;
+
+  for (int i = 1; i < argc; ++i)
+  {
+    if (!strcmp(argv[i], "-d") && i + 1 < argc)
+      log_path = argv[++i];
+    else if (!strcmp(argv[i], "-x"))
+      lines = true;
+    else if (!strcmp(argv[i], "-t"))
+      test = true;
+    else if (!in_path)
+      in_path = argv[i];
+    else
+    {
+      usage();
+      return 1;
+    }
+  }
+
+  if (test)
+    return selftest();
+  if (log_path)
+    return run_log(log_path);
+  if (!in_path)
+  {
+    usage();
+    return 1;
+  }
+  return run_capture(in_path, lines);
+}
@@ -0,0 +1,353 @@
+/*
+ * PARALAX - soft OPL2 rendering, speed and bit-exactness (host)
+ * ThisOldCPU Project - https://github.com/thisoldcpu
+ *
+ * Runs the firmware's Opl2Synth on the host. Given an OPL2LPT capture it
+ * decodes the register writes, renders them at the chip's native rate and
+ * prints an FNV-1a hash of the sample stream; -e compares that hash with
+ * one recorded earlier (on the host or from another build) and fails on
+ * any difference. -w writes a WAV through Opl2PcmSource, the 48 kHz path
+ * the USB endpoint gets, or at the native rate with -n.
+ *
+ * -t renders a built-in register script (all nine melodic voices with
+ * every waveform, feedback, both connections, AM, vibrato, key scaling,
+ * releases, then rhythm mode) and checks its hash against the reference
+ * below, then times nine sustained voices for -b seconds of audio. Core 1 has 1 / 49716 s per native sample; the
+ * nanoseconds per sample printed here are the host's share of that. It
+ * also runs pcm_interp_check(), the interpolator model against plain C.
+ *
+ * Build:
+ *   g++ -std=c++17 -O2 -Iinclude -Itools -o opl2_render tools/opl2_render.cpp \
+ *       src/opl2_synth.cpp src/opl2_pcm.cpp src/pcm_interp.cpp src/dac_pcm.cpp \
+ *       src/pit_clock.cpp src/device_decoders.cpp src/cmslpt_decoder.cpp
+ *
+ * Usage:
+ *   opl2_render <capture.csv> [-w out.wav] [-n] [-e hash]
+ *   opl2_render -t [-b seconds]
+ *
+ * License : MIT
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <vector>
+
+#include "capture_csv.h"
+#include "device_decoders.h"
+#include "opl2_pcm.h"
+#include "opl2_synth.h"
+#include "pcm_interp.h"
+#include "selftest.h"
+#include "wav_writer.h"
+
+// Hash of the self-test script's native stream; changes only with the model
+static constexpr uint32_t SELFTEST_HASH = 0x7c8cb6b4u;
+static constexpr uint32_t SELFTEST_SAMPLES = 2 * 49716;
+
+static constexpr uint32_t NATIVE_RATE_HZ =
+    (Opl2Synth::CLOCK_HZ + Opl2Synth::CLOCKS_PER_SAMPLE / 2) / Opl2Synth::CLOCKS_PER_SAMPLE;
+
+struct TimedWrite
+{
+  uint64_t sample; // native sample index the write lands before
+  uint8_t  reg;
+  uint8_t  value;
+};
+
+class WavSink : public PcmSink
+{
+public:
+  explicit WavSink(WavWriter &wav) : wav_(wav) {}
+
+  void on_sample(int16_t left, int16_t right) override
+  {
+    int16_t s[2] = {left, right};
+    wav_.write(s, 1);
+  }
+
+private:
+  WavWriter &wav_;
+};
+
+struct Fnv1a
+{
+  uint32_t h = 0x811c9dc5u;
+
+  void add(int16_t s)
+  {
+    uint16_t v = (uint16_t)s;
+    h = (h ^ (uint8_t)v) * 0x01000193u;
+    h = (h ^ (uint8_t)(v >> 8)) * 0x01000193u;
+  }
+};
+
+static void usage()
+{
+  fprintf(stderr, "Usage: opl2_render <capture.csv> [-w out.wav] [-n] [-e hash]\n"
+                  "       opl2_render -t [-b seconds]\n");
+}
+
+// Renders `total` native samples with the writes applied on time
+static uint32_t render(const std::vector<TimedWrite> &writes, uint64_t total, WavWriter *wav)
+{
+  Opl2Synth synth;
+  Fnv1a hash;
+  int16_t buf[256];
+  size_t next = 0;
+  uint64_t pos = 0;
+
+  while (pos < total)
+  {
+    while (next < writes.size() && writes[next].sample <= pos)
+    {
+      synth.write(writes[next].reg, writes[next].value);
+      next++;
+    }
+
+    uint64_t until = total;
+    if (next < writes.size() && writes[next].sample < until)
+      until = writes[next].sample;
+    uint32_t n = (uint32_t)(until - pos);
+    if (n > 256)
+      n = 256;
+
+    synth.render(buf, n);
+    for (uint32_t i = 0; i < n; ++i)
+      hash.add(buf[i]);
+    if (wav)
+      wav->write(buf, n);
+    pos += n;
+  }
+  return hash.h;
+}
+
+// ---- Self-test ----
+
+static void selftest_voice(std::vector<TimedWrite> &w, uint64_t at, uint8_t c)
+{
+  static const uint8_t mod_off[9] = {0x00, 0x01, 0x02, 0x08, 0x09, 0x0a, 0x10, 0x11, 0x12};
+  uint8_t m = mod_off[c];
+  uint8_t k = (uint8_t)(m + 3);
+
+  auto put = [&](uint8_t reg, uint8_t value) { w.push_back({at, reg, value}); };
+
+  put((uint8_t)(0x20 + m), (uint8_t)(((c & 1) ? 0x80 : 0) | ((c & 2) ? 0x40 : 0) | 0x20 | ((c & 4) ? 0x10 : 0) |
+                                     ((c + 1) & 0x0f)));
+  put((uint8_t)(0x40 + m), (uint8_t)(((c & 3) << 6) | (0x10 + c * 3)));
+  put((uint8_t)(0x60 + m), (uint8_t)(0xf0 | (c + 2)));
+  put((uint8_t)(0x80 + m), (uint8_t)(0x40 | ((c + 3) & 0x0f)));
+  put((uint8_t)(0xe0 + m), (uint8_t)(c & 3));
+
+  put((uint8_t)(0x20 + k), (uint8_t)(((c & 4) ? 0x00 : 0x20) | ((c & 1) ? 0x40 : 0) | 0x01));
+  put((uint8_t)(0x40 + k), (uint8_t)(((c >> 1) & 3) << 6 | (c * 2)));
+  put((uint8_t)(0x60 + k), (uint8_t)(((0x0f - (c & 7)) << 4) | 0x04));
+  put((uint8_t)(0x80 + k), (uint8_t)(0x25 + c));
+  put((uint8_t)(0xe0 + k), (uint8_t)((c >> 1) & 3));
+
+  put((uint8_t)(0xc0 + c), (uint8_t)(((c % 8) << 1) | (c & 1)));
+  uint16_t fnum = (uint16_t)(0x157 + c * 40);
+  put((uint8_t)(0xa0 + c), (uint8_t)fnum);
+  put((uint8_t)(0xb0 + c), (uint8_t)(0x20 | ((3 + c % 3) << 2) | (fnum >> 8)));
+}
+
+static std::vector<TimedWrite> selftest_script()
+{
+  std::vector<TimedWrite> w;
+  const uint64_t ms = NATIVE_RATE_HZ / 1000;
+
+  w.push_back({0, 0x01, 0x20}); // waveform select on
+  w.push_back({0, 0xbd, 0xc0}); // deep AM and vibrato
+  for (uint8_t c = 0; c < 9; ++c)
+    selftest_voice(w, c * 5 * ms, c);
+
+  // Bend every voice while held, then release
+  for (uint8_t c = 0; c < 9; ++c)
+  {
+    uint16_t fnum = (uint16_t)(0x1c0 + c * 33);
+    w.push_back({500 * ms, (uint8_t)(0xa0 + c), (uint8_t)fnum});
+    w.push_back({500 * ms, (uint8_t)(0xb0 + c), (uint8_t)(0x20 | ((2 + c % 4) << 2) | (fnum >> 8))});
+  }
+  for (uint8_t c = 0; c < 9; ++c)
+    w.push_back({(1000 + c * 10) * ms, (uint8_t)(0xb0 + c), 0x0d});
+
+  // Rhythm: all five, then snare and cymbal alone, waveform select off
+  w.push_back({1300 * ms, 0xbd, 0xff});
+  w.push_back({1500 * ms, 0xbd, 0xe0});
+  w.push_back({1550 * ms, 0xbd, 0xea});
+  w.push_back({1800 * ms, 0x01, 0x00});
+  w.push_back({1900 * ms, 0xbd, 0x20});
+  return w;
+}
+
+static double bench(double seconds)
+{
+  std::vector<TimedWrite> w;
+  w.push_back({0, 0x01, 0x20});
+  w.push_back({0, 0xbd, 0xc0});
+  for (uint8_t c = 0; c < 9; ++c)
+    selftest_voice(w, 0, c);
+
+  Opl2Synth synth;
+  for (const TimedWrite &t : w)
+    synth.write(t.reg, t.value);
+
+  uint64_t total = (uint64_t)(seconds * NATIVE_RATE_HZ);
+  int16_t buf[256];
+  int64_t sink = 0;
+
+  double t_start = now_secs();
+  for (uint64_t pos = 0; pos < total; pos += 256)
+  {
+    synth.render(buf, 256);
+    sink += buf[255];
+  }
+  double secs = now_secs() - t_start;
+  if (sink == INT64_MIN)
+    fprintf(stderr, "\n"); // keep the loop observable
+  return secs;
+}
+
+static int selftest(double bench_s)
+{
+  std::vector<TimedWrite> w = selftest_script();
+  uint32_t h1 = render(w, SELFTEST_SAMPLES, nullptr);
+  uint32_t h2 = render(w, SELFTEST_SAMPLES, nullptr);
+  uint32_t interp_bad = pcm_interp_check(65536);
+
+  SelfTest test("OPL2");
+  test.info("Script", "%zu writes, %u samples", w.size(), SELFTEST_SAMPLES);
+  test.check(h1 == SELFTEST_HASH && h1 == h2, "Hash", "0x%08x (reference 0x%08x)%s", h1, SELFTEST_HASH,
+             h1 == h2 ? "" : ", second run differs");
+  test.check(interp_bad == 0, "Interpolator", "%u mismatches in 65536 blends and mixes (%s)", interp_bad,
+             PCM_INTERP_HW ? "SIO" : "model vs plain C");
+
+  double secs = bench(bench_s);
+  double ns = secs * 1e9 / (bench_s * NATIVE_RATE_HZ);
+  test.info("Render speed", "%.1fx real time, 9 voices (%.0f ns per sample, %.0f ns budget)",
+            secs > 0 ? bench_s / secs : 0.0, ns, 1e9 / NATIVE_RATE_HZ);
+  return test.finish();
+}
+
+int main(int argc, char **argv)
+{
+  const char *in_path = nullptr;
+  const char *wav_path = nullptr;
+  bool native = false;
+  bool test = false;
+  bool have_expect = false;
+  uint32_t expect = 0;
+  double bench_s = 10.0;
+
+  for (int i = 1; i < argc; ++i)
+  {
+    if (!strcmp(argv[i], "-w") && i + 1 < argc)
+      wav_path = argv[++i];
+    else if (!strcmp(argv[i], "-n"))
+      native = true;
+    else if (!strcmp(argv[i], "-e") && i + 1 < argc)
+    {
+      expect = (uint32_t)strtoul(argv[++i], nullptr, 16);
+      have_expect = true;
+    }
+    else if (!strcmp(argv[i], "-t"))
+      test = true;
+    else if (!strcmp(argv[i], "-b") && i + 1 < argc)
+      bench_s = atof(argv[++i]);
+    else if (!in_path)
+      in_path = argv[i];
+    else
+    {
+      usage();
+      return 1;
+    }
+  }
+
+  if (test)
+    return selftest(bench_s > 0 ? bench_s : 10.0);
+  if (!in_path)
+  {
+    usage();
+    return 1;
+  }
+
+  CsvCaptureReader reader;
+  if (!reader.open(in_path))
+  {
+    fprintf(stderr, "Error: cannot open '%s'\n", in_path);
+    return 1;
+  }
+
+  // Decode everything first; both renders replay the same writes
+  Opl2LptDecoder dec;
+  TimeUnwrapper clock;
+  std::vector<DeviceEvent> events;
+  std::vector<TimedWrite> writes;
+  uint64_t first_t = 0, last_t = 0;
+
+  CaptureFrame f;
+  DeviceEvent e;
+  while (reader.next(f))
+  {
+    uint64_t t = clock.extend(f.t_us);
+    if (!dec.feed(f, e))
+      continue;
+    if (events.empty())
+      first_t = t;
+    last_t = t;
+    events.push_back(e);
+    writes.push_back({(t - first_t) * Opl2Synth::CLOCK_HZ / (Opl2Synth::CLOCKS_PER_SAMPLE * 1000000ull), e.reg,
+                      e.value});
+  }
+  if (events.empty())
+  {
+    fprintf(stderr, "Error: no OPL2LPT writes in '%s'\n", in_path);
+    return 1;
+  }
+
+  // A second of tail so releases finish
+  uint64_t total = writes.back().sample + NATIVE_RATE_HZ;
+
+  WavWriter wav;
+  if (wav_path && !wav.open(wav_path, native ? NATIVE_RATE_HZ : Opl2PcmSource::RATE_HZ, native ? 1 : 2))
+  {
+    fprintf(stderr, "Error: cannot write '%s'\n", wav_path);
+    return 1;
+  }
+
+  double t_start = now_secs();
+  uint32_t hash = render(writes, total, (wav_path && native) ? &wav : nullptr);
+  double secs = now_secs() - t_start;
+
+  // The firmware's path: the same events on the 48 kHz grid
+  uint32_t pcm_samples = 0;
+  if (wav_path && !native)
+  {
+    WavSink sink(wav);
+    Opl2PcmSource pcm(sink);
+    for (const DeviceEvent &ev : events)
+      pcm.on_event(ev);
+    pcm.advance(events.back().t_us + 1000000);
+    pcm_samples = pcm.samples();
+  }
+  wav.close();
+
+  double audio_s = (double)total / NATIVE_RATE_HZ;
+  bool ok = !have_expect || hash == expect;
+
+  fprintf(stderr, "=== OPL2 Render ===\n");
+  fprintf(stderr, "Frames          : %llu\n", (unsigned long long)reader.frames());
+  fprintf(stderr, "Register writes : %zu (%u violations)\n", events.size(), dec.violations());
+  fprintf(stderr, "Music duration  : %.2f s\n", (double)(last_t - first_t) / 1e6);
+  fprintf(stderr, "Native samples  : %llu at %u Hz\n", (unsigned long long)total, NATIVE_RATE_HZ);
+  fprintf(stderr, "Render time     : %.3f s (%.1fx real time)\n", secs, secs > 0 ? audio_s / secs : 0.0);
+  fprintf(stderr, "Hash            : 0x%08x\n", hash);
+  if (wav_path)
+    fprintf(stderr, "WAV             : %s (%llu frames at %u Hz)\n", wav_path,
+            native ? (unsigned long long)total : (unsigned long long)pcm_samples,
+            native ? NATIVE_RATE_HZ : Opl2PcmSource::RATE_HZ);
+  if (have_expect)
+    fprintf(stderr, "Check           : %s (expected 0x%08x)\n", ok ? "OK" : "FAILED", expect);
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,301 @@
+/*
+ * PARALAX - OPL2LPT writes paced to chip timing (host)
+ * ThisOldCPU Project - https://github.com/thisoldcpu
+ *
+ * Decodes a capture's OPL2LPT register writes and runs them through
+ * OplScheduler, the stage in front of the soft OPL2 on core 1, with the
+ * YM3812's timing (or the YMF262's with -3). It reports how many writes
+ * the program made closer than the chip takes them, how deep the queue
+ * got and how late the scheduled writes ran against the capture.
+ *
+ * Ahead of the scheduler, OplWriteCache drops writes that repeat a
+ * register's value (as on core 1); the summary gives writes per second
+ * before and after it and the bus and VGM bytes saved. -k keeps every
+ * write.
+ *
+ * -o writes the scheduled stream as a VGM for the chip picked, the form a
+ * real-chip player or a link to one replays safely. VGM time has 44.1 kHz
+ * steps; writes between two steps keep their order. -l lists
+ * t_in_us,t_out_us,reg,value on stdout.
+ *
+ * -t checks that sparse writes pass untouched, that bursts come out in
+ * order at exactly the chip's spacing and catch up after, that a flood
+ * longer than the queue forces writes rather than dropping them, OPL3
+ * spacing, a clock wrap, and which writes the cache drops.
+ *
+ * Build:
+ *   g++ -std=c++17 -O2 -Iinclude -Itools -o opl_schedule tools/opl_schedule.cpp \
+ *       src/opl_scheduler.cpp src/opl_write_cache.cpp src/device_decoders.cpp \
+ *       src/cmslpt_decoder.cpp
+ *
+ * Usage:
+ *   opl_schedule <capture.csv> [-3] [-k] [-o out.vgm] [-l]
+ *   opl_schedule -t
+ *
+ * License : MIT
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include <vector>
+
+#include "capture_csv.h"
+#include "device_decoders.h"
+#include "opl_scheduler.h"
+#include "opl_write_cache.h"
+#include "selftest.h"
+#include "vgm_writer.h"
+
+struct ScheduledWrite
+{
+  uint64_t t_ns;
+  uint16_t reg;
+  uint8_t  value;
+};
+
+class RecordSink : public OplWriteSink
+{
+public:
+  void on_opl_write(uint64_t t_ns, uint16_t reg, uint8_t value) override { out.push_back({t_ns, reg, value}); }
+
+  std::vector<ScheduledWrite> out;
+};
+
+// ---- Self-test ----
+
+struct Input
+{
+  uint32_t t_us;
+  uint8_t  reg;
+};
+
+// Plays `in` (value = index) and checks order, spacing and lateness
+static void run_case(SelfTest &test, const char *name, const OplTiming &timing, const std::vector<Input> &in,
+                     uint32_t want_delayed_min, uint32_t want_delayed_max, bool want_forced)
+{
+  RecordSink sink;
+  OplScheduler sched(sink, timing);
+  for (size_t i = 0; i < in.size(); ++i)
+  {
+    sched.advance(in[i].t_us);
+    sched.push(in[i].t_us, in[i].reg, (uint8_t)i);
+  }
+  sched.flush();
+
+  const uint64_t spacing = (uint64_t)timing.addr_ns + timing.data_ns;
+  const uint64_t base = (uint64_t)in[0].t_us * 1000;
+  bool pass = sink.out.size() == in.size() && sched.depth() == 0;
+  uint32_t tight_out = 0;
+  uint64_t t_in = base;
+  for (size_t i = 0; pass && i < in.size(); ++i)
+  {
+    const ScheduledWrite &w = sink.out[i];
+    if (i)
+      t_in += (uint64_t)(uint32_t)(in[i].t_us - in[i - 1].t_us) * 1000;
+    if (w.reg != in[i].reg || w.value != (uint8_t)i || w.t_ns < t_in)
+      pass = false;
+    if (!want_forced && w.t_ns - t_in > spacing * OplScheduler::QUEUE_WRITES)
+      pass = false;
+    if (i && w.t_ns < sink.out[i - 1].t_ns)
+      pass = false;
+    else if (i && w.t_ns - sink.out[i - 1].t_ns < spacing)
+      tight_out++;
+  }
+  pass = pass && sched.delayed() >= want_delayed_min && sched.delayed() <= want_delayed_max &&
+         (sched.forced() > 0) == want_forced && tight_out == sched.forced();
+
+  test.check(pass, name, "%u writes, %u tight in, %u delayed, %u forced, depth %u, late max %u us mean %u us",
+             sched.writes(), sched.tight(), sched.delayed(), sched.forced(), sched.max_depth(), sched.max_late_us(),
+             sched.mean_late_us());
+}
+
+// A driver tick rewriting levels and frequencies of every voice
+static void cache_case(SelfTest &test)
+{
+  OplWriteCache cache;
+  uint32_t passed = 0;
+  for (uint32_t tick = 0; tick < 100; ++tick)
+  {
+    for (uint8_t c = 0; c < 9; ++c)
+    {
+      passed += cache.pass((uint16_t)(0x40 + c), (uint8_t)(tick < 50 ? 0x10 : 0x20)); // level change at 50
+      passed += cache.pass((uint16_t)(0xa0 + c), 0x41);
+      passed += cache.pass((uint16_t)(0xb0 + c), 0x32); // key-on, always
+      passed += cache.pass((uint16_t)(0x1a0 + c), 0x41); // OPL3 second set is its own
+    }
+    passed += cache.pass(0xbd, 0x20);
+    passed += cache.pass(0x04, 0x80);
+  }
+  // Per tick: 9 key-ons, 0xbd, 0x04; plus the first sight of 27 registers and the level change
+  uint32_t want = 100 * 11 + 27 + 9;
+  bool pass = passed == want && cache.passed() == want && cache.writes() == 100 * 38;
+  uint32_t saved = cache.bytes_saved();
+
+  cache.reset();
+  pass = pass && cache.pass(0x40, 0x20) && cache.pass(0x40, 0x21) && !cache.pass(0x40, 0x21);
+
+  test.check(pass, "Write cache", "%u of %u writes passed, %u bus bytes saved", passed, 100 * 38, saved);
+}
+
+static int selftest()
+{
+  SelfTest test("OPL Scheduler");
+
+  // A tracker at 30 us per write: nothing to do
+  {
+    std::vector<Input> in;
+    for (uint32_t i = 0; i < 2000; ++i)
+      in.push_back({1000 + i * 30, (uint8_t)(0x20 + i % 0xd6)});
+    run_case(test, "Sparse", OPL2_TIMING, in, 0, 0, false);
+  }
+
+  // A note-on burst every 10 ms, 40 writes 1 us apart: spread, caught up before the next
+  {
+    std::vector<Input> in;
+    for (uint32_t b = 0; b < 50; ++b)
+      for (uint32_t i = 0; i < 40; ++i)
+        in.push_back({5000 + b * 10000 + i, (uint8_t)(0xa0 + i % 9)});
+    run_case(test, "Bursts", OPL2_TIMING, in, 50 * 39, 50 * 39, false);
+  }
+
+  // 1000 writes 1 us apart: the queue fills and the oldest are forced out
+  {
+    std::vector<Input> in;
+    for (uint32_t i = 0; i < 1000; ++i)
+      in.push_back({200 + i, (uint8_t)i});
+    run_case(test, "Flood", OPL2_TIMING, in, 1, 1000, true);
+  }
+
+  // Same bursts at the YMF262's spacing
+  {
+    std::vector<Input> in;
+    for (uint32_t b = 0; b < 50; ++b)
+      for (uint32_t i = 0; i < 40; ++i)
+        in.push_back({5000 + b * 10000 + i * 2, (uint8_t)(0xa0 + i % 9)});
+    run_case(test, "OPL3 bursts", OPL3_TIMING, in, 50 * 39, 50 * 39, false);
+  }
+
+  // The capture clock wraps mid-burst
+  {
+    std::vector<Input> in;
+    for (uint32_t i = 0; i < 200; ++i)
+      in.push_back({0xfffff000u + i * 10, (uint8_t)i});
+    run_case(test, "Clock wrap", OPL2_TIMING, in, 1, 199, false);
+  }
+
+  cache_case(test);
+  return test.finish();
+}
+
+// ---- Capture ----
+
+int main(int argc, char **argv)
+{
+  const char *in_path = nullptr;
+  const char *vgm_path = nullptr;
+  bool opl3 = false;
+  bool keep = false;
+  bool list = false;
+  bool test = false;
+
+  for (int i = 1; i < argc; ++i)
+  {
+    if (!strcmp(argv[i], "-o") && i + 1 < argc)
+      vgm_path = argv[++i];
+    else if (!strcmp(argv[i], "-3"))
+      opl3 = true;
+    else if (!strcmp(argv[i], "-k"))
+      keep = true;
+    else if (!strcmp(argv[i], "-l"))
+      list = true;
+    else if (!strcmp(argv[i], "-t"))
+      test = true;
+    else if (!in_path)
+      in_path = argv[i];
+  }
+  if (test)
+    return selftest();
+  if (!in_path)
+  {
+    fprintf(stderr, "Usage: opl_schedule <capture.csv> [-3] [-k] [-o out.vgm] [-l]\n"
+                    "       opl_schedule -t\n");
+    return 1;
+  }
+
+  CsvCaptureReader reader;
+  if (!reader.open(in_path))
+  {
+    fprintf(stderr, "Error: cannot open '%s'\n", in_path);
+    return 1;
+  }
+
+  const OplTiming &timing = opl3 ? OPL3_TIMING : OPL2_TIMING;
+  Opl2LptDecoder dec;
+  RecordSink sink;
+  OplScheduler sched(sink, timing);
+  OplWriteCache cache;
+  std::vector<uint32_t> t_in;
+  uint32_t first_t = 0, last_t = 0;
+
+  CaptureFrame f;
+  DeviceEvent e;
+  while (reader.next(f))
+  {
+    sched.advance(f.t_us);
+    if (!dec.feed(f, e))
+      continue;
+    if (!cache.writes())
+      first_t = e.t_us;
+    last_t = e.t_us;
+    if (!cache.pass(e.reg, e.value) && !keep)
+      continue;
+    t_in.push_back(e.t_us);
+    sched.push(e.t_us, e.reg, e.value);
+  }
+  sched.flush();
+
+  VgmWriter vgm;
+  vgm.set_clock(opl3 ? VGM_OFS_YMF262 : VGM_OFS_YM3812, opl3 ? CLOCK_YMF262 : CLOCK_YM3812);
+  for (size_t i = 0; i < sink.out.size(); ++i)
+  {
+    const ScheduledWrite &w = sink.out[i];
+    if (vgm_path)
+    {
+      vgm.advance_to(w.t_ns / 1000);
+      vgm.write2(opl3 ? VGM_CMD_YMF262_P0 : VGM_CMD_YM3812, (uint8_t)w.reg, w.value);
+    }
+    if (list)
+      printf("%u,%u,%02X,%02X\n", t_in[i], (uint32_t)(w.t_ns / 1000), w.reg, w.value);
+  }
+
+  fprintf(stderr, "=== OPL Schedule ===\n");
+  fprintf(stderr, "Frames read     : %llu (%llu non-frame lines skipped)\n",
+          (unsigned long long)reader.frames(), (unsigned long long)reader.skipped_lines());
+  fprintf(stderr, "Chip timing     : %s, %.2f us + %.2f us per write\n", opl3 ? "YMF262" : "YM3812",
+          timing.addr_ns / 1000.0, timing.data_ns / 1000.0);
+  fprintf(stderr, "Register writes : %u (%u closer than the chip allows)\n", sched.writes(), sched.tight());
+  double secs = (double)(uint32_t)(last_t - first_t) / 1e6;
+  if (secs > 0)
+    fprintf(stderr, "Writes/s        : %.0f captured, %.0f to the chip\n", cache.writes() / secs,
+            (keep ? cache.writes() : cache.passed()) / secs);
+  fprintf(stderr, "Write cache     : %s%u of %u repeat a register (%.1f%%), %u bus bytes, %u VGM bytes saved\n",
+          keep ? "off, " : "", cache.dropped(), cache.writes(),
+          cache.writes() ? 100.0 * cache.dropped() / cache.writes() : 0.0, keep ? 0 : cache.bytes_saved(),
+          keep ? 0 : cache.dropped() * 3);
+  fprintf(stderr, "Queue depth     : %u max of %u\n", sched.max_depth(), OplScheduler::QUEUE_WRITES);
+  fprintf(stderr, "Delayed writes  : %u, late max %u us, mean %u us, %u over %u us\n", sched.delayed(),
+          sched.max_late_us(), sched.mean_late_us(), sched.over_bound(), OplScheduler::LATE_BOUND_US);
+  fprintf(stderr, "Forced writes   : %u\n", sched.forced());
+
+  if (vgm_path)
+  {
+    if (!vgm.finish(vgm_path))
+    {
+      fprintf(stderr, "Error: cannot write '%s'\n", vgm_path);
+      return 1;
+    }
+    fprintf(stderr, "VGM written     : %s (%llu commands)\n", vgm_path, (unsigned long long)vgm.commands());
+  }
+  return 0;
+}
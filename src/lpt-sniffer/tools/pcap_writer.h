@@ -0,0 +1,72 @@
+/*
+ * PARALAX - minimal pcap writer (host only)
+ * ThisOldCPU Project - https://github.com/thisoldcpu
+ *
+ * Classic libpcap format with nanosecond timestamps (magic 0xA1B23C4D),
+ * written in host byte order as the format allows. Records go straight to
+ * a buffered FILE, so memory stays constant however long the capture.
+ *
+ * License : MIT
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+
+static constexpr uint32_t PCAP_MAGIC_NS = 0xA1B23C4Du;
+static constexpr uint32_t PCAP_LINKTYPE_ETHERNET = 1;
+
+class PcapWriter
+{
+public:
+  PcapWriter() = default;
+  PcapWriter(const PcapWriter &) = delete;
+  PcapWriter &operator=(const PcapWriter &) = delete;
+  ~PcapWriter() { close(); }
+
+  bool open(const char *path, uint32_t linktype, uint32_t snaplen = 65535)
+  {
+    close();
+    fp_ = fopen(path, "wb");
+    if (!fp_)
+      return false;
+    setvbuf(fp_, nullptr, _IOFBF, 1u << 20);
+
+    uint32_t hdr[6];
+    hdr[0] = PCAP_MAGIC_NS;
+    hdr[1] = 2u | (4u << 16); // version 2.4
+    hdr[2] = 0;               // thiszone
+    hdr[3] = 0;               // sigfigs
+    hdr[4] = snaplen;
+    hdr[5] = linktype;
+    return fwrite(hdr, sizeof(hdr), 1, fp_) == 1;
+  }
+
+  // One packet at capture time t_ns (nanoseconds from capture start)
+  bool write(uint64_t t_ns, const uint8_t *data, uint32_t len)
+  {
+    if (!fp_)
+      return false;
+    uint32_t rec[4];
+    rec[0] = (uint32_t)(t_ns / 1000000000u);
+    rec[1] = (uint32_t)(t_ns % 1000000000u);
+    rec[2] = len;
+    rec[3] = len;
+    packets_++;
+    return fwrite(rec, sizeof(rec), 1, fp_) == 1 && fwrite(data, 1, len, fp_) == len;
+  }
+
+  void close()
+  {
+    if (fp_)
+      fclose(fp_);
+    fp_ = nullptr;
+  }
+
+  uint32_t packets() const { return packets_; }
+
+private:
+  FILE    *fp_ = nullptr;
+  uint32_t packets_ = 0;
+};
@@ -0,0 +1,298 @@
+/*
+ * PARALAX - PIT divisor recovery on a Covox capture (host)
+ * ThisOldCPU Project - https://github.com/thisoldcpu
+ *
+ * Feeds a capture's Covox writes to PitClock, the stage DacPcmSource uses
+ * on core 1, and reports the 8253 divisor the program played at, the exact
+ * rate behind it, the write jitter around the recovered grid and the
+ * crystal difference the loop tracked. The mean rate from the raw
+ * timestamps (what analyze_capture.py reports) is printed next to it.
+ *
+ * -w writes the writes themselves as a WAV at the recovered rate, one
+ * sample per grid slot and nothing resampled; slots without a write hold
+ * the last value. Only the locked stretches are written.
+ *
+ * -t plays synthetic timer-paced writes (jitter, latency spikes, repeated
+ * bytes, a crystal offset) and checks the divisor, that snapped writes
+ * land under 0.75 us rms from the true slots (timestamps are whole
+ * microseconds) and at least 3x closer than the raw ones, the tracked
+ * offset, a rate change, a pause and a stream with no timer behind it.
+ *
+ * Build:
+ *   g++ -std=c++17 -O2 -Iinclude -Itools -o pit_lock tools/pit_lock.cpp src/pit_clock.cpp \
+ *       src/device_decoders.cpp src/cmslpt_decoder.cpp
+ *
+ * Usage:
+ *   pit_lock <capture.csv> [-w out.wav]
+ *   pit_lock -t
+ *
+ * License : MIT
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "capture_csv.h"
+#include "device_decoders.h"
+#include "pit_clock.h"
+#include "selftest.h"
+#include "wav_writer.h"
+
+// ---- Self-test ----
+
+struct Synth
+{
+  double   jitter_us = 8.0;  // uniform interrupt latency
+  double   spike_us = 40.0;  // occasional long latency, at most a third of a period
+  double   spike_rate = 0.01;
+  double   repeat_rate = 0.25; // repeated bytes: no Covox event
+  double   ppm = 80.0;         // PC crystal against the Pico
+};
+
+struct Result
+{
+  uint32_t divisor = 0;
+  uint32_t lock_writes = 0; // writes fed before the first lock
+  double   err_rms_us = 0.0; // snapped minus true slot, mean removed
+  double   raw_rms_us = 0.0; // raw write time minus true slot, mean removed
+};
+
+// Plays `seconds` of writes paced by `divisor` from t_start; returns the time reached
+static double play(PitClock &pit, TestRng &rng, const Synth &sy, uint32_t divisor, double t_start, double seconds,
+                   Result &res)
+{
+  double period = divisor * 1e6 / PitClock::PIT_HZ * (1.0 + sy.ppm / 1e6);
+  double spike = fmin(sy.spike_us, period / 3.0);
+  double sum_e = 0.0, sum_e2 = 0.0, sum_r = 0.0, sum_r2 = 0.0;
+  uint32_t n = 0;
+  uint32_t fed = 0;
+  double t = t_start;
+  for (; t < t_start + seconds * 1e6; t += period)
+  {
+    if (rng.unit() < sy.repeat_rate)
+      continue;
+    double lat = rng.unit() * sy.jitter_us;
+    if (rng.unit() < sy.spike_rate)
+      lat += spike;
+    uint32_t t_us = (uint32_t)(t + lat);
+    int32_t off = 0;
+    fed++;
+    if (!pit.on_write(t_us, off))
+      continue;
+    if (!res.lock_writes)
+      res.lock_writes = fed;
+    res.divisor = pit.divisor();
+
+    // Settled: skip the first half second after the lock
+    if (fed < res.lock_writes + (uint32_t)(500000.0 / period))
+      continue;
+    double e = t_us + off / 65536.0 - t;
+    double r = t_us - t;
+    sum_e += e;
+    sum_e2 += e * e;
+    sum_r += r;
+    sum_r2 += r * r;
+    n++;
+  }
+  if (n)
+  {
+    res.err_rms_us = sqrt(fmax(0.0, sum_e2 / n - (sum_e / n) * (sum_e / n)));
+    res.raw_rms_us = sqrt(fmax(0.0, sum_r2 / n - (sum_r / n) * (sum_r / n)));
+  }
+  return t;
+}
+
+static int selftest()
+{
+  Synth sy;
+  SelfTest test("PIT Clock");
+
+  // Common player rates: 44.2, 22.1, 11.0, 8.0, 4.0, 1.0 kHz
+  static const uint32_t divisors[] = {27, 54, 108, 149, 298, 1193};
+  static const double offsets[] = {-150.0, 150.0};
+  for (uint32_t d : divisors)
+  {
+    for (double ppm : offsets)
+    {
+      sy.ppm = ppm;
+      PitClock pit;
+      TestRng rng;
+      Result res;
+      play(pit, rng, sy, d, 1000.0, 3.0, res);
+      bool pass = res.divisor == d && pit.unlocks() == 0 && res.err_rms_us < 0.75 &&
+                  res.err_rms_us * 3.0 < res.raw_rms_us && abs(pit.clock_ppm() - (int32_t)ppm) < 30;
+      char label[32];
+      snprintf(label, sizeof(label), "Divisor %u", d);
+      test.check(pass, label, "%.2f Hz, %+4.0f ppm, locked after %u writes as %u (%+d ppm), %.2f us rms (raw %.2f)",
+                 (double)PitClock::PIT_HZ / d, ppm, res.lock_writes, res.divisor, pit.clock_ppm(), res.err_rms_us,
+                 res.raw_rms_us);
+    }
+  }
+  sy.ppm = 80.0;
+
+  // The program switches rate: unlock, then the new divisor
+  {
+    PitClock pit;
+    TestRng rng;
+    Result a, b;
+    double t = play(pit, rng, sy, 54, 1000.0, 1.0, a);
+    play(pit, rng, sy, 149, t, 1.0, b);
+    bool pass = a.divisor == 54 && pit.divisor() == 149 && pit.unlocks() == 1 && pit.locks() == 2;
+    test.check(pass, "Rate change", "54 -> %u, %u unlocks, %u locks", pit.divisor(), pit.unlocks(), pit.locks());
+  }
+
+  // A pause re-anchors the grid without unlocking
+  {
+    PitClock pit;
+    TestRng rng;
+    Result a, b;
+    double t = play(pit, rng, sy, 108, 1000.0, 1.0, a);
+    play(pit, rng, sy, 108, t + 300000.0 + 3.3, 1.0, b);
+    bool pass = pit.divisor() == 108 && pit.unlocks() == 0 && pit.relocks() == 1 && b.err_rms_us < 0.75;
+    test.check(pass, "Pause 300 ms", "%u relocks, %u unlocks, %.2f us rms", pit.relocks(), pit.unlocks(), b.err_rms_us);
+  }
+
+  // Writes at random times: nothing to lock to
+  {
+    PitClock pit;
+    TestRng rng;
+    int32_t off = 0;
+    double t = 1000.0;
+    for (uint32_t i = 0; i < 20000; ++i)
+    {
+      t += 20.0 + rng.unit() * 200.0;
+      pit.on_write((uint32_t)t, off);
+    }
+    test.check(pit.locks() == 0, "Random writes", "%u locks", pit.locks());
+  }
+
+  return test.finish();
+}
+
+// ---- Capture ----
+
+int main(int argc, char **argv)
+{
+  const char *in_path = nullptr;
+  const char *wav_path = nullptr;
+  bool test = false;
+
+  for (int i = 1; i < argc; ++i)
+  {
+    if (!strcmp(argv[i], "-w") && i + 1 < argc)
+      wav_path = argv[++i];
+    else if (!strcmp(argv[i], "-t"))
+      test = true;
+    else if (!in_path)
+      in_path = argv[i];
+  }
+  if (test)
+    return selftest();
+  if (!in_path)
+  {
+    fprintf(stderr, "Usage: pit_lock <capture.csv> [-w out.wav]\n"
+                    "       pit_lock -t\n");
+    return 1;
+  }
+
+  CsvCaptureReader reader;
+  if (!reader.open(in_path))
+  {
+    fprintf(stderr, "Error: cannot open '%s'\n", in_path);
+    return 1;
+  }
+
+  CovoxDecoder covox;
+  PitClock pit;
+  WavWriter wav;
+  bool wav_open = false;
+  uint32_t wav_rate = 0;
+
+  CaptureFrame f;
+  DeviceEvent e;
+  uint32_t last_t = 0;
+  uint64_t span_us = 0;
+  uint32_t events = 0;
+  uint32_t lock_at = 0;
+  uint64_t lock_us = 0;
+  uint64_t locked_writes = 0;
+  int16_t held = 0;
+  uint32_t relocks = 0;
+  uint64_t written = 0;
+
+  while (reader.next(f))
+  {
+    if (!covox.feed(f, e))
+      continue;
+
+    if (events)
+      span_us += (uint32_t)(e.t_us - last_t);
+    uint32_t gap_us = e.t_us - last_t;
+    last_t = e.t_us;
+    events++;
+
+    uint64_t slots = pit.slots();
+    int32_t off = 0;
+    if (!pit.on_write(e.t_us, off))
+      continue;
+    locked_writes++;
+    if (!lock_at)
+    {
+      lock_at = events;
+      lock_us = span_us;
+    }
+
+    if (wav_path && !wav_open)
+    {
+      wav_rate = (pit.rate_mhz() + 500) / 1000;
+      if (!wav.open(wav_path, wav_rate, 1))
+      {
+        fprintf(stderr, "Error: cannot write '%s'\n", wav_path);
+        return 1;
+      }
+      wav_open = true;
+    }
+    if (wav_open)
+    {
+      // Hold the last value up to this write's slot; a pause is kept at its length
+      uint64_t k = pit.slots() - slots;
+      if (pit.relocks() != relocks)
+      {
+        relocks = pit.relocks();
+        k = (uint64_t)gap_us * pit.rate_mhz() / 1000000000u;
+      }
+      for (uint64_t i = 0; i < k; ++i)
+        wav.write(&held, 1);
+      written += k;
+      held = (int16_t)(((int32_t)e.value - 128) * 256);
+    }
+  }
+
+  double mean_rate = events > 1 ? (events - 1) * 1e6 / span_us : 0.0;
+  fprintf(stderr, "=== PIT Clock ===\n");
+  fprintf(stderr, "Frames          : %llu\n", (unsigned long long)reader.frames());
+  fprintf(stderr, "Covox writes    : %u over %.3f s\n", events, span_us / 1e6);
+  fprintf(stderr, "Mean write rate : %.1f Hz (timestamps)\n", mean_rate);
+  if (!pit.divisor())
+  {
+    fprintf(stderr, "Divisor         : not found (writes not paced by the PIT)\n");
+    return 0;
+  }
+  fprintf(stderr, "Divisor         : %u (%u.%03u Hz)\n", pit.divisor(), pit.rate_mhz() / 1000,
+          pit.rate_mhz() % 1000);
+  fprintf(stderr, "Locked          : after %u writes (%.1f ms), %llu of %u writes on the grid\n", lock_at,
+          lock_us / 1000.0, (unsigned long long)locked_writes, events);
+  fprintf(stderr, "Grid            : %llu slots, %u without a write, %u shared\n",
+          (unsigned long long)pit.slots(), pit.skipped(), pit.collisions());
+  fprintf(stderr, "Jitter          : %.2f us mean, %.2f us max\n", pit.jitter_q16() / 65536.0,
+          pit.max_jitter_q16() / 65536.0);
+  fprintf(stderr, "Clock offset    : %+d ppm (PC crystal vs capture clock)\n", pit.clock_ppm());
+  fprintf(stderr, "Locks           : %u (%u unlocks, %u re-anchored after a pause)\n", pit.locks(), pit.unlocks(),
+          pit.relocks());
+  if (wav_open)
+    fprintf(stderr, "WAV             : %s (%llu samples at %u Hz)\n", wav_path, (unsigned long long)written,
+            wav_rate);
+  return 0;
+}
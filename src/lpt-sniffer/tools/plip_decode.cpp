@@ -0,0 +1,144 @@
+/*
+ * PARALAX - PLIP / LapLink capture decoder to pcap (host)
+ * ThisOldCPU Project - https://github.com/thisoldcpu
+ *
+ * Reassembles 4-bit PLIP frames in both directions from a sniffer capture
+ * and writes them to a pcap file Wireshark opens directly (PLIP frames
+ * carry an Ethernet header). Reports per-frame transfer time and link
+ * throughput. Capture with the PIO_CHANGE profile.
+ *
+ * Build:
+ *   g++ -std=c++17 -O2 -Iinclude -o plip_decode tools/plip_decode.cpp src/plip_decoder.cpp
+ *
+ * Usage:
+ *   plip_decode <capture.csv> [-w out.pcap] [-b] [-l]
+ *     -w  write frames to a pcap file (nanosecond timestamps)
+ *     -b  also write frames whose checksum failed
+ *     -l  list frames as t_us,dir,length,checksum,transfer_us,KB/s on stdout
+ *
+ * License : MIT
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "capture_csv.h"
+#include "pcap_writer.h"
+#include "plip_decoder.h"
+
+struct LinkStats
+{
+  uint64_t bytes = 0;
+  uint64_t busy_ns = 0;
+  uint64_t first_ns = 0;
+  uint64_t last_ns = 0;
+  uint32_t min_ns = 0xFFFFFFFFu;
+  uint32_t max_ns = 0;
+};
+
+int main(int argc, char **argv)
+{
+  const char *in_path = nullptr;
+  const char *pcap_path = nullptr;
+  bool keep_bad = false;
+  bool list = false;
+
+  for (int i = 1; i < argc; ++i)
+  {
+    if (!strcmp(argv[i], "-w") && i + 1 < argc)
+      pcap_path = argv[++i];
+    else if (!strcmp(argv[i], "-b"))
+      keep_bad = true;
+    else if (!strcmp(argv[i], "-l"))
+      list = true;
+    else if (!in_path)
+      in_path = argv[i];
+  }
+  if (!in_path)
+  {
+    fprintf(stderr, "Usage: plip_decode <capture.csv> [-w out.pcap] [-b] [-l]\n");
+    return 1;
+  }
+
+  CsvCaptureReader reader;
+  if (!reader.open(in_path))
+  {
+    fprintf(stderr, "Error: cannot open '%s'\n", in_path);
+    return 1;
+  }
+
+  PcapWriter pcap;
+  if (pcap_path && !pcap.open(pcap_path, PCAP_LINKTYPE_ETHERNET))
+  {
+    fprintf(stderr, "Error: cannot write '%s'\n", pcap_path);
+    return 1;
+  }
+
+  static const char *DIR_NAME[2] = {"tx", "rx"};
+
+  static PlipDecoder dec;
+  TimeUnwrapper clock;
+  LinkStats stats[2];
+
+  CaptureFrame f;
+  PlipFrame p;
+  while (reader.next(f))
+  {
+    uint64_t now_us = clock.extend(f.t_us);
+    if (!dec.feed(f, p))
+      continue;
+
+    // The frame started before the frame that completed it
+    uint64_t start_ns = (now_us - (uint32_t)(f.t_us - p.t_us)) * 1000u + (((uint32_t)p.t_sub * 1000u) >> 8);
+
+    LinkStats &s = stats[p.dir];
+    if (s.bytes == 0)
+      s.first_ns = start_ns;
+    s.last_ns = start_ns + p.transfer_ns;
+    s.bytes += p.length;
+    s.busy_ns += p.transfer_ns;
+    if (p.transfer_ns < s.min_ns)
+      s.min_ns = p.transfer_ns;
+    if (p.transfer_ns > s.max_ns)
+      s.max_ns = p.transfer_ns;
+
+    if (pcap_path && (p.checksum_ok || keep_bad))
+      pcap.write(start_ns, p.payload, p.length);
+
+    if (list)
+    {
+      double rate = p.transfer_ns ? (double)p.length * 1e6 / (double)p.transfer_ns : 0.0;
+      printf("%u.%03u,%s,%u,%s,%.1f,%.1f\n", p.t_us, ((uint32_t)p.t_sub * 1000u) >> 8, DIR_NAME[p.dir], p.length,
+             p.checksum_ok ? "ok" : "bad", (double)p.transfer_ns / 1e3, rate);
+    }
+  }
+  pcap.close();
+
+  fprintf(stderr, "=== PLIP Decode ===\n");
+  fprintf(stderr, "Timeouts        : %u\n", dec.timeouts());
+  fprintf(stderr, "Violations      : %u\n", dec.violations());
+  if (pcap_path)
+    fprintf(stderr, "pcap packets    : %u -> %s\n", pcap.packets(), pcap_path);
+
+  for (uint8_t dir = 0; dir < 2; ++dir)
+  {
+    uint32_t n = dec.frames(dir);
+    if (n == 0)
+      continue;
+
+    const LinkStats &s = stats[dir];
+    fprintf(stderr, "\n=== %s ===\n", dir == PLIP_TX ? "TX (sniffed host -> peer)" : "RX (peer -> sniffed host)");
+    fprintf(stderr, "Frames          : %u (%u bad checksum)\n", n, dec.bad_checksums(dir));
+    fprintf(stderr, "Bytes           : %llu\n", (unsigned long long)s.bytes);
+    fprintf(stderr, "Transfer time   : min %.1f us  mean %.1f us  max %.1f us\n", s.min_ns / 1e3,
+            (double)s.busy_ns / n / 1e3, s.max_ns / 1e3);
+    if (s.busy_ns)
+      fprintf(stderr, "Link rate       : %.1f KB/s (while transferring)\n", (double)s.bytes * 1e6 / (double)s.busy_ns);
+    if (s.last_ns > s.first_ns)
+    {
+      fprintf(stderr, "Effective rate  : %.1f KB/s over %.3f s\n",
+              (double)s.bytes * 1e6 / (double)(s.last_ns - s.first_ns), (s.last_ns - s.first_ns) / 1e9);
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,771 @@
+/*
+ * PARALAX - columnar chunked capture files, .plx (host only)
+ * ThisOldCPU Project - https://github.com/thisoldcpu
+ *
+ * A capture as column chunks instead of CSV lines: about 5 bytes a frame
+ * against about 30, indexed by time. Frames are grouped into chunks of up
+ * to PLX_CHUNK_FRAMES; each chunk stores its timestamps, data bytes and
+ * each of the nine control lines as separate columns, every column with
+ * its own size and CRC. A chunk decodes on its own, so chunks can be
+ * decoded in parallel, and a decoder reads and checks only the columns it
+ * asks for (a Covox decoder: time, data and STROBE). All integers are
+ * little-endian; README.md ("PLX Capture Files") has the full layout.
+ *
+ *   file       = header, chunk*, directory, trailer
+ *   header     16 B: "PLX1", version u16, header size u16, chunk frames
+ *              u32, flags u32
+ *   chunk      32 B: "PLXC", header size u16, columns u16, frames u32,
+ *              header crc32 u32 (with this field 0), first and last time
+ *              u64; then per column 12 B: id u8, encoding u8, 0 u16, size
+ *              u32, crc32 u32; then the columns in table order
+ *   directory  32 B per chunk: offset u64, size u32, frames u32, first and
+ *              last time u64
+ *   trailer    32 B: directory offset u64, frames u64, chunks u32,
+ *              directory crc32 u32, 0 u32, "PLXE"
+ *
+ * Times are ticks of 1/256 us (t_us << 8 | t_sub), unwrapped to 64 bits.
+ * PLX_COL_TIME holds zigzag LEB128 deltas from the previous frame (the
+ * first from the chunk's first time); PLX_COL_DATA one byte a frame;
+ * PLX_COL_LINE + FrameBit one bit a frame, LSB first. Compact CSV lines
+ * without control columns are stored with every line idle, as
+ * CsvCaptureReader reports them.
+ *
+ * Appending is crash-safe: PlxWriter::append() cuts the directory and
+ * trailer off, adds chunks and writes them back on close(), and the
+ * chunks are fsynced before the directory. A file without a valid trailer
+ * (a writer that died) is read by walking the chunks from the start up to
+ * the first one that fails its CRCs; append() continues from there.
+ *
+ * License : MIT
+ */
+
+#pragma once
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <vector>
+
+#include "capture_frame.h"
+
+static constexpr uint32_t PLX_MAGIC = 0x31584C50u;         // "PLX1"
+static constexpr uint32_t PLX_CHUNK_MAGIC = 0x43584C50u;   // "PLXC"
+static constexpr uint32_t PLX_TRAILER_MAGIC = 0x45584C50u; // "PLXE"
+static constexpr uint16_t PLX_VERSION = 1;
+static constexpr uint32_t PLX_CHUNK_FRAMES = 65536;
+
+static constexpr uint32_t PLX_FILE_HEADER_BYTES = 16;
+static constexpr uint32_t PLX_COLUMN_ENTRY_BYTES = 12;
+static constexpr uint32_t PLX_DIR_ENTRY_BYTES = 32;
+static constexpr uint32_t PLX_TRAILER_BYTES = 32;
+
+enum PlxColumn : uint8_t
+{
+  PLX_COL_TIME = 0,
+  PLX_COL_DATA = 1,
+  PLX_COL_LINE = 2, // + FrameBit: STROBE .. ERROR
+  PLX_COLUMNS = PLX_COL_LINE + 9,
+};
+
+enum PlxEncoding : uint8_t
+{
+  PLX_ENC_DELTA_VARINT = 0,
+  PLX_ENC_BYTES = 1,
+  PLX_ENC_BITS = 2,
+};
+
+static constexpr uint32_t PLX_CHUNK_HEADER_BYTES = 32 + PLX_COLUMN_ENTRY_BYTES * PLX_COLUMNS;
+
+// Column sets, for reading only some columns
+static constexpr uint32_t PLX_COLS_TIME = 1u << PLX_COL_TIME;
+static constexpr uint32_t PLX_COLS_DATA = 1u << PLX_COL_DATA;
+static constexpr uint32_t PLX_COLS_LINES = 0x1FFu << PLX_COL_LINE;
+static constexpr uint32_t PLX_COLS_ALL = (1u << PLX_COLUMNS) - 1;
+
+static constexpr uint32_t plx_line_column(FrameBit line)
+{
+  return 1u << (PLX_COL_LINE + line);
+}
+
+// ---- Little-endian fields ----
+
+static inline void plx_put16(uint8_t *p, uint16_t v)
+{
+  p[0] = (uint8_t)v;
+  p[1] = (uint8_t)(v >> 8);
+}
+
+static inline void plx_put32(uint8_t *p, uint32_t v)
+{
+  for (uint32_t i = 0; i < 4; ++i)
+    p[i] = (uint8_t)(v >> (i * 8));
+}
+
+static inline void plx_put64(uint8_t *p, uint64_t v)
+{
+  for (uint32_t i = 0; i < 8; ++i)
+    p[i] = (uint8_t)(v >> (i * 8));
+}
+
+static inline uint16_t plx_get16(const uint8_t *p)
+{
+  return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static inline uint32_t plx_get32(const uint8_t *p)
+{
+  return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static inline uint64_t plx_get64(const uint8_t *p)
+{
+  return (uint64_t)plx_get32(p) | ((uint64_t)plx_get32(p + 4) << 32);
+}
+
+// ---- CRC-32 (IEEE 802.3), four bytes a step ----
+
+struct PlxCrcTables
+{
+  uint32_t t[4][256];
+
+  PlxCrcTables()
+  {
+    for (uint32_t i = 0; i < 256; ++i)
+    {
+      uint32_t c = i;
+      for (uint32_t k = 0; k < 8; ++k)
+        c = (c >> 1) ^ (0xEDB88320u & (0u - (c & 1u)));
+      t[0][i] = c;
+    }
+    for (uint32_t i = 0; i < 256; ++i)
+      for (uint32_t s = 1; s < 4; ++s)
+        t[s][i] = (t[s - 1][i] >> 8) ^ t[0][t[s - 1][i] & 0xff];
+  }
+};
+
+static inline const uint32_t *plx_crc_tables()
+{
+  static const PlxCrcTables tables; // built once, thread-safe
+  return &tables.t[0][0];
+}
+
+// Continues crc over more bytes; start from 0
+static inline uint32_t plx_crc32(uint32_t crc, const uint8_t *p, size_t n)
+{
+  const uint32_t *t = plx_crc_tables();
+  crc = ~crc;
+  for (; n >= 4; n -= 4, p += 4)
+  {
+    crc ^= plx_get32(p);
+    crc = t[768 + (crc & 0xff)] ^ t[512 + ((crc >> 8) & 0xff)] ^ t[256 + ((crc >> 16) & 0xff)] ^ t[crc >> 24];
+  }
+  while (n--)
+    crc = (crc >> 8) ^ t[(crc ^ *p++) & 0xff];
+  return ~crc;
+}
+
+// ---- Encoding ----
+
+// One chunk's columns, built a frame at a time
+struct PlxChunk
+{
+  uint32_t frames = 0;
+  uint64_t t_first = 0;
+  uint64_t t_last = 0;
+  std::vector<uint8_t> columns[PLX_COLUMNS];
+
+  void clear()
+  {
+    frames = 0;
+    t_first = t_last = 0;
+    for (std::vector<uint8_t> &c : columns)
+      c.clear();
+    bits_.clear();
+  }
+
+  void add(uint64_t ticks, uint8_t data, uint16_t bits)
+  {
+    if (!frames)
+      t_first = t_last = ticks;
+    int64_t delta = (int64_t)(ticks - t_last);
+    uint64_t z = ((uint64_t)delta << 1) ^ (uint64_t)(delta >> 63);
+    std::vector<uint8_t> &t = columns[PLX_COL_TIME];
+    while (z >= 0x80)
+    {
+      t.push_back((uint8_t)(z | 0x80));
+      z >>= 7;
+    }
+    t.push_back((uint8_t)z);
+    columns[PLX_COL_DATA].push_back(data);
+    bits_.push_back(bits);
+    t_last = ticks;
+    frames++;
+  }
+
+  // Moves the chunk in time (the time column is relative, so only the header)
+  void shift(uint64_t ticks)
+  {
+    t_first += ticks;
+    t_last += ticks;
+  }
+
+  // Packs the line columns; call once, after the last add()
+  void finish()
+  {
+    uint32_t bytes = (frames + 7) / 8;
+    for (uint32_t line = 0; line < 9; ++line)
+    {
+      std::vector<uint8_t> &c = columns[PLX_COL_LINE + line];
+      c.assign(bytes, 0);
+      for (uint32_t i = 0; i < frames; ++i)
+        c[i >> 3] |= (uint8_t)(((bits_[i] >> line) & 1u) << (i & 7));
+    }
+    bits_.clear();
+  }
+
+  static PlxEncoding encoding(uint32_t column)
+  {
+    if (column == PLX_COL_TIME)
+      return PLX_ENC_DELTA_VARINT;
+    return column == PLX_COL_DATA ? PLX_ENC_BYTES : PLX_ENC_BITS;
+  }
+
+  // Header and column table for the finished chunk, CRCs included
+  void header(uint8_t *h) const
+  {
+    memset(h, 0, PLX_CHUNK_HEADER_BYTES);
+    plx_put32(h, PLX_CHUNK_MAGIC);
+    plx_put16(h + 4, (uint16_t)PLX_CHUNK_HEADER_BYTES);
+    plx_put16(h + 6, PLX_COLUMNS);
+    plx_put32(h + 8, frames);
+    plx_put64(h + 16, t_first);
+    plx_put64(h + 24, t_last);
+    for (uint32_t c = 0; c < PLX_COLUMNS; ++c)
+    {
+      uint8_t *e = h + 32 + c * PLX_COLUMN_ENTRY_BYTES;
+      e[0] = (uint8_t)c;
+      e[1] = (uint8_t)encoding(c);
+      plx_put32(e + 4, (uint32_t)columns[c].size());
+      plx_put32(e + 8, plx_crc32(0, columns[c].data(), columns[c].size()));
+    }
+    plx_put32(h + 12, plx_crc32(0, h, PLX_CHUNK_HEADER_BYTES));
+  }
+
+  uint32_t bytes() const
+  {
+    uint32_t n = PLX_CHUNK_HEADER_BYTES;
+    for (const std::vector<uint8_t> &c : columns)
+      n += (uint32_t)c.size();
+    return n;
+  }
+
+private:
+  std::vector<uint16_t> bits_;
+};
+
+// ---- Decoding ----
+
+// The columns of one chunk that were asked for; the others stay empty
+struct PlxFrames
+{
+  uint32_t columns = 0;
+  uint32_t count = 0;
+  std::vector<uint64_t> ticks; // PLX_COLS_TIME
+  std::vector<uint8_t>  data;  // PLX_COLS_DATA
+  std::vector<uint16_t> bits;  // any line; the lines not asked for read idle
+
+  CaptureFrame frame(uint32_t i) const
+  {
+    CaptureFrame f;
+    f.t_us = ticks.empty() ? 0 : (uint32_t)(ticks[i] >> 8);
+    f.t_sub = ticks.empty() ? 0 : (uint8_t)ticks[i];
+    f.data = data.empty() ? 0 : data[i];
+    f.bits = bits.empty() ? FRAME_BITS_IDLE : bits[i];
+    return f;
+  }
+};
+
+// One chunk in memory: its header and column table, checked; the columns
+// are only touched when decoded
+struct PlxChunkView
+{
+  uint32_t bytes = 0; // header and columns
+  uint32_t frames = 0;
+  uint64_t t_first = 0;
+  uint64_t t_last = 0;
+  const uint8_t *column[PLX_COLUMNS] = {};
+  uint32_t column_bytes[PLX_COLUMNS] = {};
+  uint32_t column_crc[PLX_COLUMNS] = {};
+
+  // The chunk at p, avail bytes from there; false if cut short or corrupt
+  bool parse(const uint8_t *p, size_t avail)
+  {
+    if (avail < 32 || plx_get32(p) != PLX_CHUNK_MAGIC)
+      return false;
+    uint32_t header_bytes = plx_get16(p + 4);
+    uint32_t columns = plx_get16(p + 6);
+    if (header_bytes != 32 + PLX_COLUMN_ENTRY_BYTES * columns || avail < header_bytes)
+      return false;
+    uint8_t zero[4] = {};
+    uint32_t crc = plx_crc32(0, p, 12);
+    crc = plx_crc32(crc, zero, 4);
+    if (plx_crc32(crc, p + 16, header_bytes - 16) != plx_get32(p + 12))
+      return false;
+
+    frames = plx_get32(p + 8);
+    t_first = plx_get64(p + 16);
+    t_last = plx_get64(p + 24);
+    uint64_t total = header_bytes;
+    uint32_t seen = 0;
+    for (uint32_t c = 0; c < columns; ++c)
+    {
+      // Columns this version does not know are skipped
+      const uint8_t *e = p + 32 + c * PLX_COLUMN_ENTRY_BYTES;
+      uint32_t id = e[0];
+      uint32_t n = plx_get32(e + 4);
+      if (id < PLX_COLUMNS && !(seen & (1u << id)))
+      {
+        if (e[1] != PlxChunk::encoding(id))
+          return false;
+        column[id] = p + total;
+        column_bytes[id] = n;
+        column_crc[id] = plx_get32(e + 8);
+        seen |= 1u << id;
+      }
+      total += n;
+    }
+    if (seen != PLX_COLS_ALL || total > avail || total > 0xffffffffu || column_bytes[PLX_COL_DATA] != frames)
+      return false;
+    for (uint32_t line = 0; line < 9; ++line)
+      if (column_bytes[PLX_COL_LINE + line] != (frames + 7) / 8)
+        return false;
+    bytes = (uint32_t)total;
+    return true;
+  }
+
+  // The CRCs of the columns in the set
+  bool check(uint32_t columns) const
+  {
+    for (uint32_t c = 0; c < PLX_COLUMNS; ++c)
+      if ((columns & (1u << c)) && plx_crc32(0, column[c], column_bytes[c]) != column_crc[c])
+        return false;
+    return true;
+  }
+
+  // Checks and decodes the columns in the set, and nothing else
+  bool decode(uint32_t columns, PlxFrames &out) const
+  {
+    columns &= PLX_COLS_ALL;
+    out.columns = columns;
+    out.count = frames;
+    out.ticks.clear();
+    out.data.clear();
+    out.bits.clear();
+    if (!check(columns))
+      return false;
+
+    if (columns & PLX_COLS_TIME)
+    {
+      out.ticks.resize(frames);
+      const uint8_t *t = column[PLX_COL_TIME];
+      const uint8_t *t_end = t + column_bytes[PLX_COL_TIME];
+      uint64_t ticks = t_first;
+      for (uint32_t i = 0; i < frames; ++i)
+      {
+        uint64_t z = 0;
+        for (uint32_t shift = 0;; shift += 7)
+        {
+          if (t == t_end || shift > 63)
+            return false;
+          uint8_t b = *t++;
+          z |= (uint64_t)(b & 0x7f) << shift;
+          if (!(b & 0x80))
+            break;
+        }
+        ticks += (uint64_t)((int64_t)(z >> 1) ^ -(int64_t)(z & 1));
+        out.ticks[i] = ticks;
+      }
+      if (t != t_end || (frames && ticks != t_last))
+        return false;
+    }
+
+    if (columns & PLX_COLS_DATA)
+      out.data.assign(column[PLX_COL_DATA], column[PLX_COL_DATA] + frames);
+
+    if (columns & PLX_COLS_LINES)
+    {
+      uint32_t lines = (columns & PLX_COLS_LINES) >> PLX_COL_LINE;
+      out.bits.assign(frames, (uint16_t)(FRAME_BITS_IDLE & ~lines));
+      for (uint32_t line = 0; line < 9; ++line)
+      {
+        if (!(lines & (1u << line)))
+          continue;
+        const uint8_t *c = column[PLX_COL_LINE + line];
+        for (uint32_t i = 0; i < frames; ++i)
+          out.bits[i] |= (uint16_t)(((c[i >> 3] >> (i & 7)) & 1u) << line);
+      }
+    }
+    return true;
+  }
+};
+
+// ---- Reading ----
+
+struct PlxChunkInfo
+{
+  uint64_t offset;
+  uint32_t bytes;
+  uint32_t frames;
+  uint64_t t_first;
+  uint64_t t_last;
+};
+
+// A whole file mapped read-only; read() is const and may run on any
+// number of threads at once, one chunk each
+class PlxReader
+{
+public:
+  PlxReader() = default;
+  PlxReader(const PlxReader &) = delete;
+  PlxReader &operator=(const PlxReader &) = delete;
+  ~PlxReader() { close(); }
+
+  bool open(const char *path)
+  {
+    close();
+    int fd = ::open(path, O_RDONLY);
+    if (fd < 0)
+      return false;
+    struct stat sb;
+    if (fstat(fd, &sb) != 0 || sb.st_size < (off_t)PLX_FILE_HEADER_BYTES)
+    {
+      ::close(fd);
+      return false;
+    }
+    void *m = mmap(nullptr, (size_t)sb.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (m == MAP_FAILED)
+      return false;
+    mapped_ = true;
+    if (!attach((const uint8_t *)m, (size_t)sb.st_size))
+    {
+      close();
+      return false;
+    }
+    return true;
+  }
+
+  // A file already in memory, which must outlive the reader
+  bool open(const uint8_t *p, size_t n)
+  {
+    close();
+    if (!attach(p, n))
+    {
+      close();
+      return false;
+    }
+    return true;
+  }
+
+  void close()
+  {
+    if (mapped_ && base_)
+      munmap((void *)base_, size_);
+    mapped_ = false;
+    base_ = nullptr;
+    size_ = 0;
+    chunks_.clear();
+    frames_ = 0;
+    end_ = 0;
+    recovered_ = false;
+  }
+
+  uint32_t chunk_frames() const { return chunk_frames_; }
+  uint32_t chunks() const { return (uint32_t)chunks_.size(); }
+  const PlxChunkInfo &chunk(uint32_t i) const { return chunks_[i]; }
+  uint64_t frames() const { return frames_; }
+  uint64_t file_bytes() const { return size_; }
+
+  // No valid trailer: the chunks were found by walking the file
+  bool recovered() const { return recovered_; }
+
+  // Where the last good chunk ends, and where appending continues
+  uint64_t end_of_chunks() const { return end_; }
+
+  bool view(uint32_t i, PlxChunkView &v) const
+  {
+    if (i >= chunks_.size())
+      return false;
+    const PlxChunkInfo &c = chunks_[i];
+    return v.parse(base_ + c.offset, (size_t)(size_ - c.offset)) && v.bytes == c.bytes && v.frames == c.frames;
+  }
+
+  // Chunk i's columns in the set, checked against their CRCs
+  bool read(uint32_t i, uint32_t columns, PlxFrames &out) const
+  {
+    PlxChunkView v;
+    return view(i, v) && v.decode(columns, out);
+  }
+
+  // First chunk that ends at or after ticks, for a capture whose time rises
+  uint32_t find(uint64_t ticks) const
+  {
+    uint32_t lo = 0, hi = (uint32_t)chunks_.size();
+    while (lo < hi)
+    {
+      uint32_t mid = (lo + hi) / 2;
+      if (chunks_[mid].t_last < ticks)
+        lo = mid + 1;
+      else
+        hi = mid;
+    }
+    return lo;
+  }
+
+private:
+  bool attach(const uint8_t *p, size_t n)
+  {
+    base_ = p;
+    size_ = n;
+    if (n < PLX_FILE_HEADER_BYTES || plx_get32(p) != PLX_MAGIC || plx_get16(p + 4) > PLX_VERSION)
+      return false;
+    header_bytes_ = plx_get16(p + 6);
+    chunk_frames_ = plx_get32(p + 8);
+    if (header_bytes_ < PLX_FILE_HEADER_BYTES || header_bytes_ > n)
+      return false;
+    if (!read_directory())
+    {
+      recovered_ = true;
+      scan();
+    }
+    return true;
+  }
+
+  bool read_directory()
+  {
+    if (size_ < header_bytes_ + PLX_TRAILER_BYTES)
+      return false;
+    const uint8_t *t = base_ + size_ - PLX_TRAILER_BYTES;
+    if (plx_get32(t + 28) != PLX_TRAILER_MAGIC)
+      return false;
+    uint64_t dir = plx_get64(t);
+    uint64_t count = plx_get32(t + 16);
+    if (dir < header_bytes_ || dir + count * PLX_DIR_ENTRY_BYTES + PLX_TRAILER_BYTES != size_ ||
+        plx_crc32(0, base_ + dir, (size_t)(count * PLX_DIR_ENTRY_BYTES)) != plx_get32(t + 20))
+      return false;
+
+    chunks_.clear();
+    uint64_t expect = header_bytes_;
+    uint64_t frames = 0;
+    for (uint64_t i = 0; i < count; ++i)
+    {
+      const uint8_t *e = base_ + dir + i * PLX_DIR_ENTRY_BYTES;
+      PlxChunkInfo c = {plx_get64(e), plx_get32(e + 8), plx_get32(e + 12), plx_get64(e + 16), plx_get64(e + 24)};
+      if (c.offset != expect)
+        return false;
+      chunks_.push_back(c);
+      expect += c.bytes;
+      frames += c.frames;
+    }
+    if (expect != dir || frames != plx_get64(t + 8))
+      return false;
+    frames_ = frames;
+    end_ = dir;
+    return true;
+  }
+
+  void scan()
+  {
+    chunks_.clear();
+    frames_ = 0;
+    uint64_t at = header_bytes_;
+    PlxChunkView v;
+    while (at < size_ && v.parse(base_ + at, (size_t)(size_ - at)) && v.check(PLX_COLS_ALL))
+    {
+      chunks_.push_back({at, v.bytes, v.frames, v.t_first, v.t_last});
+      frames_ += v.frames;
+      at += v.bytes;
+    }
+    end_ = at;
+  }
+
+  const uint8_t *base_ = nullptr;
+  size_t         size_ = 0;
+  bool           mapped_ = false;
+  bool           recovered_ = false;
+  uint32_t       header_bytes_ = PLX_FILE_HEADER_BYTES;
+  uint32_t       chunk_frames_ = PLX_CHUNK_FRAMES;
+  uint64_t       frames_ = 0;
+  uint64_t       end_ = 0;
+  std::vector<PlxChunkInfo> chunks_;
+};
+
+// ---- Writing ----
+
+class PlxWriter
+{
+public:
+  PlxWriter() = default;
+  PlxWriter(const PlxWriter &) = delete;
+  PlxWriter &operator=(const PlxWriter &) = delete;
+  ~PlxWriter() { close(); }
+
+  bool create(const char *path, uint32_t chunk_frames = PLX_CHUNK_FRAMES)
+  {
+    close();
+    fp_ = fopen(path, "wb");
+    if (!fp_)
+      return false;
+    setvbuf(fp_, nullptr, _IOFBF, 1u << 20);
+    chunk_frames_ = chunk_frames;
+    dir_.clear();
+    frames_ = 0;
+    cur_.clear();
+    clock_ = TimeUnwrapper();
+
+    uint8_t h[PLX_FILE_HEADER_BYTES] = {};
+    plx_put32(h, PLX_MAGIC);
+    plx_put16(h + 4, PLX_VERSION);
+    plx_put16(h + 6, (uint16_t)PLX_FILE_HEADER_BYTES);
+    plx_put32(h + 8, chunk_frames);
+    offset_ = PLX_FILE_HEADER_BYTES;
+    ok_ = fwrite(h, 1, sizeof(h), fp_) == sizeof(h);
+    return ok_;
+  }
+
+  // Continues a file (created if missing) after its last good chunk, its
+  // clock carried on from there; false and untouched if it is not a .plx
+  bool append(const char *path, uint32_t chunk_frames = PLX_CHUNK_FRAMES)
+  {
+    close();
+    struct stat sb;
+    if (stat(path, &sb) != 0)
+      return create(path, chunk_frames);
+
+    PlxReader r;
+    if (!r.open(path))
+      return false;
+    chunk_frames_ = r.chunk_frames();
+    dir_.clear();
+    frames_ = 0;
+    cur_.clear();
+    clock_ = TimeUnwrapper();
+    for (uint32_t i = 0; i < r.chunks(); ++i)
+    {
+      const PlxChunkInfo &c = r.chunk(i);
+      add_entry(c.offset, c.bytes, c.frames, c.t_first, c.t_last);
+      frames_ += c.frames;
+    }
+    if (r.chunks())
+    {
+      uint64_t us = r.chunk(r.chunks() - 1).t_last >> 8;
+      clock_.high = us & ~0xffffffffull;
+      clock_.last = (uint32_t)us;
+    }
+    offset_ = r.end_of_chunks();
+    r.close();
+
+    // From here until close() the file is chunks only, which reads back
+    if (truncate(path, (off_t)offset_) != 0)
+      return false;
+    fp_ = fopen(path, "r+b");
+    if (!fp_)
+      return false;
+    setvbuf(fp_, nullptr, _IOFBF, 1u << 20);
+    ok_ = fseeko(fp_, (off_t)offset_, SEEK_SET) == 0;
+    return ok_;
+  }
+
+  // One frame, its time unwrapped here; a chunk is written every chunk_frames
+  void add(const CaptureFrame &f)
+  {
+    cur_.add((clock_.extend(f.t_us) << 8) | f.t_sub, f.data, f.bits);
+    if (cur_.frames == chunk_frames_)
+    {
+      cur_.finish();
+      write_chunk(cur_);
+      cur_.clear();
+    }
+  }
+
+  // A chunk built elsewhere, finished, its times already absolute
+  bool write_chunk(const PlxChunk &c)
+  {
+    if (!fp_ || !c.frames)
+      return ok_;
+    uint8_t h[PLX_CHUNK_HEADER_BYTES];
+    c.header(h);
+    ok_ = ok_ && fwrite(h, 1, sizeof(h), fp_) == sizeof(h);
+    for (const std::vector<uint8_t> &col : c.columns)
+      ok_ = ok_ && fwrite(col.data(), 1, col.size(), fp_) == col.size();
+    add_entry(offset_, c.bytes(), c.frames, c.t_first, c.t_last);
+    offset_ += c.bytes();
+    frames_ += c.frames;
+    return ok_;
+  }
+
+  // Every chunk written so far survives a crash from here on
+  bool flush()
+  {
+    if (!fp_)
+      return ok_;
+    ok_ = ok_ && fflush(fp_) == 0 && fsync(fileno(fp_)) == 0;
+    return ok_;
+  }
+
+  // The last partial chunk, then the directory and the trailer
+  bool close()
+  {
+    if (!fp_)
+      return ok_;
+    if (cur_.frames)
+    {
+      cur_.finish();
+      write_chunk(cur_);
+      cur_.clear();
+    }
+    flush();
+    uint8_t t[PLX_TRAILER_BYTES] = {};
+    plx_put64(t, offset_);
+    plx_put64(t + 8, frames_);
+    plx_put32(t + 16, (uint32_t)(dir_.size() / PLX_DIR_ENTRY_BYTES));
+    plx_put32(t + 20, plx_crc32(0, dir_.data(), dir_.size()));
+    plx_put32(t + 28, PLX_TRAILER_MAGIC);
+    ok_ = ok_ && fwrite(dir_.data(), 1, dir_.size(), fp_) == dir_.size();
+    ok_ = ok_ && fwrite(t, 1, sizeof(t), fp_) == sizeof(t);
+    flush();
+    ok_ = fclose(fp_) == 0 && ok_;
+    fp_ = nullptr;
+    return ok_;
+  }
+
+  uint64_t frames() const { return frames_ + cur_.frames; }
+  uint32_t chunks() const { return (uint32_t)(dir_.size() / PLX_DIR_ENTRY_BYTES); }
+  uint64_t bytes() const { return offset_ + dir_.size() + PLX_TRAILER_BYTES; }
+
+private:
+  void add_entry(uint64_t offset, uint32_t bytes, uint32_t frames, uint64_t t_first, uint64_t t_last)
+  {
+    uint8_t e[PLX_DIR_ENTRY_BYTES];
+    plx_put64(e, offset);
+    plx_put32(e + 8, bytes);
+    plx_put32(e + 12, frames);
+    plx_put64(e + 16, t_first);
+    plx_put64(e + 24, t_last);
+    dir_.insert(dir_.end(), e, e + sizeof(e));
+  }
+
+  FILE    *fp_ = nullptr;
+  bool     ok_ = false;
+  uint32_t chunk_frames_ = PLX_CHUNK_FRAMES;
+  uint64_t offset_ = 0;
+  uint64_t frames_ = 0;
+  std::vector<uint8_t> dir_;
+  PlxChunk      cur_;
+  TimeUnwrapper clock_;
+};
@@ -0,0 +1,521 @@
+/*
+ * PARALAX - .plx capture reader and CSV round trip (host)
+ * ThisOldCPU Project - https://github.com/thisoldcpu
+ *
+ * Prints a .plx capture (tools/plx.h) as the firmware's CSV, for every
+ * tool that still reads CSV, or just checks it (-i). Chunks decode
+ * independently, so -j threads take chunks in turn and the text is
+ * written in chunk order; -s and -d pick a time range through the chunk
+ * directory without reading the chunks outside it.
+ *
+ * Every frame comes back as CsvCaptureReader read it: t_us as captured
+ * (the unwrap is undone), the PIO fraction as .nnn when there is one, the
+ * data byte and all nine lines. Compact lines come back in the full form,
+ * with the lines idle.
+ *
+ * A file whose writer died has no valid trailer; it is read up to the last
+ * chunk that passes its CRCs and -i says so. Appending (PlxWriter::append)
+ * repairs it.
+ *
+ * -t is the round-trip test: CSV to .plx to CSV gives the same frames for
+ * every line form, and firmware lines byte for byte; it also checks reads
+ * of a few columns, time seeks, and a writer crash with recovery and
+ * append.
+ *
+ * Build:
+ *   g++ -std=c++17 -O2 -pthread -Iinclude -Itools -o plx2csv tools/plx2csv.cpp
+ *
+ * Usage:
+ *   plx2csv [-j threads] [-s start_s] [-d duration_s] <capture.plx> > capture.csv
+ *   plx2csv -i [-j threads] <capture.plx>
+ *   plx2csv -t
+ *
+ * License : MIT
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "capture_csv.h"
+#include "plx.h"
+#include "selftest.h"
+
+static constexpr uint32_t WINDOW_PER_THREAD = 2;
+static constexpr uint32_t LINE_MAX_BYTES = 40; // "4294967295.997,FF,1,1,1,1,1,1,1,1,1\n"
+
+// ---- Chunks in parallel, results in order ----
+
+// work(i, text) runs on the threads, at most WINDOW_PER_THREAD chunks a
+// thread ahead of emit(i, ok, text), which sees the chunks in order; false
+// if any work() failed
+template <typename Work, typename Emit>
+static bool for_chunks(uint32_t first, uint32_t last, uint32_t threads, Work work, Emit emit)
+{
+  struct Slot
+  {
+    std::string text;
+    bool        ok = false;
+    bool        done = false;
+  };
+  std::vector<Slot> slots(last > first ? last - first : 0);
+  std::mutex mutex;
+  std::condition_variable done_cv, window_cv;
+  uint32_t next = first, emitted = first;
+
+  auto worker = [&] {
+    for (;;)
+    {
+      uint32_t i;
+      {
+        std::unique_lock<std::mutex> lock(mutex);
+        window_cv.wait(lock, [&] { return next >= last || next < emitted + threads * WINDOW_PER_THREAD; });
+        if (next >= last)
+          return;
+        i = next++;
+      }
+      Slot s;
+      s.ok = work(i, s.text);
+      s.done = true;
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        slots[i - first] = std::move(s);
+      }
+      done_cv.notify_all();
+    }
+  };
+  std::vector<std::thread> pool;
+  for (uint32_t t = 0; t < threads; ++t)
+    pool.emplace_back(worker);
+
+  bool ok = true;
+  for (uint32_t i = first; i < last; ++i)
+  {
+    Slot s;
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      done_cv.wait(lock, [&] { return slots[i - first].done; });
+      s = std::move(slots[i - first]);
+      slots[i - first] = Slot();
+      emitted = i + 1;
+    }
+    window_cv.notify_all();
+    ok = ok && s.ok;
+    emit(i, s.ok, s.text);
+  }
+  for (std::thread &t : pool)
+    t.join();
+  return ok;
+}
+
+// ---- CSV ----
+
+static const char HEX_DIGITS[] = "0123456789ABCDEF";
+
+static char *put_frame(char *o, uint64_t ticks, uint8_t data, uint16_t bits)
+{
+  uint32_t t = (uint32_t)(ticks >> 8);
+  char digits[10];
+  uint32_t n = 0;
+  do
+  {
+    digits[n++] = (char)('0' + t % 10);
+    t /= 10;
+  } while (t);
+  while (n)
+    *o++ = digits[--n];
+
+  // .nnn as the firmware prints it; the reader rounds it back to the same 1/256 us
+  uint32_t sub = (uint32_t)(ticks & 0xff);
+  if (sub)
+  {
+    uint32_t ns = (sub * 1000u) >> 8;
+    *o++ = '.';
+    *o++ = (char)('0' + ns / 100);
+    *o++ = (char)('0' + ns / 10 % 10);
+    *o++ = (char)('0' + ns % 10);
+  }
+  *o++ = ',';
+  *o++ = HEX_DIGITS[data >> 4];
+  *o++ = HEX_DIGITS[data & 15];
+  for (uint32_t line = 0; line < 9; ++line)
+  {
+    *o++ = ',';
+    *o++ = (char)('0' + ((bits >> line) & 1u));
+  }
+  *o++ = '\n';
+  return o;
+}
+
+struct CsvRange
+{
+  uint64_t lo = 0;
+  uint64_t hi = ~0ull;
+};
+
+// The frames of [lo, hi] as CSV, chunk by chunk on threads; false if a chunk is corrupt
+static bool write_csv(const PlxReader &reader, const CsvRange &range, uint32_t threads, FILE *out,
+                      uint64_t &frames_out)
+{
+  fprintf(out, "# t_us,data_hex,strobe,ack,busy,autofeed,init,selectin,paper_out,select,error\n");
+  uint32_t first = reader.find(range.lo);
+  uint32_t last = range.hi == ~0ull ? reader.chunks() : reader.find(range.hi) + 1;
+  if (last > reader.chunks())
+    last = reader.chunks();
+  frames_out = 0;
+  return for_chunks(
+      first, last, threads,
+      [&](uint32_t i, std::string &text) {
+        PlxFrames f;
+        if (!reader.read(i, PLX_COLS_ALL, f))
+          return false;
+        text.resize((size_t)f.count * LINE_MAX_BYTES);
+        char *o = &text[0];
+        for (uint32_t k = 0; k < f.count; ++k)
+          if (f.ticks[k] >= range.lo && f.ticks[k] <= range.hi)
+            o = put_frame(o, f.ticks[k], f.data[k], f.bits[k]);
+        text.resize((size_t)(o - text.data()));
+        return true;
+      },
+      [&](uint32_t, bool, const std::string &text) {
+        fwrite(text.data(), 1, text.size(), out);
+        frames_out += (uint64_t)std::count(text.begin(), text.end(), '\n');
+      });
+}
+
+// Every chunk against its CRCs, on threads; returns the failures
+static uint32_t check_chunks(const PlxReader &reader, uint32_t threads)
+{
+  uint32_t bad = 0;
+  for_chunks(
+      0, reader.chunks(), threads,
+      [&](uint32_t i, std::string &) {
+        PlxChunkView v;
+        return reader.view(i, v) && v.check(PLX_COLS_ALL);
+      },
+      [&](uint32_t, bool ok, const std::string &) { bad += ok ? 0 : 1; });
+  return bad;
+}
+
+static int print_info(const char *path, uint32_t threads)
+{
+  PlxReader reader;
+  if (!reader.open(path))
+  {
+    fprintf(stderr, "Not a .plx capture: %s\n", path);
+    return 1;
+  }
+  auto t0 = std::chrono::steady_clock::now();
+  uint32_t bad = check_chunks(reader, threads);
+  double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+
+  fprintf(stderr, "=== PLX ===\n");
+  fprintf(stderr, "File            : %llu bytes\n", (unsigned long long)reader.file_bytes());
+  fprintf(stderr, "Chunks          : %u of up to %u frames\n", reader.chunks(), reader.chunk_frames());
+  fprintf(stderr, "Frames          : %llu, %.2f bytes/frame\n", (unsigned long long)reader.frames(),
+          reader.frames() ? (double)reader.file_bytes() / (double)reader.frames() : 0.0);
+  if (reader.chunks())
+    fprintf(stderr, "Span            : %.3f s\n",
+            (double)(reader.chunk(reader.chunks() - 1).t_last - reader.chunk(0).t_first) / 256e6);
+  if (reader.recovered())
+    fprintf(stderr, "Trailer         : missing, %llu bytes after the last good chunk\n",
+            (unsigned long long)(reader.file_bytes() - reader.end_of_chunks()));
+  else
+    fprintf(stderr, "Trailer         : ok\n");
+  fprintf(stderr, "Checked         : %.1f MB/s on %u thread%s\n", secs > 0 ? reader.file_bytes() / secs / 1e6 : 0.0,
+          threads, threads == 1 ? "" : "s");
+  fprintf(stderr, "Check           : %s\n", bad ? "FAILED" : "OK");
+  return bad ? 1 : 0;
+}
+
+// ---- Self-test ----
+
+struct TestFrame
+{
+  uint32_t t_us;
+  uint8_t  t_sub;
+  uint8_t  data;
+  uint16_t bits;
+
+  bool operator==(const TestFrame &o) const
+  {
+    return t_us == o.t_us && t_sub == o.t_sub && data == o.data && bits == o.bits;
+  }
+};
+
+static std::vector<TestFrame> read_csv_frames(const std::string &path)
+{
+  std::vector<TestFrame> out;
+  CsvCaptureReader reader;
+  reader.open(path.c_str());
+  CaptureFrame f;
+  while (reader.next(f))
+    out.push_back({f.t_us, f.t_sub, f.data, f.bits});
+  return out;
+}
+
+static std::vector<TestFrame> read_plx_frames(const PlxReader &reader, bool &ok)
+{
+  std::vector<TestFrame> out;
+  PlxFrames cols;
+  ok = true;
+  for (uint32_t i = 0; i < reader.chunks(); ++i)
+  {
+    if (!reader.read(i, PLX_COLS_ALL, cols))
+    {
+      ok = false;
+      break;
+    }
+    for (uint32_t k = 0; k < cols.count; ++k)
+    {
+      CaptureFrame f = cols.frame(k);
+      out.push_back({f.t_us, f.t_sub, f.data, f.bits});
+    }
+  }
+  return out;
+}
+
+static bool plx_from_frames(const std::string &path, const std::vector<TestFrame> &frames, uint32_t chunk_frames)
+{
+  PlxWriter w;
+  if (!w.create(path.c_str(), chunk_frames))
+    return false;
+  for (const TestFrame &t : frames)
+  {
+    CaptureFrame f = {t.t_us, t.data, t.t_sub, t.bits};
+    w.add(f);
+  }
+  return w.close();
+}
+
+static int self_test()
+{
+  TestDir dir("plx2csv");
+  if (!dir.made())
+    return 1;
+  std::string csv_path = dir.file("in.csv");
+  std::string plx_path = dir.file("test.plx");
+  std::string out_path = dir.file("out.csv");
+  SelfTest test("PLX Round Trip");
+
+  // Every line form: the same frames after CSV -> .plx -> CSV
+  {
+    std::string csv = make_test_csv(150000, 0xC0FFEEu);
+    write_file(csv_path, csv.data(), csv.size());
+    std::vector<TestFrame> want = read_csv_frames(csv_path);
+    plx_from_frames(plx_path, want, 4096);
+
+    PlxReader reader;
+    bool pass = reader.open(plx_path.c_str()) && !reader.recovered() && reader.frames() == want.size();
+    FILE *out = fopen(out_path.c_str(), "wb");
+    uint64_t written = 0;
+    pass = pass && write_csv(reader, CsvRange(), 3, out, written);
+    fclose(out);
+    pass = pass && written == want.size() && read_csv_frames(out_path) == want;
+    test.check(pass, "Round trip", "%zu frames, %u chunks, %.2f bytes/frame", want.size(), reader.chunks(),
+               (double)reader.file_bytes() / (double)want.size());
+  }
+
+  // Firmware lines come back byte for byte
+  std::vector<TestFrame> plain;
+  {
+    std::string csv = make_test_csv(100000, 0xBEEFu, true);
+    write_file(csv_path, csv.data(), csv.size());
+    plain = read_csv_frames(csv_path);
+    plx_from_frames(plx_path, plain, 4096);
+    PlxReader reader;
+    reader.open(plx_path.c_str());
+    FILE *out = fopen(out_path.c_str(), "wb");
+    uint64_t written = 0;
+    bool pass = write_csv(reader, CsvRange(), 2, out, written);
+    fclose(out);
+    std::vector<uint8_t> text = read_file(out_path);
+    std::string back((const char *)text.data(), text.size());
+    size_t a = csv.find('\n', csv.find("CSV:")) + 1;
+    size_t b = back.find('\n') + 1;
+    pass = pass && csv.compare(a, std::string::npos, back, b, std::string::npos) == 0;
+    test.check(pass, "Text", "firmware lines identical");
+  }
+
+  // A Covox decoder's columns: time, data and STROBE, checked and decoded alone
+  {
+    PlxReader reader;
+    reader.open(plx_path.c_str());
+    uint32_t cols = PLX_COLS_TIME | PLX_COLS_DATA | plx_line_column(FB_STROBE);
+    uint64_t touched = 0, total = 0, k0 = 0;
+    bool pass = true;
+    PlxFrames f;
+    for (uint32_t i = 0; i < reader.chunks() && pass; ++i)
+    {
+      PlxChunkView v;
+      pass = reader.view(i, v) && v.decode(cols, f) && f.bits.size() == f.count && f.ticks.size() == f.count;
+      for (uint32_t c = 0; c < PLX_COLUMNS; ++c)
+        touched += (cols & (1u << c)) ? v.column_bytes[c] : 0;
+      total += v.bytes;
+      for (uint32_t k = 0; k < f.count && pass; ++k)
+      {
+        const TestFrame &w = plain[k0 + k];
+        CaptureFrame g = f.frame(k);
+        pass = g.t_us == w.t_us && g.data == w.data &&
+               g.bits == (uint16_t)((FRAME_BITS_IDLE & ~1u) | (w.bits & 1u));
+      }
+      k0 += f.count;
+    }
+    test.check(pass && k0 == plain.size(), "Columns", "time, data, STROBE read %.0f%% of the chunk bytes",
+               touched * 100.0 / total);
+
+    // Seeks land on the chunk holding the time, and -s/-d cut there
+    TestRng rng(7);
+    pass = true;
+    TimeUnwrapper clock;
+    std::vector<uint64_t> ticks;
+    for (const TestFrame &w : plain)
+      ticks.push_back((clock.extend(w.t_us) << 8) | w.t_sub);
+    for (uint32_t n = 0; n < 1000 && pass; ++n)
+    {
+      uint64_t t = ticks[rng.next() % ticks.size()];
+      uint32_t c = reader.find(t);
+      pass = c < reader.chunks() && reader.chunk(c).t_first <= t && t <= reader.chunk(c).t_last;
+    }
+    CsvRange range;
+    range.lo = ticks[ticks.size() / 3];
+    range.hi = ticks[ticks.size() / 2];
+    FILE *out = fopen(out_path.c_str(), "wb");
+    uint64_t written = 0;
+    pass = pass && write_csv(reader, range, 2, out, written);
+    fclose(out);
+    std::vector<TestFrame> part = read_csv_frames(out_path);
+    pass = pass && part.size() == ticks.size() / 2 - ticks.size() / 3 + 1 && part.front() == plain[ticks.size() / 3] &&
+           part.back() == plain[ticks.size() / 2];
+    test.check(pass, "Seek", "1000 times found, range cut");
+  }
+
+  // A writer that dies mid-append; the file reads up to its last flushed
+  // chunk, and appending again picks up from there
+  {
+    const uint32_t chunk = 1000;
+    size_t n1 = plain.size() / 4;
+    std::vector<TestFrame> head(plain.begin(), plain.begin() + n1);
+    plx_from_frames(plx_path, head, chunk);
+
+    PlxWriter w;
+    bool pass = w.append(plx_path.c_str());
+    size_t n2 = plain.size() / 2;
+    for (size_t i = n1; i < n2; ++i)
+    {
+      CaptureFrame f = {plain[i].t_us, plain[i].data, plain[i].t_sub, plain[i].bits};
+      w.add(f);
+    }
+    pass = pass && w.flush();
+    std::vector<uint8_t> crashed = read_file(plx_path);
+    for (uint32_t i = 0; i < 3000; ++i)
+      crashed.push_back((uint8_t)(0x50 + i)); // a chunk cut off mid-write
+    w.close();
+    write_file(plx_path, crashed.data(), crashed.size());
+
+    size_t durable = n1 + (n2 - n1) / chunk * chunk; // the flushed chunks, not the one being filled
+    PlxReader reader;
+    bool read_ok = false;
+    pass = pass && reader.open(plx_path.c_str()) && reader.recovered();
+    std::vector<TestFrame> got = read_plx_frames(reader, read_ok);
+    size_t kept = got.size();
+    pass = pass && read_ok && kept == durable && std::equal(got.begin(), got.end(), plain.begin());
+    test.check(pass, "Recovery", "%zu of %zu frames kept after a crash", kept, n2);
+    reader.close();
+
+    pass = w.append(plx_path.c_str());
+    for (size_t i = kept; i < plain.size(); ++i)
+    {
+      CaptureFrame f = {plain[i].t_us, plain[i].data, plain[i].t_sub, plain[i].bits};
+      w.add(f);
+    }
+    pass = w.close() && pass;
+    pass = pass && reader.open(plx_path.c_str()) && !reader.recovered() && reader.frames() == plain.size();
+    got = read_plx_frames(reader, read_ok);
+    pass = pass && read_ok && got == plain;
+    reader.close();
+
+    // Anything that is not a .plx is left alone
+    const char junk[] = "0,00\n1,01\n";
+    write_file(csv_path, junk, sizeof(junk) - 1);
+    pass = pass && !w.append(csv_path.c_str()) && read_file(csv_path).size() == sizeof(junk) - 1;
+    test.check(pass, "Append", "resumed to every frame, CSV untouched");
+  }
+
+  return test.finish();
+}
+
+int main(int argc, char **argv)
+{
+  uint32_t threads = std::thread::hardware_concurrency() ? std::thread::hardware_concurrency() : 1;
+  bool info = false;
+  double start_s = 0.0, duration_s = -1.0;
+  int opt;
+  while ((opt = getopt(argc, argv, "j:s:d:it")) != -1)
+  {
+    switch (opt)
+    {
+    case 'j':
+      threads = (uint32_t)atoi(optarg);
+      break;
+    case 's':
+      start_s = atof(optarg);
+      break;
+    case 'd':
+      duration_s = atof(optarg);
+      break;
+    case 'i':
+      info = true;
+      break;
+    case 't':
+      return self_test();
+    default:
+      argc = 0;
+      break;
+    }
+  }
+  if (argc - optind != 1 || threads < 1)
+  {
+    fprintf(stderr, "Usage: plx2csv [-j threads] [-s start_s] [-d duration_s] <capture.plx> > capture.csv\n"
+                    "       plx2csv -i [-j threads] <capture.plx>\n"
+                    "       plx2csv -t\n\n"
+                    "Prints a PARALAX .plx capture as CSV, or checks it\n");
+    return 1;
+  }
+  if (info)
+    return print_info(argv[optind], threads);
+
+  PlxReader reader;
+  if (!reader.open(argv[optind]))
+  {
+    fprintf(stderr, "Not a .plx capture: %s\n", argv[optind]);
+    return 1;
+  }
+  if (reader.recovered())
+    fprintf(stderr, "No trailer: reading the %u chunks up to the first bad one\n", reader.chunks());
+
+  CsvRange range;
+  if (reader.chunks() && (start_s > 0.0 || duration_s >= 0.0))
+  {
+    range.lo = reader.chunk(0).t_first + (uint64_t)(start_s * 256e6);
+    if (duration_s >= 0.0)
+      range.hi = range.lo + (uint64_t)(duration_s * 256e6);
+  }
+  uint64_t written = 0;
+  bool ok = write_csv(reader, range, threads, stdout, written);
+  fflush(stdout);
+  fprintf(stderr, "Frames          : %llu of %llu\n", (unsigned long long)written,
+          (unsigned long long)reader.frames());
+  if (!ok)
+    fprintf(stderr, "Corrupt chunk: output incomplete\n");
+  return ok ? 0 : 1;
+}
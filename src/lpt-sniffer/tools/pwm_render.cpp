@@ -0,0 +1,335 @@
+/*
+ * PARALAX - PWM headphone monitor on the host
+ * ThisOldCPU Project - https://github.com/thisoldcpu
+ *
+ * Runs the monitor's conversion stage (PwmMonitor) the way the firmware
+ * does: decoded Covox/DSS PCM in at 48 kHz, compare levels out in DMA
+ * blocks at the PWM's own rate, which is the system clock divided by the
+ * counter wrap. With a capture, the levels go through a model of the RC
+ * filter (one pole, -r Hz) and are written to a WAV with -w, so what the
+ * headphones get can be listened to.
+ *
+ * -t checks the stage itself:
+ *   - every frame's average level is within a quarter step of the input
+ *   - sines at 100 Hz - 16 kHz come back with at least 60 dB SNR
+ *   - a minute at the real PWM rate keeps the Asrc's fill within 2 ms of
+ *     its target, without underruns or skips, and its loop settles on the
+ *     rate error
+ *
+ * Build:
+ *   g++ -std=c++17 -O2 -Iinclude -Itools -o pwm_render tools/pwm_render.cpp src/pwm_monitor.cpp \
+ *       src/asrc.cpp src/pcm_interp.cpp src/dac_pcm.cpp src/pit_clock.cpp src/speculative_decoder.cpp \
+ *       src/device_classifier.cpp src/device_decoders.cpp src/cmslpt_decoder.cpp
+ *
+ * Usage:
+ *   pwm_render <capture.csv> [-w out.wav] [-s sys_mhz] [-r rc_hz]
+ *   pwm_render -t [-s sys_mhz]
+ *
+ * License : MIT
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <vector>
+
+#include "capture_csv.h"
+#include "dac_pcm.h"
+#include "device_classifier.h"
+#include "pwm_monitor.h"
+#include "selftest.h"
+#include "speculative_decoder.h"
+#include "wav_writer.h"
+
+static constexpr uint32_t BLOCK_FRAMES = 32; // as PWM_AUDIO_BLOCK_FRAMES
+static constexpr uint32_t BLOCK_LEVELS = BLOCK_FRAMES * PwmMonitor::OVERSAMPLE;
+
+class PcmFeed : public DeviceEventSink
+{
+public:
+  explicit PcmFeed(DacPcmSource &pcm) : pcm_(pcm) {}
+
+  void on_event(const DeviceEvent &e) override { pcm_.on_event(e); }
+  void on_commit(LptDevice device, uint32_t replayed, uint32_t lost) override
+  {
+    (void)replayed;
+    (void)lost;
+    committed = device;
+  }
+  void on_reopen() override { reopened = true; }
+
+  LptDevice committed = DEV_UNKNOWN;
+  bool      reopened = false;
+
+private:
+  DacPcmSource &pcm_;
+};
+
+// Average of one frame's levels, back on the 16-bit PCM scale
+static double frame_value(const uint16_t *levels, uint32_t steps)
+{
+  uint32_t sum = 0;
+  for (uint32_t i = 0; i < PwmMonitor::OVERSAMPLE; ++i)
+    sum += levels[i];
+  return (double)sum / PwmMonitor::OVERSAMPLE * 65536.0 / steps - 32768.0;
+}
+
+// ---- Self-test ----
+
+static bool test_dc(PwmMonitor &m, double &worst)
+{
+  // Every 16-bit value, one frame each: the average is the value to 1/4 step
+  uint16_t levels[PwmMonitor::OVERSAMPLE];
+  double step = 65536.0 / (m.top() + 1);
+  worst = 0.0;
+  for (int32_t v = -32768; v <= 32767; ++v)
+  {
+    m.convert((int16_t)v, (int16_t)v, levels);
+    double err = fabs(frame_value(levels, m.top() + 1) - v) / step;
+    // The carried remainder moves the frame average by less than a quarter step
+    if (err > worst)
+      worst = err;
+  }
+  return worst <= 0.25 + 1e-9;
+}
+
+static double test_sine(PwmMonitor &m, double hz)
+{
+  // Through the Asrc, fed and drained in lock step so its fill stays at the
+  // target. Its loop may leave a fraction of a frame of delay, which the
+  // sine fit absorbs.
+  m.reset();
+  const uint32_t frames = 48000;
+  const uint32_t settle = 4800;
+  const double w = 2.0 * M_PI * hz / PwmMonitor::RATE_HZ;
+  uint16_t levels[PwmMonitor::OVERSAMPLE];
+  std::vector<double> out;
+  out.reserve(frames);
+  for (uint32_t i = 0; i < frames + Asrc::TARGET_FRAMES; ++i)
+  {
+    int16_t v = (int16_t)lrint(30000.0 * sin(w * i));
+    m.on_sample(v, v);
+    if (i < Asrc::TARGET_FRAMES)
+      continue;
+    m.fill(levels, 1);
+    if (i >= Asrc::TARGET_FRAMES + settle)
+      out.push_back(frame_value(levels, m.top() + 1));
+  }
+
+  return sine_snr_db(out, hz / PwmMonitor::RATE_HZ);
+}
+
+static constexpr uint32_t DRIFT_BAND_FRAMES = 96; // 2 ms either side of the target
+
+static bool test_drift(PwmMonitor &m, uint32_t sys_hz, uint32_t &lo, uint32_t &hi, double &expected_ppm)
+{
+  // Producer on the 48 kHz grid, consumer at the PWM's real frame rate, in blocks
+  m.reset();
+  double pwm_rate = (double)sys_hz / ((m.top() + 1) * PwmMonitor::OVERSAMPLE);
+  double seconds = 60.0;
+  double produced = 0.0;
+  uint16_t block[BLOCK_LEVELS];
+  lo = UINT32_MAX;
+  hi = 0;
+
+  uint64_t blocks = (uint64_t)(seconds * pwm_rate / BLOCK_FRAMES);
+  for (uint64_t b = 0; b < blocks; ++b)
+  {
+    double until = (double)(b + 1) * BLOCK_FRAMES / pwm_rate * PwmMonitor::RATE_HZ;
+    while (produced < until)
+    {
+      m.on_sample(0, 0);
+      produced += 1.0;
+    }
+    m.fill(block, BLOCK_FRAMES);
+    // Once the loop has pulled in from a standing start
+    if (b * BLOCK_FRAMES >= 10 * PwmMonitor::RATE_HZ)
+    {
+      uint32_t f = m.fill_frames();
+      if (f < lo)
+        lo = f;
+      if (f > hi)
+        hi = f;
+    }
+  }
+
+  // Input frames per output frame, as the Asrc's integrator reports it
+  expected_ppm = ((double)PwmMonitor::RATE_HZ / pwm_rate - 1.0) * 1e6;
+  bool in_band = lo + BLOCK_FRAMES >= Asrc::TARGET_FRAMES - DRIFT_BAND_FRAMES &&
+                 hi <= Asrc::TARGET_FRAMES + DRIFT_BAND_FRAMES + BLOCK_FRAMES;
+  return in_band && m.underruns() == 0 && m.overruns() == 0 && m.asrc().skipped_frames() == 0 &&
+         fabs(m.clock_ppm() - expected_ppm) <= 5.0;
+}
+
+static int selftest(uint32_t sys_hz)
+{
+  PwmMonitor m(PwmMonitor::top_for_clock(sys_hz));
+  double pwm_rate = (double)sys_hz / ((m.top() + 1) * PwmMonitor::OVERSAMPLE);
+  SelfTest test("PWM Monitor");
+  test.info("System clock", "%.3f MHz", sys_hz / 1e6);
+  test.info("PWM", "top %u, carrier %.1f kHz, %.2f Hz frames (%+.0f ppm)", m.top(),
+            pwm_rate * PwmMonitor::OVERSAMPLE / 1e3, pwm_rate, (pwm_rate / PwmMonitor::RATE_HZ - 1.0) * 1e6);
+
+  double worst = 0.0;
+  bool pass = test_dc(m, worst);
+  test.check(pass, "Frame average", "within %.3f step", worst);
+
+  static const double freqs[] = {100.0, 1000.0, 5000.0, 10000.0, 16000.0};
+  double snr_min = 1e9;
+  for (double hz : freqs)
+  {
+    double snr = test_sine(m, hz);
+    if (snr < snr_min)
+      snr_min = snr;
+  }
+  test.check(snr_min >= 60.0, "Sine SNR", "%.1f dB minimum, 100 Hz - 16 kHz", snr_min);
+
+  uint32_t lo = 0, hi = 0;
+  double expected = 0.0;
+  bool drift_ok = test_drift(m, sys_hz, lo, hi, expected);
+  test.check(drift_ok, "Drift, 60 s", "fill %u-%u frames, clock %+d ppm (%+.0f expected), %u underruns", lo, hi,
+             m.clock_ppm(), expected, m.underruns());
+  return test.finish();
+}
+
+// ---- Capture ----
+
+static void usage()
+{
+  fprintf(stderr, "Usage: pwm_render <capture.csv> [-w out.wav] [-s sys_mhz] [-r rc_hz]\n"
+                  "       pwm_render -t [-s sys_mhz]\n");
+}
+
+int main(int argc, char **argv)
+{
+  const char *in_path = nullptr;
+  const char *wav_path = nullptr;
+  double sys_mhz = 133.0;
+  double rc_hz = 15900.0;
+  bool test = false;
+
+  for (int i = 1; i < argc; ++i)
+  {
+    if (!strcmp(argv[i], "-w") && i + 1 < argc)
+      wav_path = argv[++i];
+    else if (!strcmp(argv[i], "-s") && i + 1 < argc)
+      sys_mhz = atof(argv[++i]);
+    else if (!strcmp(argv[i], "-r") && i + 1 < argc)
+      rc_hz = atof(argv[++i]);
+    else if (!strcmp(argv[i], "-t"))
+      test = true;
+    else if (!in_path)
+      in_path = argv[i];
+    else
+    {
+      usage();
+      return 1;
+    }
+  }
+
+  uint32_t sys_hz = (uint32_t)(sys_mhz * 1e6);
+  if (test)
+    return selftest(sys_hz);
+  if (!in_path)
+  {
+    usage();
+    return 1;
+  }
+
+  CsvCaptureReader reader;
+  if (!reader.open(in_path))
+  {
+    fprintf(stderr, "Error: cannot open '%s'\n", in_path);
+    return 1;
+  }
+
+  WavWriter wav;
+  if (wav_path && !wav.open(wav_path, PwmMonitor::RATE_HZ, 1))
+  {
+    fprintf(stderr, "Error: cannot write '%s'\n", wav_path);
+    return 1;
+  }
+
+  PwmMonitor monitor(PwmMonitor::top_for_clock(sys_hz));
+  DacPcmSource pcm(monitor);
+  PcmFeed feed(pcm);
+  SpeculativeDecoder speculative(feed);
+  DeviceClassifier cls;
+
+  CaptureFrame f;
+  bool have = reader.next(f);
+  if (!have)
+  {
+    fprintf(stderr, "Error: no frames in '%s'\n", in_path);
+    return 1;
+  }
+
+  // One DMA block at a time at the PWM's frame rate; core 1 catches up before each
+  const uint32_t steps = monitor.top() + 1u;
+  const double carrier_hz = (double)sys_hz / steps;
+  const double block_us = BLOCK_FRAMES * PwmMonitor::OVERSAMPLE * 1e6 / carrier_hz;
+  const double alpha = 1.0 - exp(-2.0 * M_PI * rc_hz / carrier_hz);
+  TimeUnwrapper clock;
+  uint64_t t0_us = clock.extend(f.t_us);
+  uint64_t frame_us = t0_us;
+  double wall_us = (double)t0_us;
+  double rc = 0.0;
+  uint64_t drain_until_us = 0;
+  uint16_t block[BLOCK_LEVELS];
+  int16_t out[BLOCK_FRAMES];
+
+  for (;;)
+  {
+    wall_us += block_us;
+    while (have && frame_us <= (uint64_t)wall_us)
+    {
+      speculative.feed(f);
+      DeviceGuess g;
+      if (cls.feed(f, g))
+        speculative.commit(g.device);
+      if (feed.reopened)
+      {
+        cls.reset();
+        feed.reopened = false;
+      }
+      have = reader.next(f);
+      if (have)
+        frame_us = clock.extend(f.t_us);
+    }
+    pcm.advance((uint32_t)((uint64_t)wall_us - DacPcmSource::HOLDBACK_US));
+
+    if (!have && drain_until_us == 0)
+      drain_until_us = (uint64_t)wall_us + 50000;
+    if (drain_until_us && (uint64_t)wall_us >= drain_until_us)
+      break;
+
+    monitor.fill(block, BLOCK_FRAMES);
+
+    // RC filter over the PWM waveform's period averages, read once per frame
+    for (uint32_t n = 0; n < BLOCK_FRAMES; ++n)
+    {
+      for (uint32_t i = 0; i < PwmMonitor::OVERSAMPLE; ++i)
+        rc += alpha * ((double)block[n * PwmMonitor::OVERSAMPLE + i] / steps - rc);
+      double v = (rc - 0.5) * 65536.0;
+      out[n] = (int16_t)(v > 32767.0 ? 32767 : (v < -32768.0 ? -32768 : lrint(v)));
+    }
+    wav.write(out, BLOCK_FRAMES);
+  }
+
+  fprintf(stderr, "=== PWM Monitor ===\n");
+  fprintf(stderr, "Frames          : %llu\n", (unsigned long long)reader.frames());
+  fprintf(stderr, "Device          : %s\n", lpt_device_name(feed.committed));
+  fprintf(stderr, "PWM             : top %u, carrier %.1f kHz, RC corner %.0f Hz\n", monitor.top(),
+          carrier_hz / 1e3, rc_hz);
+  fprintf(stderr, "PCM frames      : %u in, %u out\n", monitor.frames_in(), monitor.frames_out());
+  fprintf(stderr, "Latency         : %.2f ms Asrc target + %.2f ms per DMA block\n",
+          Asrc::TARGET_FRAMES * 1000.0 / PwmMonitor::RATE_HZ, block_us / 1000.0);
+  fprintf(stderr, "Clock           : %+d ppm against 48 kHz\n", monitor.clock_ppm());
+  fprintf(stderr, "Underruns       : %u (%u frames held)\n", monitor.underruns(), monitor.padded_frames());
+  fprintf(stderr, "Overruns        : %u\n", monitor.overruns());
+  if (wav_path)
+    fprintf(stderr, "WAV             : %s (%llu frames)\n", wav_path, (unsigned long long)wav.frames());
+  return 0;
+}
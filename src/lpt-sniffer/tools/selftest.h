@@ -0,0 +1,269 @@
+/*
+ * PARALAX - self-test helpers shared by the host tools (host only)
+ * ThisOldCPU Project - https://github.com/thisoldcpu
+ *
+ * A tool's -t needs no capture. It prints one line per check, the label
+ * in a 16-column field, what was measured and OK or FAILED, then a last
+ * "Check" line, and exits non-zero if any check failed. SelfTest does the
+ * printing and the bookkeeping; the rest is what the checks of more than
+ * one tool need: a seeded generator (a failure reproduces), a clock for
+ * the speed lines, a sine fit, a scratch directory and synthetic captures.
+ *
+ * License : MIT
+ */
+
+#pragma once
+
+#include <dirent.h>
+#include <math.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+class SelfTest
+{
+public:
+  explicit SelfTest(const char *name) { fprintf(stderr, "=== %s Self-test ===\n", name); }
+
+  // "Label           : detail OK"; returns pass
+  __attribute__((format(printf, 4, 5))) bool check(bool pass, const char *label, const char *fmt, ...)
+  {
+    va_list ap;
+    va_start(ap, fmt);
+    line(label, fmt, ap, pass ? "OK" : "FAILED");
+    va_end(ap);
+    ok_ = ok_ && pass;
+    return pass;
+  }
+
+  // A line without a verdict: settings, speeds
+  __attribute__((format(printf, 3, 4))) void info(const char *label, const char *fmt, ...)
+  {
+    va_list ap;
+    va_start(ap, fmt);
+    line(label, fmt, ap, nullptr);
+    va_end(ap);
+  }
+
+  bool ok() const { return ok_; }
+
+  // The last line; the tool's exit status
+  int finish() const
+  {
+    fprintf(stderr, "Check           : %s\n", ok_ ? "OK" : "FAILED");
+    return ok_ ? 0 : 1;
+  }
+
+private:
+  static void line(const char *label, const char *fmt, va_list ap, const char *verdict)
+  {
+    char detail[256];
+    vsnprintf(detail, sizeof(detail), fmt, ap);
+    fprintf(stderr, "%-16s: %s%s%s\n", label, detail, *detail && verdict ? " " : "", verdict ? verdict : "");
+  }
+
+  bool ok_ = true;
+};
+
+// xorshift32
+struct TestRng
+{
+  uint32_t s;
+
+  explicit TestRng(uint32_t seed = 12345) : s(seed ? seed : 1) {}
+
+  uint32_t next()
+  {
+    s ^= s << 13;
+    s ^= s >> 17;
+    s ^= s << 5;
+    return s;
+  }
+  double unit() { return (next() >> 8) / 16777216.0; } // [0, 1)
+};
+
+static inline double now_secs()
+{
+  return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// SNR of x against the best-fitting sine of frequency f (cycles per sample)
+// plus DC, over [skip, size - skip). The fit takes any phase, so a
+// resampler's fractional delay is not counted as noise.
+template <typename T>
+static inline double sine_snr_db(const std::vector<T> &x, double f, size_t skip = 0)
+{
+  double ss = 0, sc = 0, cc = 0, s1 = 0, c1 = 0, n = 0, xs = 0, xc = 0, x1 = 0;
+  for (size_t i = skip; i + skip < x.size(); ++i)
+  {
+    double s = sin(2 * M_PI * f * i), c = cos(2 * M_PI * f * i);
+    ss += s * s;
+    sc += s * c;
+    cc += c * c;
+    s1 += s;
+    c1 += c;
+    n += 1;
+    xs += x[i] * s;
+    xc += x[i] * c;
+    x1 += x[i];
+  }
+  // Normal equations for a * sin + b * cos + d
+  double m[3][4] = {{ss, sc, s1, xs}, {sc, cc, c1, xc}, {s1, c1, n, x1}};
+  for (int i = 0; i < 3; ++i)
+    for (int j = i + 1; j < 3; ++j)
+    {
+      double k = m[j][i] / m[i][i];
+      for (int c = i; c < 4; ++c)
+        m[j][c] -= k * m[i][c];
+    }
+  double v[3];
+  for (int i = 2; i >= 0; --i)
+  {
+    v[i] = m[i][3];
+    for (int c = i + 1; c < 3; ++c)
+      v[i] -= m[i][c] * v[c];
+    v[i] /= m[i][i];
+  }
+  double sig = 0, err = 0;
+  for (size_t i = skip; i + skip < x.size(); ++i)
+  {
+    double fit = v[0] * sin(2 * M_PI * f * i) + v[1] * cos(2 * M_PI * f * i);
+    double e = x[i] - fit - v[2];
+    sig += fit * fit;
+    err += e * e;
+  }
+  return 10.0 * log10(sig / fmax(err, 1e-30));
+}
+
+// ---- Files ----
+
+// A directory under /tmp, removed with the files in it
+class TestDir
+{
+public:
+  explicit TestDir(const char *tool) : path_(std::string("/tmp/") + tool + ".XXXXXX")
+  {
+    made_ = mkdtemp(&path_[0]) != nullptr;
+    if (!made_)
+      fprintf(stderr, "Error: no temporary directory\n");
+  }
+  TestDir(const TestDir &) = delete;
+  TestDir &operator=(const TestDir &) = delete;
+  ~TestDir()
+  {
+    if (!made_)
+      return;
+    if (DIR *d = opendir(path_.c_str()))
+    {
+      while (struct dirent *e = readdir(d))
+        if (e->d_name[0] != '.')
+          unlink(file(e->d_name).c_str());
+      closedir(d);
+    }
+    rmdir(path_.c_str());
+  }
+
+  bool made() const { return made_; }
+  std::string file(const char *name) const { return path_ + "/" + name; }
+
+private:
+  std::string path_;
+  bool        made_ = false;
+};
+
+static inline bool write_file(const std::string &path, const void *p, size_t n)
+{
+  FILE *fp = fopen(path.c_str(), "wb");
+  if (!fp)
+    return false;
+  bool ok = fwrite(p, 1, n, fp) == n;
+  return fclose(fp) == 0 && ok;
+}
+
+// Empty if the file cannot be read
+static inline std::vector<uint8_t> read_file(const std::string &path)
+{
+  std::vector<uint8_t> out;
+  FILE *fp = fopen(path.c_str(), "rb");
+  if (!fp)
+    return out;
+  uint8_t buf[65536];
+  size_t n;
+  while ((n = fread(buf, 1, sizeof(buf), fp)) > 0)
+    out.insert(out.end(), buf, buf + n);
+  fclose(fp);
+  return out;
+}
+
+// ---- Captures ----
+
+// A capture as the firmware prints it when plain, else with every line form
+// CsvCaptureReader takes and some that are not frames: older headers and
+// statistics blocks, .nnn fractions, the compact form, lower case and short
+// hex, an extra column, CRLF, restarts and no final newline. Time wraps a
+// little way in.
+static inline std::string make_test_csv(uint32_t lines, uint32_t seed, bool plain = false)
+{
+  std::string csv = plain ? "# PARALAX LPT Sniffer - FRAME capture (17 signals)\n"
+                          : "\n========================================\n"
+                            "PARALAX LPT Sniffer - FRAME capture (17 signals)\n"
+                            "========================================\n\n";
+  csv += "CSV: t_us,data_hex,strobe,ack,busy,autofeed,init,selectin,paper_out,select,error\n";
+  if (!plain)
+    csv += "Deadband(us): 2\n# profile: pio\n";
+
+  TestRng rng(seed);
+  uint32_t t = 0xffff0000u;
+  char line[96];
+  for (uint32_t i = 0; i < lines; ++i)
+  {
+    uint32_t r = rng.next();
+    t += 1 + (r >> 20) % 200;
+    uint32_t kind = plain ? 31 : (r >> 8) % 32;
+    if (!plain && r % 997 == 0)
+      t -= 5000; // a capture restarted
+    const char *eol = !plain && (r & 0x80) ? "\r\n" : "\n";
+    char frac[8] = "";
+    if (kind < 4)
+      snprintf(frac, sizeof(frac), ".%03u", (r >> 3) % 1000);
+    char b[9];
+    for (uint32_t k = 0; k < 9; ++k)
+      b[k] = (char)('0' + ((r >> (k + 11)) & 1));
+    uint32_t data = (r >> 4) & 0xff;
+
+    if (kind == 30)
+      snprintf(line, sizeof(line), "# device: COVOX (90%%)%s", eol);
+    else if (kind == 29)
+      snprintf(line, sizeof(line), "%u-%u us COVOX (95%%)%s", t, t + 100, eol);
+    else if (kind == 28)
+      snprintf(line, sizeof(line), "%u,%02X%s", t, data, eol);
+    else if (kind == 27)
+      snprintf(line, sizeof(line), "%u,%X,%c,%c,%c,%c,%c,%c,%c,%c,%c%s", t, data & 0xf, b[0], b[1], b[2], b[3],
+               b[4], b[5], b[6], b[7], b[8], eol);
+    else if (kind == 26)
+      snprintf(line, sizeof(line), "%u,%02x,%c,%c,%c,%c,%c,%c,%c,%c,%c%s", t, data, b[0], b[1], b[2], b[3], b[4],
+               b[5], b[6], b[7], b[8], eol);
+    else if (kind == 25)
+      snprintf(line, sizeof(line), "%u,%02X,%c,%c,%c,%c,%c,%c,%c,%c,%c,7%s", t, data, b[0], b[1], b[2], b[3],
+               b[4], b[5], b[6], b[7], b[8], eol);
+    else if (kind == 24)
+      snprintf(line, sizeof(line), "%u,G1,0,0,0%s", t, eol);
+    else if (kind == 23)
+      snprintf(line, sizeof(line), "%s", eol);
+    else
+      snprintf(line, sizeof(line), "%u%s,%02X,%c,%c,%c,%c,%c,%c,%c,%c,%c%s", t, frac, data, b[0], b[1], b[2],
+               b[3], b[4], b[5], b[6], b[7], b[8], eol);
+    csv += line;
+    if (!plain && i == lines / 2)
+      csv += "\n--- Statistics ---\nFrames captured : 1234\nOverflows       : 0\n\n";
+  }
+  if (!plain)
+    csv += "123,4";
+  return csv;
+}
@@ -0,0 +1,346 @@
+/*
+ * PARALAX - speculative multi-device decoder (host)
+ * ThisOldCPU Project - https://github.com/thisoldcpu
+ *
+ * Host counterpart of the firmware's core 1 path. The DeviceClassifier
+ * walks the capture on the main thread; while it has no verdict, every
+ * candidate decoder runs on its own thread over the same frames and keeps
+ * its output. At the verdict the winner's output is written from the very
+ * first frame and the others are dropped; a candidate that reaches
+ * SpeculativeDecoder::VIOLATION_LIMIT stops early. After the commit only
+ * the winner runs, inline, until its violations outpace
+ * SpeculativeDecoder::ViolationRate and speculation reopens.
+ *
+ * Build:
+ *   g++ -std=c++17 -O2 -pthread -Iinclude -o spec_decode tools/spec_decode.cpp \
+ *       src/device_classifier.cpp src/device_decoders.cpp src/cmslpt_decoder.cpp
+ *
+ * Usage:
+ *   spec_decode <capture.csv> [-l]
+ *     -l  list events as t_us,device,chip,reg,value on stdout
+ *
+ * License : MIT
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "capture_csv.h"
+#include "device_classifier.h"
+#include "device_decoders.h"
+#include "speculative_decoder.h"
+
+static constexpr size_t BLOCK_FRAMES = 1u << 16;
+static constexpr size_t LANE_LIMIT = 1u << 20; // held events per candidate
+static constexpr uint32_t CANDIDATES = SpeculativeDecoder::CANDIDATES;
+
+struct Candidate
+{
+  DeviceDecoder           *dec = nullptr;
+  bool                     alive = true;
+  uint64_t                 lost = 0;
+  uint64_t                 discarded = 0; // held output dropped at switch-off
+  std::vector<DeviceEvent> held;
+
+  void arm()
+  {
+    dec->reset();
+    alive = true;
+    lost = 0;
+    held.clear();
+  }
+
+  // Decode a run of frames, keeping the output until the verdict
+  void run(const CaptureFrame *frames, size_t n)
+  {
+    DeviceEvent e;
+    for (size_t i = 0; i < n && alive; ++i)
+    {
+      if (dec->feed(frames[i], e))
+      {
+        if (held.size() >= LANE_LIMIT)
+        {
+          held.erase(held.begin(), held.begin() + LANE_LIMIT / 2);
+          lost += LANE_LIMIT / 2;
+        }
+        held.push_back(e);
+      }
+      if (dec->violations() >= SpeculativeDecoder::VIOLATION_LIMIT)
+      {
+        alive = false;
+        discarded += held.size();
+        held.clear();
+      }
+    }
+  }
+};
+
+// One thread per candidate; run() hands all of them the same frames
+class LanePool
+{
+public:
+  explicit LanePool(Candidate *cands) : cands_(cands)
+  {
+    for (uint32_t i = 0; i < CANDIDATES; ++i)
+      threads_.emplace_back(&LanePool::worker, this, i);
+  }
+
+  ~LanePool()
+  {
+    {
+      std::lock_guard<std::mutex> lock(m_);
+      quit_ = true;
+    }
+    job_cv_.notify_all();
+    for (std::thread &t : threads_)
+      t.join();
+  }
+
+  void run(const CaptureFrame *frames, size_t n)
+  {
+    std::unique_lock<std::mutex> lock(m_);
+    frames_ = frames;
+    n_ = n;
+    pending_ = CANDIDATES;
+    job_++;
+    job_cv_.notify_all();
+    done_cv_.wait(lock, [this] { return pending_ == 0; });
+  }
+
+private:
+  void worker(uint32_t i)
+  {
+    uint64_t seen = 0;
+    for (;;)
+    {
+      const CaptureFrame *frames;
+      size_t n;
+      {
+        std::unique_lock<std::mutex> lock(m_);
+        job_cv_.wait(lock, [&] { return quit_ || job_ != seen; });
+        if (quit_)
+          return;
+        seen = job_;
+        frames = frames_;
+        n = n_;
+      }
+
+      cands_[i].run(frames, n);
+
+      std::lock_guard<std::mutex> lock(m_);
+      if (--pending_ == 0)
+        done_cv_.notify_one();
+    }
+  }
+
+  Candidate               *cands_;
+  std::vector<std::thread> threads_;
+  std::mutex               m_;
+  std::condition_variable  job_cv_;
+  std::condition_variable  done_cv_;
+  const CaptureFrame      *frames_ = nullptr;
+  size_t                   n_ = 0;
+  uint32_t                 pending_ = 0;
+  uint64_t                 job_ = 0;
+  bool                     quit_ = false;
+};
+
+struct Report
+{
+  bool     list = false;
+  uint64_t events = 0;
+  uint64_t replayed = 0;
+  uint64_t lost = 0;
+  uint64_t discarded = 0;
+  uint32_t commits = 0;
+  uint32_t reopens = 0;
+  uint64_t per_device[DEV_COUNT] = {};
+
+  void emit(const DeviceEvent &e)
+  {
+    events++;
+    per_device[e.device < DEV_COUNT ? e.device : 0]++;
+    if (list)
+      printf("%u,%s,%u,%02X,%02X\n", e.t_us, lpt_device_name((LptDevice)e.device), e.chip, e.reg, e.value);
+  }
+};
+
+int main(int argc, char **argv)
+{
+  const char *in_path = nullptr;
+  Report report;
+
+  for (int i = 1; i < argc; ++i)
+  {
+    if (!strcmp(argv[i], "-l"))
+      report.list = true;
+    else if (!in_path)
+      in_path = argv[i];
+  }
+  if (!in_path)
+  {
+    fprintf(stderr, "Usage: spec_decode <capture.csv> [-l]\n");
+    return 1;
+  }
+
+  CsvCaptureReader reader;
+  if (!reader.open(in_path))
+  {
+    fprintf(stderr, "Error: cannot open '%s'\n", in_path);
+    return 1;
+  }
+
+  static CovoxDecoder covox;
+  static DssDecoder dss;
+  static Opl2LptDecoder opl2lpt;
+  static TndLptDecoder tndlpt;
+  static CmsLptDeviceDecoder cmslpt;
+
+  Candidate cands[CANDIDATES];
+  cands[DEV_COVOX - 1].dec = &covox;
+  cands[DEV_DSS - 1].dec = &dss;
+  cands[DEV_OPL2LPT - 1].dec = &opl2lpt;
+  cands[DEV_TNDLPT - 1].dec = &tndlpt;
+  cands[DEV_CMSLPT - 1].dec = &cmslpt;
+  for (Candidate &c : cands)
+    c.arm();
+
+  LanePool pool(cands);
+  DeviceClassifier cls;
+  LptDevice committed = DEV_UNKNOWN;
+  SpeculativeDecoder::ViolationRate rate;
+  rate.reset(0);
+
+  std::vector<CaptureFrame> block(BLOCK_FRAMES);
+  DeviceGuess g;
+  DeviceEvent e;
+
+  for (;;)
+  {
+    size_t n = 0;
+    while (n < BLOCK_FRAMES && reader.next(block[n]))
+      n++;
+    if (n == 0)
+      break;
+
+    size_t i = 0;
+    while (i < n)
+    {
+      if (committed == DEV_UNKNOWN)
+      {
+        // Find where (if anywhere in this block) the verdict lands, then let
+        // every live candidate decode up to and including that frame
+        size_t end = n;
+        LptDevice verdict = DEV_UNKNOWN;
+        for (size_t j = i; j < n; ++j)
+        {
+          if (!cls.feed(block[j], g))
+            continue;
+          printf("# device: %s (%u%%) at %u us\n", lpt_device_name(g.device), g.confidence, g.t_us);
+          if (g.device != DEV_UNKNOWN)
+          {
+            verdict = g.device;
+            end = j + 1;
+            break;
+          }
+        }
+
+        pool.run(&block[i], end - i);
+        i = end;
+        if (verdict == DEV_UNKNOWN)
+          continue;
+
+        Candidate &w = cands[verdict - 1];
+        for (uint32_t c = 0; c < CANDIDATES; ++c)
+        {
+          if (c != (uint32_t)(verdict - 1) && cands[c].alive)
+          {
+            report.discarded += cands[c].held.size();
+            cands[c].alive = false;
+            cands[c].held.clear();
+          }
+        }
+        if (w.alive)
+        {
+          for (const DeviceEvent &h : w.held)
+            report.emit(h);
+          report.replayed += w.held.size();
+          report.lost += w.lost;
+          w.held.clear();
+        }
+        else
+        {
+          // Switched off earlier; the classifier outvotes it, from here on
+          w.arm();
+        }
+        committed = verdict;
+        rate.reset(w.dec->violations());
+        report.commits++;
+        continue;
+      }
+
+      // Committed: only the winner runs, inline, in the firmware's order
+      const CaptureFrame &f = block[i++];
+      Candidate &w = cands[committed - 1];
+      if (w.dec->feed(f, e))
+        report.emit(e);
+
+      if (rate.over(w.dec->violations()))
+      {
+        for (Candidate &c : cands)
+          c.arm();
+        committed = DEV_UNKNOWN;
+        cls.reset();
+        report.reopens++;
+      }
+
+      if (cls.feed(f, g))
+      {
+        printf("# device: %s (%u%%) at %u us\n", lpt_device_name(g.device), g.confidence, g.t_us);
+        if (g.device == DEV_UNKNOWN)
+        {
+          if (committed != DEV_UNKNOWN)
+          {
+            for (Candidate &c : cands)
+              c.arm();
+            committed = DEV_UNKNOWN;
+            cls.reset();
+            report.reopens++;
+          }
+        }
+        else if (g.device != committed)
+        {
+          // Straight from one device to another: no prefix to replay
+          cands[g.device - 1].arm();
+          if (committed != DEV_UNKNOWN)
+            cands[committed - 1].alive = false;
+          committed = g.device;
+          rate.reset(0);
+          report.commits++;
+        }
+      }
+    }
+  }
+
+  for (const Candidate &c : cands)
+    report.discarded += c.discarded;
+
+  fprintf(stderr, "=== Speculative Decode ===\n");
+  fprintf(stderr, "Frames          : %llu\n", (unsigned long long)reader.frames());
+  fprintf(stderr, "Committed       : %s (%u commits, %u reopens)\n", lpt_device_name(committed), report.commits,
+          report.reopens);
+  fprintf(stderr, "Events          : %llu (%llu replayed from speculation, %llu lost)\n",
+          (unsigned long long)report.events, (unsigned long long)report.replayed, (unsigned long long)report.lost);
+  fprintf(stderr, "Discarded       : %llu events from losing candidates\n", (unsigned long long)report.discarded);
+  for (uint8_t d = DEV_COVOX; d < DEV_COUNT; ++d)
+  {
+    if (report.per_device[d])
+      fprintf(stderr, "  %-14s: %llu\n", lpt_device_name((LptDevice)d), (unsigned long long)report.per_device[d]);
+  }
+  return 0;
+}
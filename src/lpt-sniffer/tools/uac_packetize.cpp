@@ -0,0 +1,224 @@
+/*
+ * PARALAX - USB audio packetisation on a capture (host)
+ * ThisOldCPU Project - https://github.com/thisoldcpu
+ *
+ * Runs the firmware's audio path on a capture CSV: DeviceClassifier and
+ * SpeculativeDecoder as on core 1, DacPcmSource onto the 48 kHz grid, the
+ * Asrc, and UacPacketizer pulled once per simulated USB frame. The packets
+ * are what the isochronous endpoint would send, so the WAV written with -w
+ * is what OBS or a DAW would record.
+ *
+ * The simulated host clock can run off the capture clock (-p ppm) to
+ * exercise the ASRC loop, and the producer can be stalled (-s) to force
+ * underruns. -c checks the invariants (packet sizes, every sample taken
+ * or counted as overrun) and exits non-zero on a failure.
+ *
+ * Build:
+ *   g++ -std=c++17 -O2 -Iinclude -Itools -o uac_packetize tools/uac_packetize.cpp \
+ *       src/uac_packetizer.cpp src/asrc.cpp src/dac_pcm.cpp src/pit_clock.cpp \
+ *       src/speculative_decoder.cpp src/device_classifier.cpp src/device_decoders.cpp \
+ *       src/cmslpt_decoder.cpp
+ *
+ * Usage:
+ *   uac_packetize <capture.csv> [-w out.wav] [-p ppm] [-s at_ms:len_ms] [-c]
+ *
+ * License : MIT
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "capture_csv.h"
+#include "dac_pcm.h"
+#include "device_classifier.h"
+#include "speculative_decoder.h"
+#include "uac_packetizer.h"
+#include "wav_writer.h"
+
+class PcmFeed : public DeviceEventSink
+{
+public:
+  explicit PcmFeed(DacPcmSource &pcm) : pcm_(pcm) {}
+
+  void on_event(const DeviceEvent &e) override { pcm_.on_event(e); }
+  void on_commit(LptDevice device, uint32_t replayed, uint32_t lost) override
+  {
+    (void)replayed;
+    (void)lost;
+    committed = device;
+  }
+  void on_reopen() override { reopened = true; }
+
+  LptDevice committed = DEV_UNKNOWN;
+  bool      reopened = false;
+
+private:
+  DacPcmSource &pcm_;
+};
+
+int main(int argc, char **argv)
+{
+  const char *in_path = nullptr;
+  const char *wav_path = nullptr;
+  double ppm = 0.0;
+  uint64_t stall_at_us = 0;
+  uint64_t stall_len_us = 0;
+  bool check = false;
+
+  for (int i = 1; i < argc; ++i)
+  {
+    if (!strcmp(argv[i], "-w") && i + 1 < argc)
+      wav_path = argv[++i];
+    else if (!strcmp(argv[i], "-p") && i + 1 < argc)
+      ppm = atof(argv[++i]);
+    else if (!strcmp(argv[i], "-s") && i + 1 < argc)
+    {
+      unsigned at_ms = 0, len_ms = 0;
+      if (sscanf(argv[++i], "%u:%u", &at_ms, &len_ms) == 2)
+      {
+        stall_at_us = (uint64_t)at_ms * 1000;
+        stall_len_us = (uint64_t)len_ms * 1000;
+      }
+    }
+    else if (!strcmp(argv[i], "-c"))
+      check = true;
+    else if (!in_path)
+      in_path = argv[i];
+  }
+  if (!in_path)
+  {
+    fprintf(stderr, "Usage: uac_packetize <capture.csv> [-w out.wav] [-p ppm] [-s at_ms:len_ms] [-c]\n");
+    return 1;
+  }
+
+  CsvCaptureReader reader;
+  if (!reader.open(in_path))
+  {
+    fprintf(stderr, "Error: cannot open '%s'\n", in_path);
+    return 1;
+  }
+
+  WavWriter wav;
+  if (wav_path && !wav.open(wav_path, UacPacketizer::RATE_HZ, UacPacketizer::CHANNELS))
+  {
+    fprintf(stderr, "Error: cannot write '%s'\n", wav_path);
+    return 1;
+  }
+
+  Asrc asrc;
+  UacPacketizer packetizer(asrc);
+  DacPcmSource pcm(asrc);
+  PcmFeed feed(pcm);
+  SpeculativeDecoder speculative(feed);
+  DeviceClassifier cls;
+
+  CaptureFrame f;
+  bool have = reader.next(f);
+  if (!have)
+  {
+    fprintf(stderr, "Error: no frames in '%s'\n", in_path);
+    return 1;
+  }
+
+  // Wall clock in ns; the host's 1 ms frames are stretched by -p
+  uint64_t t0_us = f.t_us;
+  uint64_t wall_ns = t0_us * 1000;
+  uint64_t last_us = f.t_us;
+  uint32_t prev_t = f.t_us;
+  double period_ns = 1000000.0 / (1.0 + ppm / 1000000.0);
+  double wall_frac = 0.0;
+
+  uint8_t packet[UacPacketizer::PACKET_BYTES];
+  uint64_t fill_sum = 0;
+  uint32_t fill_min = UINT32_MAX;
+  uint32_t fill_max = 0;
+  uint64_t live_packets = 0;
+  uint32_t bad_packets = 0;
+  uint64_t drain_until_us = 0;
+
+  for (;;)
+  {
+    wall_frac += period_ns;
+    uint64_t step = (uint64_t)wall_frac;
+    wall_frac -= (double)step;
+    wall_ns += step;
+    uint64_t wall_us = wall_ns / 1000;
+
+    bool stalled = stall_len_us && wall_us >= t0_us + stall_at_us && wall_us < t0_us + stall_at_us + stall_len_us;
+    if (!stalled)
+    {
+      // Core 1 catches up with everything captured so far
+      while (have && last_us <= wall_us)
+      {
+        speculative.feed(f);
+        DeviceGuess g;
+        if (cls.feed(f, g))
+          speculative.commit(g.device);
+        if (feed.reopened)
+        {
+          cls.reset();
+          feed.reopened = false;
+        }
+
+        have = reader.next(f);
+        if (have)
+        {
+          last_us += (uint32_t)(f.t_us - prev_t);
+          prev_t = f.t_us;
+        }
+      }
+      pcm.advance((uint32_t)(wall_us - DacPcmSource::HOLDBACK_US));
+    }
+
+    if (!have && drain_until_us == 0)
+      drain_until_us = wall_us + 50000;
+    if (drain_until_us && wall_us >= drain_until_us)
+      break;
+
+    uint32_t len = packetizer.next_packet(packet);
+    if (len != UacPacketizer::PACKET_BYTES)
+      bad_packets++;
+    wav.write_bytes(packet, len);
+
+    if (!asrc.priming())
+    {
+      uint32_t fill = asrc.fill();
+      fill_sum += fill;
+      live_packets++;
+      if (fill < fill_min)
+        fill_min = fill;
+      if (fill > fill_max)
+        fill_max = fill;
+    }
+  }
+
+  uint64_t accounted = (uint64_t)asrc.frames_in() + asrc.overruns();
+  bool ok = bad_packets == 0 && accounted == pcm.samples();
+
+  const double frames_per_ms = UacPacketizer::RATE_HZ / 1000.0;
+  fprintf(stderr, "=== UAC Packetizer ===\n");
+  fprintf(stderr, "Frames          : %llu\n", (unsigned long long)reader.frames());
+  fprintf(stderr, "Device          : %s\n", lpt_device_name(feed.committed));
+  fprintf(stderr, "PCM samples     : %u (%u late events, %u DSS overflows)\n", pcm.samples(), pcm.late_events(),
+          pcm.dss_overflows());
+  fprintf(stderr, "Packets         : %u\n", packetizer.packets());
+  fprintf(stderr, "Clock offset    : %d ppm (loop estimate)\n", asrc.clock_ppm());
+  if (live_packets)
+    fprintf(stderr, "Latency         : %.2f ms avg (%.2f min, %.2f max)\n",
+            (double)fill_sum / live_packets / frames_per_ms, fill_min / frames_per_ms, fill_max / frames_per_ms);
+  fprintf(stderr, "Underruns       : %u (%u frames padded)\n", asrc.underruns(), asrc.padded_frames());
+  fprintf(stderr, "Overruns        : %u (%u frames skipped to restore latency)\n", asrc.overruns(),
+          asrc.skipped_frames());
+  if (wav_path)
+    fprintf(stderr, "WAV             : %s (%llu frames)\n", wav_path, (unsigned long long)wav.frames());
+  if (check)
+  {
+    fprintf(stderr, "Check           : %s", ok ? "OK" : "FAILED");
+    if (!ok)
+      fprintf(stderr, " (%u bad packets, %llu of %u samples accounted)", bad_packets, (unsigned long long)accounted,
+              pcm.samples());
+    fprintf(stderr, "\n");
+  }
+  return check && !ok ? 1 : 0;
+}
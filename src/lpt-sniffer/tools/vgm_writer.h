@@ -0,0 +1,147 @@
+/*
+ * PARALAX - minimal VGM 1.71 writer (host only)
+ * ThisOldCPU Project - https://github.com/thisoldcpu
+ *
+ * Collects chip commands in memory, converts capture microseconds to
+ * 44.1 kHz VGM wait commands from the absolute timestamp (no drift from
+ * rounding each gap), and writes header + data + end marker on finish().
+ *
+ * License : MIT
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <vector>
+
+// Header offsets of the clock fields we use
+static constexpr uint32_t VGM_OFS_SN76489 = 0x0C;
+static constexpr uint32_t VGM_OFS_YM3812 = 0x50;
+static constexpr uint32_t VGM_OFS_YMF262 = 0x5C;
+static constexpr uint32_t VGM_OFS_SAA1099 = 0xC8;
+
+// Clock bit 30 set = two chips of this type
+static constexpr uint32_t VGM_DUAL_CHIP = 0x40000000u;
+
+// Chip clocks of the devices PARALAX decodes
+static constexpr uint32_t CLOCK_SAA1099_CMS = 7159090;
+static constexpr uint32_t CLOCK_YM3812 = 3579545;
+static constexpr uint32_t CLOCK_YMF262 = 14318180;
+static constexpr uint32_t CLOCK_SN76489_TANDY = 3579545;
+
+// Command bytes
+static constexpr uint8_t VGM_CMD_SN76489 = 0x50;
+static constexpr uint8_t VGM_CMD_YM3812 = 0x5A;
+static constexpr uint8_t VGM_CMD_YMF262_P0 = 0x5E;
+static constexpr uint8_t VGM_CMD_YMF262_P1 = 0x5F;
+static constexpr uint8_t VGM_CMD_SAA1099 = 0xBD; // aa bit 7 = second chip
+
+class VgmWriter
+{
+public:
+  static constexpr uint32_t SAMPLE_RATE = 44100;
+  static constexpr uint32_t HEADER_SIZE = 0x100;
+
+  VgmWriter() { data_.reserve(1u << 20); }
+
+  void set_clock(uint32_t header_ofs, uint32_t hz) { clocks_.push_back({header_ofs, hz}); }
+
+  // Emit waits so the next command lands at capture time t_us.
+  // Timestamps are relative to the first one seen.
+  void advance_to(uint64_t t_us)
+  {
+    if (!have_t0_)
+    {
+      t0_us_ = t_us;
+      have_t0_ = true;
+    }
+    if (t_us < t0_us_)
+      return;
+    uint64_t target = ((t_us - t0_us_) * SAMPLE_RATE) / 1000000u;
+    if (target <= samples_)
+      return;
+    uint64_t gap = target - samples_;
+    samples_ = target;
+    while (gap > 0)
+    {
+      if (gap <= 16)
+      {
+        data_.push_back((uint8_t)(0x70 + gap - 1));
+        gap = 0;
+      }
+      else
+      {
+        uint32_t n = gap > 0xFFFF ? 0xFFFF : (uint32_t)gap;
+        data_.push_back(0x61);
+        data_.push_back((uint8_t)(n & 0xFF));
+        data_.push_back((uint8_t)(n >> 8));
+        gap -= n;
+      }
+    }
+  }
+
+  void write2(uint8_t cmd, uint8_t a, uint8_t d)
+  {
+    data_.push_back(cmd);
+    data_.push_back(a);
+    data_.push_back(d);
+    commands_++;
+  }
+
+  void write1(uint8_t cmd, uint8_t d)
+  {
+    data_.push_back(cmd);
+    data_.push_back(d);
+    commands_++;
+  }
+
+  uint64_t commands() const { return commands_; }
+  uint64_t samples() const { return samples_; }
+
+  bool finish(const char *path)
+  {
+    std::vector<uint8_t> hdr(HEADER_SIZE, 0);
+    uint32_t total = HEADER_SIZE + (uint32_t)data_.size() + 1;
+
+    put32(hdr, 0x00, 0x206D6756u); // "Vgm "
+    put32(hdr, 0x04, total - 0x04);
+    put32(hdr, 0x08, 0x00000171u);
+    put32(hdr, 0x18, (uint32_t)samples_);
+    put32(hdr, 0x34, HEADER_SIZE - 0x34);
+    for (const Clock &c : clocks_)
+      put32(hdr, c.ofs, c.hz);
+
+    FILE *fp = fopen(path, "wb");
+    if (!fp)
+      return false;
+    bool ok = fwrite(hdr.data(), 1, hdr.size(), fp) == hdr.size();
+    ok = ok && fwrite(data_.data(), 1, data_.size(), fp) == data_.size();
+    ok = ok && fputc(0x66, fp) != EOF;
+    ok = (fclose(fp) == 0) && ok;
+    return ok;
+  }
+
+private:
+  struct Clock
+  {
+    uint32_t ofs;
+    uint32_t hz;
+  };
+
+  static void put32(std::vector<uint8_t> &v, uint32_t ofs, uint32_t x)
+  {
+    v[ofs + 0] = (uint8_t)(x);
+    v[ofs + 1] = (uint8_t)(x >> 8);
+    v[ofs + 2] = (uint8_t)(x >> 16);
+    v[ofs + 3] = (uint8_t)(x >> 24);
+  }
+
+  std::vector<uint8_t> data_;
+  std::vector<Clock> clocks_;
+  uint64_t samples_ = 0;
+  uint64_t commands_ = 0;
+  uint64_t t0_us_ = 0;
+  bool have_t0_ = false;
+};
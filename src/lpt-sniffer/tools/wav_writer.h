@@ -0,0 +1,105 @@
+/*
+ * PARALAX - minimal WAV writer (host only)
+ * ThisOldCPU Project - https://github.com/thisoldcpu
+ *
+ * 16-bit PCM RIFF/WAVE. Samples stream straight to a buffered FILE; the
+ * RIFF and data sizes are patched on close(), so memory stays constant
+ * however long the output.
+ *
+ * License : MIT
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+
+class WavWriter
+{
+public:
+  WavWriter() = default;
+  WavWriter(const WavWriter &) = delete;
+  WavWriter &operator=(const WavWriter &) = delete;
+  ~WavWriter() { close(); }
+
+  bool open(const char *path, uint32_t rate_hz, uint16_t channels)
+  {
+    close();
+    fp_ = fopen(path, "wb");
+    if (!fp_)
+      return false;
+    setvbuf(fp_, nullptr, _IOFBF, 1u << 20);
+
+    channels_ = channels;
+    data_bytes_ = 0;
+
+    uint16_t block = (uint16_t)(channels * 2);
+    put_tag("RIFF");
+    put32(36); // patched on close
+    put_tag("WAVE");
+    put_tag("fmt ");
+    put32(16);
+    put16(1); // PCM
+    put16(channels);
+    put32(rate_hz);
+    put32(rate_hz * block);
+    put16(block);
+    put16(16);
+    put_tag("data");
+    put32(0); // patched on close
+    return true;
+  }
+
+  // Interleaved frames, `channels` samples each
+  void write(const int16_t *samples, uint32_t frames)
+  {
+    if (!fp_)
+      return;
+    uint32_t n = frames * channels_;
+    for (uint32_t i = 0; i < n; ++i)
+      put16((uint16_t)samples[i]);
+    data_bytes_ += n * 2;
+  }
+
+  // Already little-endian interleaved 16-bit bytes (e.g. a UAC packet)
+  void write_bytes(const uint8_t *bytes, uint32_t len)
+  {
+    if (!fp_)
+      return;
+    fwrite(bytes, 1, len, fp_);
+    data_bytes_ += len;
+  }
+
+  uint64_t frames() const { return channels_ ? data_bytes_ / (2u * channels_) : 0; }
+
+  void close()
+  {
+    if (!fp_)
+      return;
+    fseek(fp_, 4, SEEK_SET);
+    put32((uint32_t)(36 + data_bytes_));
+    fseek(fp_, 40, SEEK_SET);
+    put32((uint32_t)data_bytes_);
+    fclose(fp_);
+    fp_ = nullptr;
+  }
+
+private:
+  void put_tag(const char *tag) { fwrite(tag, 1, 4, fp_); }
+
+  void put16(uint16_t v)
+  {
+    uint8_t b[2] = {(uint8_t)v, (uint8_t)(v >> 8)};
+    fwrite(b, 1, 2, fp_);
+  }
+
+  void put32(uint32_t v)
+  {
+    uint8_t b[4] = {(uint8_t)v, (uint8_t)(v >> 8), (uint8_t)(v >> 16), (uint8_t)(v >> 24)};
+    fwrite(b, 1, 4, fp_);
+  }
+
+  FILE    *fp_ = nullptr;
+  uint16_t channels_ = 0;
+  uint64_t data_bytes_ = 0;
+};